@@ -0,0 +1,173 @@
+﻿//Component lookup on a scene of many game objects, every one with a transform, one in five with a light and one in a thousand
+//with a camera. GameObject::TryGetComponent tests a bit of the component mask and reads a slot, it is timed against the
+//dynamic_cast scan over the component list it replaced and against walking dense arrays, the best a per-type pool could do:
+//one array of component pointers, which saves the lookup, and one array of the translations themselves, which also saves the
+//pointer chase. Every path must find the same components before any timing is reported. Times are per game object.
+//Run from the build directory: ComponentLookupBenchmark [game objects] [iterations]
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "../Source/Model.hpp"
+#include "../Source/GameObject.hpp"
+#include "../Source/Components/CameraComponent.hpp"
+#include "../Source/Components/LightComponent.hpp"
+
+using namespace Kaamoo;
+
+namespace {
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    //How TryGetComponent worked before the component mask
+    template<typename T>
+    bool ScanComponents(const GameObject &gameObject, T *&component) {
+        for (auto *candidate: gameObject.getComponents()) {
+            if (auto *cast = dynamic_cast<T *>(candidate)) {
+                component = cast;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Keeps the loops from being optimised away and lets the paths be compared
+    struct Result {
+        float sum = 0;
+        size_t found = 0;
+
+        bool operator==(const Result &other) const { return sum == other.sum && found == other.found; }
+    };
+
+    volatile float sink;
+}
+
+int main(int argc, char **argv) {
+    size_t gameObjectCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 50;
+
+    GameObject::Map gameObjects;
+    gameObjects.reserve(gameObjectCount);
+    for (size_t i = 0; i < gameObjectCount; i++) {
+        auto gameObject = GameObject::createGameObject();
+        gameObject.transform->SetTranslation({static_cast<float>(i), 0, 0});
+        if (i % 5 == 0) gameObject.TryAddComponent(new LightComponent());
+        if (i % 1000 == 0) gameObject.TryAddComponent(new CameraComponent());
+        GameObject::insertInto(gameObjects, std::move(gameObject));
+    }
+    TransformComponent::UpdateDirtyTransforms();
+
+    std::vector<TransformComponent *> transformPool;
+    std::vector<LightComponent *> lightPool;
+    std::vector<glm::vec3> translationPool;
+    for (auto &gameObject: gameObjects) {
+        transformPool.push_back(gameObject.transform);
+        translationPool.push_back(gameObject.transform->GetRelativeTranslation());
+        LightComponent *lightComponent;
+        if (gameObject.TryGetComponent(lightComponent)) lightPool.push_back(lightComponent);
+    }
+
+    //Every object's transform, the common case
+    auto transformMask = [&gameObjects]() {
+        Result result;
+        for (auto &gameObject: gameObjects) {
+            TransformComponent *transformComponent;
+            if (!gameObject.TryGetComponent(transformComponent)) continue;
+            result.sum += transformComponent->GetRelativeTranslation().x;
+            result.found++;
+        }
+        return result;
+    };
+    auto transformScan = [&gameObjects]() {
+        Result result;
+        for (auto &gameObject: gameObjects) {
+            TransformComponent *transformComponent;
+            if (!ScanComponents(gameObject, transformComponent)) continue;
+            result.sum += transformComponent->GetRelativeTranslation().x;
+            result.found++;
+        }
+        return result;
+    };
+    auto transformPointers = [&transformPool]() {
+        Result result;
+        for (auto *transformComponent: transformPool) {
+            result.sum += transformComponent->GetRelativeTranslation().x;
+            result.found++;
+        }
+        return result;
+    };
+    auto transformValues = [&translationPool]() {
+        Result result;
+        for (const auto &translation: translationPool) {
+            result.sum += translation.x;
+            result.found++;
+        }
+        return result;
+    };
+
+    //A type most objects lack, every miss still costs a lookup
+    auto lightMask = [&gameObjects]() {
+        Result result;
+        for (auto &gameObject: gameObjects) {
+            LightComponent *lightComponent;
+            if (!gameObject.TryGetComponent(lightComponent)) continue;
+            result.sum += static_cast<float>(lightComponent->GetType());
+            result.found++;
+        }
+        return result;
+    };
+    auto lightScan = [&gameObjects]() {
+        Result result;
+        for (auto &gameObject: gameObjects) {
+            LightComponent *lightComponent;
+            if (!ScanComponents(gameObject, lightComponent)) continue;
+            result.sum += static_cast<float>(lightComponent->GetType());
+            result.found++;
+        }
+        return result;
+    };
+    auto lightPointers = [&lightPool]() {
+        Result result;
+        for (auto *lightComponent: lightPool) {
+            result.sum += static_cast<float>(lightComponent->GetType());
+            result.found++;
+        }
+        return result;
+    };
+
+    if (!(transformMask() == transformScan() && transformMask() == transformPointers() && transformMask() == transformValues() &&
+          lightMask() == lightScan() && lightMask() == lightPointers())) {
+        std::cout << "Lookups disagree" << std::endl;
+        return 1;
+    }
+
+    struct Case {
+        const char *name;
+        float milliseconds;
+    };
+    auto time = [iterations](auto &function) {
+        return MeasureMilliseconds(iterations, [&function]() { sink = function().sum; });
+    };
+    Case cases[] = {
+            {"transform, mask",           time(transformMask)},
+            {"transform, dynamic_cast",   time(transformScan)},
+            {"transform, pointer pool",   time(transformPointers)},
+            {"transform, value pool",     time(transformValues)},
+            {"light, mask",               time(lightMask)},
+            {"light, dynamic_cast",       time(lightScan)},
+            {"light, pointer pool",       time(lightPointers)},
+    };
+
+    std::cout << gameObjects.size() << " game objects, " << lightPool.size() << " lights" << std::endl;
+    std::cout << "lookup, ms per pass, ns per game object" << std::endl;
+    for (const auto &lookupCase: cases) {
+        std::cout << lookupCase.name << ", " << lookupCase.milliseconds << ", "
+                  << lookupCase.milliseconds * 1e6f / static_cast<float>(gameObjects.size()) << std::endl;
+    }
+    return 0;
+}
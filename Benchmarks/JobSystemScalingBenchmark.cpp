@@ -0,0 +1,133 @@
+﻿//JobSystem throughput from one thread up to many. Every pool size runs the same workloads:
+//  adaptive ParallelFor: a compute bound loop over many elements with AdaptiveGrain, the renderer's usual call
+//  fixed ParallelFor: the same loop in chunks of 1024 elements
+//  nested ParallelFor: an outer ParallelFor whose every index runs an inner one, as jobs calling into the pool do
+//  small jobs: many tiny jobs on one counter, which measures the cost of Run and Wait more than any work
+//  dependency chain: jobs that each depend on the one before, which cannot get faster and shows the hand off latency
+//The speedup column is against the same workload on one thread. The results of every pool size must match before any
+//timing is reported.
+//Run from the build directory: JobSystemScalingBenchmark [max threads] [iterations]
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Source/Utils/JobSystem.h"
+
+using namespace Kaamoo;
+
+namespace {
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    const size_t ElementCount = 1 << 20;
+    const size_t OuterCount = 64;
+    const size_t SmallJobCount = 20000;
+    const size_t ChainLength = 2000;
+
+    float Work(size_t i) {
+        float x = static_cast<float>(i) * 0.001f;
+        return std::sin(x) * std::cos(x * 0.5f) + std::sqrt(x);
+    }
+
+    void FillParallel(JobSystem &jobSystem, size_t grainSize, std::vector<float> &values) {
+        jobSystem.ParallelFor(values.size(), grainSize, [&values](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) values[i] = Work(i);
+        });
+    }
+
+    void FillNested(JobSystem &jobSystem, std::vector<float> &values) {
+        size_t innerCount = values.size() / OuterCount;
+        jobSystem.ParallelFor(OuterCount, 1, [&](size_t outerBegin, size_t outerEnd) {
+            for (size_t outer = outerBegin; outer < outerEnd; outer++) {
+                jobSystem.ParallelFor(innerCount, 1024, [&, outer](size_t begin, size_t end) {
+                    for (size_t i = outer * innerCount + begin; i < outer * innerCount + end; i++) values[i] = Work(i);
+                });
+            }
+        });
+    }
+
+    //Summed in order, so every pool size has to give the same result
+    double Sum(std::vector<float> &values) {
+        double sum = 0;
+        for (float value: values) sum += value;
+        std::fill(values.begin(), values.end(), 0.0f);
+        return sum;
+    }
+
+    size_t RunSmallJobs(JobSystem &jobSystem) {
+        std::atomic<size_t> ran{0};
+        JobSystem::Counter counter;
+        for (size_t i = 0; i < SmallJobCount; i++) {
+            jobSystem.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        }
+        jobSystem.Wait(counter);
+        return ran.load();
+    }
+
+    size_t RunChain(JobSystem &jobSystem) {
+        std::unique_ptr<JobSystem::Counter[]> counters(new JobSystem::Counter[ChainLength]);
+        size_t ran = 0;
+        for (size_t i = 0; i < ChainLength; i++) {
+            jobSystem.Run([&ran]() { ran++; }, &counters[i], i > 0 ? &counters[i - 1] : nullptr);
+        }
+        jobSystem.Wait(counters[ChainLength - 1]);
+        return ran;
+    }
+
+    volatile size_t sink;
+}
+
+int main(int argc, char **argv) {
+    size_t maxThreads = argc > 1 ? std::max(1, std::atoi(argv[1])) : std::max(4u, std::thread::hardware_concurrency());
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    const char *names[] = {"adaptive ParallelFor", "fixed ParallelFor", "nested ParallelFor", "small jobs", "dependency chain"};
+    const size_t workloadCount = sizeof(names) / sizeof(names[0]);
+    std::vector<float> singleThread(workloadCount);
+    double expected[workloadCount] = {};
+    std::vector<float> values(ElementCount);
+
+    std::cout << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "threads, workload, ms, speedup" << std::endl;
+    for (size_t threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobSystem(threads - 1);
+        double results[workloadCount] = {
+                (FillParallel(jobSystem, JobSystem::AdaptiveGrain, values), Sum(values)),
+                (FillParallel(jobSystem, 1024, values), Sum(values)),
+                (FillNested(jobSystem, values), Sum(values)),
+                static_cast<double>(RunSmallJobs(jobSystem)),
+                static_cast<double>(RunChain(jobSystem)),
+        };
+        for (size_t w = 0; w < workloadCount; w++) {
+            if (threads == 1) expected[w] = results[w];
+            if (results[w] != expected[w]) {
+                std::cout << names[w] << " disagrees on " << threads << " threads: " << results[w] << " against " << expected[w]
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        float milliseconds[workloadCount] = {
+                MeasureMilliseconds(iterations, [&]() { FillParallel(jobSystem, JobSystem::AdaptiveGrain, values); }),
+                MeasureMilliseconds(iterations, [&]() { FillParallel(jobSystem, 1024, values); }),
+                MeasureMilliseconds(iterations, [&]() { FillNested(jobSystem, values); }),
+                MeasureMilliseconds(iterations, [&]() { sink = RunSmallJobs(jobSystem); }),
+                MeasureMilliseconds(iterations, [&]() { sink = RunChain(jobSystem); }),
+        };
+        for (size_t w = 0; w < workloadCount; w++) {
+            if (threads == 1) singleThread[w] = milliseconds[w];
+            std::cout << threads << ", " << names[w] << ", " << milliseconds[w] << ", " << singleThread[w] / milliseconds[w] << std::endl;
+        }
+    }
+    return 0;
+}
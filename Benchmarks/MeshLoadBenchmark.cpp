@@ -0,0 +1,115 @@
+﻿//Cold vs warm mesh loads over Models/, plus the CPU side of the warm upload before and after the packed streams were cooked.
+//The OBJ files are copied to a temporary directory so the .kmesh files next to the real assets are left alone.
+//Run from the build directory: MeshLoadBenchmark [iterations]
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "../Source/Model.hpp"
+#include "../Source/Mesh/MeshCache.h"
+
+using namespace Kaamoo;
+
+namespace {
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    //What a warm load did before: copy Vertex and uint32 data out of the mapping, pack and narrow it, then copy into staging
+    void StageFromVectors(const Model::CookedStreams &cooked, std::vector<uint8_t> &staging) {
+        std::vector<Model::Vertex> vertices(cooked.vertexCount);
+        std::memcpy(vertices.data(), cooked.vertices, vertices.size() * sizeof(Model::Vertex));
+        std::vector<uint32_t> indices(cooked.indexCount);
+        std::memcpy(indices.data(), cooked.indices, indices.size() * sizeof(uint32_t));
+
+        uint8_t *positions = staging.data();
+        uint8_t *attributes = positions + vertices.size() * sizeof(Model::PackedPosition);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            Model::PackedVertex packed = Model::PackedVertex::pack(vertices[i]);
+            std::memcpy(positions + i * sizeof(Model::PackedPosition), &packed.position, sizeof(Model::PackedPosition));
+            std::memcpy(attributes + i * sizeof(Model::PackedAttributes), &packed.attributes, sizeof(Model::PackedAttributes));
+        }
+        uint8_t *rasterIndices = attributes + vertices.size() * sizeof(Model::PackedAttributes);
+        if (Model::UsesShortIndices(cooked.vertexCount)) {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            std::memcpy(rasterIndices, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+        } else {
+            std::memcpy(rasterIndices, indices.data(), indices.size() * sizeof(uint32_t));
+        }
+    }
+
+    //What Model::createBuffersFromCooked does now: one copy per stream from the mapping into staging
+    void StageFromMapping(const Model::CookedStreams &cooked, std::vector<uint8_t> &staging) {
+        size_t positionBytes = static_cast<size_t>(cooked.vertexCount) * sizeof(Model::PackedPosition);
+        size_t attributeBytes = static_cast<size_t>(cooked.vertexCount) * sizeof(Model::PackedAttributes);
+        size_t indexSize = Model::UsesShortIndices(cooked.vertexCount) ? sizeof(uint16_t) : sizeof(uint32_t);
+        std::memcpy(staging.data(), cooked.positions, positionBytes);
+        std::memcpy(staging.data() + positionBytes, cooked.attributes, attributeBytes);
+        std::memcpy(staging.data() + positionBytes + attributeBytes, cooked.rasterIndices, cooked.indexCount * indexSize);
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+    std::filesystem::path benchmarkDirectory = std::filesystem::temp_directory_path() / "KaamooMeshLoadBenchmark";
+    std::filesystem::create_directories(benchmarkDirectory);
+
+    std::vector<std::filesystem::path> sources;
+    for (const auto &entry: std::filesystem::directory_iterator(Model::BaseModelsPath)) {
+        if (entry.path().extension() == ".obj") sources.push_back(entry.path());
+    }
+    if (sources.empty()) {
+        std::cerr << "No OBJ files in " << Model::BaseModelsPath << ", run from the build directory" << std::endl;
+        return 1;
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::cout << "model, vertices, cold ms, warm ms, staging before ms, staging after ms" << std::endl;
+    for (const auto &source: sources) {
+        std::string path = (benchmarkDirectory / source.filename()).string();
+        std::filesystem::copy_file(source, path, std::filesystem::copy_options::overwrite_existing);
+
+        float coldMilliseconds = 0;
+        for (int i = 0; i < std::max(1, iterations / 10); i++) {
+            std::filesystem::remove(MeshCache::GetCookedPath(path));
+            coldMilliseconds += MeasureMilliseconds(1, [&]() {
+                Model::Builder builder;
+                builder.loadCached(path);
+            });
+        }
+        coldMilliseconds /= static_cast<float>(std::max(1, iterations / 10));
+
+        float warmMilliseconds = MeasureMilliseconds(iterations, [&]() {
+            Model::Builder builder;
+            builder.loadCached(path);
+        });
+
+        Model::Builder builder;
+        builder.loadCached(path);
+        if (builder.cooked == nullptr) {
+            std::cerr << "Warm load of " << path << " did not hit the cooked mesh" << std::endl;
+            return 1;
+        }
+        const Model::CookedStreams &cooked = *builder.cooked;
+        std::vector<uint8_t> staging(static_cast<size_t>(cooked.vertexCount) * (sizeof(Model::PackedPosition) + sizeof(Model::PackedAttributes)) +
+                                     static_cast<size_t>(cooked.indexCount) * sizeof(uint32_t));
+        float beforeMilliseconds = MeasureMilliseconds(iterations, [&]() { StageFromVectors(cooked, staging); });
+        std::vector<uint8_t> beforeStaging = staging;
+        float afterMilliseconds = MeasureMilliseconds(iterations, [&]() { StageFromMapping(cooked, staging); });
+        if (beforeStaging != staging) {
+            std::cerr << "Cooked streams of " << path << " differ from packing the vertices at load time" << std::endl;
+            return 1;
+        }
+
+        std::cout << source.filename().string() << ", " << cooked.vertexCount << ", " << coldMilliseconds << ", " << warmMilliseconds << ", "
+                  << beforeMilliseconds << ", " << afterMilliseconds << std::endl;
+    }
+
+    std::filesystem::remove_all(benchmarkDirectory);
+    return 0;
+}
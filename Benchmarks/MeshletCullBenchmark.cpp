@@ -0,0 +1,84 @@
+﻿//Triangles submitted by the meshlet culled path against drawing the whole mesh, for every model in Models/ that gets meshlets.
+//The camera orbits each model at a few distances, looking at it and past it, and MeshletCuller::Cull, the CPU reference of
+//MeshletCull.comp, decides which clusters are drawn. Without meshlets RenderSystem draws every triangle of LOD 0.
+//GPU time is not measured here, the cull time column is the CPU reference and only gives the relative cost per object.
+//Run from the build directory: MeshletCullBenchmark [views per orbit]
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "../Source/Model.hpp"
+#include "../Source/Mesh/MeshOptimizer.h"
+#include "../Source/Mesh/MeshletBuilder.h"
+#include "../Source/Mesh/MeshletCuller.h"
+
+using namespace Kaamoo;
+
+namespace {
+    //Same as CameraComponent::CorrectionMatrix, flips y and maps depth to [0, w]
+    const glm::mat4 CorrectionMatrix = glm::mat4{
+            1, 0, 0, 0,
+            0, -1, 0, 0,
+            0, 0, 0.5f, 0,
+            0, 0, 0.5f, 1
+    };
+}
+
+int main(int argc, char **argv) {
+    int viewsPerOrbit = argc > 1 ? std::max(1, std::atoi(argv[1])) : 64;
+    const float distances[] = {1.5f, 3.0f, 6.0f};
+    const float pi = 3.14159265f;
+
+    std::vector<std::string> paths;
+    for (const auto &entry: std::filesystem::directory_iterator(Model::BaseModelsPath)) {
+        if (entry.path().extension() == ".obj") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::cout << "model, triangles, meshlets, whole mesh triangles, culled triangles, submitted, cull us per object" << std::endl;
+    for (const auto &path: paths) {
+        //Same import steps as loadCached up to the meshlets, without touching the cooked files
+        Model::Builder builder;
+        builder.loadModel(path);
+        MeshOptimizer::Optimize(builder, path);
+        MeshletBuilder::Build(builder, path);
+        if (builder.meshlets.empty()) continue;
+
+        glm::vec3 center = (builder.boundsMin + builder.boundsMax) * 0.5f;
+        float radius = builder.maxRadius;
+        glm::mat4 projection = CorrectionMatrix * glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, 100.0f * radius);
+        glm::mat4 modelMatrix(1.0f);
+        uint64_t triangleCount = builder.indices.size() / 3;
+
+        uint64_t wholeTriangles = 0, culledTriangles = 0, cullCount = 0;
+        std::vector<VkDrawIndexedIndirectCommand> draws;
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (float distance: distances) {
+            for (int view = 0; view < viewsPerOrbit; view++) {
+                float angle = 2.0f * pi * static_cast<float>(view) / static_cast<float>(viewsPerOrbit);
+                glm::vec3 cameraPosition = center + glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * (distance * radius);
+                //Every other view looks past the model so part of it leaves the frustum
+                glm::vec3 target = view % 2 == 0 ? center : center + glm::vec3(-std::sin(angle), 0.0f, std::cos(angle)) * radius;
+                glm::mat4 projectionView = projection * glm::lookAt(cameraPosition, target, glm::vec3(0, 1, 0));
+
+                MeshletCuller::CullParameters parameters = MeshletCuller::MakeParameters(projectionView, modelMatrix, cameraPosition);
+                parameters.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+                draws.clear();
+                MeshletCuller::Cull(builder.meshlets, parameters, draws);
+                cullCount++;
+
+                wholeTriangles += triangleCount;
+                for (const auto &draw: draws) culledTriangles += draw.indexCount / 3;
+            }
+        }
+        float cullMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count() /
+                                 static_cast<float>(cullCount);
+
+        std::cout << std::filesystem::path(path).filename().string() << ", " << triangleCount << ", " << builder.meshlets.size() << ", "
+                  << wholeTriangles / cullCount << ", " << culledTriangles / cullCount << ", "
+                  << 100.0f * static_cast<float>(culledTriangles) / static_cast<float>(wholeTriangles) << "%, " << cullMicroseconds << std::endl;
+    }
+    return 0;
+}
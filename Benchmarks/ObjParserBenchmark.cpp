@@ -0,0 +1,135 @@
+﻿//OBJ import throughput of ObjParser against tinyobj on Models/ and on generated meshes of a few sizes.
+//ObjParser::Parse is called directly so the parallel path runs even below ObjParser::ParallelThreshold,
+//and its attributes and corners are compared with tinyobj's before any timing is reported.
+//Run from the build directory: ObjParserBenchmark [iterations]
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "../External/tiny_obj_loader.h"
+#include "../Source/Model.hpp"
+#include "../Source/Mesh/ObjParser.h"
+#include "../Source/Utils/MappedFile.h"
+#include "../Source/Utils/JobSystem.h"
+
+using namespace Kaamoo;
+
+namespace {
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    bool LoadWithTinyObj(const std::string &path, tinyobj::attrib_t &attrib, std::vector<tinyobj::index_t> &corners) {
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        attrib = tinyobj::attrib_t{};
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) return false;
+        corners.clear();
+        for (const auto &shape: shapes) {
+            corners.insert(corners.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+        }
+        return true;
+    }
+
+    bool LoadWithObjParser(const std::string &path, tinyobj::attrib_t &attrib, std::vector<tinyobj::index_t> &corners) {
+        MappedFile source(path);
+        if (source.data() == nullptr) return false;
+        attrib = tinyobj::attrib_t{};
+        corners.clear();
+        return ObjParser::Parse(source.data(), source.size(), attrib, corners);
+    }
+
+    bool SameCorners(const std::vector<tinyobj::index_t> &a, const std::vector<tinyobj::index_t> &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const tinyobj::index_t &x, const tinyobj::index_t &y) {
+            return x.vertex_index == y.vertex_index && x.normal_index == y.normal_index && x.texcoord_index == y.texcoord_index;
+        });
+    }
+
+    //A wavy grid of quads and triangles with uvs, normals and relative indices on every other row, about targetBytes large
+    void WriteGrid(const std::string &path, size_t targetBytes) {
+        size_t side = 2;
+        while (side * side * 150 < targetBytes) side++;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        for (size_t y = 0; y < side; y++) {
+            for (size_t x = 0; x < side; x++) {
+                float u = static_cast<float>(x) / static_cast<float>(side - 1);
+                float v = static_cast<float>(y) / static_cast<float>(side - 1);
+                file << "v " << u * 10.0f << ' ' << std::sin(u * 20.0f) * std::cos(v * 20.0f) << ' ' << v * 10.0f << '\n';
+                file << "vt " << u << ' ' << v << '\n';
+                file << "vn " << 0.0f << ' ' << 1.0f << ' ' << 0.0f << '\n';
+            }
+        }
+        for (size_t y = 0; y + 1 < side; y++) {
+            for (size_t x = 0; x + 1 < side; x++) {
+                size_t a = y * side + x + 1, b = a + 1, c = a + side + 1, d = a + side;
+                if (y % 2 == 0) {
+                    file << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/' << b << ' '
+                         << c << '/' << c << '/' << c << ' ' << d << '/' << d << '/' << d << '\n';
+                } else {
+                    long total = static_cast<long>(side * side);
+                    long ra = static_cast<long>(a) - total - 1, rb = static_cast<long>(b) - total - 1;
+                    long rc = static_cast<long>(c) - total - 1, rd = static_cast<long>(d) - total - 1;
+                    file << "f " << ra << '/' << ra << '/' << ra << ' ' << rb << '/' << rb << '/' << rb << ' ' << rc << '/' << rc << '/' << rc << '\n';
+                    file << "f " << ra << '/' << ra << '/' << ra << ' ' << rc << '/' << rc << '/' << rc << ' ' << rd << '/' << rd << '/' << rd << '\n';
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    std::filesystem::path benchmarkDirectory = std::filesystem::temp_directory_path() / "KaamooObjParserBenchmark";
+    std::filesystem::create_directories(benchmarkDirectory);
+
+    std::vector<std::string> paths;
+    for (const auto &entry: std::filesystem::directory_iterator(Model::BaseModelsPath)) {
+        if (entry.path().extension() == ".obj") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (size_t megabytes: {1, 4, 16, 64}) {
+        std::string path = (benchmarkDirectory / ("grid_" + std::to_string(megabytes) + "mb.obj")).string();
+        WriteGrid(path, megabytes * 1024 * 1024);
+        paths.push_back(path);
+    }
+
+    std::cout << "ObjParser on " << JobSystem::GetInstance().GetConcurrency() << " threads, ParallelThreshold "
+              << ObjParser::ParallelThreshold / 1024 << " KB" << std::endl;
+    std::cout << "file, MB, tinyobj MB/s, ObjParser MB/s, speed up" << std::endl;
+    int failures = 0;
+    for (const auto &path: paths) {
+        tinyobj::attrib_t serialAttrib, parallelAttrib;
+        std::vector<tinyobj::index_t> serialCorners, parallelCorners;
+        if (!LoadWithTinyObj(path, serialAttrib, serialCorners)) {
+            std::cerr << "tinyobj failed on " << path << std::endl;
+            failures++;
+            continue;
+        }
+        if (!LoadWithObjParser(path, parallelAttrib, parallelCorners)) {
+            std::cout << std::filesystem::path(path).filename().string() << ": uses features only tinyobj reads, skipped" << std::endl;
+            continue;
+        }
+        if (serialAttrib.vertices != parallelAttrib.vertices || serialAttrib.normals != parallelAttrib.normals ||
+            serialAttrib.texcoords != parallelAttrib.texcoords || serialAttrib.colors != parallelAttrib.colors ||
+            !SameCorners(serialCorners, parallelCorners)) {
+            std::cerr << "ObjParser output differs from tinyobj on " << path << std::endl;
+            failures++;
+            continue;
+        }
+
+        float serialMilliseconds = MeasureMilliseconds(iterations, [&]() { LoadWithTinyObj(path, serialAttrib, serialCorners); });
+        float parallelMilliseconds = MeasureMilliseconds(iterations, [&]() { LoadWithObjParser(path, parallelAttrib, parallelCorners); });
+        float megabytes = static_cast<float>(std::filesystem::file_size(path)) / (1024.0f * 1024.0f);
+        std::cout << std::filesystem::path(path).filename().string() << ", " << megabytes << ", " << megabytes / serialMilliseconds * 1000.0f
+                  << ", " << megabytes / parallelMilliseconds * 1000.0f << ", " << serialMilliseconds / parallelMilliseconds << std::endl;
+    }
+
+    std::filesystem::remove_all(benchmarkDirectory);
+    return failures == 0 ? 0 : 1;
+}
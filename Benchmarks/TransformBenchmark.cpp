@@ -0,0 +1,162 @@
+﻿//Frame cost of world transforms before and after they were cached. The scene is chains of four transforms, parents composing
+//into their children. Every frame a share of the chains' roots moves, then every object's world matrix is read a few times, as
+//the LOD selection, texture streaming, shadow and main passes do.
+//  uncached: the old mat4(), which walked up the parents and composed translate * rotate * scale on every read
+//  lazy: the cached mat4(), rebuilding a dirty transform on its first read
+//  batched: UpdateDirtyTransforms once per frame, as LogicManager does, then the cached mat4()
+//The three must produce the same matrices before any timing is reported.
+//Run from the build directory: TransformBenchmark [game objects] [moving percent] [frames]
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "../Source/Model.hpp"
+#include "../Source/GameObject.hpp"
+
+using namespace Kaamoo;
+
+namespace {
+    const size_t ChainLength = 4;
+    //Reads of each world matrix per frame
+    const int ReadsPerFrame = 4;
+
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    bool Composes(const TransformComponent *transform) {
+        return transform->GetParent() != nullptr && transform->GetTransformId() != -1;
+    }
+
+    //TransformComponent's world getters and mat4() before the cache
+    glm::vec3 UncachedTranslation(const TransformComponent *transform) {
+        if (Composes(transform)) return transform->GetRelativeTranslation() + UncachedTranslation(transform->GetParent());
+        return transform->GetRelativeTranslation();
+    }
+
+    glm::vec3 UncachedRotation(const TransformComponent *transform) {
+        if (Composes(transform)) return transform->GetRelativeRotation() + UncachedRotation(transform->GetParent());
+        return transform->GetRelativeRotation();
+    }
+
+    glm::vec3 UncachedScale(const TransformComponent *transform) {
+        if (Composes(transform)) return transform->GetRelativeScale() * UncachedScale(transform->GetParent());
+        return transform->GetRelativeScale();
+    }
+
+    glm::mat4 UncachedMat4(const TransformComponent *transform) {
+        auto matrix = glm::translate(glm::mat4{1.f}, UncachedTranslation(transform));
+        auto worldRotation = UncachedRotation(transform);
+        matrix = glm::rotate(matrix, worldRotation.y, {0, 1, 0});
+        matrix = glm::rotate(matrix, worldRotation.x, {1, 0, 0});
+        matrix = glm::rotate(matrix, worldRotation.z, {0, 0, 1});
+        return glm::scale(matrix, UncachedScale(transform));
+    }
+
+    bool SameMatrix(const glm::mat4 &a, const glm::mat4 &b) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                if (std::abs(a[column][row] - b[column][row]) > 1e-4f * std::max(1.0f, std::abs(a[column][row]))) return false;
+            }
+        }
+        return true;
+    }
+
+    volatile float sink;
+}
+
+int main(int argc, char **argv) {
+    size_t gameObjectCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+    int movingPercent = argc > 2 ? std::clamp(std::atoi(argv[2]), 0, 100) : 10;
+    int frames = argc > 3 ? std::max(1, std::atoi(argv[3])) : 100;
+
+    GameObject::Map gameObjects;
+    gameObjects.reserve(gameObjectCount);
+    for (size_t i = 0; i < gameObjectCount; i++) {
+        GameObject::insertInto(gameObjects, GameObject::createGameObject());
+    }
+    std::vector<TransformComponent *> transforms;
+    std::vector<TransformComponent *> roots;
+    for (auto &gameObject: gameObjects) {
+        auto *transform = gameObject.transform;
+        size_t index = transforms.size();
+        transform->SetTransformId(static_cast<int32_t>(index));
+        transform->SetTranslation({static_cast<float>(index % 100), static_cast<float>(index / 100), 1.0f});
+        transform->SetRotation({0.1f * static_cast<float>(index % 7), 0.2f, 0.05f * static_cast<float>(index % 5)});
+        transform->SetScale({1.0f, 1.0f + 0.01f * static_cast<float>(index % 3), 1.0f});
+        if (index % ChainLength == 0) {
+            roots.push_back(transform);
+        } else {
+            transforms.back()->AddChild(transform);
+        }
+        transforms.push_back(transform);
+    }
+    TransformComponent::UpdateDirtyTransforms();
+
+    size_t movingCount = roots.size() * movingPercent / 100;
+    int frame = 0;
+    auto move = [&roots, movingCount, &frame]() {
+        frame++;
+        for (size_t i = 0; i < movingCount; i++) {
+            //Spread the moving roots over the scene and vary them between frames
+            auto *root = roots[(i * roots.size() / std::max<size_t>(1, movingCount) + frame) % roots.size()];
+            root->SetTranslation(root->GetRelativeTranslation() + glm::vec3{0.01f, 0, 0});
+            root->SetRotation(root->GetRelativeRotation() + glm::vec3{0, 0.01f, 0});
+        }
+    };
+
+    auto uncached = [&]() {
+        move();
+        float sum = 0;
+        for (int read = 0; read < ReadsPerFrame; read++) {
+            for (auto *transform: transforms) sum += UncachedMat4(transform)[3][0];
+        }
+        sink = sum;
+    };
+    auto lazy = [&]() {
+        move();
+        float sum = 0;
+        for (int read = 0; read < ReadsPerFrame; read++) {
+            for (auto *transform: transforms) sum += transform->mat4()[3][0];
+        }
+        sink = sum;
+    };
+    auto batched = [&]() {
+        move();
+        TransformComponent::UpdateDirtyTransforms();
+        float sum = 0;
+        for (int read = 0; read < ReadsPerFrame; read++) {
+            for (auto *transform: transforms) sum += transform->mat4()[3][0];
+        }
+        sink = sum;
+    };
+
+    //Move every root once, then check the cache against the old composition
+    for (auto *root: roots) root->SetTranslation(root->GetRelativeTranslation() + glm::vec3{0, 0.5f, 0});
+    TransformComponent::UpdateDirtyTransforms();
+    for (auto *transform: transforms) {
+        if (!SameMatrix(transform->mat4(), UncachedMat4(transform))) {
+            std::cout << "Cached and uncached world matrices disagree" << std::endl;
+            return 1;
+        }
+    }
+
+    float uncachedMilliseconds = MeasureMilliseconds(frames, uncached);
+    float lazyMilliseconds = MeasureMilliseconds(frames, lazy);
+    float batchedMilliseconds = MeasureMilliseconds(frames, batched);
+    //Whatever moved in the lazy run was rebuilt on demand, UpdateDirtyTransforms finds nothing dirty
+    TransformComponent::UpdateDirtyTransforms();
+
+    std::cout << transforms.size() << " transforms in chains of " << ChainLength << ", " << movingCount << " of " << roots.size()
+              << " roots moving per frame, " << ReadsPerFrame << " reads of every world matrix" << std::endl;
+    std::cout << "path, ms per frame" << std::endl;
+    std::cout << "uncached, " << uncachedMilliseconds << std::endl;
+    std::cout << "lazy, " << lazyMilliseconds << std::endl;
+    std::cout << "batched, " << batchedMilliseconds << std::endl;
+    return 0;
+}
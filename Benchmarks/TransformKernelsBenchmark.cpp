@@ -0,0 +1,162 @@
+﻿//World matrix composition for many animated transforms, scalar against SIMD.
+//The kernels compose random translations, Euler rotations and scales with three glm::rotate calls as TransformComponent used
+//to, with TransformKernels::ComposeScalar, with the SSE2 and, when the CPU has it, the AVX2 kernel, all checked against glm
+//first.
+//The frame rows move every transform of a scene and rebuild the world matrices the two ways TransformComponent can: one at a
+//time from mat4(), which uses the scalar kernel, or in one TransformComponent::UpdateDirtyTransforms pass, which uses Compose.
+//Run from the build directory: TransformKernelsBenchmark [transforms] [iterations]
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include "../Source/Model.hpp"
+#include "../Source/GameObject.hpp"
+#include "../Source/Utils/TransformKernels.h"
+
+using namespace Kaamoo;
+
+namespace {
+    template<typename Function>
+    float MeasureMilliseconds(int iterations, Function &&function) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) function();
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+    }
+
+    void ComposeGlm(const TRSArrays &trs, size_t count, float *matrices) {
+        for (size_t i = 0; i < count; i++) {
+            auto matrix = glm::translate(glm::mat4{1.f}, {trs.translation[0][i], trs.translation[1][i], trs.translation[2][i]});
+            matrix = glm::rotate(matrix, trs.rotation[1][i], {0, 1, 0});
+            matrix = glm::rotate(matrix, trs.rotation[0][i], {1, 0, 0});
+            matrix = glm::rotate(matrix, trs.rotation[2][i], {0, 0, 1});
+            matrix = glm::scale(matrix, {trs.scale[0][i], trs.scale[1][i], trs.scale[2][i]});
+            std::copy_n(&matrix[0][0], 16, matrices + i * 16);
+        }
+    }
+
+    //Largest difference relative to the matrix's largest element
+    float MaxRelativeError(const std::vector<float> &reference, const std::vector<float> &matrices) {
+        float maxError = 0;
+        for (size_t i = 0; i < reference.size(); i += 16) {
+            float magnitude = 1.0f;
+            for (size_t j = 0; j < 16; j++) magnitude = std::max(magnitude, std::abs(reference[i + j]));
+            for (size_t j = 0; j < 16; j++) maxError = std::max(maxError, std::abs(reference[i + j] - matrices[i + j]) / magnitude);
+        }
+        return maxError;
+    }
+
+    volatile float sink;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::max(1, std::atoi(argv[1])) : 50000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 50;
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-6.3f, 6.3f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    std::vector<float> values[9];
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < 3; j++) values[j].push_back(position(random));
+        for (int j = 3; j < 6; j++) values[j].push_back(angle(random));
+        for (int j = 6; j < 9; j++) values[j].push_back(scale(random));
+    }
+    TRSArrays trs{{values[0].data(), values[1].data(), values[2].data()},
+                  {values[3].data(), values[4].data(), values[5].data()},
+                  {values[6].data(), values[7].data(), values[8].data()}};
+
+    std::vector<float> reference(count * 16), matrices(count * 16);
+    ComposeGlm(trs, count, reference.data());
+    TransformKernels::ComposeScalar(trs, 0, count, matrices.data());
+    float scalarError = MaxRelativeError(reference, matrices);
+    //The SIMD kernels take multiples of their width, the scalar kernel finishes the rest
+    size_t sseCount = count & ~static_cast<size_t>(3);
+    size_t avxCount = count & ~static_cast<size_t>(7);
+    bool hasAVX2 = TransformKernels::HasAVX2();
+    auto composeSSE = [&]() {
+        TransformKernels::ComposeSSE(trs, 0, sseCount, matrices.data());
+        TransformKernels::ComposeScalar(trs, sseCount, count, matrices.data());
+    };
+    auto composeAVX2 = [&]() {
+        TransformKernels::ComposeAVX2(trs, 0, avxCount, matrices.data());
+        TransformKernels::ComposeScalar(trs, avxCount, count, matrices.data());
+    };
+    composeSSE();
+    float sseError = MaxRelativeError(reference, matrices);
+    float avxError = 0;
+    if (hasAVX2) {
+        composeAVX2();
+        avxError = MaxRelativeError(reference, matrices);
+    }
+    if (scalarError > 1e-4f || sseError > 1e-4f || avxError > 1e-4f) {
+        std::cout << "Kernels disagree with glm: scalar " << scalarError << ", sse2 " << sseError << ", avx2 " << avxError << std::endl;
+        return 1;
+    }
+
+    float glmMilliseconds = MeasureMilliseconds(iterations, [&]() {
+        ComposeGlm(trs, count, matrices.data());
+        sink = matrices[0];
+    });
+    float scalarMilliseconds = MeasureMilliseconds(iterations, [&]() {
+        TransformKernels::ComposeScalar(trs, 0, count, matrices.data());
+        sink = matrices[0];
+    });
+    float sseMilliseconds = MeasureMilliseconds(iterations, [&]() {
+        composeSSE();
+        sink = matrices[0];
+    });
+    float avxMilliseconds = hasAVX2 ? MeasureMilliseconds(iterations, [&]() {
+        composeAVX2();
+        sink = matrices[0];
+    }) : 0;
+
+    //A scene of count root transforms that all move every frame
+    GameObject::Map gameObjects;
+    gameObjects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        GameObject::insertInto(gameObjects, GameObject::createGameObject());
+    }
+    std::vector<TransformComponent *> transforms;
+    for (auto &gameObject: gameObjects) {
+        size_t i = transforms.size();
+        gameObject.transform->SetTranslation({values[0][i], values[1][i], values[2][i]});
+        gameObject.transform->SetRotation({values[3][i], values[4][i], values[5][i]});
+        gameObject.transform->SetScale({values[6][i], values[7][i], values[8][i]});
+        transforms.push_back(gameObject.transform);
+    }
+    TransformComponent::UpdateDirtyTransforms();
+    auto animate = [&transforms]() {
+        for (auto *transform: transforms) transform->Rotate({0, 0.01f, 0});
+    };
+    float oneAtATimeMilliseconds = MeasureMilliseconds(iterations, [&]() {
+        animate();
+        float sum = 0;
+        for (auto *transform: transforms) sum += transform->mat4()[0][0];
+        sink = sum;
+        //Everything was rebuilt on demand above, nothing is left to do
+        TransformComponent::UpdateDirtyTransforms();
+    });
+    float batchedMilliseconds = MeasureMilliseconds(iterations, [&]() {
+        animate();
+        TransformComponent::UpdateDirtyTransforms();
+        float sum = 0;
+        for (auto *transform: transforms) sum += transform->mat4()[0][0];
+        sink = sum;
+    });
+
+    std::cout << count << " transforms, max relative error against glm: scalar " << scalarError << ", sse2 " << sseError;
+    if (hasAVX2) std::cout << ", avx2 " << avxError;
+    std::cout << std::endl;
+    std::cout << "path, ms" << std::endl;
+    std::cout << "compose, glm rotates, " << glmMilliseconds << std::endl;
+    std::cout << "compose, scalar kernel, " << scalarMilliseconds << std::endl;
+    std::cout << "compose, sse2 kernel, " << sseMilliseconds << std::endl;
+    if (hasAVX2) std::cout << "compose, avx2 kernel, " << avxMilliseconds << std::endl;
+    std::cout << "frame, mat4 one at a time, " << oneAtATimeMilliseconds << std::endl;
+    std::cout << "frame, UpdateDirtyTransforms, " << batchedMilliseconds << std::endl;
+    return 0;
+}
@@ -0,0 +1,66 @@
+﻿//Headless check of HierarchyTree with children added before their parent, registered with CTest in Checks/CMakeLists.txt
+#include <iostream>
+#include "../Source/Model.hpp"
+#include "../Source/GameObject.hpp"
+
+using namespace Kaamoo;
+
+namespace {
+    int failures = 0;
+
+    void Expect(bool condition, const char *name) {
+        std::cout << (condition ? "passed: " : "FAILED: ") << name << std::endl;
+        if (!condition) failures++;
+    }
+
+    GameObject &MakeGameObject(GameObject::Map &gameObjects) {
+        return *gameObjects.get(GameObject::insertInto(gameObjects, GameObject::createGameObject()));
+    }
+
+    size_t ChildCount(HierarchyTree::Node *node) {
+        size_t count = 0;
+        for (auto *child = node->firstChild; child != nullptr; child = child->nextSibling) count++;
+        return count;
+    }
+}
+
+int main() {
+    GameObject::Map gameObjects;
+    gameObjects.reserve(16);
+    HierarchyTree tree;
+    auto *root = tree.GetRoot();
+
+    //A waiting child is moved under its parent once the parent is added
+    auto &waitingObject = MakeGameObject(gameObjects);
+    auto &parentObject = MakeGameObject(gameObjects);
+    tree.AddNode(1, 2, waitingObject);
+    Expect(tree.FindNode(2)->parent == root, "waiting: parked under the root");
+    tree.AddNode(HierarchyTree::ROOT_ID, 1, parentObject);
+    Expect(tree.FindNode(2)->parent == tree.FindNode(1), "waiting: adopted by its parent");
+
+    //A removed waiting child leaves nothing behind for the node that recycles it
+    auto &removedObject = MakeGameObject(gameObjects);
+    auto &recycledObject = MakeGameObject(gameObjects);
+    auto &lateParentObject = MakeGameObject(gameObjects);
+    tree.AddNode(3, 4, removedObject);
+    Expect(tree.RemoveNode(4, gameObjects), "remove: waiting child removed");
+    tree.AddNode(HierarchyTree::ROOT_ID, 5, recycledObject);
+    tree.AddNode(HierarchyTree::ROOT_ID, 3, lateParentObject);
+    Expect(tree.FindNode(5)->parent == root, "remove: recycled node stays under the root");
+    Expect(ChildCount(tree.FindNode(3)) == 0, "remove: late parent adopts nothing");
+    Expect(ChildCount(root) == 3, "remove: root keeps its children");
+
+    //A reparented waiting child stays where it was moved
+    auto &movedObject = MakeGameObject(gameObjects);
+    auto &otherParentObject = MakeGameObject(gameObjects);
+    tree.AddNode(6, 7, movedObject);
+    Expect(tree.Reparent(7, 1, gameObjects), "reparent: waiting child moved");
+    tree.AddNode(HierarchyTree::ROOT_ID, 6, otherParentObject);
+    Expect(tree.FindNode(7)->parent == tree.FindNode(1), "reparent: stays under the new parent");
+    Expect(ChildCount(tree.FindNode(6)) == 0, "reparent: awaited parent adopts nothing");
+    Expect(movedObject.transform->GetParent() == parentObject.transform, "reparent: transform follows the tree");
+    Expect(ChildCount(tree.FindNode(1)) == 2, "reparent: new parent has both children");
+
+    std::cout << (failures == 0 ? "All hierarchy tree checks passed" : "Hierarchy tree checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
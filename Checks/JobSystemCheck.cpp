@@ -0,0 +1,161 @@
+﻿//Headless stress check of JobSystem, registered with CTest in Checks/CMakeLists.txt. Every case runs many rounds on pools of
+//several sizes, so lost wake ups, lost jobs and continuations that run early show up as a hang or a failure here
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "../Source/Utils/JobSystem.h"
+
+using namespace Kaamoo;
+
+namespace {
+    int failures = 0;
+
+    void Expect(bool condition, const std::string &name) {
+        std::cout << (condition ? "passed: " : "FAILED: ") << name << std::endl;
+        if (!condition) failures++;
+    }
+
+    const int Rounds = 50;
+
+    //Every index of an outer ParallelFor runs an inner one, each element is visited exactly once
+    bool NestedParallelFor(JobSystem &jobSystem) {
+        const size_t outerCount = 32;
+        const size_t innerCount = 1000;
+        std::vector<std::atomic<int>> visits(outerCount * innerCount);
+        for (auto &visit: visits) visit.store(0);
+        jobSystem.ParallelFor(outerCount, 1, [&](size_t outerBegin, size_t outerEnd) {
+            for (size_t i = outerBegin; i < outerEnd; i++) {
+                jobSystem.ParallelFor(innerCount, JobSystem::AdaptiveGrain, [&, i](size_t begin, size_t end) {
+                    for (size_t j = begin; j < end; j++) visits[i * innerCount + j].fetch_add(1);
+                });
+            }
+        });
+        for (auto &visit: visits) {
+            if (visit.load() != 1) return false;
+        }
+        return true;
+    }
+
+    //Each job of a chain depends on the counter of the one before it and has to see it finished
+    bool DependencyChain(JobSystem &jobSystem) {
+        const size_t length = 500;
+        std::unique_ptr<JobSystem::Counter[]> counters(new JobSystem::Counter[length]);
+        std::atomic<size_t> finished{0};
+        std::atomic<bool> ordered{true};
+        for (size_t i = 0; i < length; i++) {
+            jobSystem.Run([&finished, &ordered, i]() {
+                if (finished.load() != i) ordered.store(false);
+                finished.fetch_add(1);
+            }, &counters[i], i > 0 ? &counters[i - 1] : nullptr);
+        }
+        jobSystem.Wait(counters[length - 1]);
+        return ordered.load() && finished.load() == length;
+    }
+
+    //Many jobs wait on one counter, then one job waits on all of them
+    bool FanOutFanIn(JobSystem &jobSystem) {
+        const size_t width = 200;
+        JobSystem::Counter first, middle, last;
+        std::atomic<bool> firstDone{false};
+        std::atomic<size_t> middleDone{0};
+        std::atomic<bool> ordered{true};
+        std::atomic<bool> lastSawAll{false};
+        jobSystem.Run([&firstDone]() { firstDone.store(true); }, &first);
+        for (size_t i = 0; i < width; i++) {
+            jobSystem.Run([&]() {
+                if (!firstDone.load()) ordered.store(false);
+                middleDone.fetch_add(1);
+            }, &middle, &first);
+        }
+        jobSystem.Run([&]() { lastSawAll.store(middleDone.load() == width); }, &last, &middle);
+        jobSystem.Wait(last);
+        return ordered.load() && lastSawAll.load();
+    }
+
+    //The first exception of a counter's jobs reaches Wait, the other jobs still run and the counter still finishes
+    bool CounterException(JobSystem &jobSystem) {
+        JobSystem::Counter counter, dependent;
+        std::atomic<size_t> ran{0};
+        for (size_t i = 0; i < 50; i++) {
+            jobSystem.Run([&ran, i]() {
+                ran.fetch_add(1);
+                if (i % 10 == 3) throw std::runtime_error("job failed");
+            }, &counter);
+        }
+        std::atomic<bool> dependentRan{false};
+        jobSystem.Run([&dependentRan]() { dependentRan.store(true); }, &dependent, &counter);
+        bool thrown = false;
+        try {
+            jobSystem.Wait(counter);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        jobSystem.Wait(dependent);
+        return thrown && ran.load() == 50 && dependentRan.load();
+    }
+
+    //An exception in an inner ParallelFor reaches the caller of the outer one
+    bool NestedException(JobSystem &jobSystem) {
+        try {
+            jobSystem.ParallelFor(16, 1, [&jobSystem](size_t outerBegin, size_t outerEnd) {
+                for (size_t i = outerBegin; i < outerEnd; i++) {
+                    jobSystem.ParallelFor(256, 8, [i](size_t begin, size_t end) {
+                        if (i == 5 && begin <= 100 && 100 < end) throw std::runtime_error("chunk failed");
+                    });
+                }
+            });
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    }
+
+    //A job without a counter hands its exception to the handler
+    bool UncaughtException(JobSystem &jobSystem) {
+        std::atomic<int> handled{0};
+        jobSystem.SetExceptionHandler([&handled](std::exception_ptr exception) {
+            try {
+                std::rethrow_exception(exception);
+            } catch (const std::runtime_error &) {
+                handled.fetch_add(1);
+            }
+        });
+        for (int i = 0; i < 10; i++) {
+            jobSystem.Run([]() { throw std::runtime_error("nobody waits for this job"); });
+        }
+        //Nothing can wait for the throwing jobs, waiting on empty jobs helps the pool until they all ran
+        JobSystem::Counter barrier;
+        while (handled.load() < 10) {
+            jobSystem.Run([]() {}, &barrier);
+            jobSystem.Wait(barrier);
+        }
+        jobSystem.SetExceptionHandler(nullptr);
+        return handled.load() == 10;
+    }
+
+    template<typename F>
+    void RunRounds(JobSystem &jobSystem, const std::string &name, F &&check) {
+        bool passed = true;
+        for (int round = 0; round < Rounds && passed; round++) {
+            passed = check(jobSystem);
+        }
+        Expect(passed, name + " with " + std::to_string(jobSystem.GetConcurrency()) + " threads");
+    }
+}
+
+int main() {
+    for (size_t workerCount: {0, 1, 3, 7}) {
+        JobSystem jobSystem(workerCount);
+        RunRounds(jobSystem, "nested ParallelFor", NestedParallelFor);
+        RunRounds(jobSystem, "dependency chain", DependencyChain);
+        RunRounds(jobSystem, "fan out and in", FanOutFanIn);
+        RunRounds(jobSystem, "exception through a counter", CounterException);
+        RunRounds(jobSystem, "exception through nested ParallelFor", NestedException);
+        RunRounds(jobSystem, "exception without a counter", UncaughtException);
+    }
+
+    std::cout << (failures == 0 ? "All job system checks passed" : "Job system checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+﻿//Headless check of MeshletCuller::Cull against known cases, registered with CTest in Checks/CMakeLists.txt
+#include <iostream>
+#include "../Source/Mesh/MeshletCuller.h"
+
+using namespace Kaamoo;
+
+namespace {
+    int failures = 0;
+
+    void Expect(bool condition, const char *name) {
+        std::cout << (condition ? "passed: " : "FAILED: ") << name << std::endl;
+        if (!condition) failures++;
+    }
+
+    Model::Meshlet MakeMeshlet(glm::vec3 center, float radius, glm::vec4 cone, uint32_t indexOffset = 0, uint32_t indexCount = 3) {
+        Model::Meshlet meshlet{};
+        meshlet.sphere = glm::vec4(center, radius);
+        meshlet.cone = cone;
+        meshlet.indexOffset = indexOffset;
+        meshlet.indexCount = indexCount;
+        return meshlet;
+    }
+
+    //The box [-10, 10]^3 as frustum, seen from cameraPosition
+    MeshletCuller::CullParameters MakeBox(glm::vec3 cameraPosition) {
+        MeshletCuller::CullParameters parameters{};
+        parameters.planes[0] = glm::vec4(1, 0, 0, 10);
+        parameters.planes[1] = glm::vec4(-1, 0, 0, 10);
+        parameters.planes[2] = glm::vec4(0, 1, 0, 10);
+        parameters.planes[3] = glm::vec4(0, -1, 0, 10);
+        parameters.planes[4] = glm::vec4(0, 0, 1, 10);
+        parameters.planes[5] = glm::vec4(0, 0, -1, 10);
+        parameters.cameraPosition = glm::vec4(cameraPosition, 1);
+        return parameters;
+    }
+
+    uint32_t CullOne(const Model::Meshlet &meshlet, const MeshletCuller::CullParameters &parameters) {
+        std::vector<VkDrawIndexedIndirectCommand> draws;
+        return MeshletCuller::Cull({meshlet}, parameters, draws);
+    }
+}
+
+int main() {
+    const glm::vec4 noCone(0, 0, 0, 1);
+    auto box = MakeBox(glm::vec3(0, 0, 9));
+
+    //Frustum
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 1, noCone), box) == 1, "frustum: inside");
+    Expect(CullOne(MakeMeshlet({12, 0, 0}, 1, noCone), box) == 0, "frustum: outside +x");
+    Expect(CullOne(MakeMeshlet({0, 0, -12}, 1, noCone), box) == 0, "frustum: outside -z");
+    Expect(CullOne(MakeMeshlet({10.5f, 0, 0}, 1, noCone), box) == 1, "frustum: straddling a plane");
+    Expect(CullOne(MakeMeshlet({11, 0, 0}, 1, noCone), box) == 1, "frustum: touching a plane");
+    Expect(CullOne(MakeMeshlet({11.5f, 11.5f, 0}, 1, noCone), box) == 0, "frustum: outside two planes");
+
+    //Normal cone, the camera looks at the meshlet from +z
+    glm::vec4 facingCamera(0, 0, 1, 0.5f);
+    glm::vec4 facingAway(0, 0, -1, 0.5f);
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, facingCamera), box) == 1, "cone: faces the camera");
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, facingAway), box) == 0, "cone: backfacing");
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, glm::vec4(1, 0, 0, 0.5f)), box) == 1, "cone: seen edge on");
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, facingAway), MakeBox(glm::vec3(0, 0, 0.25f))) == 1, "cone: camera inside the sphere");
+
+    //Degenerate cones, what MeshletBuilder writes for open meshes and zero area clusters
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, noCone), box) == 1, "degenerate cone: zero axis");
+    Expect(CullOne(MakeMeshlet({0, 0, 0}, 0.5f, glm::vec4(0, 0, -1, 1)), box) == 1, "degenerate cone: cutoff 1 facing away");
+    Expect(CullOne(MakeMeshlet({0, 0, 9}, 0.5f, noCone), box) == 1, "degenerate cone: camera at the center");
+
+    //Draws are appended in meshlet order
+    std::vector<Model::Meshlet> meshlets = {
+            MakeMeshlet({0, 0, 0}, 1, noCone, 0, 372),
+            MakeMeshlet({12, 0, 0}, 1, noCone, 372, 372),
+            MakeMeshlet({0, 0, 0}, 0.5f, facingAway, 744, 300),
+            MakeMeshlet({0, 5, 0}, 1, facingCamera, 1044, 90),
+    };
+    std::vector<VkDrawIndexedIndirectCommand> draws(1);
+    uint32_t visible = MeshletCuller::Cull(meshlets, box, draws);
+    Expect(visible == 2 && draws.size() == 3, "draws: count and append");
+    Expect(draws[1].indexCount == 372 && draws[1].firstIndex == 0 && draws[1].instanceCount == 1, "draws: first survivor");
+    Expect(draws[2].indexCount == 90 && draws[2].firstIndex == 1044 && draws[2].vertexOffset == 0 && draws[2].firstInstance == 0,
+           "draws: second survivor");
+
+    std::cout << (failures == 0 ? "All meshlet culling checks passed" : "Meshlet culling checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -1,9 +1,10 @@
 #version 450
 #include "UBO.glsl"
+#include "../Utils/VertexPacking.glsl"
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
-layout (location = 3) in vec3 smoothedNormal;
+layout (location = 2) in vec2 packedNormal;
+layout (location = 3) in vec2 smoothedNormal;
 layout (location = 4) in vec2 uv;
 
 layout (location = 0) out vec3 fragColor;
@@ -18,6 +19,7 @@ layout (push_constant) uniform PushConstantData {
 } push;
 
 void main() {
+    vec3 normal = decodeOctahedral(packedNormal);
     vec3 cameraWorldPos = vec3(ubo.inverseViewMatrix[3]);
     mat4 modelMatrix = push.modelMatrix;
     vec3 forward = normalize(ubo.inverseViewMatrix[2].xyz);
@@ -1,9 +1,10 @@
 #version 450
 #include "UBO.glsl"
+#include "../Utils/VertexPacking.glsl"
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
-layout (location = 3) in vec3 smoothedNormal;
+layout (location = 2) in vec2 normal;
+layout (location = 3) in vec2 packedSmoothedNormal;
 layout (location = 4) in vec2 uv;
 
 layout (location = 0) out vec3 fragColor;
@@ -17,6 +18,7 @@ layout (push_constant, std430) uniform PushConstantData {
 } push;
 
 void main() {
+    vec3 smoothedNormal = decodeOctahedral(packedSmoothedNormal);
     float NormalScaleFactor = 0.015;
 
     worldNormal = normalize(push.normalMatrix * vec4(normalize(smoothedNormal), 0));
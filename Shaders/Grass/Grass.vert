@@ -1,10 +1,11 @@
 
 #version 450
+#include "../Utils/VertexPacking.glsl"
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
-layout (location = 3) in vec3 smoothedNormal;
+layout (location = 2) in vec2 packedNormal;
+layout (location = 3) in vec2 smoothedNormal;
 layout (location = 4) in vec2 uv;
 
 
@@ -35,6 +36,7 @@ layout(push_constant) uniform PushConstantData{
 
 
 void main(){
+    vec3 normal = decodeOctahedral(packedNormal);
     vec4 worldPos = push.modelMatrix*vec4(position, 1);
     outPosition = position;
     outColor=color;
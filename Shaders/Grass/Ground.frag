@@ -21,8 +21,9 @@ layout (set = 1, binding = 2) uniform samplerCube shadowSampler;
 
 void main() {
     vec3 texColor = texture(texSampler, uv).xyz;
-    vec3 normalMapColor = texture(normalSampler, uv).xyz;
-    vec3 normal = normalize(normalMapColor * 2.0 - 1.0);
+    //Normal maps are cooked to BC5, which keeps x and y only
+    vec2 normalXY = texture(normalSampler, uv).xy * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY))));
     //Hard coded here, not constructing TBN, I am not planning to optimize rasterization pipeline for now
     vec4 worldNormal = normalize(vec4(normal.x,-normal.z,normal.y, 0));
 
@@ -3,10 +3,6 @@
 #include "UBO.glsl"
 
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
-layout (location = 3) in vec3 smoothedNormal;
-layout (location = 4) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec4 worldPos;
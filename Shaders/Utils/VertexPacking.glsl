@@ -0,0 +1,9 @@
+// Raster vertices store normals octahedral encoded in two snorm16 components, see Model::PackedVertex
+vec3 decodeOctahedral(vec2 encoded){
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0){
+        vec2 signs = vec2(normal.x >= 0 ? 1.0 : -1.0, normal.y >= 0 ? 1.0 : -1.0);
+        normal.xy = (1.0 - abs(normal.yx)) * signs;
+    }
+    return normalize(normal);
+}
@@ -16,6 +16,7 @@
 #include "ShaderBuilder.h"
 #include "Utils/JsonUtils.hpp"
 #include "Sampler.h"
+#include "Utils/Profiler.h"
 
 #include "ComponentFactory.hpp"
 #include "GUI.hpp"
@@ -27,8 +28,17 @@ namespace Kaamoo {
     class Application {
     public:
         Application() {
-            m_resourceManager = std::make_shared<ResourceManager>();
-            m_renderManager = std::make_unique<RenderManager>(m_resourceManager);
+            //Startup is recorded until the first frame, see run
+            Profiler::GetInstance().BeginSession("startup_trace");
+            PROFILE_SCOPE("Application startup");
+            {
+                PROFILE_SCOPE("ResourceManager");
+                m_resourceManager = std::make_shared<ResourceManager>();
+            }
+            {
+                PROFILE_SCOPE("RenderManager");
+                m_renderManager = std::make_unique<RenderManager>(m_resourceManager);
+            }
             m_logicManager = std::make_unique<LogicManager>(m_resourceManager);
         }
 
@@ -39,7 +49,11 @@ namespace Kaamoo {
         void run() {
             auto currentTime = std::chrono::high_resolution_clock::now();
             float totalTime = 0;
-            Awake();
+            {
+                PROFILE_SCOPE("Awake");
+                Awake();
+            }
+            Profiler::GetInstance().EndSession();
             auto &_window = m_resourceManager->GetWindow();
             auto &_renderer = m_resourceManager->GetRenderer();
             auto &_gameObjects = m_resourceManager->GetGameObjects();
@@ -54,8 +68,10 @@ namespace Kaamoo {
 
                 if (auto commandBuffer = _renderer.beginFrame()) {
                     int frameIndex = _renderer.getFrameIndex();
-                    FrameInfo frameInfo{frameIndex, frameTime, totalTime, commandBuffer, _gameObjects, _materials, m_ubo, _window.getCurrentExtent(), GUI::GetSelectedId(), false};
+                    FrameInfo frameInfo{frameIndex, frameTime, totalTime, commandBuffer, _gameObjects, _materials, m_ubo, _window.getCurrentExtent(), GUI::GetSelectedHandle(), false};
                     UpdateComponents(frameInfo);
+                    //After the camera moved and before anything binds the material descriptors
+                    m_resourceManager->UpdateTextureStreaming(frameInfo);
                     UpdateRendering(frameInfo);
                 }
 
@@ -78,9 +94,9 @@ namespace Kaamoo {
             auto &_gameObjects = m_resourceManager->GetGameObjects();
 
             ComponentAwakeInfo awakeInfo{};
-            for (auto &pair: _gameObjects) {
-                awakeInfo.gameObject = &pair.second;
-                pair.second.Awake(awakeInfo);
+            for (auto &gameObject: _gameObjects) {
+                awakeInfo.gameObject = &gameObject;
+                gameObject.Awake(awakeInfo);
             }
         }
 
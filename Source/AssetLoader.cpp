@@ -0,0 +1,81 @@
+﻿#include "AssetLoader.h"
+#include "Utils/JobSystem.h"
+#include "Utils/Profiler.h"
+#include <chrono>
+#include <unordered_set>
+
+namespace Kaamoo {
+    void AssetLoader::Prefetch(const std::vector<std::string> &modelPaths, const std::vector<TextureRequest> &textureRequests) {
+        PROFILE_SCOPE("AssetLoader::Prefetch");
+#ifdef ASSET_STATISTICS
+        auto startTime = std::chrono::high_resolution_clock::now();
+#endif
+
+        std::vector<std::string> uniqueModelPaths;
+        std::unordered_set<std::string> seenPaths;
+        for (const auto &path: modelPaths) {
+            if (seenPaths.insert(path).second) uniqueModelPaths.push_back(path);
+        }
+        std::vector<TextureRequest> uniqueTextureRequests;
+        seenPaths.clear();
+        for (const auto &request: textureRequests) {
+            if (seenPaths.insert(request.path).second) uniqueTextureRequests.push_back(request);
+        }
+
+        //Models first, they take longest and also split their own work over the pool
+        size_t jobCount = uniqueModelPaths.size() + uniqueTextureRequests.size();
+        JobSystem::GetInstance().ParallelFor(jobCount, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                try {
+                    if (i < uniqueModelPaths.size()) {
+                        auto builder = std::make_shared<Model::Builder>();
+                        builder->loadCached(uniqueModelPaths[i]);
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_modelBuilders[uniqueModelPaths[i]] = std::move(builder);
+                    } else {
+                        const auto &request = uniqueTextureRequests[i - uniqueModelPaths.size()];
+                        auto texture = TextureCooker::LoadCached(request.path, request.cubeMap);
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_textures[request.path] = std::move(texture);
+                    }
+                } catch (const std::exception &exception) {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    std::cout << "Prefetch failed: " << exception.what() << std::endl;
+                }
+            }
+        });
+
+#ifdef ASSET_STATISTICS
+        float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Prefetched " << uniqueModelPaths.size() << " models and " << uniqueTextureRequests.size() << " textures ("
+                  << modelPaths.size() + textureRequests.size() - jobCount << " duplicates skipped) on "
+                  << JobSystem::GetInstance().GetConcurrency() << " threads in " << milliseconds << " ms" << std::endl;
+#endif
+    }
+
+    std::shared_ptr<const Model::Builder> AssetLoader::GetModelBuilder(const std::string &filePath) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto iterator = m_modelBuilders.find(filePath);
+            if (iterator != m_modelBuilders.end()) return iterator->second;
+        }
+        auto builder = std::make_shared<Model::Builder>();
+        builder->loadCached(filePath);
+        return builder;
+    }
+
+    std::shared_ptr<const TextureCooker::CookedTexture> AssetLoader::GetTexture(const std::string &path, bool cubeMap) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto iterator = m_textures.find(path);
+            if (iterator != m_textures.end() && iterator->second->layerCount == (cubeMap ? 6u : 1u)) return iterator->second;
+        }
+        return TextureCooker::LoadCached(path, cubeMap);
+    }
+
+    void AssetLoader::Clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_modelBuilders.clear();
+        m_textures.clear();
+    }
+}
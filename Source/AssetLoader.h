@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Model.hpp"
+#include "Image.h"
+#include "Texture/TextureCooker.h"
+
+namespace Kaamoo {
+    //Loads the models and cooked textures a scene references on the worker pool before anything is uploaded.
+    //Model::createModelFromFile and Image::createTextureImage pick the results up and only do the device work themselves
+    class AssetLoader {
+    public:
+        struct TextureRequest {
+            std::string path;
+            bool cubeMap = false;
+        };
+
+        static AssetLoader &GetInstance() {
+            static AssetLoader assetLoader;
+            return assetLoader;
+        }
+
+        AssetLoader(const AssetLoader &) = delete;
+
+        AssetLoader &operator=(const AssetLoader &) = delete;
+
+        //Loads every distinct path concurrently. A failed asset is only logged here, loading it again on use reports the error
+        void Prefetch(const std::vector<std::string> &modelPaths, const std::vector<TextureRequest> &textureRequests);
+
+        //Prefetched builder of filePath, or a fresh synchronous load when it was not prefetched
+        std::shared_ptr<const Model::Builder> GetModelBuilder(const std::string &filePath);
+
+        //Prefetched cooked texture of path, or a fresh synchronous load when it was not prefetched
+        std::shared_ptr<const TextureCooker::CookedTexture> GetTexture(const std::string &path, bool cubeMap);
+
+        //Drops the decoded data once the scene is uploaded
+        void Clear();
+
+    private:
+        AssetLoader() = default;
+
+        std::mutex m_mutex;
+        std::unordered_map<std::string, std::shared_ptr<const Model::Builder>> m_modelBuilders;
+        std::unordered_map<std::string, std::shared_ptr<const TextureCooker::CookedTexture>> m_textures;
+    };
+}
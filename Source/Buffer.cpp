@@ -21,7 +21,8 @@ namespace Kaamoo {
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
-            VkDeviceSize minOffsetAlignment)
+            VkDeviceSize minOffsetAlignment,
+            MemoryAllocator::Strategy strategy)
             : Device{device},
               instanceSize{instanceSize},
               instanceCount{instanceCount},
@@ -29,17 +30,18 @@ namespace Kaamoo {
               memoryPropertyFlags{memoryPropertyFlags} {
         alignmentSize = Device::getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, strategy);
     }
 
     Buffer::~Buffer() {
         unmap();
         vkDestroyBuffer(Device.device(), buffer, nullptr);
-        vkFreeMemory(Device.device(), memory, nullptr);
+        Device.memoryAllocator().free(allocation);
     }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Host visible memory blocks stay mapped, so this only points into the persistent mapping.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
@@ -48,20 +50,21 @@ namespace Kaamoo {
  * @return VkResult of the buffer mapping call
  */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(Device.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create");
+        if (allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char *>(allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory block itself stays mapped until it is freed
  */
     void Buffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(Device.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
 /**
@@ -100,12 +103,7 @@ namespace Kaamoo {
  * @return VkResult of the flush call
  */
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(Device.device(), 1, &mappedRange);
+        return Device.memoryAllocator().flush(allocation, size, offset);
     }
 
 /**
@@ -120,12 +118,7 @@ namespace Kaamoo {
  * @return VkResult of the invalidate call
  */
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(Device.device(), 1, &mappedRange);
+        return Device.memoryAllocator().invalidate(allocation, size, offset);
     }
 
 /**
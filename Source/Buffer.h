@@ -13,7 +13,8 @@ namespace Kaamoo {
                 uint32_t instanceCount,
                 VkBufferUsageFlags usageFlags,
                 VkMemoryPropertyFlags memoryPropertyFlags,
-                VkDeviceSize minOffsetAlignment = 1);
+                VkDeviceSize minOffsetAlignment = 1,
+                MemoryAllocator::Strategy strategy = MemoryAllocator::Strategy::Buddy);
 
         ~Buffer();
 
@@ -63,14 +64,17 @@ namespace Kaamoo {
             return vkGetBufferDeviceAddress(Device.device(), &bufferDeviceAddressInfo);
         };
         
-        VkDeviceMemory getMemory() const { return memory; }
+        VkDeviceMemory getMemory() const { return allocation.memory; }
+
+        //Where the buffer starts inside getMemory, buffers share memory blocks
+        VkDeviceSize getMemoryOffset() const { return allocation.offset; }
 
     private:
 
         Device &Device;
         void *mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        MemoryAllocator::Allocation allocation{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
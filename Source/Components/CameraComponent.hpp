@@ -5,6 +5,14 @@
 namespace Kaamoo {
     class CameraComponent : public Component {
     public:
+        static constexpr ComponentType Type = ComponentType::Camera;
+
+        ComponentType GetType() const override { return Type; }
+
+        ComponentAccess GetUpdateAccess() const override {
+            return {ComponentData::OwnTransform, ComponentData::CameraUbo, false, false};
+        }
+
         CameraComponent() {
             name = "CameraComponent";
         }
@@ -28,11 +28,64 @@ namespace Kaamoo {
 
     const float FIXED_UPDATE_INTERVAL = 0.02;
 
+    //One per concrete component class, the bit index of the type in GameObject's component mask
+    enum class ComponentType : uint32_t {
+        Transform,
+        Camera,
+        Light,
+        MeshRenderer,
+        RigidBody,
+        RayTracingManager,
+        CameraMovement,
+        ObjectMovement,
+        Count
+    };
+
+    using ComponentMask = uint32_t;
+    static_assert(static_cast<uint32_t>(ComponentType::Count) <= sizeof(ComponentMask) * 8, "ComponentMask has a bit per component type");
+
+    //Frame data an Update reads or writes. FrameInfo::sceneUpdated and TLAS::shouldUpdate are atomic flags any Update may set
+    namespace ComponentData {
+        enum : uint32_t {
+            //Transform of the component's own game object
+            OwnTransform = 1u << 0,
+            //Transforms of any other game object
+            Transforms = 1u << 1,
+            //View and projection matrices of the global UBO
+            CameraUbo = 1u << 2,
+            //Light array of the global UBO
+            LightUbo = 1u << 3,
+            //TLAS instance transforms and masks
+            TLASInstances = 1u << 4,
+            All = ~0u
+        };
+    }
+
+    //What an Update touches, LogicManager's scheduler only runs Updates together when neither writes what the other uses
+    struct ComponentAccess {
+        uint32_t reads = ComponentData::All;
+        uint32_t writes = ComponentData::All;
+        //Reads input through GLFW, which only allows the main thread
+        bool mainThread = true;
+        //Instances on different game objects touch disjoint data and may update concurrently
+        bool parallelInstances = false;
+
+        bool ConflictsWith(const ComponentAccess &other) const {
+            return (writes & (other.reads | other.writes)) != 0 || (other.writes & (reads | writes)) != 0;
+        }
+    };
+
+    //Concrete components declare their type as static constexpr ComponentType Type and return it from GetType
     class Component {
     public:
 
         virtual std::string GetName() { return name; }
 
+        virtual ComponentType GetType() const = 0;
+
+        //Unknown components update alone on the main thread, an Update touching no data is skipped
+        virtual ComponentAccess GetUpdateAccess() const { return {}; }
+
         virtual ~Component() = default;
 
         virtual void OnLoad(GameObject *gameObject) {};
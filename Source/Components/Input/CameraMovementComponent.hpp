@@ -7,6 +7,15 @@
 namespace Kaamoo {
     class CameraMovementComponent : public InputControllerComponent {
     public:
+        static constexpr ComponentType Type = ComponentType::CameraMovement;
+
+        ComponentType GetType() const override { return Type; }
+
+        //Focusing reads the selected object's transform
+        ComponentAccess GetUpdateAccess() const override {
+            return {ComponentData::OwnTransform | ComponentData::Transforms, ComponentData::OwnTransform, true, false};
+        }
+
         CameraMovementComponent(GLFWwindow *window) : InputControllerComponent(window) {
             name = "CameraMovementComponent";
         }
@@ -66,10 +75,10 @@ namespace Kaamoo {
             static glm::vec3 _targetPosition;
             static glm::vec3 _focusObjectPosition;
             if (glfwGetKey(window, keys.KEY_F) == GLFW_PRESS && !_isFocusing) {
-                auto _frameInfo = *updateInfo.frameInfo;
-                auto _selectedObject = _frameInfo.gameObjects.find(_frameInfo.selectedGameObjectId);
-                if (_selectedObject != _frameInfo.gameObjects.end()) {
-                    auto &_selectedGameObject = _selectedObject->second;
+                auto &_frameInfo = *updateInfo.frameInfo;
+                auto *_selectedObject = _frameInfo.gameObjects.get(_frameInfo.selectedGameObject);
+                if (_selectedObject != nullptr) {
+                    auto &_selectedGameObject = *_selectedObject;
                     _focusObjectPosition = _selectedGameObject.transform->GetTranslation();
                     auto _moveTarget = _focusObjectPosition - updateInfo.gameObject->transform->GetTranslation();
                     if (glm::length(_moveTarget) < std::numeric_limits<float>::epsilon()) {
@@ -80,7 +89,7 @@ namespace Kaamoo {
 
                     MeshRendererComponent *_meshRendererComponent;
                     float _maxRadius = 1;
-                    if (_selectedObject->second.TryGetComponent(_meshRendererComponent) && _meshRendererComponent->GetModelPtr() != nullptr) {
+                    if (_selectedGameObject.TryGetComponent(_meshRendererComponent) && _meshRendererComponent->GetModelPtr() != nullptr) {
                         auto _selectedScale = _selectedGameObject.transform->GetScale();
                         _maxRadius = _meshRendererComponent->GetModelPtr()->GetMaxRadius() * glm::max(_selectedScale.x, glm::max(_selectedScale.y, _selectedScale.z));
                     }
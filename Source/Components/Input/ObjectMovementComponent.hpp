@@ -5,6 +5,14 @@
 namespace Kaamoo {
     class ObjectMovementComponent : public InputControllerComponent {
     public:
+        static constexpr ComponentType Type = ComponentType::ObjectMovement;
+
+        ComponentType GetType() const override { return Type; }
+
+        ComponentAccess GetUpdateAccess() const override {
+            return {ComponentData::OwnTransform, ComponentData::OwnTransform, true, false};
+        }
+
         ObjectMovementComponent(GLFWwindow *window) : InputControllerComponent(window) {
             name = "ObjectMovementComponent";
         }
@@ -14,6 +14,14 @@ namespace Kaamoo {
 
     class LightComponent : public Component {
     public:
+        static constexpr ComponentType Type = ComponentType::Light;
+
+        ComponentType GetType() const override { return Type; }
+
+        //Each light writes its own slot of the light array
+        ComponentAccess GetUpdateAccess() const override {
+            return {ComponentData::OwnTransform, ComponentData::LightUbo, false, true};
+        }
 
         LightComponent() {
             name = "LightComponent";
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <cmath>
+#include <limits>
 #include "Component.hpp"
 #include "../RayTracing/BLAS.hpp"
 #include "../RayTracing/TLAS.hpp"
@@ -7,6 +9,14 @@
 namespace Kaamoo {
     class MeshRendererComponent : public Component {
     public:
+        static constexpr ComponentType Type = ComponentType::MeshRenderer;
+
+        ComponentType GetType() const override { return Type; }
+
+        //Writes its own TLAS instance only
+        ComponentAccess GetUpdateAccess() const override {
+            return {ComponentData::OwnTransform, ComponentData::TLASInstances, false, true};
+        }
 
         ~MeshRendererComponent() override {
             Model::models.clear();
@@ -159,7 +169,55 @@ namespace Kaamoo {
 
         std::shared_ptr<Model> GetModelPtr() { return model; }
 
+        //LOD of this frame, RenderManager selects it before the meshlet, shadow and opaque passes record
+        uint32_t GetLodIndex() const { return lodIndex; }
+
+        //Radius of the bounding sphere on screen in pixels, infinite when the camera is inside it
+        float GetScreenRadius(const FrameInfo &frameInfo, const glm::mat4 &modelMatrix) const {
+            if (model == nullptr) return 0;
+            float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+                                   glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+            float radius = model->GetMaxRadius() * scale;
+            glm::vec3 cameraPosition = glm::vec3(frameInfo.globalUbo.inverseViewMatrix[3]);
+            float distance = glm::length(glm::vec3(modelMatrix[3]) - cameraPosition);
+            if (distance <= radius) return std::numeric_limits<float>::infinity();
+            return radius * glm::abs(frameInfo.globalUbo.projectionMatrix[1][1]) / distance * static_cast<float>(frameInfo.extent.height) * 0.5f;
+        }
+
+        //Picks the coarsest LOD whose simplification error covers less than LodErrorPixels on screen.
+        //Switching to a coarser level needs some margin so objects near a threshold do not pop every frame.
+        //Called once per frame by RenderManager::SelectLods, passes read the result through GetLodIndex
+        uint32_t SelectLod(const FrameInfo &frameInfo, const glm::mat4 &modelMatrix) {
+            if (model == nullptr) return 0;
+            const auto &lods = model->GetLods();
+
+            float screenRadius = GetScreenRadius(frameInfo, modelMatrix);
+            if (std::isinf(screenRadius)) {
+                lodIndex = 0;
+                return lodIndex;
+            }
+
+            uint32_t selected = 0;
+            for (uint32_t i = 1; i < lods.size(); i++) {
+                float threshold = i > lodIndex ? LodErrorPixels * LodHysteresis : LodErrorPixels;
+                if (lods[i].error * screenRadius > threshold) break;
+                selected = i;
+            }
+            lodIndex = selected;
+            return lodIndex;
+        }
+
+        //Meshlets that survived culling this frame, drawBuffer is null when the object is drawn whole
+        const Model::ClusterDraw &GetClusterDraw() const { return clusterDraw; }
+
+        void SetClusterDraw(const Model::ClusterDraw &draw) { clusterDraw = draw; }
+
     private:
+        inline static const float LodErrorPixels = 1.0f;
+        inline static const float LodHysteresis = 0.75f;
+
+        uint32_t lodIndex = 0;
+        Model::ClusterDraw clusterDraw{};
         id_t tlasId;
         id_t materialId;
         std::shared_ptr<Model> model = nullptr;
@@ -8,6 +8,13 @@
 namespace Kaamoo {
     class RayTracingManagerComponent : public Component {
     public:
+        static constexpr ComponentType Type = ComponentType::RayTracingManager;
+
+        ComponentType GetType() const override { return Type; }
+
+        //Only LateUpdate does work
+        ComponentAccess GetUpdateAccess() const override { return {0, 0, false, true}; }
+
         ~RayTracingManagerComponent() override {
             BLAS::release();
             TLAS::release();
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <optional>
 #include "MeshRendererComponent.hpp"
 
@@ -14,8 +17,33 @@ namespace Kaamoo {
         glm::vec3 normal;
     };
 
+    //World pose the simulation integrates, translation and Euler rotation like TransformComponent's world values
+    struct RigidBodyPose {
+        glm::vec3 translation{};
+        glm::vec3 rotation{};
+    };
+
+    //What one step leaves of a body, the physics thread publishes it for the main thread
+    struct RigidBodyState {
+        RigidBodyPose pose;
+        glm::vec3 velocity{};
+        glm::vec3 omega{};
+    };
+
+    //The simulation runs on PhysicsManager's thread and never touches TransformComponent. Each step works on the bodies' own
+    //poses and publishes them, the main thread writes interpolated poses back to the transforms. Everything the two threads
+    //share is guarded by stateMutex
     class RigidBodyComponent : public Component {
     public:
+        using CollisionMap = std::unordered_map<GameObject::Handle, int, GameObject::Handle::Hash>;
+
+        static constexpr ComponentType Type = ComponentType::RigidBody;
+
+        ComponentType GetType() const override { return Type; }
+
+        //Simulation runs on the physics thread
+        ComponentAccess GetUpdateAccess() const override { return {0, 0, false, true}; }
+
         inline const static float EPSILON = 0.0001f;
         inline const static glm::vec3 GRAVITY = glm::vec3(0, 0.98f, 0);
 
@@ -37,16 +65,30 @@ namespace Kaamoo {
             name = "RigidBodyComponent";
         }
 
+        //Game objects outlive the physics thread, see PhysicsManager::Stop
+        ~RigidBodyComponent() override {
+            auto _iterator = std::find(bodies.begin(), bodies.end(), this);
+            if (_iterator == bodies.end()) return;
+            bodies.erase(_iterator);
+            bodyMap.erase(m_handle);
+            gameObjectAABBs.erase(m_handle);
+        }
+
         void Loaded(GameObject *gameObject) override {
             if (!gameObject->TryGetComponent(m_meshRendererComponent)) {
                 throw std::runtime_error("RigidBodyComponent needs a MeshRendererComponent");
             }
             m_transformComponent = gameObject->transform;
+            m_handle = gameObject->GetHandle();
+            m_scale = m_transformComponent->GetScale();
+            SetPose({m_transformComponent->GetTranslation(), m_transformComponent->GetRotation()});
+            m_writtenTranslation = m_transformComponent->GetRelativeTranslation();
+            m_writtenRotation = m_transformComponent->GetRelativeRotation();
 
             glm::mat3 _I0;
             glm::vec3 _massCenter;
             float _totalMass;
-            MeshComputeInertia(gameObject->transform, m_meshRendererComponent->GetModelPtr().get(), 1.0f, &_I0, &_massCenter, &_totalMass);
+            MeshComputeInertia(m_scale, m_meshRendererComponent->GetModelPtr().get(), 1.0f, &_I0, &_massCenter, &_totalMass);
 
             m_I0 = _I0;
             m_invI0 = glm::inverse(_I0);
@@ -66,73 +108,74 @@ namespace Kaamoo {
 
             m_aabb.min = _min;
             m_aabb.max = _max;
-            Insert(GetAABB(gameObject->transform), gameObject);
+            Insert(GetAABB(), m_handle);
 
             m_meshRendererComponent->GetModelPtr()->RefreshVertexBuffer(_vertices);
             m_meshRendererComponent->GetModelPtr()->SetMaxRadius(_maxRadius);
+
+            m_simulated = gameObject->IsActive();
+            m_input.simulated = m_simulated;
+            m_published[0] = m_published[1] = RigidBodyState{m_pose, m_velocity, m_omega};
+            m_shownVelocity = m_velocity;
+            m_shownOmega = m_omega;
+            bodies.push_back(this);
+            bodyMap[m_handle] = this;
         }
 
-        //Todo: Damn gravity!
-        void FixedUpdate(const ComponentUpdateInfo &updateInfo) override {
-            auto _massCenter = GetMassCenter(m_transformComponent);
-            if (m_useGravity) {
-                AddJ(_massCenter, FIXED_UPDATE_INTERVAL * m_totalMass * GRAVITY);
-            }
-            for (auto &pair: m_momentum) {
-                auto _r = std::get<0>(pair) - _massCenter;
-                m_velocity += std::get<1>(pair) * m_invMass;
-                m_omega += m_invI0 * glm::cross(_r, std::get<1>(pair));
-            }
-            m_momentum.clear();
+        void OnDisable(const ComponentUpdateInfo &updateInfo) override {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            m_input.simulated = false;
+        }
 
-            updated = false;
-            auto _startTime = std::chrono::high_resolution_clock::now();
-            auto _gameObjects = GetBroadPhaseCollisions(updateInfo.gameObject);
-            if (!_gameObjects.empty()) {
-                for (auto &_gameObjectPair: _gameObjects) {
-                    auto _gameObject = _gameObjectPair.first;
-                    RigidBodyComponent *_otherRigidBodyComponent;
-                    if (!_gameObject->TryGetComponent(_otherRigidBodyComponent)) {
-                        throw std::runtime_error("RigidBodyComponent not found");
-                    }
-                    if (_otherRigidBodyComponent->GetCollisionMap().find(updateInfo.gameObject) != _otherRigidBodyComponent->GetCollisionMap().end()) {
-                        continue;
-                    }
-                    glm::vec3 _collidedFaceNormal{};
-                    auto _collidedPoint = GetNarrowPhaseCollision(updateInfo.gameObject, _gameObject, _collidedFaceNormal);
-                    if (_collidedPoint.has_value()) {
-                        ProcessCollision(_otherRigidBodyComponent, _collidedPoint.value(), _collidedFaceNormal, updateInfo.gameObject, _gameObject);
-                    }
-                }
-            }
-            if (glm::length(m_velocity) < EPSILON) {
-                m_velocity = glm::vec3(0);
+        void OnEnable(const ComponentUpdateInfo &updateInfo) override {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            m_input.simulated = true;
+        }
+
+        //One fixed step of every simulated body, then the octree is rebuilt from the moved AABBs. Physics thread only
+        static void StepBodies() {
+            ApplyInputs();
+            for (auto *_body: bodies) {
+                if (_body->m_simulated) _body->Integrate();
             }
-            if (glm::length(m_omega) < EPSILON) {
-                m_omega = glm::vec3(0);
+            UpdateOctree();
+            for (auto *_body: bodies) {
+                _body->m_collisionMap.clear();
             }
-            auto _rotationMatrix = m_transformComponent->GetRotationMatrix();
-            m_transformComponent->Translate(m_velocity * FIXED_UPDATE_INTERVAL);
-            m_transformComponent->Rotate(m_omega * FIXED_UPDATE_INTERVAL);
-            m_I0 = _rotationMatrix * m_I0 * glm::transpose(_rotationMatrix);
+        }
 
-            gameObjectAABBs[updateInfo.gameObject] = GetAABB(m_transformComponent);
+        //Moves the last published state to the previous slot and publishes the current one, which the simulation reached at
+        //stateTime. Physics thread only
+        static void PublishStates(std::chrono::steady_clock::time_point stateTime) {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            publishedTime = stateTime;
+            for (auto *_body: bodies) {
+                RigidBodyState _state{_body->m_pose, _body->m_velocity, _body->m_omega};
+                //A pose set from outside is not blended from where the body was
+                _body->m_published[0] = _body->m_teleported ? _state : _body->m_published[1];
+                _body->m_published[1] = _state;
+                _body->m_teleported = false;
+            }
         }
 
-        void LateFixedUpdate(const ComponentUpdateInfo &updateInfo) override {
-            if (!updated) {
-                UpdateOctree();
-                updated = true;
+        //Writes every transform's pose at now, between the previous and the current published state. Those are one step apart,
+        //so the bodies are shown up to one step late. Transforms moved by anyone else since the last call hand their pose to
+        //the simulation instead. Main thread only
+        static void InterpolateTransforms(std::chrono::steady_clock::time_point now) {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            float _alpha = std::chrono::duration<float>(now - publishedTime).count() / FIXED_UPDATE_INTERVAL;
+            _alpha = glm::clamp(_alpha, 0.0f, 1.0f);
+            for (auto *_body: bodies) {
+                _body->WriteTransform(_alpha);
             }
-            m_collisionMap.clear();
         }
 
         //Todo: Static objects do not need to reconstruct
 
-        AABB GetAABB(TransformComponent *transformComponent) const {
+        AABB GetAABB() const {
             //Jim Arvo
             //Split the transform into a translation vector (T) and a 3x3 rotation (M).
-            auto _mat4 = transformComponent->mat4();
+            const auto &_mat4 = m_poseMatrix;
             glm::vec3 _translation = _mat4[3];
             AABB _aabb{};
             for (int i = 0; i < 3; ++i) {
@@ -148,24 +191,30 @@ namespace Kaamoo {
             return _aabb;
         }
 
-        glm::vec3 GetMassCenter(TransformComponent *transformComponent) const {
-            return transformComponent->mat4() * glm::vec4(m_nativeMassCenter, 1);
+        glm::vec3 GetMassCenter() const {
+            return m_poseMatrix * glm::vec4(m_nativeMassCenter, 1);
         }
 
+        //Main thread, the simulation picks it up before its next step
         void SetVelocity(glm::vec3 velocity) {
-            m_velocity = velocity;
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            m_input.velocity = velocity;
         }
 
         void SetOmega(glm::vec3 omega) {
-            m_omega = omega;
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            m_input.omega = omega;
         }
 
+        //Main thread, the velocities of the state last written to the transform
         glm::vec3 GetVelocity() const {
-            return m_velocity;
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            return m_shownVelocity;
         }
 
         glm::vec3 GetOmega() const {
-            return m_omega;
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            return m_shownOmega;
         }
 
         float GetInvMass() const {
@@ -180,12 +229,8 @@ namespace Kaamoo {
             m_momentum.push_back(std::make_tuple(position, j));
         }
 
-        std::unordered_map<GameObject *, int> GetCollisionMap() const {
-            return m_collisionMap;
-        }
-
-        glm::mat3 GetInvI0(TransformComponent *transformComponent) const {
-            auto _rotateMatrix = transformComponent->GetRotationMatrix();
+        glm::mat3 GetInvI0() const {
+            auto _rotateMatrix = m_poseRotationMatrix;
             auto _I0 = _rotateMatrix * m_I0 * glm::transpose(_rotateMatrix);
             return glm::inverse(_I0);
         }
@@ -195,11 +240,41 @@ namespace Kaamoo {
         }
 
     private:
+        //Changes the main thread asks for, applied at the start of the next step
+        struct Input {
+            std::optional<RigidBodyPose> pose;
+            std::optional<glm::vec3> velocity;
+            std::optional<glm::vec3> omega;
+            std::optional<float> mass;
+            bool simulated = true;
+        };
+
         TransformComponent *m_transformComponent;
         MeshRendererComponent *m_meshRendererComponent;
-        std::unordered_map<GameObject *, int> m_collisionMap;
+        GameObject::Handle m_handle{};
+        CollisionMap m_collisionMap;
         AABB m_aabb;
 
+        //Physics thread
+        RigidBodyPose m_pose;
+        glm::mat4 m_poseMatrix{1.f};
+        glm::mat3 m_poseRotationMatrix{1.f};
+        glm::vec3 m_scale{1.f};
+        bool m_simulated = true;
+
+        //Guarded by stateMutex. Published states are the previous and the current step, teleported is set from taking a
+        //pose of the input until that pose is published
+        Input m_input;
+        RigidBodyState m_published[2];
+        bool m_teleported = false;
+
+        //Main thread, the local values last written to the transform
+        glm::vec3 m_writtenTranslation{};
+        glm::vec3 m_writtenRotation{};
+        //Guarded by stateMutex, the velocities published with the pose last written to the transform
+        glm::vec3 m_shownVelocity{};
+        glm::vec3 m_shownOmega{};
+
         glm::vec3 m_velocity{0, 0, 0};
         glm::vec3 m_omega{0, 0, 0};
         glm::vec3 m_nativeMassCenter{0};
@@ -214,22 +289,121 @@ namespace Kaamoo {
         bool m_isKinematic = false;
         bool m_useGravity = false;
 
-        void ProcessCollision(RigidBodyComponent *otherRigidBodyComponent, glm::vec3 intersectionPoint, glm::vec3 collidedFaceNormal, GameObject *gameObject, GameObject *otherObject) {
-            glm::vec3 _massCenter = GetMassCenter(gameObject->transform);
+        void SetPose(const RigidBodyPose &pose) {
+            m_pose = pose;
+            TRSArrays _arrays{{&m_pose.translation.x, &m_pose.translation.y, &m_pose.translation.z},
+                              {&m_pose.rotation.x, &m_pose.rotation.y, &m_pose.rotation.z},
+                              {&m_scale.x, &m_scale.y, &m_scale.z}};
+            TransformKernels::ComposeScalar(_arrays, 0, 1, &m_poseMatrix[0][0]);
+            //Columns of the upper 3x3 are the rotation's columns times the scale
+            m_poseRotationMatrix = glm::mat3(glm::vec3(m_poseMatrix[0]) / m_scale.x, glm::vec3(m_poseMatrix[1]) / m_scale.y,
+                                             glm::vec3(m_poseMatrix[2]) / m_scale.z);
+        }
+
+        //Todo: Damn gravity!
+        void Integrate() {
+            auto _massCenter = GetMassCenter();
+            if (m_useGravity) {
+                AddJ(_massCenter, FIXED_UPDATE_INTERVAL * m_totalMass * GRAVITY);
+            }
+            for (auto &pair: m_momentum) {
+                auto _r = std::get<0>(pair) - _massCenter;
+                m_velocity += std::get<1>(pair) * m_invMass;
+                m_omega += m_invI0 * glm::cross(_r, std::get<1>(pair));
+            }
+            m_momentum.clear();
+
+            auto _collisions = GetBroadPhaseCollisions(this);
+            for (auto &_collisionPair: _collisions) {
+                auto _iterator = bodyMap.find(_collisionPair.first);
+                if (_iterator == bodyMap.end()) continue;
+                auto *_otherRigidBodyComponent = _iterator->second;
+                if (_otherRigidBodyComponent->m_collisionMap.count(m_handle) != 0) {
+                    continue;
+                }
+                glm::vec3 _collidedFaceNormal{};
+                auto _collidedPoint = GetNarrowPhaseCollision(this, _otherRigidBodyComponent, _collidedFaceNormal);
+                if (_collidedPoint.has_value()) {
+                    ProcessCollision(_otherRigidBodyComponent, _collidedPoint.value(), _collidedFaceNormal);
+                }
+            }
+            if (glm::length(m_velocity) < EPSILON) {
+                m_velocity = glm::vec3(0);
+            }
+            if (glm::length(m_omega) < EPSILON) {
+                m_omega = glm::vec3(0);
+            }
+            auto _rotationMatrix = m_poseRotationMatrix;
+            SetPose({m_pose.translation + m_velocity * FIXED_UPDATE_INTERVAL, m_pose.rotation + m_omega * FIXED_UPDATE_INTERVAL});
+            m_I0 = _rotationMatrix * m_I0 * glm::transpose(_rotationMatrix);
+
+            gameObjectAABBs[m_handle] = GetAABB();
+        }
+
+        static void ApplyInputs() {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            for (auto *_body: bodies) {
+                auto &_input = _body->m_input;
+                _body->m_simulated = _input.simulated;
+                if (_input.pose.has_value()) {
+                    _body->SetPose(_input.pose.value());
+                    gameObjectAABBs[_body->m_handle] = _body->GetAABB();
+                    _body->m_teleported = true;
+                }
+                if (_input.velocity.has_value()) _body->m_velocity = _input.velocity.value();
+                if (_input.omega.has_value()) _body->m_omega = _input.omega.value();
+                if (_input.mass.has_value() && _input.mass.value() > 0) {
+                    _body->m_totalMass = _input.mass.value();
+                    _body->m_invMass = 1.0f / _body->m_totalMass;
+                }
+                _input.pose.reset();
+                _input.velocity.reset();
+                _input.omega.reset();
+                _input.mass.reset();
+            }
+        }
+
+        //Called with stateMutex held
+        void WriteTransform(float alpha) {
+            auto *_transform = m_transformComponent;
+            if (_transform->GetRelativeTranslation() != m_writtenTranslation || _transform->GetRelativeRotation() != m_writtenRotation) {
+                //Moved in the editor or by a script since the last frame
+                m_input.pose = RigidBodyPose{_transform->GetTranslation(), _transform->GetRotation()};
+                m_writtenTranslation = _transform->GetRelativeTranslation();
+                m_writtenRotation = _transform->GetRelativeRotation();
+            }
+            //The transform keeps the pose it was given until the simulation has published it
+            if (m_input.pose.has_value() || m_teleported) return;
+
+            const auto &_previous = m_published[0];
+            const auto &_current = m_published[1];
+            //Parents add their world translation and rotation, the simulation works in world space
+            glm::vec3 _parentTranslation = _transform->GetTranslation() - _transform->GetRelativeTranslation();
+            glm::vec3 _parentRotation = _transform->GetRotation() - _transform->GetRelativeRotation();
+            m_writtenTranslation = glm::mix(_previous.pose.translation, _current.pose.translation, alpha) - _parentTranslation;
+            m_writtenRotation = glm::mix(_previous.pose.rotation, _current.pose.rotation, alpha) - _parentRotation;
+            _transform->SetTranslation(m_writtenTranslation);
+            _transform->SetRotation(m_writtenRotation);
+            m_shownVelocity = _current.velocity;
+            m_shownOmega = _current.omega;
+        }
+
+        void ProcessCollision(RigidBodyComponent *otherRigidBodyComponent, glm::vec3 intersectionPoint, glm::vec3 collidedFaceNormal) {
+            glm::vec3 _massCenter = GetMassCenter();
             glm::vec3 _r = Utils::TruncSmallValues(intersectionPoint - _massCenter, EPSILON);
             glm::vec3 _n = Utils::TruncSmallValues(glm::normalize(collidedFaceNormal), EPSILON);
 
 //Todo: Subtle swizzles
-            TransformComponent *_otherTransformComponent = otherObject->transform;
-            glm::vec3 _velocityOther = otherRigidBodyComponent->GetVelocity();
-            glm::vec3 _omegaOther = otherRigidBodyComponent->GetOmega();
+            //The simulated velocities, GetVelocity and GetOmega are the main thread's
+            glm::vec3 _velocityOther = otherRigidBodyComponent->m_velocity;
+            glm::vec3 _omegaOther = otherRigidBodyComponent->m_omega;
             float _otherInvMass = otherRigidBodyComponent->GetInvMass();
-            glm::mat3 _otherInvI0 = otherRigidBodyComponent->GetInvI0(_otherTransformComponent);
+            glm::mat3 _otherInvI0 = otherRigidBodyComponent->GetInvI0();
             glm::vec3 _rOther =
-                    Utils::TruncSmallValues(intersectionPoint - otherRigidBodyComponent->GetMassCenter(otherObject->transform), EPSILON);
+                    Utils::TruncSmallValues(intersectionPoint - otherRigidBodyComponent->GetMassCenter(), EPSILON);
 
             glm::vec3 _relativeVelocity = m_velocity - _velocityOther + glm::cross(m_omega, _r) - glm::cross(_omegaOther, _rOther);
-            auto _invI0 = GetInvI0(m_transformComponent);
+            auto _invI0 = GetInvI0();
 
             if (glm::length(_relativeVelocity) < 0.001f || glm::dot(_relativeVelocity, -_n) < 0) {
                 return;
@@ -262,21 +436,15 @@ namespace Kaamoo {
                 otherRigidBodyComponent->AddJ(intersectionPoint, -_J);
             }
 
-            m_collisionMap[otherObject] = 1;
+            m_collisionMap[otherRigidBodyComponent->m_handle] = 1;
         }
 
-        static std::optional<glm::vec3> GetNarrowPhaseCollision(GameObject *main, GameObject *other, glm::vec3 &normal) {
-            RigidBodyComponent *_mainRigidBodyComponent, *_otherRigidBodyComponent;
-            MeshRendererComponent *_mainMeshRendererComponent, *_otherMeshRendererComponent;
-            if (!main->TryGetComponent(_mainRigidBodyComponent) || !other->TryGetComponent(_otherRigidBodyComponent)) {
-                throw std::runtime_error("Collide: RigidBodyComponent not found");
-            }
-            if (!main->TryGetComponent(_mainMeshRendererComponent) || !other->TryGetComponent(_otherMeshRendererComponent)) {
-                throw std::runtime_error("Collide: MeshRendererComponent not found");
-            }
+        static std::optional<glm::vec3> GetNarrowPhaseCollision(RigidBodyComponent *main, RigidBodyComponent *other, glm::vec3 &normal) {
+            auto *_mainMeshRendererComponent = main->m_meshRendererComponent;
+            auto *_otherMeshRendererComponent = other->m_meshRendererComponent;
 
-            AABB _aabbMain = _mainRigidBodyComponent->GetAABB(main->transform);
-            AABB _aabbOther = _otherRigidBodyComponent->GetAABB(other->transform);
+            AABB _aabbMain = main->GetAABB();
+            AABB _aabbOther = other->GetAABB();
             AABB _intersectionAABB{};
             bool _intersect = AABBIntersect(_aabbMain, _aabbOther);
             if (!_intersect) {
@@ -295,15 +463,16 @@ namespace Kaamoo {
             auto &_otherVertices = _otherMeshRendererComponent->GetModelPtr()->GetVertices();
             auto &_otherIndices = _otherMeshRendererComponent->GetModelPtr()->GetIndices();
 
-            auto getValidTriangles = [](GameObject *object, std::vector<Model::Vertex> &vertices, std::vector<unsigned int> &indices, const AABB &_intersectionAABB) {
+            auto getValidTriangles = [](RigidBodyComponent *object, std::vector<Model::Vertex> &vertices, std::vector<unsigned int> &indices, const AABB &_intersectionAABB) {
                 std::vector<Triangle> _validTriangles;
+                const glm::mat4 &_modelMatrix = object->m_poseMatrix;
                 for (int i = 0; i < indices.size(); i += 3) {
                     glm::vec3 _triangleVertices[3];
                     AABB _triangleAABB;
                     _triangleAABB.min = glm::vec3(FLT_MAX);
                     _triangleAABB.max = glm::vec3(-FLT_MAX);
                     for (int j = 0; j < 3; ++j) {
-                        _triangleVertices[j] = object->transform->mat4() * glm::vec4(vertices[indices[i + j]].position, 1);
+                        _triangleVertices[j] = _modelMatrix * glm::vec4(vertices[indices[i + j]].position, 1);
                         for (int k = 0; k < 3; ++k) {
                             _triangleAABB.min[k] = glm::min(_triangleAABB.min[k], _triangleVertices[j][k]);
                             _triangleAABB.max[k] = glm::max(_triangleAABB.max[k], _triangleVertices[j][k]);
@@ -323,7 +492,7 @@ namespace Kaamoo {
             auto _mainValidTriangles = getValidTriangles(main, _mainVertices, _mainIndices, _intersectionAABB);
             auto _otherValidTriangles = getValidTriangles(other, _otherVertices, _otherIndices, _intersectionAABB);
 
-            glm::vec3 _center = _mainRigidBodyComponent->GetMassCenter(main->transform);
+            glm::vec3 _center = main->GetMassCenter();
             std::vector<glm::vec3> _intersectionPoints;
             std::unordered_map<glm::vec3, int, Utils::Vec3Hash, Utils::Vec3Equal> _intersectionPointsMap{};
             glm::vec3 _centroid{};
@@ -381,7 +550,7 @@ namespace Kaamoo {
             return _averageIntersectionPoint;
         }
 
-        static void MeshComputeInertia(TransformComponent *transformComponent, Model *model, float density, glm::mat3 *I0, glm::vec3 *massCenter, float *totalMass) {
+        static void MeshComputeInertia(glm::vec3 scale, Model *model, float density, glm::mat3 *I0, glm::vec3 *massCenter, float *totalMass) {
             auto _indices = model->GetIndices();
             auto _vertices = model->GetVertices();
             assert(_indices.size() % 3 == 0 && "Indices size must be a multiple of 3");
@@ -392,7 +561,7 @@ namespace Kaamoo {
             for (int i = 0; i < _indices.size(); i += 3) {
                 glm::vec3 _triangleVertices[3];
                 for (int j = 0; j < 3; j++) {
-                    _triangleVertices[j] = transformComponent->GetScale() * _vertices[_indices[i + j]].position;
+                    _triangleVertices[j] = scale * _vertices[_indices[i + j]].position;
                 }
 
                 //Todo: The algorithm below is copied and should be understood later
@@ -517,36 +686,39 @@ namespace Kaamoo {
             }
         }
 
-#ifdef RAY_TRACING
-
-        void SetUI(std::vector<GameObjectDesc> *, FrameInfo &frameInfo) override {
+        //Shows the last published state, edits are handed to the simulation
+        void SetSimulationUI() {
+            std::lock_guard<std::mutex> _lock(stateMutex);
+            auto _velocity = m_shownVelocity;
+            auto _omega = m_shownOmega;
+            auto _mass = m_totalMass;
             ImGui::Text("Velocity:");
             ImGui::SameLine(90);
-            ImGui::InputFloat3("##Velocity", &m_velocity.x);
+            bool _velocityChanged = ImGui::InputFloat3("##Velocity", &_velocity.x);
 
             ImGui::Text("Omega:");
             ImGui::SameLine(90);
-            ImGui::InputFloat3("##Omega", &m_omega.x);
+            bool _omegaChanged = ImGui::InputFloat3("##Omega", &_omega.x);
 
             ImGui::Text("Mass:");
             ImGui::SameLine(90);
-            ImGui::InputFloat("##Mass", &m_totalMass);
+            bool _massChanged = ImGui::InputFloat("##Mass", &_mass);
+
+            if (_velocityChanged) m_input.velocity = _velocity;
+            if (_omegaChanged) m_input.omega = _omega;
+            if (_massChanged) m_input.mass = _mass;
         }
 
-#else
+#ifdef RAY_TRACING
 
-        void SetUI(Material::Map *, FrameInfo &frameInfo) override {
-            ImGui::Text("Velocity:");
-            ImGui::SameLine(90);
-            ImGui::InputFloat3("##Velocity", &m_velocity.x);
+        void SetUI(std::vector<GameObjectDesc> *, FrameInfo &frameInfo) override {
+            SetSimulationUI();
+        }
 
-            ImGui::Text("Omega:");
-            ImGui::SameLine(90);
-            ImGui::InputFloat3("##Omega", &m_omega.x);
+#else
 
-            ImGui::Text("Mass:");
-            ImGui::SameLine(90);
-            ImGui::InputFloat("##Mass", &m_totalMass);
+        void SetUI(Material::Map *, FrameInfo &frameInfo) override {
+            SetSimulationUI();
         }
 
 #endif
@@ -554,8 +726,12 @@ namespace Kaamoo {
 
 //Octree
     private:
-        inline static bool updated = false;
-        inline static std::unordered_map<GameObject *, AABB> gameObjectAABBs = {};
+        //Filled on the main thread while loading, only the physics thread touches them once it runs
+        inline static std::vector<RigidBodyComponent *> bodies = {};
+        inline static std::unordered_map<GameObject::Handle, RigidBodyComponent *, GameObject::Handle::Hash> bodyMap = {};
+        inline static std::mutex stateMutex;
+        inline static std::chrono::steady_clock::time_point publishedTime{};
+        inline static std::unordered_map<GameObject::Handle, AABB, GameObject::Handle::Hash> gameObjectAABBs = {};
         struct SplitEntry {
             float min;
             float max;
@@ -563,7 +739,8 @@ namespace Kaamoo {
 
         struct Node {
             SplitEntry splitEntry[3];
-            std::vector<GameObject *> gameObjects{};
+            //Handles are kept with the AABB they were inserted with, so a split does not need the objects
+            std::vector<std::pair<GameObject::Handle, AABB>> gameObjects{};
             std::vector<std::shared_ptr<Node>> children{};
         };
         inline static std::shared_ptr<Node> root = nullptr;
@@ -578,13 +755,13 @@ namespace Kaamoo {
             }
         }
 
-        static void Insert(AABB aabb, GameObject *gameObject) {
+        static void Insert(AABB aabb, GameObject::Handle gameObject) {
             InitRoot();
             InsertRecursive(aabb, gameObject, root, 0);
         }
 
 //Todo: Simplify the collider of complex mesh.
-        static void InsertRecursive(AABB aabb, GameObject *gameObject, std::shared_ptr<Node> node, int depth) {
+        static void InsertRecursive(AABB aabb, GameObject::Handle gameObject, std::shared_ptr<Node> node, int depth) {
             glm::vec3 _min = {node->splitEntry[0].min, node->splitEntry[1].min, node->splitEntry[2].min};
             glm::vec3 _max = {node->splitEntry[0].max, node->splitEntry[1].max, node->splitEntry[2].max};
             AABB _sectorAABB = MakeAABB(_min, _max);
@@ -600,7 +777,7 @@ namespace Kaamoo {
             }
 
             if (_isIntersect) {
-                node->gameObjects.push_back(gameObject);
+                node->gameObjects.emplace_back(gameObject, aabb);
             }
 
             if (node->gameObjects.size() > 2 && depth < MAX_DEPTH) {
@@ -608,35 +785,31 @@ namespace Kaamoo {
             }
         }
 
-        static std::unordered_map<GameObject *, int> GetBroadPhaseCollisions(GameObject *gameObject) {
-            std::unordered_map<GameObject *, int> _gameObjects;
-            GetBroadPhaseCollisionsRecursive(gameObject, root, _gameObjects);
+        static CollisionMap GetBroadPhaseCollisions(RigidBodyComponent *body) {
+            CollisionMap _gameObjects;
+            GetBroadPhaseCollisionsRecursive(body, root, _gameObjects);
             return _gameObjects;
         }
 
-        static void GetBroadPhaseCollisionsRecursive(GameObject *gameObject, std::shared_ptr<Node> node, std::unordered_map<GameObject *, int> &_gameObjects) {
+        static void GetBroadPhaseCollisionsRecursive(RigidBodyComponent *body, std::shared_ptr<Node> node, CollisionMap &_gameObjects) {
             if (node->children.size() != 0) {
                 for (auto &_childNode: node->children) {
-                    GetBroadPhaseCollisionsRecursive(gameObject, _childNode, _gameObjects);
+                    GetBroadPhaseCollisionsRecursive(body, _childNode, _gameObjects);
                 }
                 return;
             }
 
+            auto _handle = body->m_handle;
             for (auto &_gameObject: node->gameObjects) {
-                if (_gameObject == gameObject) {
+                if (_gameObject.first == _handle) {
                     for (auto &_gameObject1: node->gameObjects) {
-                        if (_gameObject1 == gameObject || _gameObjects.find(_gameObject1) != _gameObjects.end()) {
+                        if (_gameObject1.first == _handle || _gameObjects.find(_gameObject1.first) != _gameObjects.end()) {
                             continue;
                         }
-                        RigidBodyComponent *_rigidBodyComponentMain;
-                        if (!gameObject->TryGetComponent(_rigidBodyComponentMain)) {
-                            throw std::runtime_error("RigidBodyComponent not found");
-                        }
-                        RigidBodyComponent *_itemRigidBodyComponent;
-                        if (_gameObject1->TryGetComponent(_itemRigidBodyComponent)) {
-                            if (AABBIntersect(_rigidBodyComponentMain->GetAABB(gameObject->transform), _itemRigidBodyComponent->GetAABB(_gameObject1->transform))) {
-                                _gameObjects[_gameObject1] = 1;
-                            }
+                        auto _iterator = bodyMap.find(_gameObject1.first);
+                        if (_iterator == bodyMap.end()) continue;
+                        if (AABBIntersect(body->GetAABB(), _iterator->second->GetAABB())) {
+                            _gameObjects[_gameObject1.first] = 1;
                         }
                     }
                     break;
@@ -708,10 +881,7 @@ namespace Kaamoo {
             auto _gameObjects = std::move(node->gameObjects);
             node->gameObjects.clear();
             for (const auto &_gameObject: _gameObjects) {
-                RigidBodyComponent *_rigidBodyComponent;
-                if (_gameObject->TryGetComponent(_rigidBodyComponent)) {
-                    InsertRecursive(_rigidBodyComponent->GetAABB(_gameObject->transform), _gameObject, node, depth);
-                }
+                InsertRecursive(_gameObject.second, _gameObject.first, node, depth);
             }
         }
 
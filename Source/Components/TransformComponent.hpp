@@ -1,41 +1,151 @@
 ﻿#ifndef TRANSFORM_COMPONENT_INCLUDED
 #define TRANSFORM_COMPONENT_INCLUDED
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <glm/vec3.hpp>
 #include <glm/fwd.hpp>
 #include <glm/detail/type_mat3x3.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include "Component.hpp"
+#include "../Utils/TransformKernels.h"
 
 namespace Kaamoo {
+    //Local translation, Euler rotation and scale. The values of every transform live in arrays shared by all transforms of
+    //the same hierarchy depth, next to their world values and world matrix, so a frame's rebuild walks each depth in order
+    //over contiguous memory. World values are cached until the transform or an ancestor changes, and the const getters
+    //refill the caches without any locking. Transforms are only written, created, destroyed and reparented on the main
+    //thread. Other threads may call the const getters only while nothing does any of that and after UpdateDirtyTransforms,
+    //when every cache is clean and a getter only reads; UpdateScheduler runs its pool waves that way. GetRotationMatrix and
+    //normalMatrix refill the rotation cache even then and are main thread only
     class TransformComponent : public Component {
     public:
+        static constexpr ComponentType Type = ComponentType::Transform;
+
+        ComponentType GetType() const override { return Type; }
+
+        ComponentAccess GetUpdateAccess() const override { return {0, 0, false, true}; }
+
         TransformComponent() {
             name = "TransformComponent";
+            Insert(0, IdentityValues);
+        }
+
+        //The arrays hold this pointer
+        TransformComponent(const TransformComponent &) = delete;
+
+        TransformComponent &operator=(const TransformComponent &) = delete;
+
+        ~TransformComponent() override {
+            if (parentNode != nullptr) {
+                auto &_siblings = parentNode->childrenNodes;
+                _siblings.erase(std::find(_siblings.begin(), _siblings.end(), this));
+            }
+            while (!childrenNodes.empty()) {
+                RemoveChild(childrenNodes.back());
+            }
+            Erase();
+        }
+
+        //Rebuilds every transform changed since the last call in one pass, one depth after the other, composing the
+        //matrices in SIMD batches. Transforms read in between are still rebuilt on demand, one at a time
+        static void UpdateDirtyTransforms() {
+            if (dirtyCount == 0) return;
+            auto &_batch = worldBatch;
+            for (size_t _depth = 0; _depth < levels.size() && dirtyCount > 0; _depth++) {
+                auto &_level = levels[_depth];
+                _batch.indices.clear();
+                for (uint32_t i = 0; i < _level.owners.size(); i++) {
+                    if (!_level.dirty[i]) continue;
+                    _level.dirty[i] = false;
+                    _batch.indices.push_back(i);
+                }
+                size_t _count = _batch.indices.size();
+                if (_count == 0) continue;
+                dirtyCount -= _count;
+
+                //One value at a time over the whole depth. The parents are one depth up, which this pass already finished
+                for (int j = 0; j < 9; j++) {
+                    auto &_local = _level.local[j];
+                    auto &_world = _level.world[j];
+                    const float *_parentWorld = _depth > 0 ? levels[_depth - 1].world[j].data() : nullptr;
+                    for (uint32_t i: _batch.indices) {
+                        uint32_t _parent = _level.parents[i];
+                        if (_parent == NoParent) {
+                            _world[i] = _local[i];
+                        } else {
+                            _world[i] = j < 6 ? _local[i] + _parentWorld[_parent] : _local[i] * _parentWorld[_parent];
+                        }
+                    }
+                }
+
+                //Every transform of the depth moved, the kernel reads and writes the arrays in place
+                if (_count == _level.owners.size()) {
+                    TransformKernels::Compose(WorldArrays(_level), _count, &_level.matrices[0][0][0]);
+                    continue;
+                }
+                for (int j = 0; j < 9; j++) {
+                    _batch.values[j].resize(_count);
+                    for (size_t i = 0; i < _count; i++) {
+                        _batch.values[j][i] = _level.world[j][_batch.indices[i]];
+                    }
+                }
+                _batch.matrices.resize(_count * 16);
+                auto &_values = _batch.values;
+                TRSArrays _arrays{{_values[0].data(), _values[1].data(), _values[2].data()},
+                                  {_values[3].data(), _values[4].data(), _values[5].data()},
+                                  {_values[6].data(), _values[7].data(), _values[8].data()}};
+                TransformKernels::Compose(_arrays, _count, _batch.matrices.data());
+                for (size_t i = 0; i < _count; i++) {
+                    std::copy_n(_batch.matrices.data() + i * 16, 16, &_level.matrices[_batch.indices[i]][0][0]);
+                }
+            }
         }
 
         glm::vec3 getForwardDir() const {
-            float yaw = rotation.y;
+            float yaw = GetRelativeRotation().y;
             return glm::vec3{glm::sin(yaw), 0, glm::cos(yaw)};
         };
 
         void Translate(glm::vec3 t) {
-            translation += t;
+            SetLocal(TranslationValue, GetRelativeTranslation() + t);
+            MarkWorldDirty();
         }
         
         void Rotate(glm::vec3 r,glm::vec3 rotateCenter = glm::vec3(0.f)) {
-            rotation += r;
+            SetLocal(RotationValue, GetRelativeRotation() + r);
+            MarkRotationDirty();
         }
 
+        //Moves child under this transform, detaching it from its previous parent. Local values are kept
         void AddChild(TransformComponent *child) {
+            if (child->parentNode != nullptr) {
+                child->parentNode->RemoveChild(child);
+            }
             childrenNodes.push_back(child);
             child->parentNode = this;
+            child->SetDepth(m_depth + 1);
+            child->MarkWorldDirty();
+        }
+
+        void RemoveChild(TransformComponent *child) {
+            auto iterator = std::find(childrenNodes.begin(), childrenNodes.end(), child);
+            if (iterator == childrenNodes.end()) return;
+            childrenNodes.erase(iterator);
+            child->parentNode = nullptr;
+            child->SetDepth(0);
+            child->MarkWorldDirty();
+        }
+
+        TransformComponent *GetParent() const {
+            return parentNode;
         }
 
         glm::mat3 normalMatrix() {
             glm::mat3 invScaleMatrix = glm::mat4{1.f};
-            const glm::vec3 invScale = 1.0f / scale;
+            const glm::vec3 invScale = 1.0f / GetRelativeScale();
             invScaleMatrix[0][0] = invScale.x;
             invScaleMatrix[1][1] = invScale.y;
             invScaleMatrix[2][2] = invScale.z;
@@ -45,21 +155,16 @@ namespace Kaamoo {
             return rotationMatrix * invScaleMatrix;
         }
 
-        glm::mat4 mat4() const {
-
-            auto transform = glm::translate(glm::mat4{1.f}, GetTranslation());
-
-            auto worldRotation = GetRotation();
-            transform = glm::rotate(transform, worldRotation.y, {0, 1, 0});
-            transform = glm::rotate(transform, worldRotation.x, {1, 0, 0});
-            transform = glm::rotate(transform, worldRotation.z, {0, 0, 1});
-
-            transform = glm::scale(transform, GetScale());
-            return transform;
+        //Points into the shared arrays, valid until a transform is created, destroyed or reparented
+        const glm::mat4 &mat4() const {
+            UpdateWorld();
+            return levels[m_depth].matrices[m_index];
         }
 
         void SetTransformId(int32_t id) {
             transformId = id;
+            LinkParent();
+            MarkWorldDirty();
         }
 
         int32_t GetTransformId() const {
@@ -67,65 +172,256 @@ namespace Kaamoo {
         }
 
         void SetTranslation(glm::vec3 t) {
-            translation = t;
+            if (GetRelativeTranslation() == t) return;
+            SetLocal(TranslationValue, t);
+            MarkWorldDirty();
         }
 
         glm::vec3 GetTranslation() const {
-            if (parentNode != nullptr && transformId != -1)
-                return translation + parentNode->GetTranslation();
-            return translation;
+            UpdateWorld();
+            return World(TranslationValue);
         }
         
         glm::vec3 GetRelativeTranslation() const {
-            return translation;
+            return Local(TranslationValue);
         }
 
         void SetScale(glm::vec3 s) {
-            scale = s;
+            if (GetRelativeScale() == s) return;
+            SetLocal(ScaleValue, s);
+            MarkWorldDirty();
         }
 
         glm::vec3 GetScale() const {
-            if (parentNode != nullptr && transformId != -1)
-                return scale * parentNode->GetScale();
-            return scale;
+            UpdateWorld();
+            return World(ScaleValue);
         }
         
         glm::vec3 GetRelativeScale() const {
-            return scale;
+            return Local(ScaleValue);
         }
 
         void SetRotation(glm::vec3 r) {
-            rotation = r;
+            if (GetRelativeRotation() == r) return;
+            SetLocal(RotationValue, r);
+            MarkRotationDirty();
         }
 
         glm::vec3 GetRotation() const {
-            if (parentNode != nullptr && transformId != -1)
-                return rotation + parentNode->GetRotation();
-            return rotation;
+            UpdateWorld();
+            return World(RotationValue);
         }
         
         glm::vec3 GetRelativeRotation() const {
-            return rotation;
+            return Local(RotationValue);
         }
         
         glm::mat3 GetRotationMatrix() const {
-            auto rotationMatrix = glm::mat4(1.0f);
-            rotationMatrix = glm::rotate(rotationMatrix, rotation.y, {0, 1, 0});
-            rotationMatrix = glm::rotate(rotationMatrix, rotation.x, {1, 0, 0});
-            rotationMatrix = glm::rotate(rotationMatrix, rotation.z, {0, 0, 1});
-            return glm::mat3(rotationMatrix);
+            if (m_rotationDirty) {
+                m_rotationMatrix = glm::mat3(EulerYXZ(GetRelativeRotation()));
+                m_rotationDirty = false;
+            }
+            return m_rotationMatrix;
         }
         
 
     private:
+        //First of the three floats of each value in Level::local and Level::world
+        static constexpr int TranslationValue = 0;
+        static constexpr int RotationValue = 3;
+        static constexpr int ScaleValue = 6;
+        static constexpr float IdentityValues[9] = {0, 0, 0, 0, 0, 0, 1, 1, 1};
+        static constexpr uint32_t NoParent = UINT32_MAX;
+
+        //Every transform of one hierarchy depth, an index into the arrays is a transform's m_index. parents holds the
+        //index of the parent one depth up, or NoParent when the transform does not inherit from it
+        struct Level {
+            std::vector<TransformComponent *> owners;
+            std::vector<uint32_t> parents;
+            std::vector<float> local[9];
+            std::vector<float> world[9];
+            std::vector<glm::mat4> matrices;
+            std::vector<uint8_t> dirty;
+        };
+
+        //Scratch arrays of UpdateDirtyTransforms, kept to avoid reallocating every frame
+        struct WorldBatch {
+            std::vector<float> values[9];
+            std::vector<float> matrices;
+            std::vector<uint32_t> indices;
+        };
+
+        inline static std::vector<Level> levels{};
+        //Number of transforms whose world values went dirty since the last UpdateDirtyTransforms
+        inline static size_t dirtyCount = 0;
+        inline static WorldBatch worldBatch{};
+
+        //Rotation about y, then x, then z, the order every matrix of this transform uses
+        static glm::mat4 EulerYXZ(glm::vec3 r) {
+            auto rotationMatrix = glm::rotate(glm::mat4(1.0f), r.y, {0, 1, 0});
+            rotationMatrix = glm::rotate(rotationMatrix, r.x, {1, 0, 0});
+            return glm::rotate(rotationMatrix, r.z, {0, 0, 1});
+        }
+
+        static TRSArrays WorldArrays(Level &level) {
+            auto &_world = level.world;
+            return {{_world[0].data(), _world[1].data(), _world[2].data()},
+                    {_world[3].data(), _world[4].data(), _world[5].data()},
+                    {_world[6].data(), _world[7].data(), _world[8].data()}};
+        }
+
+        //World values add the parent's translation and rotation and multiply its scale. Reads the parent's cached world
+        //values without bringing them up to date
+        static void ComputeWorld(size_t depth, uint32_t index) {
+            auto &_level = levels[depth];
+            for (int i = 0; i < 9; i++) {
+                _level.world[i][index] = _level.local[i][index];
+            }
+            uint32_t _parent = _level.parents[index];
+            if (_parent == NoParent) return;
+            auto &_parentLevel = levels[depth - 1];
+            for (int i = 0; i < 6; i++) {
+                _level.world[i][index] += _parentLevel.world[i][_parent];
+            }
+            for (int i = 6; i < 9; i++) {
+                _level.world[i][index] *= _parentLevel.world[i][_parent];
+            }
+        }
+
+        glm::vec3 Local(int value) const {
+            auto &_local = levels[m_depth].local;
+            return {_local[value][m_index], _local[value + 1][m_index], _local[value + 2][m_index]};
+        }
+
+        glm::vec3 World(int value) const {
+            auto &_world = levels[m_depth].world;
+            return {_world[value][m_index], _world[value + 1][m_index], _world[value + 2][m_index]};
+        }
+
+        void SetLocal(int value, glm::vec3 v) {
+            auto &_local = levels[m_depth].local;
+            for (int i = 0; i < 3; i++) {
+                _local[value + i][m_index] = v[i];
+            }
+        }
+
+        uint32_t ParentIndex() const {
+            return parentNode != nullptr && transformId != -1 ? parentNode->m_index : NoParent;
+        }
+
+        void LinkParent() {
+            levels[m_depth].parents[m_index] = ParentIndex();
+        }
+
+        //Appends this transform to the arrays of depth, dirty
+        void Insert(uint32_t depth, const float (&locals)[9]) {
+            if (levels.size() <= depth) {
+                levels.resize(depth + 1);
+            }
+            auto &_level = levels[depth];
+            m_depth = depth;
+            m_index = static_cast<uint32_t>(_level.owners.size());
+            _level.owners.push_back(this);
+            _level.parents.push_back(ParentIndex());
+            for (int i = 0; i < 9; i++) {
+                _level.local[i].push_back(locals[i]);
+                _level.world[i].push_back(locals[i]);
+            }
+            _level.matrices.emplace_back(1.f);
+            _level.dirty.push_back(true);
+            dirtyCount++;
+        }
+
+        //Fills the hole with the last transform of the depth, whose children then find it at its new index
+        void Erase() {
+            auto &_level = levels[m_depth];
+            if (_level.dirty[m_index]) {
+                dirtyCount--;
+            }
+            uint32_t _last = static_cast<uint32_t>(_level.owners.size() - 1);
+            if (m_index != _last) {
+                auto *_moved = _level.owners[_last];
+                _level.owners[m_index] = _moved;
+                _level.parents[m_index] = _level.parents[_last];
+                for (int i = 0; i < 9; i++) {
+                    _level.local[i][m_index] = _level.local[i][_last];
+                    _level.world[i][m_index] = _level.world[i][_last];
+                }
+                _level.matrices[m_index] = _level.matrices[_last];
+                _level.dirty[m_index] = _level.dirty[_last];
+                _moved->m_index = m_index;
+                //A transform moving one depth down can be erased right after its parent moved into its depth
+                for (auto *child: _moved->childrenNodes) {
+                    if (child != this) child->LinkParent();
+                }
+            }
+            _level.owners.pop_back();
+            _level.parents.pop_back();
+            for (int i = 0; i < 9; i++) {
+                _level.local[i].pop_back();
+                _level.world[i].pop_back();
+            }
+            _level.matrices.pop_back();
+            _level.dirty.pop_back();
+        }
+
+        void MarkRotationDirty() {
+            m_rotationDirty = true;
+            MarkWorldDirty();
+        }
+
+        //A dirty transform always has dirty descendants, so the walk can stop at the first one already marked
+        void MarkWorldDirty() {
+            auto &_dirty = levels[m_depth].dirty;
+            if (_dirty[m_index]) return;
+            _dirty[m_index] = true;
+            dirtyCount++;
+            for (auto *child: childrenNodes) {
+                child->MarkWorldDirty();
+            }
+        }
+
+        //Parents are brought up to date first, so each transform is rebuilt once after it or an ancestor changed no matter
+        //how often it is read
+        void UpdateWorld() const {
+            auto &_level = levels[m_depth];
+            if (!_level.dirty[m_index]) return;
+            if (_level.parents[m_index] != NoParent) {
+                parentNode->UpdateWorld();
+            }
+            ComputeWorld(m_depth, m_index);
+            TransformKernels::ComposeScalar(WorldArrays(_level), m_index, m_index + 1, &_level.matrices[0][0][0]);
+            _level.dirty[m_index] = false;
+            dirtyCount--;
+        }
+
+        //Moves this transform and its descendants to the arrays of their new depth, every moved transform is dirty
+        void SetDepth(uint32_t depth) {
+            if (depth == m_depth) {
+                LinkParent();
+                return;
+            }
+            float _locals[9];
+            for (int i = 0; i < 9; i++) {
+                _locals[i] = levels[m_depth].local[i][m_index];
+            }
+            Erase();
+            Insert(depth, _locals);
+            for (auto *child: childrenNodes) {
+                child->SetDepth(depth + 1);
+            }
+        }
 
         int32_t transformId = -1;
-        glm::vec3 translation{};
-        glm::vec3 scale{1.f, 1.f, 1.f};
-        glm::vec3 rotation{};
         TransformComponent *parentNode{nullptr};
         std::vector<TransformComponent *> childrenNodes{};
+        uint32_t m_depth = 0;
+        uint32_t m_index = 0;
+
+        //Refilled by the const getters, see the class comment for who may read it
+        mutable glm::mat3 m_rotationMatrix{1.f};
+        mutable bool m_rotationDirty = true;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -37,6 +37,8 @@ namespace Kaamoo {
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
 
+        const std::vector<VkDescriptorSetLayoutBinding> &getBindings() const { return bindings; }
+
     private:
         Device &Device;
         VkDescriptorSetLayout descriptorSetLayout;
@@ -1,4 +1,8 @@
 #include "Device.hpp"
+#include "UploadBatcher.h"
+#include "Sampler.h"
+#include "PipelineCache.h"
+#include "Utils/Profiler.h"
 
 #include <cstring>
 #include <iostream>
@@ -72,11 +76,23 @@ namespace Kaamoo {
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+#ifdef RAY_TRACING
+        memoryAllocator_ = std::make_unique<MemoryAllocator>(physicalDevice, device_, true);
+#else
+        memoryAllocator_ = std::make_unique<MemoryAllocator>(physicalDevice, device_, false);
+#endif
         createCommandPool();
+        uploadBatcher_ = std::make_unique<UploadBatcher>(*this);
+        samplerCache_ = std::make_unique<SamplerCache>(*this);
+        pipelineCache_ = std::make_unique<PipelineCache>(*this);
         deviceSingleton = this;
     }
 
     Device::~Device() {
+        pipelineCache_.reset();
+        samplerCache_.reset();
+        uploadBatcher_.reset();
+        memoryAllocator_.reset();
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -88,6 +104,10 @@ namespace Kaamoo {
         vkDestroyInstance(instance, nullptr);
     }
 
+    VkPipelineCache Device::pipelineCache() {
+        return pipelineCache_->getPipelineCache();
+    }
+
     void Device::createInstance() {
         if (enableValidationLayers && !checkValidationLayerSupport()) {
             throw std::runtime_error("validation layers requested, but not available!");
@@ -168,6 +188,9 @@ namespace Kaamoo {
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -182,10 +205,13 @@ namespace Kaamoo {
 
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        //Textures are cooked to BC7 and BC5
+        deviceFeatures.textureCompressionBC = VK_TRUE;
         deviceFeatures.geometryShader = VK_TRUE;
         deviceFeatures.tessellationShader = VK_TRUE;
         deviceFeatures.shaderInt64 = VK_TRUE;
         deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
 
         VkDeviceCreateInfo createInfo = {};
 
@@ -194,6 +220,12 @@ namespace Kaamoo {
         vulkan11Features.multiview = VK_TRUE;
         createInfo.pNext = &vulkan11Features;
 
+        //Meshlet culling draws a GPU written number of clusters
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        vulkan12Features.drawIndirectCount = VK_TRUE;
+        //Uploads on the transfer queue hand over to graphics through a timeline
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
 #ifdef RAY_TRACING
         VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {};
         accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
@@ -209,7 +241,6 @@ namespace Kaamoo {
 //        rayTracingValidationFeatures.rayTracingValidation = VK_TRUE;
 //        rayTracingPipelineFeatures.pNext = &rayTracingValidationFeatures;
 
-        VkPhysicalDeviceVulkan12Features vulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
         vulkan12Features.bufferDeviceAddress = VK_TRUE;
         vulkan12Features.hostQueryReset = VK_TRUE;
         vulkan12Features.runtimeDescriptorArray = VK_TRUE;
@@ -224,6 +255,8 @@ namespace Kaamoo {
 //        hostQueryResetFeatures.hostQueryReset = VK_TRUE;
 //        vulkan12Features.pNext = &hostQueryResetFeatures;
 
+#else
+        vulkan11Features.pNext = &vulkan12Features;
 #endif
 
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -246,6 +279,13 @@ namespace Kaamoo {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        if (indices.transferFamilyHasValue) {
+            vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+        } else {
+            transferQueue_ = graphicsQueue_;
+        }
+        std::cout << (indices.transferFamilyHasValue ? "uploads use transfer queue family " + std::to_string(indices.transferFamily)
+                                                     : std::string("no dedicated transfer queue family, uploads share the graphics queue")) << std::endl;
 
         loadExtensionFunctions();
     }
@@ -281,7 +321,7 @@ namespace Kaamoo {
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
         bool isDeviceSuitable = indices.isComplete() && extensionsSupported && swapChainAdequate &&
-                                supportedFeatures.samplerAnisotropy;
+                                supportedFeatures.samplerAnisotropy && supportedFeatures.textureCompressionBC;
 #ifdef RAY_TRACING
         VkPhysicalDeviceFeatures2 deviceFeatures2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
 //        VkPhysicalDeviceRayTracingValidationFeaturesNV rayTracingValidationFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_VALIDATION_FEATURES_NV};
@@ -431,6 +471,19 @@ namespace Kaamoo {
             i++;
         }
 
+        //Prefer a pure transfer family over an async compute one, both run copies beside the graphics queue
+        indices.transferFamilyHasValue = false;
+        for (uint32_t j = 0; j < queueFamilyCount; j++) {
+            const VkQueueFlags flags = queueFamilies[j].queueFlags;
+            if (queueFamilies[j].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+            bool pureTransfer = !(flags & VK_QUEUE_COMPUTE_BIT);
+            if (!indices.transferFamilyHasValue || pureTransfer) {
+                indices.transferFamily = j;
+                indices.transferFamilyHasValue = true;
+            }
+            if (pureTransfer) break;
+        }
+
         return indices;
     }
 
@@ -494,7 +547,8 @@ namespace Kaamoo {
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags propertyFlags,
             VkBuffer &buffer,
-            VkDeviceMemory &bufferMemory) {
+            MemoryAllocator::Allocation &allocation,
+            MemoryAllocator::Strategy strategy) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -505,25 +559,7 @@ namespace Kaamoo {
             throw std::runtime_error("failed to create vertex buffer!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-        VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {};
-        memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-        memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-        allocInfo.allocationSize = getAlignment(memRequirements.size, externalMemoryHostProperties.minImportedHostPointerAlignment);
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, propertyFlags);
-        allocInfo.pNext = &memoryAllocateFlagsInfo;
-
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate memory!");
-        }
-
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+        allocation = memoryAllocator_->allocateBufferMemory(buffer, propertyFlags, strategy);
     }
 
     VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -546,6 +582,8 @@ namespace Kaamoo {
 
     void Device::endSingleTimeCommands(VkCommandBuffer &commandBuffer) {
         vkEndCommandBuffer(commandBuffer);
+        //Pending uploads go first, the commands may read what they write
+        uploadBatcher_->flush();
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -553,7 +591,10 @@ namespace Kaamoo {
         submitInfo.pCommandBuffers = &commandBuffer;
 
         vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        {
+            PROFILE_GPU_WAIT("Device::endSingleTimeCommands");
+            vkQueueWaitIdle(graphicsQueue_);
+        }
 
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
@@ -601,26 +642,12 @@ namespace Kaamoo {
             const VkImageCreateInfo &imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage &image,
-            VkDeviceMemory &imageMemory) {
+            MemoryAllocator::Allocation &allocation) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
-        }
-
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-            throw std::runtime_error("failed to bind image memory!");
-        }
+        allocation = memoryAllocator_->allocateImageMemory(image, imageInfo.tiling, properties);
     }
 
     void Device::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
@@ -681,6 +708,12 @@ namespace Kaamoo {
         pfn_vkGetRayTracingCaptureReplayShaderGroupHandlesKHR = (PFN_vkGetRayTracingCaptureReplayShaderGroupHandlesKHR) getDeviceProcAddr(device, "vkGetRayTracingCaptureReplayShaderGroupHandlesKHR");
         pfn_vkGetRayTracingShaderGroupHandlesKHR = (PFN_vkGetRayTracingShaderGroupHandlesKHR) getDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR");
         pfn_vkGetRayTracingShaderGroupStackSizeKHR = (PFN_vkGetRayTracingShaderGroupStackSizeKHR) getDeviceProcAddr(device, "vkGetRayTracingShaderGroupStackSizeKHR");
+
+        pfn_vkCreateDeferredOperationKHR = (PFN_vkCreateDeferredOperationKHR) getDeviceProcAddr(device, "vkCreateDeferredOperationKHR");
+        pfn_vkDeferredOperationJoinKHR = (PFN_vkDeferredOperationJoinKHR) getDeviceProcAddr(device, "vkDeferredOperationJoinKHR");
+        pfn_vkDestroyDeferredOperationKHR = (PFN_vkDestroyDeferredOperationKHR) getDeviceProcAddr(device, "vkDestroyDeferredOperationKHR");
+        pfn_vkGetDeferredOperationMaxConcurrencyKHR = (PFN_vkGetDeferredOperationMaxConcurrencyKHR) getDeviceProcAddr(device, "vkGetDeferredOperationMaxConcurrencyKHR");
+        pfn_vkGetDeferredOperationResultKHR = (PFN_vkGetDeferredOperationResultKHR) getDeviceProcAddr(device, "vkGetDeferredOperationResultKHR");
 #endif
     }
 
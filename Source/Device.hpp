@@ -4,12 +4,17 @@
 #define VALIDATION_ENABLED
 
 #include "MyWindow.hpp"
+#include "MemoryAllocator.h"
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <vulkan/vulkan.h>
 
 namespace Kaamoo {
+    class UploadBatcher;
+    class SamplerCache;
+    class PipelineCache;
 
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
@@ -20,8 +25,11 @@ namespace Kaamoo {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        //Family without graphics support, the DMA engine on discrete GPUs
+        uint32_t transferFamily;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
 
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
@@ -61,6 +69,16 @@ namespace Kaamoo {
 
         VkCommandPool getCommandPool() { return commandPool; }
 
+        MemoryAllocator &memoryAllocator() { return *memoryAllocator_; }
+
+        //Shared staging ring for buffer and image uploads, submitted in batches instead of one stall per copy
+        UploadBatcher &uploadBatcher() { return *uploadBatcher_; }
+
+        SamplerCache &samplerCache() { return *samplerCache_; }
+
+        //Pass to every vkCreate*Pipelines call, it is internally synchronized so pipelines can be built on any thread
+        VkPipelineCache pipelineCache();
+
         const VkDevice& device() const { return device_; }
 
         VkSurfaceKHR surface() { return surface_; }
@@ -68,6 +86,11 @@ namespace Kaamoo {
         VkQueue graphicsQueue() { return graphicsQueue_; }
 
         VkQueue presentQueue() { return presentQueue_; }
+
+        //The dedicated transfer queue, or the graphics queue when the device has none
+        VkQueue transferQueue() { return transferQueue_; }
+
+        bool hasDedicatedTransferQueue() const { return indices.transferFamilyHasValue; }
         
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 
@@ -77,7 +100,8 @@ namespace Kaamoo {
 
         VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-        void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags propertyFlags, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+        void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags propertyFlags, VkBuffer &buffer,
+                          MemoryAllocator::Allocation &allocation, MemoryAllocator::Strategy strategy = MemoryAllocator::Strategy::Buddy);
 
         VkCommandBuffer beginSingleTimeCommands();
 
@@ -89,7 +113,7 @@ namespace Kaamoo {
 
         void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageSubresourceRange subresourceRange);
 
-        void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
+        void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocator::Allocation &allocation);
 
         VkPipelineStageFlagBits pipelineStageForLayout(VkImageLayout layout);
 
@@ -118,11 +142,16 @@ namespace Kaamoo {
         VkDebugUtilsMessengerEXT debugMessenger;
         MyWindow &window;
         VkCommandPool commandPool;
+        std::unique_ptr<MemoryAllocator> memoryAllocator_;
+        std::unique_ptr<UploadBatcher> uploadBatcher_;
+        std::unique_ptr<SamplerCache> samplerCache_;
+        std::unique_ptr<PipelineCache> pipelineCache_;
 
         VkDevice device_;
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_;
         
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         
@@ -202,6 +231,12 @@ namespace Kaamoo {
         inline static PFN_vkGetRayTracingCaptureReplayShaderGroupHandlesKHR pfn_vkGetRayTracingCaptureReplayShaderGroupHandlesKHR = 0;
         inline static PFN_vkGetRayTracingShaderGroupHandlesKHR pfn_vkGetRayTracingShaderGroupHandlesKHR = 0;
         inline static PFN_vkGetRayTracingShaderGroupStackSizeKHR pfn_vkGetRayTracingShaderGroupStackSizeKHR = 0;
+
+        inline static PFN_vkCreateDeferredOperationKHR pfn_vkCreateDeferredOperationKHR = 0;
+        inline static PFN_vkDeferredOperationJoinKHR pfn_vkDeferredOperationJoinKHR = 0;
+        inline static PFN_vkDestroyDeferredOperationKHR pfn_vkDestroyDeferredOperationKHR = 0;
+        inline static PFN_vkGetDeferredOperationMaxConcurrencyKHR pfn_vkGetDeferredOperationMaxConcurrencyKHR = 0;
+        inline static PFN_vkGetDeferredOperationResultKHR pfn_vkGetDeferredOperationResultKHR = 0;
 #endif
     };
 
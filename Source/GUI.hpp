@@ -8,7 +8,7 @@ namespace Kaamoo {
     public:
         GUI() = delete;
 
-        static id_t GetSelectedId() { return selectedId; }
+        static GameObject::Handle GetSelectedHandle() { return selectedHandle; }
 
         static void Destroy() {
             ImGui_ImplVulkan_Shutdown();
@@ -97,7 +97,7 @@ namespace Kaamoo {
             ImGui::Begin("Scene", nullptr, window_flags);
             ShowPerformance(frameInfo);
             if (ImGui::TreeNode("Hierarchy")) {
-                ShowHierarchyTree(hierarchyTree->GetRoot());
+                ShowHierarchyTree(hierarchyTree->GetRoot(), *pGameObjectsMap);
                 ImGui::TreePop();
             }
             ImGui::End();
@@ -107,8 +107,9 @@ namespace Kaamoo {
             ImGui::Begin("Inspector", nullptr, window_flags);
 
 
-            if (bSelected) {
-                auto &gameObject = pGameObjectsMap->at(selectedId);
+            auto *selectedObject = bSelected ? pGameObjectsMap->get(selectedHandle) : nullptr;
+            if (selectedObject != nullptr) {
+                auto &gameObject = *selectedObject;
                 ImGui::Text("Name:");
                 ImGui::SameLine(70);
                 ImGui::Text(gameObject.GetName().c_str());
@@ -163,7 +164,7 @@ namespace Kaamoo {
             ImGui::Begin("Scene", nullptr, window_flags);
             ShowPerformance(frameInfo);
             if (ImGui::TreeNode("Hierarchy")) {
-                ShowHierarchyTree(hierarchyTree->GetRoot());
+                ShowHierarchyTree(hierarchyTree->GetRoot(), *pGameObjectsMap);
                 ImGui::TreePop();
             }
             ImGui::End();
@@ -171,8 +172,9 @@ namespace Kaamoo {
             ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
             ImGui::SetNextWindowSize(ImVec2(UI_LEFT_WIDTH_2, windowExtent.y), ImGuiCond_Always);
             ImGui::Begin("Inspector", nullptr, window_flags);
-            if (bSelected) {
-                auto &gameObject = pGameObjectsMap->at(selectedId);
+            auto *selectedObject = bSelected ? pGameObjectsMap->get(selectedHandle) : nullptr;
+            if (selectedObject != nullptr) {
+                auto &gameObject = *selectedObject;
                 ImGui::Text("Name:");
                 ImGui::SameLine(70);
                 ImGui::Text(gameObject.GetName().c_str());
@@ -224,7 +226,7 @@ namespace Kaamoo {
     private:
         inline static VkDescriptorPool imguiDescPool{};
         inline static bool bSelected;
-        inline static id_t selectedId = -1;
+        inline static GameObject::Handle selectedHandle{};
 
         static void ShowPerformance(FrameInfo &frameInfo) {
             if (ImGui::TreeNode("Performance")) {
@@ -233,53 +235,63 @@ namespace Kaamoo {
                 sprintf(fpsText, "FPS: %s", framePerSecondStr.c_str());
                 ImGui::Text(fpsText);
 
+                auto memoryStatistics = Device::getDeviceSingleton()->memoryAllocator().getStatistics();
+                char memoryText[100];
+                sprintf(memoryText, "GPU allocations: %u in %u memory objects", memoryStatistics.allocationCount, memoryStatistics.deviceMemoryCount);
+                ImGui::Text(memoryText);
+                sprintf(memoryText, "GPU memory: %.1f / %.1f MB", static_cast<float>(memoryStatistics.usedBytes) / (1024.0f * 1024.0f),
+                        static_cast<float>(memoryStatistics.reservedBytes) / (1024.0f * 1024.0f));
+                ImGui::Text(memoryText);
+
                 ImGui::TreePop();
             }
         }
 
-        static void ShowHierarchyTree(HierarchyTree::Node *node) {
-            for (auto &child: node->children) {
+        static void ShowHierarchyTree(HierarchyTree::Node *node, GameObject::Map &gameObjects) {
+            for (auto *child = node->firstChild; child != nullptr; child = child->nextSibling) {
+                auto *_gameObject = gameObjects.get(child->gameObject);
+                if (_gameObject == nullptr) continue;
                 ImGui::SetNextItemAllowOverlap();
-                if (!child->children.empty()) {
-                    if (ImGui::TreeNodeEx(child->gameObject->GetName().c_str(),
-                                          ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth | (selectedId == child->gameObject->GetId() ? ImGuiTreeNodeFlags_Selected : 0))) {
+                if (child->firstChild != nullptr) {
+                    if (ImGui::TreeNodeEx(_gameObject->GetName().c_str(),
+                                          ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth | (selectedHandle == child->gameObject ? ImGuiTreeNodeFlags_Selected : 0))) {
                         if (ImGui::IsItemClicked()) {
-                            selectedId = child->gameObject->GetId();
+                            selectedHandle = child->gameObject;
                             bSelected = true;
                         }
-                        DrawSelectionRect(child);
-                        ShowHierarchyTree(child);
+                        DrawSelectionRect(child, *_gameObject);
+                        ShowHierarchyTree(child, gameObjects);
                         ImGui::TreePop();
                     }
                 } else {
-                    ImGui::TreeNodeEx(child->gameObject->GetName().c_str(),
+                    ImGui::TreeNodeEx(_gameObject->GetName().c_str(),
                                       ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_SpanAvailWidth |
-                                      (selectedId == child->gameObject->GetId() ? ImGuiTreeNodeFlags_Selected : 0));
+                                      (selectedHandle == child->gameObject ? ImGuiTreeNodeFlags_Selected : 0));
                     if (ImGui::IsItemClicked()) {
-                        selectedId = child->gameObject->GetId();
+                        selectedHandle = child->gameObject;
                         bSelected = true;
                     }
-                    DrawSelectionRect(child);
+                    DrawSelectionRect(child, *_gameObject);
 
                 }
             }
         }
 
     private:
-        static void DrawSelectionRect(HierarchyTree::Node *child) {
+        static void DrawSelectionRect(HierarchyTree::Node *child, GameObject &gameObject) {
             auto _extent = ImGui::GetContentRegionAvail();
 
-            ImGui::PushID(child->gameObject->GetId());
+            ImGui::PushID(child->id);
 
             ImGui::SameLine(_extent.x);
 
-            bool _isSelected = child->gameObject->IsActive();
+            bool _isSelected = gameObject.IsActive();
             ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
-            ImGui::Checkbox(("##Checkbox" + std::to_string(child->gameObject->GetId())).c_str(), &_isSelected);
+            ImGui::Checkbox(("##Checkbox" + std::to_string(child->id)).c_str(), &_isSelected);
 
-            if (_isSelected == !child->gameObject->IsActive()) {
-                if (!_isSelected)child->gameObject->SetOnDisabled(true);
-                else child->gameObject->SetOnEnabled(true);
+            if (_isSelected == !gameObject.IsActive()) {
+                if (!_isSelected)gameObject.SetOnDisabled(true);
+                else gameObject.SetOnEnabled(true);
             }
 
             ImGui::PopStyleVar();
@@ -1,8 +1,14 @@
 ﻿#ifndef GAME_OBJECT_INCLUDED
 #define GAME_OBJECT_INCLUDED
 
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <memory>
+#include <type_traits>
+#include <unordered_map>
 #include "Utils/Utils.hpp"
+#include "Utils/SlotMap.hpp"
 #include "Components/TransformComponent.hpp"
 
 namespace Kaamoo {
@@ -10,7 +16,9 @@ namespace Kaamoo {
 
     class GameObject {
     public:
-        using Map = std::unordered_map<id_t, GameObject>;
+        //Game objects are stored by value in a slot map, anything kept across frames refers to them by Handle
+        using Map = SlotMap<GameObject>;
+        using Handle = SlotMapHandle;
 
         TransformComponent *transform;
 
@@ -20,13 +28,20 @@ namespace Kaamoo {
             }
         }
 
-        static GameObject &createGameObject(std::string name = "GameObject") {
+        static GameObject createGameObject(std::string name = "GameObject") {
             static id_t currentID = 0;
-            auto *gameObject = new GameObject(currentID++, std::move(name));
+            GameObject gameObject(currentID++, std::move(name));
             auto *t = new TransformComponent();
-            gameObject->TryAddComponent(t);
-            gameObject->transform = t;
-            return *gameObject;
+            gameObject.TryAddComponent(t);
+            gameObject.transform = t;
+            return gameObject;
+        }
+
+        //Inserts gameObject and tells it its handle
+        static Handle insertInto(Map &map, GameObject &&gameObject) {
+            auto handle = map.insert(std::move(gameObject));
+            map.get(handle)->m_handle = handle;
+            return handle;
         }
 
 
@@ -38,6 +53,9 @@ namespace Kaamoo {
         
         id_t GetId() { return id; }
 
+        //Invalid until the object is inserted into a Map
+        Handle GetHandle() const { return m_handle; }
+
         std::string GetName() const { return name; }
         void SetName(std::string name) { GameObject::name = std::move(name); }
         
@@ -50,31 +68,37 @@ namespace Kaamoo {
         bool IsOnEnabled() const { return m_onEnabled; }
         void SetOnEnabled(bool onEnabled) { m_onEnabled = onEnabled; }
 
-        std::vector<Component *> getComponents() { return m_components; }
+        const std::vector<Component *> &getComponents() const { return m_components; }
 
         template<typename T, typename std::enable_if<std::is_base_of<Component, T>::value, int>::type = 0>
         void TryAddComponent(T *component) {
-            for (auto &item: m_components) {
-                if (item->GetName() == component->GetName()) {
-                    throw std::runtime_error(
-                            "Game Object " + name + " already has component type " + component->GetName());
-                }
+            auto typeIndex = static_cast<uint32_t>(component->GetType());
+            if (m_componentMask & (ComponentMask(1) << typeIndex)) {
+                throw std::runtime_error(
+                        "Game Object " + name + " already has component type " + component->GetName());
             }
+            m_componentMask |= ComponentMask(1) << typeIndex;
+            m_componentSlots[typeIndex] = component;
             m_components.push_back(component);
         }
 
+        //Only concrete component types have a slot, see ComponentType
         template<typename T>
         bool TryGetComponent(T *&component) {
-            for (auto &item: m_components) {
-                T *targetComponent = dynamic_cast<T *>(item);
-                if (targetComponent != nullptr) {
-                    component = targetComponent;
-                    return true;
-                }
-            }
-            return false;
+            static_assert(std::is_base_of<Component, T>::value, "T is not a component");
+            constexpr auto typeIndex = static_cast<uint32_t>(T::Type);
+            if (!(m_componentMask & (ComponentMask(1) << typeIndex))) return false;
+            component = static_cast<T *>(m_componentSlots[typeIndex]);
+            return true;
         }
 
+        template<typename T>
+        bool HasComponent() const {
+            return m_componentMask & (ComponentMask(1) << static_cast<uint32_t>(T::Type));
+        }
+
+        ComponentMask GetComponentMask() const { return m_componentMask; }
+
         void OnLoad() {
             for (auto &component: m_components) {
                 component->OnLoad(this);
@@ -143,82 +167,189 @@ namespace Kaamoo {
         bool m_isActive = true;
         bool m_onDisabled = false;
         bool m_onEnabled = false;
+        //Owns the components in the order they were added, which is the order the callbacks run in
         std::vector<Component *> m_components;
+        //Lookup by type, the mask tells which slots are set
+        std::array<Component *, static_cast<size_t>(ComponentType::Count)> m_componentSlots{};
+        ComponentMask m_componentMask = 0;
 
         id_t id;
+        Handle m_handle;
 
         std::string name;
 
         GameObject(id_t id, std::string name = "GameObject") : id{id}, name{std::move(name)} {};
     };
 
+    //Scene hierarchy shown by the GUI, keyed by game object id. Nodes are pooled and indexed by id, children are kept as an
+    //intrusive sibling list, so adding, removing and reparenting a node are O(1) apart from the cycle check
     class HierarchyTree {
     public:
         struct Node {
             int id;
-            GameObject *gameObject;
-            int parentTransformId;
-            std::vector<Node *> children;
+            GameObject::Handle gameObject;
+            Node *parent = nullptr;
+            Node *firstChild = nullptr;
+            Node *lastChild = nullptr;
+            Node *previousSibling = nullptr;
+            Node *nextSibling = nullptr;
+            //Id of the parent this node waits for under the root, ROOT_ID when it waits for nothing
+            int awaitedParentId = ROOT_ID;
         };
         static const int ROOT_ID = -1;
         static const int DEFAULT_TRANSFORM_ID = -2;
 
         HierarchyTree() {
-            m_root = new Node{ROOT_ID, nullptr};
+            m_root.id = ROOT_ID;
         };
 
+        HierarchyTree(const HierarchyTree &) = delete;
+
+        HierarchyTree &operator=(const HierarchyTree &) = delete;
+
         Node *GetRoot() {
-            return m_root;
+            return &m_root;
         }
 
-        bool AddNode(int parentId, int childId, GameObject *childGameObject) {
+        Node *FindNode(int id) {
+            if (id == ROOT_ID) return &m_root;
+            auto iterator = m_nodes.find(id);
+            return iterator != m_nodes.end() ? iterator->second : nullptr;
+        }
 
-            auto parentNode = FindNode(parentId, m_root);
+        //Children may arrive before their parent, they wait under the root until it is added
+        bool AddNode(int parentId, int childId, GameObject &childGameObject) {
+            if (m_nodes.find(childId) != m_nodes.end()) return false;
 
+            auto *node = AllocateNode();
+            node->id = childId;
+            node->gameObject = childGameObject.GetHandle();
+            m_nodes.emplace(childId, node);
+
+            auto *parentNode = FindNode(parentId);
             if (parentNode == nullptr) {
-                auto node = new Node{childId, childGameObject, parentId};
-                m_fakeNodes.push_back(node);
-                m_root->children.push_back(node);
+                Attach(node, &m_root);
+                node->awaitedParentId = parentId;
+                m_waitingChildren[parentId].push_back(node);
             } else {
-                auto node = new Node{childId, childGameObject};
-                parentNode->children.push_back(node);
-                for (auto &fakeNode: m_fakeNodes) {
-                    if (childGameObject->transform->GetTransformId() == fakeNode->parentTransformId) {
-                        node->children.push_back(fakeNode);
-                        auto it = std::find_if(m_root->children.begin(), m_root->children.end(), [&fakeNode](const Node *node) {
-                            return node->id == fakeNode->id;
-                        });
-                        if (it != m_root->children.end()) {
-                            m_root->children.erase(it);
-                        }
-
-                        it = std::find(m_fakeNodes.begin(), m_fakeNodes.end(), fakeNode);
-                        if (it != m_fakeNodes.end()) {
-                            m_fakeNodes.erase(it);
-                        }
-                    }
-                }
+                Attach(node, parentNode);
             }
 
+            auto waiting = m_waitingChildren.find(childId);
+            if (waiting != m_waitingChildren.end()) {
+                for (auto *waitingNode: waiting->second) {
+                    waitingNode->awaitedParentId = ROOT_ID;
+                    Detach(waitingNode);
+                    Attach(waitingNode, node);
+                }
+                m_waitingChildren.erase(waiting);
+            }
             return true;
         }
 
+        //Removes the node of id, its children move up to its parent. Transform links in gameObjects follow the tree
+        bool RemoveNode(int id, GameObject::Map &gameObjects) {
+            auto *node = FindNode(id);
+            if (node == nullptr || node == &m_root) return false;
+
+            auto *parentNode = node->parent;
+            auto *parentTransform = TransformOf(parentNode, gameObjects);
+            auto *transform = TransformOf(node, gameObjects);
+            while (node->firstChild != nullptr) {
+                auto *child = node->firstChild;
+                Detach(child);
+                Attach(child, parentNode);
+                LinkTransforms(parentTransform, TransformOf(child, gameObjects));
+            }
+            if (transform != nullptr && transform->GetParent() != nullptr) {
+                transform->GetParent()->RemoveChild(transform);
+            }
 
-    private:
-        Node *m_root = nullptr;
-        std::vector<Node *> m_fakeNodes;
+            StopWaiting(node);
+            Detach(node);
+            m_nodes.erase(id);
+            *node = Node{};
+            m_freeNodes.push_back(node);
+            return true;
+        }
 
-        Node *FindNode(int id, Node *tmpNode) {
-            if (tmpNode->id == id) {
-                return tmpNode;
+        //Moves the node of id under newParentId, refusing to make a node its own descendant
+        bool Reparent(int id, int newParentId, GameObject::Map &gameObjects) {
+            auto *node = FindNode(id);
+            auto *newParent = FindNode(newParentId);
+            if (node == nullptr || newParent == nullptr || node == &m_root) return false;
+            for (auto *ancestor = newParent; ancestor != nullptr; ancestor = ancestor->parent) {
+                if (ancestor == node) return false;
             }
-            for (auto &child: tmpNode->children) {
-                auto node = FindNode(id, child);
-                if (node != nullptr) {
-                    return node;
-                }
+
+            StopWaiting(node);
+            Detach(node);
+            Attach(node, newParent);
+            LinkTransforms(TransformOf(newParent, gameObjects), TransformOf(node, gameObjects));
+            return true;
+        }
+
+        size_t GetNodeCount() const {
+            return m_nodes.size();
+        }
+
+    private:
+        Node m_root{};
+        std::deque<Node> m_nodePool;
+        std::vector<Node *> m_freeNodes;
+        std::unordered_map<int, Node *> m_nodes;
+        //Parent id to nodes parked under the root until that parent is added
+        std::unordered_map<int, std::vector<Node *>> m_waitingChildren;
+
+        Node *AllocateNode() {
+            if (!m_freeNodes.empty()) {
+                auto *node = m_freeNodes.back();
+                m_freeNodes.pop_back();
+                return node;
             }
-            return nullptr;
+            return &m_nodePool.emplace_back();
+        }
+
+        //A node recycled or moved while it waits would otherwise be moved again when the parent it waited for is added
+        void StopWaiting(Node *node) {
+            if (node->awaitedParentId == ROOT_ID) return;
+            auto waiting = m_waitingChildren.find(node->awaitedParentId);
+            auto &waitingNodes = waiting->second;
+            waitingNodes.erase(std::find(waitingNodes.begin(), waitingNodes.end(), node));
+            if (waitingNodes.empty()) m_waitingChildren.erase(waiting);
+            node->awaitedParentId = ROOT_ID;
+        }
+
+        static void Attach(Node *node, Node *parent) {
+            node->parent = parent;
+            node->previousSibling = parent->lastChild;
+            node->nextSibling = nullptr;
+            if (parent->lastChild != nullptr) parent->lastChild->nextSibling = node;
+            else parent->firstChild = node;
+            parent->lastChild = node;
+        }
+
+        static void Detach(Node *node) {
+            auto *parent = node->parent;
+            if (parent == nullptr) return;
+            if (node->previousSibling != nullptr) node->previousSibling->nextSibling = node->nextSibling;
+            else parent->firstChild = node->nextSibling;
+            if (node->nextSibling != nullptr) node->nextSibling->previousSibling = node->previousSibling;
+            else parent->lastChild = node->previousSibling;
+            node->parent = node->previousSibling = node->nextSibling = nullptr;
+        }
+
+        static TransformComponent *TransformOf(Node *node, GameObject::Map &gameObjects) {
+            if (node == nullptr) return nullptr;
+            auto *gameObject = gameObjects.get(node->gameObject);
+            return gameObject != nullptr ? gameObject->transform : nullptr;
+        }
+
+        //Makes the transform links match the tree, a node under the root has no parent transform
+        static void LinkTransforms(TransformComponent *newParent, TransformComponent *child) {
+            if (child == nullptr) return;
+            if (newParent != nullptr) newParent->AddChild(child);
+            else if (child->GetParent() != nullptr) child->GetParent()->RemoveChild(child);
         }
     };
 
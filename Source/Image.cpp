@@ -1,96 +1,67 @@
-﻿#include <stdexcept>
+﻿#include <algorithm>
+#include <stdexcept>
 #include <memory>
 #include <utility>
 #include "Image.h"
 #include "Buffer.h"
+#include "AssetLoader.h"
+#include "UploadBatcher.h"
+#include "Utils/Profiler.h"
 
 namespace Kaamoo {
-    void Image::createDefaultImage(const std::string &path, VkImageCreateInfo createInfo) {
-        stbi_uc *pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-        if (pixels == nullptr) {
-            throw std::runtime_error("Failed to load pixels from given texture path");
+    std::shared_ptr<const Image::Pixels> Image::LoadPixels(const std::string &path, bool cubeMap) {
+        PROFILE_SCOPE("Image::LoadPixels");
+        auto pixels = std::make_shared<Pixels>();
+        pixels->layerCount = cubeMap ? 6 : 1;
+        for (uint32_t i = 0; i < pixels->layerCount; i++) {
+            std::string layerPath = cubeMap ? path + "/" + CubeMapFaceNames[i] : path;
+            int width, height, channels;
+            stbi_uc *layerPixels = stbi_load(layerPath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (layerPixels == nullptr) {
+                throw std::runtime_error("Failed to load pixels from given texture path: " + layerPath);
+            }
+            if (i > 0 && (width != pixels->width || height != pixels->height)) {
+                stbi_image_free(layerPixels);
+                throw std::runtime_error("Cube map faces differ in size: " + layerPath);
+            }
+            pixels->width = width;
+            pixels->height = height;
+            size_t layerSize = static_cast<size_t>(width) * height * 4;
+            pixels->data.insert(pixels->data.end(), layerPixels, layerPixels + layerSize);
+            stbi_image_free(layerPixels);
         }
-
-        std::unique_ptr<Buffer> stagingBuffer = std::make_unique<Buffer>(device, imageSize, 1,
-                                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        stagingBuffer->map();
-        stagingBuffer->writeToBuffer(pixels, imageSize);
-        stagingBuffer->unmap();
-
-        stbi_image_free(pixels);
-
-        createInfo.extent.width = texWidth;
-        createInfo.extent.height = texHeight;
-
-        device.createImageWithInfo(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
-
-
-        VkImageSubresourceRange subresourceRange{};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount = 1;
-        subresourceRange.baseArrayLayer = 0;
-        subresourceRange.layerCount = 1;
-        device.transitionImageLayout(image, createInfo.initialLayout,
-                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-        device.copyBufferToImage(stagingBuffer->getBuffer(), image, static_cast<uint32_t>(texWidth),
-                                 static_cast<uint32_t>(texHeight), 1);
-        device.transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-
-
+        return pixels;
     }
 
-    void Image::createCubeMapImage(const std::string &path, VkImageCreateInfo createInfo) {
-        const std::string cubeMapSuffix[6] = {"posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg"};
-        stbi_uc *cubeMapPixels[6];
-        for (int i = 0; i < 6; i++) {
-            std::string cubeMapPath = path + "/" + cubeMapSuffix[i];
-            cubeMapPixels[i] = stbi_load(cubeMapPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        }
-        VkDeviceSize imageSize = texWidth * texHeight * 4 * 6;
-
-        std::unique_ptr<Buffer> stagingBuffer = std::make_unique<Buffer>(device, imageSize, 1,
-                                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        stagingBuffer->map();
-        VkDeviceSize layerSize = imageSize / 6;
-        for (int i = 0; i < 6; ++i) {
-            stagingBuffer->writeToBuffer(cubeMapPixels[i], layerSize, layerSize * i);
-        }
-        stagingBuffer->unmap();
-
-        for (int i = 0; i < 6; i++) {
-            stbi_image_free(cubeMapPixels[i]);
+    void Image::uploadTexture(const TextureCooker::CookedTexture &texture, VkImageCreateInfo createInfo) {
+        uint32_t mipLevels = texture.mipCount - texture.firstMip;
+        texWidth = static_cast<int>(std::max(texture.width >> texture.firstMip, 1u));
+        texHeight = static_cast<int>(std::max(texture.height >> texture.firstMip, 1u));
+        texChannels = 4;
+
+        createInfo.extent.width = static_cast<uint32_t>(texWidth);
+        createInfo.extent.height = static_cast<uint32_t>(texHeight);
+        createInfo.mipLevels = mipLevels;
+        createInfo.arrayLayers = texture.layerCount;
+        m_format = createInfo.format;
+        m_mipLevels = mipLevels;
+
+        device.createImageWithInfo(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+        //Every mip is copied straight from the cooked container, one region per level covering all layers
+        std::vector<VkBufferImageCopy> regions(mipLevels);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            uint32_t mip = texture.firstMip + level;
+            auto &region = regions[level];
+            region.bufferOffset = texture.mipOffsets[level];
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = texture.layerCount;
+            region.imageExtent = {std::max(texture.width >> mip, 1u), std::max(texture.height >> mip, 1u), 1};
         }
-
-        createInfo.extent.width = texWidth;
-        createInfo.extent.height = texHeight;
-        createInfo.arrayLayers = 6;
-        createInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-        createInfo.imageType = VK_IMAGE_TYPE_2D;
-
-        device.createImageWithInfo(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
-
-        VkImageSubresourceRange subresourceRange{};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount = 1;
-        subresourceRange.baseArrayLayer = 0;
-        subresourceRange.layerCount = 6;
-        device.transitionImageLayout(image, createInfo.initialLayout,
-                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-        device.copyBufferToImage(stagingBuffer->getBuffer(), image, static_cast<uint32_t>(texWidth),
-                                 static_cast<uint32_t>(texHeight), 6);
-        device.transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-
-
+        device.uploadBatcher().uploadImage(image, texture.data.data(), texture.data.size(), std::move(regions), mipLevels,
+                                           texture.layerCount);
     }
 
     Image::Image(Device &device, std::string imageCategory) : device{device}, imageType(imageCategory) {}
@@ -98,7 +69,7 @@ namespace Kaamoo {
     Image::~Image() {
         vkDestroyImage(device.device(), image, nullptr);
         vkDestroyImageView(device.device(), imageView, nullptr);
-        vkFreeMemory(device.device(), imageMemory, nullptr);
+        device.memoryAllocator().free(imageAllocation);
     }
 
     void Image::setDefaultImageCreateInfo(VkImageCreateInfo &defaultCreateInfo) {
@@ -129,29 +100,37 @@ namespace Kaamoo {
     void Image::setDefaultImageViewCreateInfo(VkImageViewCreateInfo &imageViewCreateInfo) {
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         imageViewCreateInfo.image = image;
-        imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageViewCreateInfo.format = m_format;
         imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
         imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
-        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.levelCount = m_mipLevels;
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
 
     }
 
     void Image::createTextureImage(const std::string &path,bool SRGB) {
+        //Cooked ahead of time by AssetLoader::Prefetch when the path was listed in the configuration
+        auto texture = AssetLoader::GetInstance().GetTexture(path, imageType == ImageType.CubeMap);
+        createTextureImage(*texture, SRGB);
+    }
+
+    void Image::createTextureImage(const TextureCooker::CookedTexture &texture, bool SRGB) {
         VkImageCreateInfo createInfo{};
         setDefaultImageCreateInfo(createInfo);
-        if (SRGB){
-            createInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+        bool cubeMap = imageType == ImageType.CubeMap;
+        if (texture.format == TextureCooker::Format::BC5) {
+            createInfo.format = VK_FORMAT_BC5_UNORM_BLOCK;
+        } else {
+            createInfo.format = SRGB || cubeMap ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
         }
-        if (imageType == ImageType.CubeMap) {
-            createInfo.arrayLayers = 6;
+        //Nothing is blitted into textures anymore, the mips come cooked
+        createInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (cubeMap) {
             createInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-            createCubeMapImage(path, createInfo);
-        } else {
-            createDefaultImage(path, createInfo);
         }
+        uploadTexture(texture, createInfo);
     }
 
     void Image::createImageView() {
@@ -160,7 +139,6 @@ namespace Kaamoo {
         if (imageType == ImageType.CubeMap) {
             createInfo.subresourceRange.layerCount = 6;
             createInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-            createInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
         }
         createImageView(createInfo);
     }
@@ -183,7 +161,9 @@ namespace Kaamoo {
 
 
     void Image::createImage(VkImageCreateInfo createInfo) {
-        device.createImageWithInfo(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+        m_format = createInfo.format;
+        m_mipLevels = createInfo.mipLevels;
+        device.createImageWithInfo(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
     }
 
     const VkImageView *Image::getImageView() const {
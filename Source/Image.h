@@ -5,10 +5,13 @@
 
 #include "../External/stb_image.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <vulkan/vulkan.h>
 #include "Device.hpp"
 #include "Sampler.h"
+#include "Texture/TextureCooker.h"
 
 namespace Kaamoo {
     const struct ImageCategory{
@@ -20,6 +23,16 @@ namespace Kaamoo {
     
     class Image {
     public:
+        //Decoded RGBA8 texels, cube maps hold the six faces one after another
+        struct Pixels {
+            int width = 0;
+            int height = 0;
+            uint32_t layerCount = 1;
+            std::vector<stbi_uc> data;
+        };
+
+        inline static const std::string CubeMapFaceNames[6] = {"posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg"};
+
         VkImage image;
         VkImageView imageView;
         VkSampler sampler;
@@ -30,6 +43,13 @@ namespace Kaamoo {
 
         void createTextureImage(const std::string& path,bool SRGB = false);
 
+        //Creates the image from already loaded mips, covering only those from texture.firstMip down
+        void createTextureImage(const TextureCooker::CookedTexture &texture, bool SRGB = false);
+
+        //Decodes a texture file, or the six faces of a cube map directory, without touching the device.
+        //Safe to call from worker threads
+        static std::shared_ptr<const Pixels> LoadPixels(const std::string &path, bool cubeMap);
+
 
         void createImageView();
 
@@ -50,18 +70,21 @@ namespace Kaamoo {
         void createImage(VkImageCreateInfo createInfo);
 
         const VkImageView *getImageView() const;
+
+        VkDeviceSize getMemorySize() const { return imageAllocation.size; }
         
     private:
         Device &device;
         
-        VkDeviceMemory imageMemory{};
+        MemoryAllocator::Allocation imageAllocation{};
         int texWidth, texHeight, texChannels;
+        //Format and mip count the image was created with, views of textures follow them
+        VkFormat m_format = VK_FORMAT_R8G8B8A8_UNORM;
+        uint32_t m_mipLevels = 1;
         
         std::string imageType;
         
-        void createDefaultImage(const std::string& path, VkImageCreateInfo createInfo);
-
-        void createCubeMapImage(const std::string &path, VkImageCreateInfo createInfo);
+        void uploadTexture(const TextureCooker::CookedTexture &texture, VkImageCreateInfo createInfo);
     };
 
 
@@ -1,4 +1,6 @@
 ﻿#include <utility>
+#include "UpdateScheduler.hpp"
+#include "PhysicsManager.hpp"
 
 
 namespace Kaamoo {
@@ -8,7 +10,10 @@ namespace Kaamoo {
             m_resourceManager = resourceManager;
         };
 
-        ~LogicManager() {};
+        //Joins the physics thread while the game objects are still alive
+        ~LogicManager() {
+            m_physicsManager.Stop();
+        };
 
         LogicManager(const LogicManager &) = delete;
 
@@ -26,16 +31,16 @@ namespace Kaamoo {
 
             static bool firstFrame = true;
             if (firstFrame) {
-                for (auto &pair: _gameObjects) {
-                    if (!pair.second.IsActive()) continue;
-                    updateInfo.gameObject = &pair.second;
-                    pair.second.Start(updateInfo);
+                for (auto &_gameObject: _gameObjects) {
+                    if (!_gameObject.IsActive()) continue;
+                    updateInfo.gameObject = &_gameObject;
+                    _gameObject.Start(updateInfo);
                 }
                 firstFrame = false;
+                m_physicsManager.Start();
             }
 
-            for (auto &pair: _gameObjects) {
-                auto& _gameObject = pair.second;
+            for (auto &_gameObject: _gameObjects) {
                 updateInfo.gameObject = &_gameObject;
                 if (_gameObject.IsOnDisabled()) {
                     _gameObject.OnDisable(updateInfo);
@@ -45,26 +50,30 @@ namespace Kaamoo {
                 }
             }
 
-            for (auto &pair: _gameObjects) {
-                if (!pair.second.IsActive()) continue;
-                updateInfo.gameObject = &pair.second;
-                pair.second.Update(updateInfo);
-            }
+            //Rigid bodies are where the simulation is now, before anything reads them this frame
+            m_physicsManager.InterpolateTransforms();
 
-            for (auto &pair: _gameObjects) {
-                if (!pair.second.IsActive()) continue;
-                updateInfo.gameObject = &pair.second;
-                pair.second.LateUpdate(updateInfo);
+            m_updateScheduler.Run(_gameObjects, updateInfo);
+
+            //Every Update has finished, LateUpdate stays serial
+            for (auto &_gameObject: _gameObjects) {
+                if (!_gameObject.IsActive()) continue;
+                updateInfo.gameObject = &_gameObject;
+                _gameObject.LateUpdate(updateInfo);
             }
 
             FixedUpdateComponents(frameInfo);
+            //Everything that moves this frame has moved, rebuild the world matrices before rendering reads them
+            TransformComponent::UpdateDirtyTransforms();
         }
 
+        //Rigid bodies step on the physics thread, this runs FixedUpdate of everything else on the main thread. Capped at the
+        //same number of steps per frame as the physics thread, a slow frame drops the rest instead of making the next one slower
         void FixedUpdateComponents(FrameInfo &frameInfo) {
             auto &_renderer = m_resourceManager->GetRenderer();
             auto &_gameObjects = m_resourceManager->GetGameObjects();
             static float reservedFrameTime = 0;
-            float frameTime = frameInfo.frameTime + reservedFrameTime;
+            float frameTime = std::min(frameInfo.frameTime + reservedFrameTime, m_physicsManager.GetMaxSubsteps() * FIXED_UPDATE_INTERVAL);
 
             while (frameTime >= FIXED_UPDATE_INTERVAL) {
                 frameTime -= FIXED_UPDATE_INTERVAL;
@@ -73,15 +82,15 @@ namespace Kaamoo {
                 RendererInfo rendererInfo{_renderer.getAspectRatio()};
                 updateInfo.frameInfo = &frameInfo;
                 updateInfo.rendererInfo = &rendererInfo;
-                for (auto &pair: _gameObjects) {
-                    if (!pair.second.IsActive()) continue;
-                    updateInfo.gameObject = &pair.second;
-                    pair.second.FixedUpdate(updateInfo);
+                for (auto &_gameObject: _gameObjects) {
+                    if (!_gameObject.IsActive()) continue;
+                    updateInfo.gameObject = &_gameObject;
+                    _gameObject.FixedUpdate(updateInfo);
                 }
-                for (auto &pair: _gameObjects) {
-                    if (!pair.second.IsActive()) continue;
-                    updateInfo.gameObject = &pair.second;
-                    pair.second.LateFixedUpdate(updateInfo);
+                for (auto &_gameObject: _gameObjects) {
+                    if (!_gameObject.IsActive()) continue;
+                    updateInfo.gameObject = &_gameObject;
+                    _gameObject.LateFixedUpdate(updateInfo);
                 }
             }
             reservedFrameTime = frameTime;
@@ -95,5 +104,7 @@ namespace Kaamoo {
 
     private:
         std::shared_ptr<ResourceManager> m_resourceManager;
+        UpdateScheduler m_updateScheduler;
+        PhysicsManager m_physicsManager;
     };
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "../Components/RigidBodyComponent.hpp"
+
+namespace Kaamoo {
+    //Steps the rigid bodies every FIXED_UPDATE_INTERVAL on a thread of its own, so a collision heavy step delays the
+    //simulation and not the frame. Every step is published, the main thread shows the bodies between the last two
+    class PhysicsManager {
+    public:
+        //Steps taken at most per wake up. A thread further behind drops the rest, the simulation slows down for a moment
+        //instead of falling further behind with every step it tries to catch up on
+        inline static const uint32_t DefaultMaxSubsteps = 4;
+
+        explicit PhysicsManager(uint32_t maxSubsteps = DefaultMaxSubsteps) {
+            SetMaxSubsteps(maxSubsteps);
+        }
+
+        ~PhysicsManager() {
+            Stop();
+        }
+
+        PhysicsManager(const PhysicsManager &) = delete;
+
+        PhysicsManager &operator=(const PhysicsManager &) = delete;
+
+        //Once every rigid body is loaded
+        void Start() {
+            if (m_thread.joinable()) return;
+            m_running = true;
+            m_thread = std::thread([this]() { Run(); });
+        }
+
+        //Before any game object is destroyed
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> _lock(m_mutex);
+                m_running = false;
+            }
+            m_wakeUp.notify_all();
+            if (m_thread.joinable()) m_thread.join();
+        }
+
+        void SetMaxSubsteps(uint32_t maxSubsteps) {
+            m_maxSubsteps = std::max(maxSubsteps, 1u);
+        }
+
+        uint32_t GetMaxSubsteps() const {
+            return m_maxSubsteps;
+        }
+
+        uint64_t GetDroppedSteps() const {
+            return m_droppedSteps;
+        }
+
+        //Whether a step threw and ended the physics thread. The bodies keep the last state it published
+        bool HasFailed() const {
+            return m_failed;
+        }
+
+        //Main thread, before any Update reads a rigid body's transform. Rethrows, once, the exception that ended the physics
+        //thread. Stop never throws, so the owner's destructor can call it
+        void InterpolateTransforms() {
+            if (m_failed) {
+                std::exception_ptr _exception;
+                {
+                    std::lock_guard<std::mutex> _lock(m_mutex);
+                    std::swap(_exception, m_exception);
+                }
+                if (_exception) std::rethrow_exception(_exception);
+            }
+            RigidBodyComponent::InterpolateTransforms(std::chrono::steady_clock::now());
+        }
+
+    private:
+        void Run() {
+            using Clock = std::chrono::steady_clock;
+            const auto _interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(FIXED_UPDATE_INTERVAL));
+            //Time the simulation has reached, one step behind it is the previous published state
+            auto _stateTime = Clock::now();
+            RigidBodyComponent::PublishStates(_stateTime);
+
+            std::unique_lock<std::mutex> _lock(m_mutex);
+            while (!m_wakeUp.wait_until(_lock, _stateTime + _interval, [this]() { return !m_running; })) {
+                _lock.unlock();
+                auto _now = Clock::now();
+                uint64_t _dueSteps = (_now - _stateTime) / _interval;
+                uint32_t _maxSubsteps = m_maxSubsteps;
+                if (_dueSteps > _maxSubsteps) {
+                    m_droppedSteps += _dueSteps - _maxSubsteps;
+                    _stateTime += (_dueSteps - _maxSubsteps) * _interval;
+                    _dueSteps = _maxSubsteps;
+                }
+                try {
+                    for (uint64_t i = 0; i < _dueSteps && m_running; i++) {
+                        RigidBodyComponent::StepBodies();
+                        _stateTime += _interval;
+                        RigidBodyComponent::PublishStates(_stateTime);
+                    }
+                } catch (...) {
+                    _lock.lock();
+                    m_exception = std::current_exception();
+                    m_failed = true;
+                    return;
+                }
+                _lock.lock();
+            }
+        }
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        //Written under m_mutex so a stop cannot slip in between the check and the wait
+        std::atomic<bool> m_running{false};
+        std::atomic<uint32_t> m_maxSubsteps{DefaultMaxSubsteps};
+        std::atomic<uint64_t> m_droppedSteps{0};
+        //Set by the physics thread as it ends, m_exception is guarded by m_mutex until InterpolateTransforms takes it
+        std::atomic<bool> m_failed{false};
+        std::exception_ptr m_exception;
+    };
+}
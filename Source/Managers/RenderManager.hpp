@@ -1,4 +1,7 @@
-﻿#include <utility>
+﻿#include <chrono>
+#include <functional>
+#include <iostream>
+#include <utility>
 
 #include "../RenderSystems/RenderSystem.h"
 #include "../RenderSystems/ShadowSystem.hpp"
@@ -8,6 +11,9 @@
 #include "../RenderSystems/PostSystem.hpp"
 #include "../RenderSystems/GizmosRenderSystem.hpp"
 #include "../RenderSystems/ComputeSystem.hpp"
+#include "../RenderSystems/MeshletCullSystem.hpp"
+#include "../Utils/JobSystem.h"
+#include "../Utils/Profiler.h"
 
 namespace Kaamoo {
     class RenderManager {
@@ -24,29 +30,36 @@ namespace Kaamoo {
         RenderManager &operator=(const RenderManager &) = delete;
 
         void CreateRenderSystems(Material::Map &materials, Device &device, Renderer &renderer) {
+            PROFILE_SCOPE("RenderManager::CreateRenderSystems");
+            auto startTime = std::chrono::high_resolution_clock::now();
+            //Systems are created here, their pipelines are built together on the worker pool below.
+            //Pipeline creation only shares the device, the memory allocator and the pipeline cache, all of them thread safe
+            std::vector<std::function<void()>> pipelineJobs;
             for (auto &materialPair: materials) {
                 auto _material = materialPair.second;
                 auto pipelineCategory = _material->getPipelineCategory();
 
                 if (pipelineCategory == PipelineCategory.Gizmos) {
-                    m_gizmosRenderSystem = std::make_shared<GizmosRenderSystem>(device, renderer.getSwapChainRenderPass(), _material);
+                    //This render system contains multiple pipelines, so it builds them in the constructor
+                    pipelineJobs.emplace_back([this, &device, &renderer, _material]() {
+                        m_gizmosRenderSystem = std::make_shared<GizmosRenderSystem>(device, renderer.getSwapChainRenderPass(), _material);
+                    });
                     continue;
-//          This render system contains multiple pipelines, so I initialize it in the constructor.
-//          m_gizmosRenderSystem->Init();   
                 }
 
 #ifdef RAY_TRACING
                 if (pipelineCategory == PipelineCategory.RayTracing) {
                     m_rayTracingSystem = std::make_shared<RayTracingSystem>(device, nullptr, materialPair.second);
-                    m_rayTracingSystem->Init();
+                    //Longest job, started first
+                    pipelineJobs.emplace(pipelineJobs.begin(), [system = m_rayTracingSystem]() { system->Init(); });
                 }
                 if (pipelineCategory == PipelineCategory.Post) {
                     m_postSystem = std::make_shared<PostSystem>(device, renderer.getSwapChainRenderPass(), materialPair.second);
-                    m_postSystem->Init();
+                    pipelineJobs.emplace_back([system = m_postSystem]() { system->Init(); });
                 }
                 if (pipelineCategory == PipelineCategory.Compute) {
                     m_computeSystem = std::make_shared<ComputeSystem>(device, nullptr, materialPair.second);
-                    m_computeSystem->Init();
+                    pipelineJobs.emplace_back([system = m_computeSystem]() { system->Init(); });
                 }
 #else
 
@@ -54,7 +67,9 @@ namespace Kaamoo {
 
                 std::shared_ptr<RenderSystem> _renderSystem;
                 if (pipelineCategory == PipelineCategory.Shadow) {
-                    m_shadowSystem = std::make_shared<ShadowSystem>(device, renderer.getShadowRenderPass(), _material);
+                    pipelineJobs.emplace_back([this, &device, &renderer, _material]() {
+                        m_shadowSystem = std::make_shared<ShadowSystem>(device, renderer.getShadowRenderPass(), _material);
+                    });
                     continue;
                 }
 
@@ -68,12 +83,26 @@ namespace Kaamoo {
                 }
 
                 if (_renderSystem != nullptr) {
-                    _renderSystem->Init();
+                    pipelineJobs.emplace_back([_renderSystem]() { _renderSystem->Init(); });
                     m_renderSystemMap[_material->getMaterialId()] = _renderSystem;
                 }
 #endif
 
             }
+#ifndef RAY_TRACING
+            pipelineJobs.emplace_back([this, &device]() { m_meshletCullSystem = std::make_shared<MeshletCullSystem>(device); });
+#endif
+
+            JobSystem::GetInstance().ParallelFor(pipelineJobs.size(), 1, [&pipelineJobs](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    PROFILE_SCOPE("Render system pipelines");
+                    pipelineJobs[i]();
+                }
+            });
+
+            float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+            std::cout << "Created " << pipelineJobs.size() << " render system pipelines on " << JobSystem::GetInstance().GetConcurrency()
+                      << " threads in " << milliseconds << " ms" << std::endl;
         }
 
         void UpdateUbo(FrameInfo &frameInfo) {
@@ -90,6 +119,16 @@ namespace Kaamoo {
 
         }
 
+        //Every pass of the frame draws the same level, so it is picked once before the first pass records
+        void SelectLods(FrameInfo &frameInfo) {
+            for (auto &gameObject: frameInfo.gameObjects) {
+                if (!gameObject.IsActive()) continue;
+                MeshRendererComponent *meshRendererComponent;
+                if (!gameObject.TryGetComponent(meshRendererComponent)) continue;
+                meshRendererComponent->SelectLod(frameInfo, gameObject.transform->mat4());
+            }
+        }
+
         void UpdateRendering(Renderer &renderer, FrameInfo &frameInfo, HierarchyTree &hierarchyTree) {
             UpdateUbo(frameInfo);
             
@@ -114,6 +153,9 @@ namespace Kaamoo {
             m_postSystem->UpdateGlobalUboBuffer(frameInfo.globalUbo, _frameIndex);
             m_postSystem->render(frameInfo);
 #else
+            SelectLods(frameInfo);
+            m_meshletCullSystem->cull(frameInfo);
+
             renderer.beginShadowRenderPass(frameInfo.commandBuffer);
             m_shadowSystem->UpdateGlobalUboBuffer(frameInfo.globalUbo, _frameIndex);
             m_shadowSystem->renderShadow(frameInfo);
@@ -125,8 +167,7 @@ namespace Kaamoo {
 
             //Todo: SceneManager
             std::vector<std::pair<std::shared_ptr<RenderSystem>, GameObject *>> _renderQueue;
-            for (auto &item: frameInfo.gameObjects) {
-                auto &_gameObject = item.second;
+            for (auto &_gameObject: frameInfo.gameObjects) {
                 if (!_gameObject.IsActive()) continue;
                 MeshRendererComponent *_meshRendererComponent;
                 if (_gameObject.TryGetComponent(_meshRendererComponent)) {
@@ -175,6 +216,7 @@ namespace Kaamoo {
         std::shared_ptr<RayTracingSystem> m_rayTracingSystem;
 #else
         std::shared_ptr<ShadowSystem> m_shadowSystem;
+        std::shared_ptr<MeshletCullSystem> m_meshletCullSystem;
 #endif
 
     };
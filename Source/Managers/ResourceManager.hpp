@@ -1,4 +1,8 @@
 ﻿#include <numeric>
+#include "../AssetLoader.h"
+#include "../UploadBatcher.h"
+#include "../Texture/TextureStreamer.h"
+#include "../Utils/Profiler.h"
 
 namespace Kaamoo {
 #ifdef RAY_TRACING
@@ -26,14 +30,30 @@ namespace Kaamoo {
                     addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT * MATERIAL_NUMBER).
                     addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT * MATERIAL_NUMBER).
                     addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT * MATERIAL_NUMBER).build();
+            prefetchAssets();
+            m_textureStreamer = std::make_unique<TextureStreamer>(m_device);
             loadGameObjects();
             loadMaterials();
+            AssetLoader::GetInstance().Clear();
+
+            auto &_uploadBatcher = m_device.uploadBatcher();
+            {
+                PROFILE_SCOPE("UploadBatcher::flush");
+                _uploadBatcher.flush();
+            }
+            std::cout << "Scene upload: " << _uploadBatcher.getUploadCount() << " copies, "
+                      << static_cast<float>(_uploadBatcher.getUploadedBytes()) / (1024.0f * 1024.0f) << " MB in "
+                      << _uploadBatcher.getSubmitCount() << " submissions" << std::endl;
+            m_device.memoryAllocator().printStatistics();
+            PROFILE_SCOPE("GUI::Init");
             GUI::Init(m_renderer, m_window);
         }
 
         ~ResourceManager() {
             m_gameObjects.clear();
             m_materials.clear();
+            m_textureStreamer.reset();
+            m_images.clear();
 
         }
 
@@ -50,19 +70,74 @@ namespace Kaamoo {
 
         Renderer &GetRenderer() { return m_renderer; }
 
+        TextureStreamer &GetTextureStreamer() { return *m_textureStreamer; }
+
+        //Feeds the screen size of every active mesh to the texture streamer, then lets it swap and start loads
+        void UpdateTextureStreaming(const FrameInfo &frameInfo) {
+            for (auto &gameObject: m_gameObjects) {
+                if (!gameObject.IsActive()) continue;
+                MeshRendererComponent *meshRendererComponent;
+                if (gameObject.TryGetComponent(meshRendererComponent)) {
+                    float screenRadius = meshRendererComponent->GetScreenRadius(frameInfo, gameObject.transform->mat4());
+                    m_textureStreamer->requestMaterial(meshRendererComponent->GetMaterialID(), screenRadius * 2.0f);
+                }
+            }
+            m_textureStreamer->update(frameInfo.frameIndex);
+        }
+
 #ifdef RAY_TRACING
         std::shared_ptr<Buffer>& GetGameObjectDescBuffer() { return m_pGameObjectDescBuffer; }
         std::vector<GameObjectDesc>& GetGameObjectDescs() { return m_pGameObjectDescs; }
 #endif
 
-        void loadGameObjects() {
-            std::string gameObjectsJsonString = JsonUtils::ReadJsonFile(BasePath + GameObjectsFileName);
+        //Decodes every model and cube map the configuration names on the worker pool, the load functions below only upload them.
+        //Material textures are left to the TextureStreamer
+        void prefetchAssets() {
+            PROFILE_SCOPE("ResourceManager::prefetchAssets");
+            std::vector<std::string> modelPaths;
             std::string componentsJsonString = JsonUtils::ReadJsonFile(BasePath + ComponentsFileName);
+            rapidjson::Document componentsDocument;
+            componentsDocument.Parse(componentsJsonString.c_str());
+            if (componentsDocument.IsArray()) {
+                for (auto &component: componentsDocument.GetArray()) {
+                    if (component.HasMember("model")) {
+                        modelPaths.push_back(Model::BaseModelsPath + component["model"].GetString());
+                    }
+                }
+            }
 
+            std::vector<AssetLoader::TextureRequest> textureRequests;
+            std::string materialsJsonString = JsonUtils::ReadJsonFile(BasePath + MaterialsFileName);
+            rapidjson::Document materialsDocument;
+            materialsDocument.Parse(materialsJsonString.c_str());
+            if (materialsDocument.IsArray()) {
+                for (auto &material: materialsDocument.GetArray()) {
+                    if (!material.HasMember("texture")) continue;
+                    bool cubeMap = material.HasMember("pipelineCategory") && material["pipelineCategory"].GetString() == PipelineCategory.SkyBox;
+                    if (!cubeMap) continue;
+                    for (auto &textureName: material["texture"].GetArray()) {
+                        textureRequests.push_back({BaseTexturePath + textureName.GetString(), cubeMap});
+                    }
+                }
+            }
+#ifdef RAY_TRACING
+            textureRequests.push_back({BaseTexturePath + SkyboxCubeMapName, true});
+#endif
+
+            AssetLoader::GetInstance().Prefetch(modelPaths, textureRequests);
+        }
+
+        void loadGameObjects() {
+            PROFILE_SCOPE("ResourceManager::loadGameObjects");
             rapidjson::Document gameObjectsDocument;
             rapidjson::Document componentsDocument;
-            gameObjectsDocument.Parse(gameObjectsJsonString.c_str());
-            componentsDocument.Parse(componentsJsonString.c_str());
+            {
+                PROFILE_SCOPE("Parse scene JSON");
+                std::string gameObjectsJsonString = JsonUtils::ReadJsonFile(BasePath + GameObjectsFileName);
+                std::string componentsJsonString = JsonUtils::ReadJsonFile(BasePath + ComponentsFileName);
+                gameObjectsDocument.Parse(gameObjectsJsonString.c_str());
+                componentsDocument.Parse(componentsJsonString.c_str());
+            }
 
             std::unordered_map<int, rapidjson::Value> componentsMap;
             if (componentsDocument.IsArray()) {
@@ -72,12 +147,14 @@ namespace Kaamoo {
                 }
             }
 
-            std::unordered_map<int, GameObject *> transformIdToParentGameObjMap;
+            std::unordered_map<int, GameObject::Handle> transformIdToParentGameObjMap;
             auto *componentFactory = new ComponentFactory();
             if (gameObjectsDocument.IsArray()) {
+                m_gameObjects.reserve(gameObjectsDocument.Size());
                 for (rapidjson::SizeType i = 0; i < gameObjectsDocument.Size(); i++) {
-                    auto &gameObject = GameObject::createGameObject();
+                    auto gameObject = GameObject::createGameObject();
                     const rapidjson::Value &object = gameObjectsDocument[i];
+                    std::vector<int> childrenIds;
 
                     if (object.HasMember("transform")) {
                         const rapidjson::Value &transformJsonObj = object["transform"];
@@ -94,7 +171,7 @@ namespace Kaamoo {
                                 const rapidjson::Value &arrayId = childrenIdsArray[j];
                                 const int childrenId = arrayId.GetInt();
                                 if (transformId != -1) {
-                                    transformIdToParentGameObjMap[childrenId] = &gameObject;
+                                    childrenIds.push_back(childrenId);
                                 }
                             }
                         }
@@ -135,25 +212,27 @@ namespace Kaamoo {
                         gameObject.SetActive(object["IsActive"].GetBool());
                     }
 
-                    m_gameObjects.emplace(gameObject.GetId(), std::move(gameObject));
+                    auto handle = GameObject::insertInto(m_gameObjects, std::move(gameObject));
+                    for (int childrenId: childrenIds) {
+                        transformIdToParentGameObjMap[childrenId] = handle;
+                    }
                 }
             }
 
-            for (auto &pair: m_gameObjects) {
-                auto &gameObject = pair.second;
-                if (transformIdToParentGameObjMap.find(gameObject.transform->GetTransformId()) != transformIdToParentGameObjMap.end()) {
-                    auto parent = transformIdToParentGameObjMap[gameObject.transform->GetTransformId()];
+            for (auto &gameObject: m_gameObjects) {
+                auto parentIterator = transformIdToParentGameObjMap.find(gameObject.transform->GetTransformId());
+                auto *parent = parentIterator != transformIdToParentGameObjMap.end() ? m_gameObjects.get(parentIterator->second) : nullptr;
+                if (parent != nullptr) {
                     parent->transform->AddChild(gameObject.transform);
                     //Make sure parent node exists in the hierarchy tree before inserting child node.
-                    m_hierarchyTree.AddNode(parent->GetId(), gameObject.GetId(), &gameObject);
+                    m_hierarchyTree.AddNode(parent->GetId(), gameObject.GetId(), gameObject);
                 } else {
-                    m_hierarchyTree.AddNode(HierarchyTree::ROOT_ID, gameObject.GetId(), &gameObject);
+                    m_hierarchyTree.AddNode(HierarchyTree::ROOT_ID, gameObject.GetId(), gameObject);
                 }
                 gameObject.OnLoad();
             }
 
-            for (auto &pair: m_gameObjects) {
-                auto &gameObject = pair.second;
+            for (auto &gameObject: m_gameObjects) {
                 gameObject.Loaded();
             }
 
@@ -163,10 +242,12 @@ namespace Kaamoo {
         }
 
         void loadMaterials() {
+            PROFILE_SCOPE("ResourceManager::loadMaterials");
 
             uint32_t minUniformOffsetAlignment = std::lcm(m_device.properties.limits.minUniformBufferOffsetAlignment,
                                                           m_device.properties.limits.nonCoherentAtomSize);
             std::string materialsString = JsonUtils::ReadJsonFile(BasePath + "Materials.json");
+            size_t textureReferenceCount = 0;
             rapidjson::Document materialsDocument;
             materialsDocument.Parse(materialsString.c_str());
 
@@ -202,6 +283,9 @@ namespace Kaamoo {
             std::unordered_map<int, glm::vec2> textureEntries{};
             std::unordered_map<int, PBR> pbrMaterials{};
             std::unordered_map<int, int> idShaderOffsetMap{};
+            std::vector<std::pair<TextureStreamer::Handle, uint32_t>> streamedTextures{};
+            std::unordered_map<TextureStreamer::Handle, int32_t> arrayElements{};
+            std::vector<int32_t> textureIndices{};
             int shaderGroupOffset = 0;
             if (materialsDocument.IsArray()) {
                 for (rapidjson::SizeType i = 0; i < materialsDocument.Size(); i++) {
@@ -219,20 +303,22 @@ namespace Kaamoo {
 
                     auto textureNames = object["texture"].GetArray();
                     glm::i32vec2 textureEntry{};
-                    textureEntry.x = imageInfos.size();
+                    textureEntry.x = textureIndices.size();
                     for (auto &textureNameGenericValue: textureNames) {
                         std::string textureName = textureNameGenericValue.GetString();
-                        auto image = std::make_shared<Image>(m_device, ImageType.Default);
-                        image->createTextureImage(BaseTexturePath + textureName);
-                        image->createImageView();
-                        auto sampler = std::make_shared<Sampler>(m_device);
-                        sampler->createTextureSampler();
-                        auto imageInfo = image->descriptorInfo(*sampler);
-                        imagePointers.emplace_back(image);
-                        samplerPointers.emplace_back(sampler);
-                        imageInfos.emplace_back(*imageInfo);
+                        //Starts as a placeholder, the streamer rewrites the array element as mips arrive
+                        auto handle = m_textureStreamer->registerTexture(BaseTexturePath + textureName, id);
+                        //One array element per distinct texture, materials reach it through textureIndices
+                        auto arrayElement = arrayElements.find(handle);
+                        if (arrayElement == arrayElements.end()) {
+                            arrayElement = arrayElements.emplace(handle, static_cast<int32_t>(imageInfos.size())).first;
+                            streamedTextures.emplace_back(handle, static_cast<uint32_t>(imageInfos.size()));
+                            imageInfos.emplace_back(m_textureStreamer->descriptorInfo(handle));
+                        }
+                        textureIndices.push_back(arrayElement->second);
+                        textureReferenceCount++;
                     }
-                    textureEntry.y = imageInfos.size() - textureEntry.x;
+                    textureEntry.y = textureIndices.size() - textureEntry.x;
                     if (object.HasMember("PBR")) {
                         auto pbr = PBRLoader::loadPBR(object["PBR"]);
                         if (PBRParametersCount - PBRLoader::getValidPropertyCount(pbr) != textureEntry.y) {
@@ -243,8 +329,7 @@ namespace Kaamoo {
                     textureEntries.emplace(id, textureEntry);
                 }
             }
-            for (auto &gameObjectPair: m_gameObjects) {
-                auto &gameObject = gameObjectPair.second;
+            for (auto &gameObject: m_gameObjects) {
                 MeshRendererComponent *meshRendererComponent;
                 if (gameObject.TryGetComponent(meshRendererComponent)) {
                     auto model = meshRendererComponent->GetModelPtr();
@@ -292,17 +377,15 @@ namespace Kaamoo {
 
             //ObjectDesc
             int meshRendererCount = 0;
-            for (auto &modelPair: m_gameObjects) {
-                auto &gameObject = modelPair.second;
+            for (auto &gameObject: m_gameObjects) {
                 MeshRendererComponent *meshRendererComponent;
                 if (gameObject.TryGetComponent(meshRendererComponent)) {
                     meshRendererCount++;
                 }
             }
             m_pGameObjectDescs.resize(meshRendererCount);
-            for (auto &modelPair: m_gameObjects) {
+            for (auto &gameObject: m_gameObjects) {
                 GameObjectDesc modelDesc{};
-                auto &gameObject = modelPair.second;
                 MeshRendererComponent *meshRendererComponent;
                 if (gameObject.TryGetComponent(meshRendererComponent)) {
                     modelDesc.vertexBufferAddress = meshRendererComponent->GetModelPtr()->getVertexBuffer()->getDeviceAddress();
@@ -326,12 +409,17 @@ namespace Kaamoo {
             m_pGameObjectDescBuffer->writeToBuffer(m_pGameObjectDescs.data(), m_pGameObjectDescs.size() * sizeof(GameObjectDesc));
             bufferPointers.push_back(m_pGameObjectDescBuffer);
 
+            //Texture slots of every material as elements of the sampler array, textureEntry indexes into these
+            if (textureIndices.empty()) textureIndices.push_back(0);
+            auto textureIndexBuffer = std::make_shared<Buffer>(m_device, sizeof(int32_t), textureIndices.size(),
+                                                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            m_device.uploadBatcher().uploadBuffer(textureIndexBuffer->getBuffer(), textureIndices.data(), sizeof(int32_t) * textureIndices.size());
+            bufferPointers.push_back(textureIndexBuffer);
+
             //Skybox cube map
-            auto skyBoxImage = std::make_shared<Image>(m_device, ImageType.CubeMap);
-            skyBoxImage->createTextureImage(BaseTexturePath + SkyboxCubeMapName, true);
-            skyBoxImage->createImageView();
-            auto skyBoxSampler = std::make_shared<Sampler>(m_device);
-            skyBoxSampler->createTextureSampler();
+            auto skyBoxImage = getOrCreateTexture(BaseTexturePath + SkyboxCubeMapName, ImageType.CubeMap, true);
+            auto skyBoxSampler = m_device.samplerCache().getDefaultSampler();
             imagePointers.emplace_back(skyBoxImage);
             samplerPointers.emplace_back(skyBoxSampler);
 
@@ -341,6 +429,7 @@ namespace Kaamoo {
                     addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR).
                     addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, imageInfos.size()).
                     addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_MISS_BIT_KHR).
+                    addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR).
                     build();
             descriptorSetLayoutPointers.push_back(sceneDescriptorSetLayoutPtr);
 
@@ -350,7 +439,11 @@ namespace Kaamoo {
                     writeBuffer(1, m_pGameObjectDescBuffer->descriptorInfo(m_pGameObjectDescBuffer->getBufferSize())).
                     writeImages(2, imageInfos).
                     writeImage(3, skyBoxImage->descriptorInfo(*skyBoxSampler)).
+                    writeBuffer(4, textureIndexBuffer->descriptorInfo(textureIndexBuffer->getBufferSize())).
                     build(sceneDescriptorSet);
+            for (auto &[handle, arrayElement]: streamedTextures) {
+                m_textureStreamer->bindDescriptor(handle, sceneDescriptorSet, sceneDescriptorSetLayoutPtr, 2, arrayElement);
+            }
             descriptorSetPointers.push_back(sceneDescriptorSet);
             auto material = std::make_shared<Material>(Material::MaterialId::rayTracing, shaderModulePointers, descriptorSetLayoutPointers, descriptorSetPointers,
                                                        imagePointers, samplerPointers, bufferPointers, "RayTracing");
@@ -550,23 +643,26 @@ namespace Kaamoo {
                     int writerBindingPoint = 0;
                     std::shared_ptr<Image> image;
                     std::vector<std::shared_ptr<VkDescriptorImageInfo>> imageInfos;
+                    std::vector<std::pair<TextureStreamer::Handle, uint32_t>> streamedTextures;
                     for (auto &textureNameGenericValue: textureNames) {
                         std::string textureName = textureNameGenericValue.GetString();
 
-                        if (pipelineCategoryString == PipelineCategory.SkyBox)
-                            image = std::make_shared<Image>(m_device, ImageType.CubeMap);
-                        else
-                            image = std::make_shared<Image>(m_device, ImageType.Default);
-
-                        image->createTextureImage(BaseTexturePath + textureName);
-                        image->createImageView();
-                        auto sampler = std::make_shared<Sampler>(m_device);
-                        sampler->createTextureSampler();
-                        auto imageInfo = image->descriptorInfo(*sampler);
+                        std::shared_ptr<VkDescriptorImageInfo> imageInfo;
+                        textureReferenceCount++;
+                        if (pipelineCategoryString == PipelineCategory.SkyBox) {
+                            image = getOrCreateTexture(BaseTexturePath + textureName, ImageType.CubeMap, false);
+                            auto sampler = m_device.samplerCache().getDefaultSampler();
+                            imageInfo = image->descriptorInfo(*sampler);
+                            imagePointers.emplace_back(image);
+                            samplerPointers.emplace_back(sampler);
+                        } else {
+                            //Starts as a placeholder, the streamer rewrites the binding as mips arrive
+                            auto handle = m_textureStreamer->registerTexture(BaseTexturePath + textureName, id);
+                            streamedTextures.emplace_back(handle, writerBindingPoint);
+                            imageInfo = std::make_shared<VkDescriptorImageInfo>(m_textureStreamer->descriptorInfo(handle));
+                        }
                         imageInfos.emplace_back(imageInfo);
                         descriptorWriter.writeImage(writerBindingPoint++, imageInfo);
-                        imagePointers.emplace_back(image);
-                        samplerPointers.emplace_back(sampler);
                     }
 
                     std::vector<std::shared_ptr<Buffer>> bufferPointers{globalUboBufferPtr};
@@ -592,6 +688,9 @@ namespace Kaamoo {
 
                     std::shared_ptr<VkDescriptorSet> materialDescriptorSetPointer = std::make_shared<VkDescriptorSet>();
                     descriptorWriter.build(materialDescriptorSetPointer);
+                    for (auto &[handle, binding]: streamedTextures) {
+                        m_textureStreamer->bindDescriptor(handle, materialDescriptorSetPointer, materialDescriptorSetLayoutPointer, binding);
+                    }
 
                     descriptorSetLayoutPointers.push_back(materialDescriptorSetLayoutPointer);
                     descriptorSetPointers.push_back(materialDescriptorSetPointer);
@@ -627,6 +726,22 @@ namespace Kaamoo {
                                                              PipelineCategory.Gizmos);
                 m_materials.emplace(Material::MaterialId::gizmos, std::move(uiMaterial));
             }
+
+            std::cout << "Material textures: " << textureReferenceCount << " references, "
+                      << m_textureStreamer->getStatistics().textureCount + m_images.size() << " unique images, "
+                      << m_device.samplerCache().size() << " samplers" << std::endl;
+        }
+
+        //Images that are not streamed, shared by every material naming the same file with the same format
+        std::shared_ptr<Image> getOrCreateTexture(const std::string &path, const std::string &imageCategory, bool SRGB) {
+            std::string key = path + "|" + imageCategory + (SRGB ? "|SRGB" : "");
+            auto iterator = m_images.find(key);
+            if (iterator != m_images.end()) return iterator->second;
+            auto image = std::make_shared<Image>(m_device, imageCategory);
+            image->createTextureImage(path, SRGB);
+            image->createImageView();
+            m_images.emplace(key, image);
+            return image;
         }
 
     private:
@@ -639,6 +754,8 @@ namespace Kaamoo {
         GameObject::Map m_gameObjects;
         HierarchyTree m_hierarchyTree;
         Material::Map m_materials;
+        std::unique_ptr<TextureStreamer> m_textureStreamer;
+        std::unordered_map<std::string, std::shared_ptr<Image>> m_images;
 
 #ifdef RAY_TRACING
         std::shared_ptr<Buffer> m_pGameObjectDescBuffer;
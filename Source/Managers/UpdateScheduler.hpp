@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "../Utils/JobSystem.h"
+
+namespace Kaamoo {
+    //Runs the Update of every active component, spreading component types over the worker pool by what they declare in
+    //GetUpdateAccess. Types go into waves in the order they first appear in the scene, a type waits for every earlier type it
+    //conflicts with, so conflicting Updates keep their serial order. Within a wave, main thread types run on the calling
+    //thread while the others run on the pool
+    class UpdateScheduler {
+    public:
+        //Instances of a parallel type are split into chunks of this many
+        inline static const size_t InstanceGrain = 64;
+
+        void Run(GameObject::Map &gameObjects, const ComponentUpdateInfo &updateInfo) {
+            CollectInstances(gameObjects);
+            BuildWaves();
+
+            for (auto &wave: m_waves) {
+                //Updates on the pool read world transforms through the cache, which has to be clean before they start
+                TransformComponent::UpdateDirtyTransforms();
+
+                m_poolJobs.clear();
+                bool hasMainThreadWork = false;
+                for (auto type: wave) {
+                    auto &bucket = m_buckets[static_cast<size_t>(type)];
+                    if (bucket.access.mainThread) {
+                        hasMainThreadWork = true;
+                        continue;
+                    }
+                    size_t grain = bucket.access.parallelInstances ? InstanceGrain : bucket.instances.size();
+                    for (size_t begin = 0; begin < bucket.instances.size(); begin += grain) {
+                        m_poolJobs.push_back({&bucket, begin, std::min(bucket.instances.size(), begin + grain)});
+                    }
+                }
+
+                auto runPoolJobs = [this, &updateInfo]() {
+                    JobSystem::GetInstance().ParallelFor(m_poolJobs.size(), 1, [this, &updateInfo](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; i++) {
+                            RunInstances(*m_poolJobs[i].bucket, m_poolJobs[i].begin, m_poolJobs[i].end, updateInfo);
+                        }
+                    });
+                };
+                if (!hasMainThreadWork) {
+                    runPoolJobs();
+                    continue;
+                }
+
+                JobSystem::Counter poolWork;
+                if (!m_poolJobs.empty()) JobSystem::GetInstance().Run(runPoolJobs, &poolWork);
+                for (auto type: wave) {
+                    auto &bucket = m_buckets[static_cast<size_t>(type)];
+                    if (bucket.access.mainThread) RunInstances(bucket, 0, bucket.instances.size(), updateInfo);
+                }
+                JobSystem::GetInstance().Wait(poolWork);
+            }
+        }
+
+    private:
+        struct Bucket {
+            ComponentAccess access;
+            std::vector<std::pair<Component *, GameObject *>> instances;
+        };
+
+        struct PoolJob {
+            Bucket *bucket;
+            size_t begin;
+            size_t end;
+        };
+
+        void CollectInstances(GameObject::Map &gameObjects) {
+            for (auto &bucket: m_buckets) bucket.instances.clear();
+            m_typeOrder.clear();
+            for (auto &gameObject: gameObjects) {
+                if (!gameObject.IsActive()) continue;
+                for (auto *component: gameObject.getComponents()) {
+                    auto &bucket = m_buckets[static_cast<size_t>(component->GetType())];
+                    if (bucket.instances.empty()) {
+                        bucket.access = component->GetUpdateAccess();
+                        //Touching nothing means there is nothing to update
+                        if (bucket.access.reads == 0 && bucket.access.writes == 0) continue;
+                        m_typeOrder.push_back(component->GetType());
+                    } else if (bucket.access.reads == 0 && bucket.access.writes == 0) {
+                        continue;
+                    }
+                    bucket.instances.emplace_back(component, &gameObject);
+                }
+            }
+        }
+
+        void BuildWaves() {
+            m_waves.clear();
+            std::array<size_t, static_cast<size_t>(ComponentType::Count)> waveOf{};
+            for (size_t i = 0; i < m_typeOrder.size(); i++) {
+                auto &access = m_buckets[static_cast<size_t>(m_typeOrder[i])].access;
+                size_t wave = 0;
+                for (size_t j = 0; j < i; j++) {
+                    auto earlierType = static_cast<size_t>(m_typeOrder[j]);
+                    if (access.ConflictsWith(m_buckets[earlierType].access)) wave = std::max(wave, waveOf[earlierType] + 1);
+                }
+                waveOf[static_cast<size_t>(m_typeOrder[i])] = wave;
+                if (wave >= m_waves.size()) m_waves.resize(wave + 1);
+                m_waves[wave].push_back(m_typeOrder[i]);
+            }
+        }
+
+        static void RunInstances(Bucket &bucket, size_t begin, size_t end, const ComponentUpdateInfo &updateInfo) {
+            ComponentUpdateInfo instanceInfo = updateInfo;
+            for (size_t i = begin; i < end; i++) {
+                instanceInfo.gameObject = bucket.instances[i].second;
+                bucket.instances[i].first->Update(instanceInfo);
+            }
+        }
+
+        std::array<Bucket, static_cast<size_t>(ComponentType::Count)> m_buckets{};
+        std::vector<ComponentType> m_typeOrder;
+        std::vector<std::vector<ComponentType>> m_waves;
+        std::vector<PoolJob> m_poolJobs;
+    };
+}
@@ -0,0 +1,290 @@
+﻿#include "MemoryAllocator.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace Kaamoo {
+    MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool bufferDeviceAddress)
+            : device{device}, m_bufferDeviceAddress{bufferDeviceAddress} {
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+        m_pools.resize(m_memoryProperties.memoryTypeCount * 4);
+        for (uint32_t i = 0; i < m_pools.size(); i++) {
+            auto &pool = m_pools[i];
+            pool.memoryTypeIndex = i / 4;
+            pool.optimalImages = (i / 2) % 2 == 1;
+            pool.strategy = i % 2 == 1 ? Strategy::Linear : Strategy::Buddy;
+
+            //Small heaps such as the host visible window of device local memory get smaller blocks
+            VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].size;
+            pool.blockSize = PreferredBlockSize;
+            while (pool.blockSize > MinNodeSize && pool.blockSize > heapSize / 8) {
+                pool.blockSize >>= 1;
+            }
+        }
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+        if (m_statistics.allocationCount > 0) {
+            std::cout << "MemoryAllocator: " << m_statistics.allocationCount << " allocations still alive at shutdown" << std::endl;
+        }
+        for (auto &pool: m_pools) {
+            for (auto &block: pool.blocks) {
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+        }
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags propertyFlags, Strategy strategy) {
+        VkBufferMemoryRequirementsInfo2 requirementsInfo{VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2};
+        requirementsInfo.buffer = buffer;
+        VkMemoryDedicatedRequirements dedicatedRequirements{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+        VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+        requirements.pNext = &dedicatedRequirements;
+        vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+        bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+        auto allocation = allocate(requirements.memoryRequirements, propertyFlags, strategy, false, dedicated, buffer, VK_NULL_HANDLE);
+        if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind buffer memory!");
+        }
+        return allocation;
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocateImageMemory(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags propertyFlags) {
+        VkImageMemoryRequirementsInfo2 requirementsInfo{VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2};
+        requirementsInfo.image = image;
+        VkMemoryDedicatedRequirements dedicatedRequirements{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+        VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+        requirements.pNext = &dedicatedRequirements;
+        vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+        bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+        //Linear images are laid out like buffers and may share their blocks
+        auto allocation = allocate(requirements.memoryRequirements, propertyFlags, Strategy::Buddy, tiling != VK_IMAGE_TILING_LINEAR,
+                                   dedicated, VK_NULL_HANDLE, image);
+        if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind image memory!");
+        }
+        return allocation;
+    }
+
+    void MemoryAllocator::free(Allocation &allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.allocationCount--;
+        m_statistics.usedBytes -= allocation.size;
+        if (allocation.block != nullptr) {
+            freeFromBlock(m_pools[allocation.poolIndex], allocation);
+        } else {
+            freeDeviceMemory(allocation.memory, allocation.size);
+            m_statistics.dedicatedCount--;
+        }
+        allocation = {};
+    }
+
+    VkResult MemoryAllocator::flush(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        auto range = mappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    VkResult MemoryAllocator::invalidate(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        auto range = mappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    MemoryAllocator::Statistics MemoryAllocator::getStatistics() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    void MemoryAllocator::printStatistics() {
+        auto statistics = getStatistics();
+        std::cout << "GPU memory: " << statistics.allocationCount << " allocations in " << statistics.deviceMemoryCount
+                  << " device memory objects (" << statistics.blockCount << " blocks, " << statistics.dedicatedCount << " dedicated, peak "
+                  << statistics.peakDeviceMemoryCount << "), " << static_cast<float>(statistics.usedBytes) / (1024.0f * 1024.0f) << " MB used of "
+                  << static_cast<float>(statistics.reservedBytes) / (1024.0f * 1024.0f) << " MB reserved" << std::endl;
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags propertyFlags,
+                                                          Strategy strategy, bool optimalImage, bool dedicated, VkBuffer dedicatedBuffer,
+                                                          VkImage dedicatedImage) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, propertyFlags);
+        uint32_t poolIndex = memoryTypeIndex * 4 + (optimalImage ? 2 : 0) + (strategy == Strategy::Linear ? 1 : 0);
+        auto &pool = m_pools[poolIndex];
+
+        //Whole atoms keep flushes of one allocation from touching its neighbours
+        VkDeviceSize size = requirements.size;
+        //Buddy nodes are at least this aligned anyway, linear blocks match them so scratch addresses meet the acceleration structure limit
+        VkDeviceSize alignment = std::max(requirements.alignment, MinNodeSize);
+        if (isHostVisible(memoryTypeIndex)) {
+            size = (size + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+            alignment = std::max(alignment, m_nonCoherentAtomSize);
+        }
+
+        Allocation allocation{};
+        allocation.size = size;
+        allocation.poolIndex = poolIndex;
+        if (dedicated || size > pool.blockSize / 2 || alignment > pool.blockSize / 2) {
+            VkMemoryDedicatedAllocateInfo dedicatedInfo{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+            dedicatedInfo.buffer = dedicatedBuffer;
+            dedicatedInfo.image = dedicatedImage;
+            allocation.memory = allocateDeviceMemory(size, memoryTypeIndex, dedicatedBuffer != VK_NULL_HANDLE, &dedicatedInfo, allocation.mapped);
+            m_statistics.dedicatedCount++;
+        } else {
+            bool allocated = false;
+            for (auto &block: pool.blocks) {
+                if (tryAllocateFromBlock(pool, *block, size, alignment, allocation)) {
+                    allocated = true;
+                    break;
+                }
+            }
+            if (!allocated) {
+                auto block = std::make_unique<Block>();
+                block->memory = allocateDeviceMemory(pool.blockSize, memoryTypeIndex, !optimalImage, nullptr, block->mapped);
+                if (pool.strategy == Strategy::Buddy) {
+                    uint32_t maxOrder = 0;
+                    while ((MinNodeSize << maxOrder) < pool.blockSize) maxOrder++;
+                    block->freeNodes.resize(maxOrder + 1);
+                    block->freeNodes[maxOrder].insert(0);
+                }
+                m_statistics.blockCount++;
+                pool.blocks.push_back(std::move(block));
+                if (!tryAllocateFromBlock(pool, *pool.blocks.back(), size, alignment, allocation)) {
+                    throw std::runtime_error("failed to sub-allocate from a new memory block!");
+                }
+            }
+        }
+
+        m_statistics.allocationCount++;
+        m_statistics.totalAllocationCount++;
+        m_statistics.usedBytes += size;
+        return allocation;
+    }
+
+    bool MemoryAllocator::tryAllocateFromBlock(Pool &pool, Block &block, VkDeviceSize size, VkDeviceSize alignment, Allocation &allocation) {
+        if (pool.strategy == Strategy::Linear) {
+            VkDeviceSize offset = (block.head + alignment - 1) / alignment * alignment;
+            if (offset + size > pool.blockSize) return false;
+            block.head = offset + size;
+            allocation.offset = offset;
+        } else {
+            //Nodes are aligned to their own size, so a node covering the alignment satisfies it
+            uint32_t order = 0;
+            while ((MinNodeSize << order) < size || (MinNodeSize << order) < alignment) order++;
+            uint32_t freeOrder = order;
+            while (freeOrder < block.freeNodes.size() && block.freeNodes[freeOrder].empty()) freeOrder++;
+            if (freeOrder >= block.freeNodes.size()) return false;
+
+            //Lowest offset first keeps the top of the block free for large requests
+            auto iterator = block.freeNodes[freeOrder].begin();
+            VkDeviceSize offset = *iterator;
+            block.freeNodes[freeOrder].erase(iterator);
+            while (freeOrder > order) {
+                freeOrder--;
+                block.freeNodes[freeOrder].insert(offset + (MinNodeSize << freeOrder));
+            }
+            allocation.offset = offset;
+            allocation.order = order;
+        }
+
+        block.allocationCount++;
+        allocation.memory = block.memory;
+        allocation.block = &block;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char *>(block.mapped) + allocation.offset : nullptr;
+        return true;
+    }
+
+    void MemoryAllocator::freeFromBlock(Pool &pool, Allocation &allocation) {
+        auto &block = *allocation.block;
+        block.allocationCount--;
+        if (pool.strategy == Strategy::Linear) {
+            if (block.allocationCount == 0) block.head = 0;
+        } else {
+            VkDeviceSize offset = allocation.offset;
+            uint32_t order = allocation.order;
+            while (order + 1 < block.freeNodes.size()) {
+                VkDeviceSize buddy = offset ^ (MinNodeSize << order);
+                if (block.freeNodes[order].erase(buddy) == 0) break;
+                offset = std::min(offset, buddy);
+                order++;
+            }
+            block.freeNodes[order].insert(offset);
+        }
+
+        //One empty block per pool is kept so a pool that drains and refills does not reallocate every time
+        if (block.allocationCount > 0) return;
+        auto emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block> &poolBlock) {
+            return poolBlock->allocationCount == 0;
+        });
+        if (emptyBlocks < 2) return;
+        freeDeviceMemory(block.memory, pool.blockSize);
+        m_statistics.blockCount--;
+        pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(), [&block](const std::unique_ptr<Block> &poolBlock) {
+            return poolBlock.get() == &block;
+        }));
+    }
+
+    VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, bool deviceAddress, const void *pNext,
+                                                         void *&mapped) {
+        VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+        memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        memoryAllocateFlagsInfo.pNext = pNext;
+
+        VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+        allocInfo.pNext = deviceAddress && m_bufferDeviceAddress ? &memoryAllocateFlagsInfo : pNext;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory!");
+        }
+
+        mapped = nullptr;
+        if (isHostVisible(memoryTypeIndex) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map memory!");
+        }
+
+        m_statistics.deviceMemoryCount++;
+        m_statistics.peakDeviceMemoryCount = std::max(m_statistics.peakDeviceMemoryCount, m_statistics.deviceMemoryCount);
+        m_statistics.reservedBytes += size;
+        return memory;
+    }
+
+    void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size) {
+        vkFreeMemory(device, memory, nullptr);
+        m_statistics.deviceMemoryCount--;
+        m_statistics.reservedBytes -= size;
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) const {
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+        return (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    VkMappedMemoryRange MemoryAllocator::mappedRange(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const {
+        if (size == VK_WHOLE_SIZE) size = allocation.size - offset;
+        VkDeviceSize begin = (allocation.offset + offset) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+        VkDeviceSize end = (allocation.offset + offset + size + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+
+        VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+        range.memory = allocation.memory;
+        range.offset = begin;
+        range.size = end - begin;
+        return range;
+    }
+}
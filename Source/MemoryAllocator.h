@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace Kaamoo {
+    //Places buffers and images in a few large VkDeviceMemory blocks instead of one vkAllocateMemory per resource.
+    //Every memory type has buddy blocks for resources with their own lifetime and linear blocks for scratch memory.
+    //Buffers and optimal images never share a block, so bufferImageGranularity never applies. Host visible blocks stay mapped
+    class MemoryAllocator {
+        struct Block;
+
+    public:
+        enum class Strategy {
+            //Power of two nodes, split on allocation and merged with their buddy on free
+            Buddy,
+            //Bump allocation, a block is rewound once everything in it is freed. For memory released together
+            Linear
+        };
+
+        struct Allocation {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = 0;
+            //Host address of offset, null when the memory is not host visible
+            void *mapped = nullptr;
+
+            //Bookkeeping for free, block is null for dedicated allocations
+            Block *block = nullptr;
+            uint32_t poolIndex = 0;
+            uint32_t order = 0;
+        };
+
+        struct Statistics {
+            //Live VkDeviceMemory objects, blocks plus dedicated allocations
+            uint32_t deviceMemoryCount = 0;
+            uint32_t peakDeviceMemoryCount = 0;
+            uint32_t blockCount = 0;
+            uint32_t dedicatedCount = 0;
+            //Live buffers and images
+            uint32_t allocationCount = 0;
+            uint64_t totalAllocationCount = 0;
+            VkDeviceSize reservedBytes = 0;
+            VkDeviceSize usedBytes = 0;
+        };
+
+        inline static const VkDeviceSize PreferredBlockSize = 64 * 1024 * 1024;
+        inline static const VkDeviceSize MinNodeSize = 256;
+
+        MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool bufferDeviceAddress);
+
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator &) = delete;
+
+        MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+        //Allocates and binds memory for buffer
+        Allocation allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags propertyFlags, Strategy strategy = Strategy::Buddy);
+
+        //Allocates and binds memory for image, large images get a dedicated allocation
+        Allocation allocateImageMemory(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags propertyFlags);
+
+        //Does nothing for an empty allocation
+        void free(Allocation &allocation);
+
+        //Ranges are relative to the allocation and widened to nonCoherentAtomSize
+        VkResult flush(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        VkResult invalidate(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        Statistics getStatistics();
+
+        void printStatistics();
+
+    private:
+        struct Block {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            uint32_t allocationCount = 0;
+            //Buddy: offsets of free nodes per order, a node of order n is MinNodeSize << n bytes
+            std::vector<std::set<VkDeviceSize>> freeNodes;
+            //Linear: end of the last allocation
+            VkDeviceSize head = 0;
+        };
+
+        struct Pool {
+            uint32_t memoryTypeIndex = 0;
+            Strategy strategy = Strategy::Buddy;
+            bool optimalImages = false;
+            VkDeviceSize blockSize = 0;
+            std::vector<std::unique_ptr<Block>> blocks;
+        };
+
+        Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags propertyFlags, Strategy strategy,
+                            bool optimalImage, bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+
+        bool tryAllocateFromBlock(Pool &pool, Block &block, VkDeviceSize size, VkDeviceSize alignment, Allocation &allocation);
+
+        void freeFromBlock(Pool &pool, Allocation &allocation);
+
+        VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, bool deviceAddress, const void *pNext, void *&mapped);
+
+        void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size);
+
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) const;
+
+        bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+        VkMappedMemoryRange mappedRange(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+        VkDevice device;
+        bool m_bufferDeviceAddress = false;
+        VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+        VkDeviceSize m_nonCoherentAtomSize = 1;
+        std::mutex m_mutex;
+        //Indexed by memory type, resource kind and strategy, see poolIndex
+        std::vector<Pool> m_pools;
+        Statistics m_statistics{};
+    };
+}
@@ -0,0 +1,169 @@
+﻿#include "MeshCache.h"
+#include "../Utils/MappedFile.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+namespace Kaamoo {
+    bool MeshCache::TryLoad(const std::string &cookedPath, uint64_t sourceHash, Model::Builder &builder, float &cookMilliseconds) {
+        auto cooked = std::make_shared<MappedFile>(cookedPath);
+        if (cooked->data() == nullptr || cooked->size() < sizeof(Header)) return false;
+
+        Header header{};
+        std::memcpy(&header, cooked->data(), sizeof(Header));
+        if (header.magic != Magic || header.version != Version || header.sourceHash != sourceHash ||
+            header.vertexSize != sizeof(Model::Vertex) || header.optimized != static_cast<uint32_t>(builder.optimize) ||
+            header.lodsGenerated != static_cast<uint32_t>(builder.generateLods) ||
+            header.meshletsBuilt != static_cast<uint32_t>(builder.buildMeshlets) ||
+            header.rasterIndexSize != (Model::UsesShortIndices(header.vertexCount) ? sizeof(uint16_t) : sizeof(uint32_t))) {
+            return false;
+        }
+
+        size_t vertexBytes = static_cast<size_t>(header.vertexCount) * sizeof(Model::Vertex);
+        size_t indexBytes = static_cast<size_t>(header.indexCount) * sizeof(uint32_t);
+        size_t lodBytes = static_cast<size_t>(header.lodCount) * sizeof(Model::LodLevel);
+        size_t lodIndexBytes = static_cast<size_t>(header.lodIndexCount) * sizeof(uint32_t);
+        size_t meshletBytes = static_cast<size_t>(header.meshletCount) * sizeof(Model::Meshlet);
+        size_t positionBytes = static_cast<size_t>(header.vertexCount) * sizeof(Model::PackedPosition);
+        size_t attributeBytes = static_cast<size_t>(header.vertexCount) * sizeof(Model::PackedAttributes);
+        uint32_t rasterIndexCount = header.indexCount + header.lodIndexCount;
+        size_t rasterIndexBytes = static_cast<size_t>(rasterIndexCount) * header.rasterIndexSize;
+        if (cooked->size() < sizeof(Header) + vertexBytes + indexBytes + lodBytes + lodIndexBytes + meshletBytes +
+                             positionBytes + attributeBytes + rasterIndexBytes) {
+            return false;
+        }
+
+        //LODs and meshlets are small and kept on the CPU, the vertex and index data stays in the mapping
+        const uint8_t *payload = cooked->data() + sizeof(Header);
+        auto streams = std::make_shared<Model::CookedStreams>();
+        streams->vertices = payload;
+        streams->vertexCount = header.vertexCount;
+        payload += vertexBytes;
+        streams->indices = payload;
+        streams->indexCount = header.indexCount;
+        payload += indexBytes;
+        builder.lods.resize(header.lodCount);
+        std::memcpy(builder.lods.data(), payload, lodBytes);
+        payload += lodBytes;
+        builder.lodIndices.resize(header.lodIndexCount);
+        std::memcpy(builder.lodIndices.data(), payload, lodIndexBytes);
+        payload += lodIndexBytes;
+        builder.meshlets.resize(header.meshletCount);
+        std::memcpy(builder.meshlets.data(), payload, meshletBytes);
+        payload += meshletBytes;
+        streams->positions = payload;
+        payload += positionBytes;
+        streams->attributes = payload;
+        payload += attributeBytes;
+        streams->rasterIndices = payload;
+        streams->rasterIndexCount = rasterIndexCount;
+        streams->file = std::move(cooked);
+
+        builder.vertices.clear();
+        builder.indices.clear();
+        builder.cooked = std::move(streams);
+        builder.maxRadius = header.maxRadius;
+        builder.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        builder.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        cookMilliseconds = header.cookMilliseconds;
+        return true;
+    }
+
+    void MeshCache::Save(const std::string &cookedPath, uint64_t sourceHash, const Model::Builder &builder, float cookMilliseconds) {
+        Header header{};
+        header.magic = Magic;
+        header.version = Version;
+        header.sourceHash = sourceHash;
+        header.vertexSize = sizeof(Model::Vertex);
+        header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        header.indexCount = static_cast<uint32_t>(builder.indices.size());
+        header.maxRadius = builder.maxRadius;
+        for (int i = 0; i < 3; i++) {
+            header.boundsMin[i] = builder.boundsMin[i];
+            header.boundsMax[i] = builder.boundsMax[i];
+        }
+        header.cookMilliseconds = cookMilliseconds;
+        header.optimized = builder.optimize;
+        header.lodsGenerated = builder.generateLods;
+        header.lodCount = static_cast<uint32_t>(builder.lods.size());
+        header.lodIndexCount = static_cast<uint32_t>(builder.lodIndices.size());
+        header.meshletsBuilt = builder.buildMeshlets;
+        header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+        bool shortIndices = Model::UsesShortIndices(header.vertexCount);
+        header.rasterIndexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        //The raster streams exactly as Model uploads them
+        std::vector<Model::PackedPosition> positions(builder.vertices.size());
+        std::vector<Model::PackedAttributes> attributes(builder.vertices.size());
+        for (size_t i = 0; i < builder.vertices.size(); i++) {
+            Model::PackedVertex packed = Model::PackedVertex::pack(builder.vertices[i]);
+            positions[i] = packed.position;
+            attributes[i] = packed.attributes;
+        }
+        std::vector<uint32_t> rasterIndices(builder.indices);
+        rasterIndices.insert(rasterIndices.end(), builder.lodIndices.begin(), builder.lodIndices.end());
+        std::vector<uint16_t> shortRasterIndices;
+        if (shortIndices) shortRasterIndices.assign(rasterIndices.begin(), rasterIndices.end());
+
+        //Write to a temporary file first so an interrupted cook never leaves a half written cache behind
+        std::string tempPath = cookedPath + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Failed to write cooked mesh: " << cookedPath << std::endl;
+                return;
+            }
+            file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            file.write(reinterpret_cast<const char *>(builder.vertices.data()),
+                       static_cast<std::streamsize>(builder.vertices.size() * sizeof(Model::Vertex)));
+            file.write(reinterpret_cast<const char *>(builder.indices.data()),
+                       static_cast<std::streamsize>(builder.indices.size() * sizeof(uint32_t)));
+            file.write(reinterpret_cast<const char *>(builder.lods.data()),
+                       static_cast<std::streamsize>(builder.lods.size() * sizeof(Model::LodLevel)));
+            file.write(reinterpret_cast<const char *>(builder.lodIndices.data()),
+                       static_cast<std::streamsize>(builder.lodIndices.size() * sizeof(uint32_t)));
+            file.write(reinterpret_cast<const char *>(builder.meshlets.data()),
+                       static_cast<std::streamsize>(builder.meshlets.size() * sizeof(Model::Meshlet)));
+            file.write(reinterpret_cast<const char *>(positions.data()),
+                       static_cast<std::streamsize>(positions.size() * sizeof(Model::PackedPosition)));
+            file.write(reinterpret_cast<const char *>(attributes.data()),
+                       static_cast<std::streamsize>(attributes.size() * sizeof(Model::PackedAttributes)));
+            if (shortIndices) {
+                file.write(reinterpret_cast<const char *>(shortRasterIndices.data()),
+                           static_cast<std::streamsize>(shortRasterIndices.size() * sizeof(uint16_t)));
+            } else {
+                file.write(reinterpret_cast<const char *>(rasterIndices.data()),
+                           static_cast<std::streamsize>(rasterIndices.size() * sizeof(uint32_t)));
+            }
+            if (!file.good()) {
+                file.close();
+                std::remove(tempPath.c_str());
+                std::cerr << "Failed to write cooked mesh: " << cookedPath << std::endl;
+                return;
+            }
+        }
+        std::remove(cookedPath.c_str());
+        if (std::rename(tempPath.c_str(), cookedPath.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            std::cerr << "Failed to write cooked mesh: " << cookedPath << std::endl;
+        }
+    }
+
+    uint64_t MeshCache::HashBytes(const uint8_t *data, size_t size) {
+        //FNV-1a style mixing on 8 byte words, fast enough to validate large OBJ files on every launch
+        const uint64_t prime = 0x100000001b3ULL;
+        uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; i++) {
+            hash = (hash ^ data[i]) * prime;
+        }
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+
+namespace Kaamoo {
+    //Cooked binary mesh format, written next to the source OBJ so later launches can skip OBJ parsing.
+    //Besides the Vertex/uint32 data it stores the packed raster streams, so a warm load uploads straight from the mapping
+    class MeshCache {
+    public:
+        inline static const std::string CookedExtension = ".kmesh";
+
+        static std::string GetCookedPath(const std::string &sourcePath) { return sourcePath + CookedExtension; }
+
+        //Returns false when the cooked file is missing, truncated, from another version or cooked from a different source.
+        //On success builder.cooked points into the mapped file, builder.vertices and builder.indices stay empty
+        static bool TryLoad(const std::string &cookedPath, uint64_t sourceHash, Model::Builder &builder, float &cookMilliseconds);
+
+        static void Save(const std::string &cookedPath, uint64_t sourceHash, const Model::Builder &builder, float cookMilliseconds);
+
+        static uint64_t HashBytes(const uint8_t *data, size_t size);
+
+    private:
+        inline static const uint32_t Magic = 0x48534D4B; // "KMSH"
+        inline static const uint32_t Version = 7;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t sourceHash;
+            uint32_t vertexSize;
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            float maxRadius;
+            float boundsMin[3];
+            float boundsMax[3];
+            //Time the OBJ import took when this file was cooked, used to report the warm start speed up
+            float cookMilliseconds;
+            //Whether MeshOptimizer ran before cooking, a cache cooked with other settings counts as stale
+            uint32_t optimized;
+            //Same for the LOD chain, lodCount includes the full resolution level
+            uint32_t lodsGenerated;
+            uint32_t lodCount;
+            uint32_t lodIndexCount;
+            uint32_t meshletsBuilt;
+            uint32_t meshletCount;
+            //2 or 4, follows Model::UsesShortIndices
+            uint32_t rasterIndexSize;
+            uint32_t reserved[2];
+        };
+        static_assert(sizeof(Header) % 16 == 0, "Cooked mesh payload must stay 16 byte aligned");
+    };
+}
@@ -0,0 +1,297 @@
+﻿#include "MeshOptimizer.h"
+#include "../Utils/Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Kaamoo {
+    namespace {
+        //Scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+        const int ScoringCacheSize = 32;
+        const float CacheDecayPower = 1.5f;
+        const float LastTriangleScore = 0.75f;
+        const float ValenceBoostScale = 2.0f;
+        const float ValenceBoostPower = 0.5f;
+
+        float vertexScore(int cachePosition, uint32_t liveTriangles) {
+            //Vertices without remaining triangles never need to be picked again
+            if (liveTriangles == 0) return -1.0f;
+
+            float score = 0.0f;
+            if (cachePosition >= 0) {
+                if (cachePosition < 3) {
+                    score = LastTriangleScore;
+                } else {
+                    float scaler = 1.0f / (ScoringCacheSize - 3);
+                    score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, CacheDecayPower);
+                }
+            }
+            score += ValenceBoostScale * std::pow(static_cast<float>(liveTriangles), -ValenceBoostPower);
+            return score;
+        }
+
+        //FIFO simulation with timestamps, a vertex is a hit if it was transformed in the last cacheSize misses
+        struct FifoCache {
+            std::vector<uint32_t> timestamps;
+            uint32_t time;
+            uint32_t cacheSize;
+
+            FifoCache(size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+
+            uint32_t triangleMisses(const uint32_t *triangle) {
+                uint32_t misses = 0;
+                for (int k = 0; k < 3; k++) {
+                    if (time - timestamps[triangle[k]] > cacheSize) {
+                        timestamps[triangle[k]] = time++;
+                        misses++;
+                    }
+                }
+                return misses;
+            }
+
+            void reset() { time += cacheSize + 1; }
+        };
+    }
+
+    void MeshOptimizer::Optimize(Model::Builder &builder, const std::string &name) {
+        if (builder.indices.size() < 3) return;
+
+#ifdef ASSET_STATISTICS
+        CacheStatistics before = AnalyzeVertexCache(builder.indices, builder.vertices.size());
+#endif
+        OptimizeVertexCache(builder.indices, builder.vertices.size());
+        OptimizeOverdraw(builder.indices, builder.vertices, OverdrawThreshold);
+        OptimizeVertexFetch(builder.vertices, builder.indices);
+
+#ifdef ASSET_STATISTICS
+        CacheStatistics after = AnalyzeVertexCache(builder.indices, builder.vertices.size());
+        std::cout << "Optimized " << name << ": ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+#endif
+    }
+
+    void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return;
+
+        //Triangle adjacency per vertex, live entries are kept at the front of each range
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (uint32_t index: indices) {
+            liveTriangles[index]++;
+        }
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++) {
+            adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) {
+                adjacency[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            vertexScores[i] = vertexScore(-1, liveTriangles[i]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        int64_t bestTriangle = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+            if (triangleScores[t] > triangleScores[bestTriangle]) bestTriangle = static_cast<int64_t>(t);
+        }
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        uint32_t cache[ScoringCacheSize + 3];
+        size_t cacheCount = 0;
+        size_t cursor = 0;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            if (bestTriangle < 0) {
+                //Nothing adjacent to the cache is left, continue with the next unused triangle in input order
+                while (emitted[cursor]) cursor++;
+                bestTriangle = static_cast<int64_t>(cursor);
+            }
+
+            const uint32_t *triangle = &indices[3 * bestTriangle];
+            output.insert(output.end(), triangle, triangle + 3);
+            emitted[bestTriangle] = true;
+
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = triangle[k];
+                uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+                uint32_t *end = begin + liveTriangles[vertex];
+                uint32_t *found = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+                if (found != end) {
+                    std::swap(*found, *(end - 1));
+                    liveTriangles[vertex]--;
+                }
+            }
+
+            //The emitted triangle moves to the front of the cache, the rest shifts back
+            uint32_t newCache[ScoringCacheSize + 3];
+            size_t newCacheCount = 0;
+            for (int k = 0; k < 3; k++) {
+                if (std::find(newCache, newCache + newCacheCount, triangle[k]) == newCache + newCacheCount) {
+                    newCache[newCacheCount++] = triangle[k];
+                }
+            }
+            for (size_t i = 0; i < cacheCount; i++) {
+                uint32_t vertex = cache[i];
+                if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                    newCache[newCacheCount++] = vertex;
+                }
+            }
+
+            for (size_t i = 0; i < newCacheCount; i++) {
+                uint32_t vertex = newCache[i];
+                int position = i < ScoringCacheSize ? static_cast<int>(i) : -1;
+                cachePositions[vertex] = position;
+                float score = vertexScore(position, liveTriangles[vertex]);
+                float delta = score - vertexScores[vertex];
+                vertexScores[vertex] = score;
+                const uint32_t *adjacent = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t j = 0; j < liveTriangles[vertex]; j++) {
+                    triangleScores[adjacent[j]] += delta;
+                }
+            }
+
+            cacheCount = std::min<size_t>(newCacheCount, ScoringCacheSize);
+            std::copy(newCache, newCache + cacheCount, cache);
+
+            bestTriangle = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cacheCount; i++) {
+                uint32_t vertex = cache[i];
+                const uint32_t *adjacent = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t j = 0; j < liveTriangles[vertex]; j++) {
+                    if (triangleScores[adjacent[j]] > bestScore) {
+                        bestScore = triangleScores[adjacent[j]];
+                        bestTriangle = adjacent[j];
+                    }
+                }
+            }
+        }
+
+        indices.swap(output);
+    }
+
+    void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Model::Vertex> &vertices, float threshold) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2) return;
+
+        //Hard boundaries: triangles that miss the cache on every vertex start a new cluster anyway
+        std::vector<size_t> hardClusters;
+        {
+            FifoCache fifoCache(vertices.size(), SimulatedCacheSize);
+            for (size_t t = 0; t < triangleCount; t++) {
+                if (fifoCache.triangleMisses(&indices[3 * t]) == 3 || t == 0) hardClusters.push_back(t);
+            }
+        }
+        hardClusters.push_back(triangleCount);
+
+        //Soft boundaries: split a cluster further as long as each piece keeps an acmr close to the whole cluster's
+        std::vector<size_t> clusters;
+        {
+            FifoCache fifoCache(vertices.size(), SimulatedCacheSize);
+            for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+                size_t begin = hardClusters[c], end = hardClusters[c + 1];
+
+                fifoCache.reset();
+                uint32_t clusterMisses = 0;
+                for (size_t t = begin; t < end; t++) {
+                    clusterMisses += fifoCache.triangleMisses(&indices[3 * t]);
+                }
+                float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+                clusters.push_back(begin);
+                fifoCache.reset();
+                uint32_t runningMisses = 0, runningTriangles = 0;
+                for (size_t t = begin; t < end; t++) {
+                    runningMisses += fifoCache.triangleMisses(&indices[3 * t]);
+                    runningTriangles++;
+                    if (t + 1 < end && static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold) {
+                        clusters.push_back(t + 1);
+                        fifoCache.reset();
+                        runningMisses = runningTriangles = 0;
+                    }
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+
+        glm::vec3 meshCentroid{0.0f};
+        for (const auto &vertex: vertices) {
+            meshCentroid += vertex.position;
+        }
+        meshCentroid /= static_cast<float>(std::max<size_t>(1, vertices.size()));
+
+        //Clusters facing away from the mesh centre are likely occluders, draw them first
+        size_t clusterCount = clusters.size() - 1;
+        std::vector<float> sortKeys(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            glm::vec3 centroid{0.0f}, normal{0.0f};
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+                const glm::vec3 &p0 = vertices[indices[3 * t]].position;
+                const glm::vec3 &p1 = vertices[indices[3 * t + 1]].position;
+                const glm::vec3 &p2 = vertices[indices[3 * t + 2]].position;
+                glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+                float faceArea = glm::length(faceNormal);
+                centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+                normal += faceNormal;
+                area += faceArea;
+            }
+            centroid = area > 0.0f ? centroid / area : vertices[indices[3 * clusters[c]]].position;
+            float normalLength = glm::length(normal);
+            normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+            sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+        }
+
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        for (size_t c: order) {
+            output.insert(output.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+        }
+        indices.swap(output);
+    }
+
+    void MeshOptimizer::OptimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices) {
+        const uint32_t unused = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), unused);
+        uint32_t nextVertex = 0;
+        for (uint32_t &index: indices) {
+            if (remap[index] == unused) remap[index] = nextVertex++;
+            index = remap[index];
+        }
+
+        //Vertices no triangle references are dropped
+        std::vector<Model::Vertex> reordered(nextVertex);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (remap[i] != unused) reordered[remap[i]] = vertices[i];
+        }
+        vertices.swap(reordered);
+    }
+
+    MeshOptimizer::CacheStatistics MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+        CacheStatistics statistics{};
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || vertexCount == 0) return statistics;
+
+        FifoCache fifoCache(vertexCount, cacheSize);
+        uint64_t misses = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            misses += fifoCache.triangleMisses(&indices[3 * t]);
+        }
+        statistics.acmr = static_cast<float>(misses) / static_cast<float>(triangleCount);
+        statistics.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+        return statistics;
+    }
+}
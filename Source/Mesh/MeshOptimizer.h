@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+
+namespace Kaamoo {
+    //Reorders imported meshes for the post transform vertex cache, early-z and vertex fetch
+    class MeshOptimizer {
+    public:
+        struct CacheStatistics {
+            //Average cache miss ratio, transformed vertices per triangle
+            float acmr = 0;
+            //Average transform to vertex ratio, 1.0 means every vertex is transformed once
+            float atvr = 0;
+        };
+
+        //FIFO size used to simulate the post transform cache
+        inline static const uint32_t SimulatedCacheSize = 16;
+        //Clusters may get this much worse acmr than the whole mesh before overdraw ordering stops splitting them
+        inline static const float OverdrawThreshold = 1.05f;
+
+        //Runs all three passes on the builder and reports acmr/atvr before and after
+        static void Optimize(Model::Builder &builder, const std::string &name);
+
+        //Tom Forsyth's linear speed vertex cache optimisation
+        static void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+        //Splits the cache optimised order into clusters and draws outward facing clusters first
+        static void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Model::Vertex> &vertices, float threshold);
+
+        //Renumbers vertices in first use order
+        static void OptimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices);
+
+        static CacheStatistics AnalyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = SimulatedCacheSize);
+    };
+}
@@ -0,0 +1,265 @@
+﻿#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "VertexWelder.hpp"
+#include "../Utils/Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Kaamoo {
+    namespace {
+        //Symmetric 4x4 matrix of Garland and Heckbert, the sum of squared distances to the accumulated planes
+        struct Quadric {
+            double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+            double b0 = 0, b1 = 0, b2 = 0;
+            double c = 0;
+            //Accumulated area, dividing by it turns the error back into a squared distance
+            double weight = 0;
+
+            void addPlane(const glm::dvec3 &normal, double distance, double weight) {
+                a00 += weight * normal.x * normal.x;
+                a01 += weight * normal.x * normal.y;
+                a02 += weight * normal.x * normal.z;
+                a11 += weight * normal.y * normal.y;
+                a12 += weight * normal.y * normal.z;
+                a22 += weight * normal.z * normal.z;
+                b0 += weight * normal.x * distance;
+                b1 += weight * normal.y * distance;
+                b2 += weight * normal.z * distance;
+                c += weight * distance * distance;
+                this->weight += weight;
+            }
+
+            void add(const Quadric &other) {
+                a00 += other.a00, a01 += other.a01, a02 += other.a02;
+                a11 += other.a11, a12 += other.a12, a22 += other.a22;
+                b0 += other.b0, b1 += other.b1, b2 += other.b2;
+                c += other.c;
+                weight += other.weight;
+            }
+
+            double evaluate(const glm::vec3 &p) const {
+                double x = p.x, y = p.y, z = p.z;
+                double result = a00 * x * x + a11 * y * y + a22 * z * z
+                                + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                                + 2 * (b0 * x + b1 * y + b2 * z) + c;
+                return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+            }
+        };
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return (static_cast<uint64_t>(a) << 32) | b;
+        }
+    }
+
+    void MeshSimplifier::GenerateLods(Model::Builder &builder, const std::string &name) {
+        builder.lods.clear();
+        builder.lodIndices.clear();
+        if (builder.indices.empty()) return;
+        builder.lods.push_back({0, static_cast<uint32_t>(builder.indices.size()), 0.0f});
+
+        float radius = std::max(builder.maxRadius, 1e-6f);
+        size_t previousCount = builder.indices.size();
+#ifdef ASSET_STATISTICS
+        std::string chain = std::to_string(previousCount / 3);
+#endif
+        for (uint32_t level = 1; level < MaxLodCount; level++) {
+            size_t targetCount = static_cast<size_t>(static_cast<float>(previousCount) * LevelRatio) / 3 * 3;
+            if (targetCount < MinTriangleCount * 3) break;
+
+            std::vector<uint32_t> lodIndices;
+            float error = Simplify(builder.vertices, builder.indices, targetCount, MaxRelativeError * radius, lodIndices);
+            if (static_cast<float>(lodIndices.size()) > static_cast<float>(previousCount) * MinReduction) break;
+
+            MeshOptimizer::OptimizeVertexCache(lodIndices, builder.vertices.size());
+            Model::LodLevel lod{};
+            lod.indexOffset = static_cast<uint32_t>(builder.indices.size() + builder.lodIndices.size());
+            lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+            //Coarser levels never report less error than finer ones, selection relies on it
+            lod.error = std::max(error / radius, builder.lods.back().error);
+            builder.lods.push_back(lod);
+            builder.lodIndices.insert(builder.lodIndices.end(), lodIndices.begin(), lodIndices.end());
+
+            previousCount = lodIndices.size();
+#ifdef ASSET_STATISTICS
+            chain += " -> " + std::to_string(previousCount / 3) + " (" + std::to_string(lod.error * 100.0f) + "%)";
+#endif
+        }
+
+#ifdef ASSET_STATISTICS
+        std::cout << "Generated " << builder.lods.size() << " LODs for " << name << ": " << chain << " triangles" << std::endl;
+#endif
+    }
+
+    float MeshSimplifier::Simplify(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                   size_t targetIndexCount, float maxError, std::vector<uint32_t> &result) {
+        result = indices;
+        if (indices.size() <= targetIndexCount) return 0.0f;
+        size_t vertexCount = vertices.size();
+
+        //Corners split by uv or normal seams share a position group, edges are compared in group space
+        VertexWelder positionWelder(VertexWelder::Mode::PositionOnly, vertexCount);
+        std::vector<uint32_t> positionGroups(vertexCount);
+        std::vector<uint32_t> groupSizes;
+        for (size_t i = 0; i < vertexCount; i++) {
+            bool inserted;
+            positionGroups[i] = positionWelder.FindOrInsert(vertices[i], static_cast<uint32_t>(groupSizes.size()), inserted);
+            if (inserted) groupSizes.push_back(0);
+            groupSizes[positionGroups[i]]++;
+        }
+
+        //Seam vertices are locked, and so is every vertex on an open or non manifold edge
+        std::vector<uint8_t> locked(vertexCount, 0);
+        for (size_t i = 0; i < vertexCount; i++) {
+            if (groupSizes[positionGroups[i]] > 1) locked[i] = 1;
+        }
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                edges.push_back(edgeKey(positionGroups[indices[i + k]], positionGroups[indices[i + (k + 1) % 3]]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+                uint64_t forward = edgeKey(positionGroups[a], positionGroups[b]);
+                uint64_t backward = edgeKey(positionGroups[b], positionGroups[a]);
+                auto range = std::equal_range(edges.begin(), edges.end(), forward);
+                if (range.second - range.first != 1 || !std::binary_search(edges.begin(), edges.end(), backward)) {
+                    locked[a] = 1;
+                    locked[b] = 1;
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::dvec3 p0 = vertices[indices[i]].position, p1 = vertices[indices[i + 1]].position, p2 = vertices[indices[i + 2]].position;
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            double length = glm::length(normal);
+            if (length <= 0.0) continue;
+            normal /= length;
+            //Area weighted so that many tiny triangles do not outvote one large one
+            double area = length * 0.5;
+            double distance = -glm::dot(normal, p0);
+            for (int k = 0; k < 3; k++) {
+                quadrics[indices[i + k]].addPlane(normal, distance, area);
+            }
+        }
+
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        std::vector<uint32_t> vertexTriangles;
+        std::vector<uint8_t> touched(vertexCount);
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> remap(vertexCount);
+        double errorLimit = static_cast<double>(maxError) * maxError;
+        double resultError = 0.0;
+
+        while (result.size() > targetIndexCount) {
+            //Triangles around every vertex, rebuilt each pass since collapses rewrite the index list
+            std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+            for (uint32_t index: result) triangleOffsets[index + 1]++;
+            for (size_t i = 0; i < vertexCount; i++) triangleOffsets[i + 1] += triangleOffsets[i];
+            vertexTriangles.resize(result.size());
+            {
+                std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+                for (size_t i = 0; i < result.size(); i++) {
+                    vertexTriangles[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+                }
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t from = result[i + k], to = result[i + (k + 1) % 3];
+                    if (locked[from]) continue;
+                    Quadric quadric = quadrics[from];
+                    quadric.add(quadrics[to]);
+                    collapses.push_back({from, to, quadric.evaluate(vertices[to].position)});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+            //Independent collapses only, a vertex whose fan changed this pass is not touched again until the next one
+            std::fill(touched.begin(), touched.end(), 0);
+            for (size_t i = 0; i < vertexCount; i++) remap[i] = static_cast<uint32_t>(i);
+            size_t removableTriangles = (result.size() - targetIndexCount) / 3;
+            size_t removedTriangles = 0;
+            for (const Collapse &collapse: collapses) {
+                if (removedTriangles >= removableTriangles || collapse.cost > errorLimit) break;
+                if (touched[collapse.from] || touched[collapse.to]) continue;
+
+                const glm::vec3 &target = vertices[collapse.to].position;
+                uint32_t sharedTriangles = 0;
+                bool valid = true;
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && valid; t++) {
+                    const uint32_t *triangle = &result[vertexTriangles[t] * 3];
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                        sharedTriangles++;
+                        continue;
+                    }
+                    //Triangles that survive the collapse must not flip or fold over
+                    glm::vec3 before[3], after[3];
+                    for (int k = 0; k < 3; k++) {
+                        before[k] = vertices[triangle[k]].position;
+                        after[k] = triangle[k] == collapse.from ? target : before[k];
+                    }
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+                    if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < MaxNormalDeviation * lengths) valid = false;
+                }
+                //An interior edge is shared by exactly two triangles, anything else would leave a non manifold fan
+                if (!valid || sharedTriangles != 2) continue;
+
+                //Link condition: the two fans may only meet at the opposite corners of the shared triangles
+                uint32_t commonNeighbours = 0;
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                    const uint32_t *triangle = &result[vertexTriangles[t] * 3];
+                    for (int k = 0; k < 3; k++) {
+                        uint32_t neighbour = triangle[k];
+                        if (neighbour == collapse.from || neighbour == collapse.to) continue;
+                        for (uint32_t s = triangleOffsets[collapse.to]; s < triangleOffsets[collapse.to + 1]; s++) {
+                            const uint32_t *other = &result[vertexTriangles[s] * 3];
+                            if (other[0] == neighbour || other[1] == neighbour || other[2] == neighbour) {
+                                commonNeighbours++;
+                                break;
+                            }
+                        }
+                    }
+                }
+                //Every neighbour is seen from two triangles of the closed fan
+                if (commonNeighbours != 4) continue;
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                resultError = std::max(resultError, collapse.cost);
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                    const uint32_t *triangle = &result[vertexTriangles[t] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+                removedTriangles += sharedTriangles;
+            }
+            if (removedTriangles == 0) break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                if (a == b || b == c || a == c) continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        return static_cast<float>(std::sqrt(resultError));
+    }
+}
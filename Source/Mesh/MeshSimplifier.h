@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+
+namespace Kaamoo {
+    //Quadric error edge collapse, builds the LOD chain that shares the vertex buffer of the full resolution mesh
+    class MeshSimplifier {
+    public:
+        //Levels including the full resolution one
+        inline static const uint32_t MaxLodCount = 5;
+        //Each level targets this fraction of the triangles of the previous level
+        inline static const float LevelRatio = 0.5f;
+        //A level that keeps more than this fraction of the previous one is dropped, the mesh is mostly seams or borders
+        inline static const float MinReduction = 0.85f;
+        inline static const size_t MinTriangleCount = 64;
+        //Collapses are not allowed to move the surface further than this fraction of the model radius
+        inline static const float MaxRelativeError = 0.1f;
+        //Collapses that turn a neighbouring triangle further than this (cosine) are rejected
+        inline static const float MaxNormalDeviation = 0.25f;
+
+        //Fills builder.lods and builder.lodIndices, has to run after the vertex order is final
+        static void GenerateLods(Model::Builder &builder, const std::string &name);
+
+        //Collapses edges until result holds at most targetIndexCount indices or the next collapse would exceed maxError.
+        //Vertices on borders and uv/normal seams never move. Returns the object space error of the result
+        static float Simplify(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices,
+                              size_t targetIndexCount, float maxError, std::vector<uint32_t> &result);
+    };
+}
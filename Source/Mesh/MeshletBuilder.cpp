@@ -0,0 +1,201 @@
+﻿#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "VertexWelder.hpp"
+#include "../Utils/Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Kaamoo {
+    void MeshletBuilder::Build(Model::Builder &builder, const std::string &name) {
+        builder.meshlets.clear();
+        const auto &vertices = builder.vertices;
+        const auto &indices = builder.indices;
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        if (triangleCount < MinTriangleCount) return;
+
+        //The opaque pipeline does not cull faces, back facing clusters are only hidden behind the front of closed meshes
+        bool coneCulling = IsClosed(vertices, indices);
+
+        //Triangles around every position, meshlets grow over shared corners so their bounds stay tight.
+        //Positions rather than vertices, flat shaded meshes share no vertex between faces
+        VertexWelder positionWelder(VertexWelder::Mode::PositionOnly, vertices.size());
+        std::vector<uint32_t> positionGroups(vertices.size());
+        uint32_t groupCount = 0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            bool inserted;
+            positionGroups[i] = positionWelder.FindOrInsert(vertices[i], groupCount, inserted);
+            if (inserted) groupCount++;
+        }
+        std::vector<uint32_t> adjacencyOffsets(groupCount + 1, 0);
+        for (uint32_t index: indices) adjacencyOffsets[positionGroups[index] + 1]++;
+        for (uint32_t i = 0; i < groupCount; i++) adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (uint32_t i = 0; i < indices.size(); i++) adjacency[cursors[positionGroups[indices[i]]]++] = i / 3;
+        }
+
+        //Vertices are counted once per meshlet, the stamp remembers which meshlet saw them last
+        std::vector<uint32_t> vertexStamp(vertices.size(), ~0u);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> clusteredIndices;
+        clusteredIndices.reserve(indices.size());
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> meshletIndices;
+        uint32_t seedCursor = 0;
+        uint32_t stamp = 0;
+        while (true) {
+            //Continue next to the previous meshlet, fall back to the first free triangle in the optimised order
+            uint32_t triangle = ~0u;
+            for (uint32_t candidate: candidates) {
+                if (!emitted[candidate]) {
+                    triangle = candidate;
+                    break;
+                }
+            }
+            if (triangle == ~0u) {
+                while (seedCursor < triangleCount && emitted[seedCursor]) seedCursor++;
+                if (seedCursor == triangleCount) break;
+                triangle = seedCursor;
+            }
+
+            uint32_t meshletOffset = static_cast<uint32_t>(clusteredIndices.size());
+            uint32_t meshletVertices = 0;
+            glm::vec3 positionSum{0.0f};
+            candidates.clear();
+            while (triangle != ~0u) {
+                emitted[triangle] = true;
+                for (int k = 0; k < 3; k++) {
+                    uint32_t vertex = indices[triangle * 3 + k];
+                    clusteredIndices.push_back(vertex);
+                    if (vertexStamp[vertex] == stamp) continue;
+                    vertexStamp[vertex] = stamp;
+                    meshletVertices++;
+                    positionSum += vertices[vertex].position;
+                    uint32_t group = positionGroups[vertex];
+                    for (uint32_t i = adjacencyOffsets[group]; i < adjacencyOffsets[group + 1]; i++) {
+                        if (!emitted[adjacency[i]]) candidates.push_back(adjacency[i]);
+                    }
+                }
+                if ((clusteredIndices.size() - meshletOffset) / 3 >= MaxTriangles) break;
+
+                //Prefer triangles adding the fewest vertices, then the one closest to the meshlet centre
+                glm::vec3 center = positionSum / static_cast<float>(meshletVertices);
+                triangle = ~0u;
+                uint32_t bestNewVertices = 4;
+                float bestDistance = std::numeric_limits<float>::max();
+                for (size_t c = 0; c < candidates.size();) {
+                    uint32_t candidate = candidates[c];
+                    if (emitted[candidate]) {
+                        candidates[c] = candidates.back();
+                        candidates.pop_back();
+                        continue;
+                    }
+                    c++;
+                    uint32_t newVertices = 0;
+                    glm::vec3 centroid{0.0f};
+                    for (int k = 0; k < 3; k++) {
+                        uint32_t vertex = indices[candidate * 3 + k];
+                        if (vertexStamp[vertex] != stamp) newVertices++;
+                        centroid += vertices[vertex].position;
+                    }
+                    if (meshletVertices + newVertices > MaxVertices || newVertices > bestNewVertices) continue;
+                    float distance = glm::length(centroid / 3.0f - center);
+                    if (newVertices < bestNewVertices || distance < bestDistance) {
+                        triangle = candidate;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            //Growth order is not cache order, restore the vertex cache order inside the meshlet
+            meshletIndices.assign(clusteredIndices.begin() + meshletOffset, clusteredIndices.end());
+            MeshOptimizer::OptimizeVertexCache(meshletIndices, vertices.size());
+            std::copy(meshletIndices.begin(), meshletIndices.end(), clusteredIndices.begin() + meshletOffset);
+
+            builder.meshlets.push_back(ComputeBounds(vertices, clusteredIndices, meshletOffset,
+                                                     static_cast<uint32_t>(clusteredIndices.size()) - meshletOffset, coneCulling));
+            stamp++;
+        }
+        builder.indices = std::move(clusteredIndices);
+
+#ifdef ASSET_STATISTICS
+        std::cout << "Built " << builder.meshlets.size() << " meshlets for " << name << " ("
+                  << static_cast<float>(triangleCount) / static_cast<float>(builder.meshlets.size()) << " triangles each, cone culling "
+                  << (coneCulling ? "on" : "off") << ")" << std::endl;
+#endif
+    }
+
+    bool MeshletBuilder::IsClosed(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices) {
+        VertexWelder positionWelder(VertexWelder::Mode::PositionOnly, vertices.size());
+        std::vector<uint32_t> positionGroups(vertices.size());
+        uint32_t groupCount = 0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            bool inserted;
+            positionGroups[i] = positionWelder.FindOrInsert(vertices[i], groupCount, inserted);
+            if (inserted) groupCount++;
+        }
+
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint64_t a = positionGroups[indices[i + k]], b = positionGroups[indices[i + (k + 1) % 3]];
+                edges.push_back((a << 32) | b);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (i + 1 < edges.size() && edges[i + 1] == edges[i]) return false;
+            uint64_t reversed = (edges[i] << 32) | (edges[i] >> 32);
+            if (!std::binary_search(edges.begin(), edges.end(), reversed)) return false;
+        }
+        return true;
+    }
+
+    Model::Meshlet MeshletBuilder::ComputeBounds(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                                 uint32_t indexOffset, uint32_t indexCount, bool coneCulling) {
+        Model::Meshlet meshlet{};
+        meshlet.indexOffset = indexOffset;
+        meshlet.indexCount = indexCount;
+
+        glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+        glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+        for (uint32_t i = indexOffset; i < indexOffset + indexCount; i++) {
+            boundsMin = glm::min(boundsMin, vertices[indices[i]].position);
+            boundsMax = glm::max(boundsMax, vertices[indices[i]].position);
+        }
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = indexOffset; i < indexOffset + indexCount; i++) {
+            radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+        }
+        meshlet.sphere = glm::vec4(center, radius);
+
+        //Average face normal as the axis, the cutoff is the sine of the widest angle any face makes with it
+        std::vector<glm::vec3> normals;
+        normals.reserve(indexCount / 3);
+        glm::vec3 axis{0.0f};
+        for (uint32_t i = indexOffset; i < indexOffset + indexCount; i += 3) {
+            const glm::vec3 &p0 = vertices[indices[i]].position;
+            glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f) continue;
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        float axisLength = glm::length(axis);
+        if (!coneCulling || axisLength <= 0.0f) return meshlet;
+
+        axis /= axisLength;
+        float minDot = 1.0f;
+        for (const glm::vec3 &normal: normals) {
+            minDot = std::min(minDot, glm::dot(axis, normal));
+        }
+        if (minDot < MinConeSpread) return meshlet;
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+        return meshlet;
+    }
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+
+namespace Kaamoo {
+    //Splits the full resolution index list into meshlets with bounds for cluster culling
+    class MeshletBuilder {
+    public:
+        inline static const uint32_t MaxVertices = 64;
+        inline static const uint32_t MaxTriangles = 124;
+        //Smaller meshes are cheaper to draw whole than to cull. At 1024 the sphere and both vases get meshlets,
+        //Benchmarks/MeshletCullBenchmark reports what culling saves on them
+        inline static const size_t MinTriangleCount = 1024;
+        //Cones wider than this (minimum cosine between axis and a triangle normal) are not worth testing
+        inline static const float MinConeSpread = 0.1f;
+
+        //Fills builder.meshlets and reorders builder.indices so every meshlet is a contiguous range. Each meshlet grows from a
+        //seed over shared vertices, which keeps its bounds tight and its triangles cache friendly
+        static void Build(Model::Builder &builder, const std::string &name);
+
+        //Whether every edge is shared by exactly two triangles, seams counted by position
+        static bool IsClosed(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+        //Bounding sphere and normal cone of the triangles in [indexOffset, indexOffset + indexCount)
+        static Model::Meshlet ComputeBounds(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                            uint32_t indexOffset, uint32_t indexCount, bool coneCulling);
+    };
+}
@@ -0,0 +1,51 @@
+﻿#include "MeshletCuller.h"
+
+namespace Kaamoo {
+    MeshletCuller::CullParameters MeshletCuller::MakeParameters(const glm::mat4 &projectionView, const glm::mat4 &modelMatrix,
+                                                                const glm::vec3 &cameraPosition) {
+        CullParameters parameters{};
+
+        //Gribb-Hartmann extraction from the full object to clip matrix, depth is [0, w] after CorrectionMatrix
+        glm::mat4 objectToClip = projectionView * modelMatrix;
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(objectToClip[0][i], objectToClip[1][i], objectToClip[2][i], objectToClip[3][i]);
+        }
+        parameters.planes[0] = rows[3] + rows[0];
+        parameters.planes[1] = rows[3] - rows[0];
+        parameters.planes[2] = rows[3] + rows[1];
+        parameters.planes[3] = rows[3] - rows[1];
+        parameters.planes[4] = rows[2];
+        parameters.planes[5] = rows[3] - rows[2];
+        for (auto &plane: parameters.planes) {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) plane /= length;
+        }
+
+        parameters.cameraPosition = glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1.0f);
+        return parameters;
+    }
+
+    bool MeshletCuller::IsVisible(const Model::Meshlet &meshlet, const CullParameters &parameters) {
+        glm::vec3 center = glm::vec3(meshlet.sphere);
+        float radius = meshlet.sphere.w;
+        for (const auto &plane: parameters.planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+
+        //Every face of the cluster points away from the camera
+        glm::vec3 toCenter = center - glm::vec3(parameters.cameraPosition);
+        return glm::dot(toCenter, glm::vec3(meshlet.cone)) < meshlet.cone.w * glm::length(toCenter) + radius;
+    }
+
+    uint32_t MeshletCuller::Cull(const std::vector<Model::Meshlet> &meshlets, const CullParameters &parameters,
+                                 std::vector<VkDrawIndexedIndirectCommand> &draws) {
+        uint32_t visibleCount = 0;
+        for (const auto &meshlet: meshlets) {
+            if (!IsVisible(meshlet, parameters)) continue;
+            draws.push_back({meshlet.indexCount, 1, meshlet.indexOffset, 0, 0});
+            visibleCount++;
+        }
+        return visibleCount;
+    }
+}
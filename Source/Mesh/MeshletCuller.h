@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+
+namespace Kaamoo {
+    //CPU reference of Shaders/Compute/MeshletCull.comp, everything is tested in the object space of the model.
+    //Checks/MeshletCullerCheck.cpp runs it against known cases without a GPU.
+    class MeshletCuller {
+    public:
+        //Push constant of the culling shader, 128 bytes
+        struct CullParameters {
+            //Normalized frustum planes, xyz normal and w distance, a point is inside when dot(xyz, p) + w >= 0
+            glm::vec4 planes[6];
+            //xyz camera position
+            glm::vec4 cameraPosition;
+            uint32_t meshletCount;
+            //First draw command slot of this object
+            uint32_t drawOffset;
+            //Slot of the visible meshlet counter of this object
+            uint32_t countIndex;
+            uint32_t padding;
+        };
+        static_assert(sizeof(CullParameters) == 128, "CullParameters must fit the guaranteed push constant size");
+
+        //Frustum and camera of projectionView and cameraPosition moved into the object space of modelMatrix
+        static CullParameters MakeParameters(const glm::mat4 &projectionView, const glm::mat4 &modelMatrix, const glm::vec3 &cameraPosition);
+
+        static bool IsVisible(const Model::Meshlet &meshlet, const CullParameters &parameters);
+
+        //Appends the draws of visible meshlets like the shader does and returns how many were appended
+        static uint32_t Cull(const std::vector<Model::Meshlet> &meshlets, const CullParameters &parameters,
+                             std::vector<VkDrawIndexedIndirectCommand> &draws);
+    };
+}
@@ -0,0 +1,330 @@
+﻿#include "ObjParser.h"
+#include "../Utils/JobSystem.h"
+#include "../../External/tiny_obj_loader.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace Kaamoo {
+    namespace {
+        const uint8_t RelativeVertex = 1 << 0;
+        const uint8_t RelativeTexcoord = 1 << 1;
+        const uint8_t RelativeNormal = 1 << 2;
+
+        inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+        inline bool isDelimiter(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        inline void skipSpaces(const char *&cursor, const char *end) {
+            while (cursor < end && isSpace(*cursor)) cursor++;
+        }
+
+        //Same as atoi on the index token, an empty token reads as 0
+        inline int parseIndex(const char *&cursor, const char *end) {
+            bool negative = false;
+            if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                negative = *cursor == '-';
+                cursor++;
+            }
+            int value = 0;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                value = value * 10 + (*cursor - '0');
+                cursor++;
+            }
+            while (cursor < end && *cursor != '/' && !isDelimiter(*cursor)) cursor++;
+            return negative ? -value : value;
+        }
+
+        //Mirrors tinyobj's fixIndex, relative indices stay relative to the chunk until the merge
+        inline bool fixIndex(int rawIndex, size_t localCount, bool allowZero, int &index, uint8_t relativeBit, uint8_t &relativeMask) {
+            if (rawIndex > 0) {
+                index = rawIndex - 1;
+                return true;
+            }
+            if (rawIndex == 0) {
+                index = -1;
+                return allowZero;
+            }
+            index = static_cast<int>(localCount) + rawIndex;
+            relativeMask |= relativeBit;
+            return true;
+        }
+    }
+
+    bool ObjParser::parseFloat(const char *&cursor, const char *end, float &value) {
+        static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        skipSpaces(cursor, end);
+        if (cursor >= end || *cursor == '\r') return false;
+
+        bool negative = false;
+        if (*cursor == '-' || *cursor == '+') {
+            negative = *cursor == '-';
+            cursor++;
+        }
+
+        double mantissa = 0;
+        int exponent = 0;
+        bool hasDigits = false;
+        while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+            mantissa = mantissa * 10 + (*cursor - '0');
+            hasDigits = true;
+            cursor++;
+        }
+        if (cursor < end && *cursor == '.') {
+            cursor++;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                mantissa = mantissa * 10 + (*cursor - '0');
+                exponent--;
+                hasDigits = true;
+                cursor++;
+            }
+        }
+        if (hasDigits && cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+            cursor++;
+            bool negativeExponent = false;
+            if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                negativeExponent = *cursor == '-';
+                cursor++;
+            }
+            int explicitExponent = 0;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                explicitExponent = std::min(explicitExponent * 10 + (*cursor - '0'), 1000);
+                cursor++;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        }
+
+        while (cursor < end && !isDelimiter(*cursor)) cursor++;
+        if (!hasDigits) return false;
+
+        double result = mantissa;
+        while (exponent > 22) {
+            result *= powersOfTen[22];
+            exponent -= 22;
+        }
+        while (exponent < -22) {
+            result /= powersOfTen[22];
+            exponent += 22;
+        }
+        result = exponent >= 0 ? result * powersOfTen[exponent] : result / powersOfTen[-exponent];
+        value = static_cast<float>(negative ? -result : result);
+        return true;
+    }
+
+    bool ObjParser::parseCorner(const char *&cursor, const char *end, const Chunk &chunk, RawCorner &corner) {
+        corner = {-1, -1, -1, 0};
+        if (!fixIndex(parseIndex(cursor, end), chunk.positions.size() / 3, false, corner.vertexIndex, RelativeVertex, corner.relativeMask)) {
+            return false;
+        }
+        if (cursor >= end || *cursor != '/') return true;
+        cursor++;
+
+        // i//k
+        if (cursor < end && *cursor == '/') {
+            cursor++;
+            return fixIndex(parseIndex(cursor, end), chunk.normals.size() / 3, true, corner.normalIndex, RelativeNormal, corner.relativeMask);
+        }
+
+        // i/j/k or i/j
+        if (!fixIndex(parseIndex(cursor, end), chunk.texcoords.size() / 2, true, corner.texcoordIndex, RelativeTexcoord, corner.relativeMask)) {
+            return false;
+        }
+        if (cursor >= end || *cursor != '/') return true;
+        cursor++;
+        return fixIndex(parseIndex(cursor, end), chunk.normals.size() / 3, true, corner.normalIndex, RelativeNormal, corner.relativeMask);
+    }
+
+    void ObjParser::parseChunk(Chunk &chunk) {
+        //Rough guess of 30 bytes per line keeps reallocations down without counting lines first
+        size_t estimatedLines = static_cast<size_t>(chunk.end - chunk.begin) / 30;
+        chunk.positions.reserve(estimatedLines * 3 / 2);
+        chunk.colors.reserve(estimatedLines * 3 / 2);
+        chunk.corners.reserve(estimatedLines * 3 / 2);
+
+        const char *cursor = chunk.begin;
+        while (cursor < chunk.end) {
+            const char *lineEnd = static_cast<const char *>(std::memchr(cursor, '\n', chunk.end - cursor));
+            if (lineEnd == nullptr) lineEnd = chunk.end;
+            const char *token = cursor;
+            cursor = lineEnd + 1;
+
+            skipSpaces(token, lineEnd);
+            if (lineEnd - token < 2) continue;
+
+            if (token[0] == 'v' && isSpace(token[1])) {
+                token += 2;
+                float values[6] = {0, 0, 0, 1, 1, 1};
+                int count = 0;
+                while (count < 6 && parseFloat(token, lineEnd, values[count])) count++;
+                if (count < 6) values[3] = values[4] = values[5] = 1;
+                chunk.positions.insert(chunk.positions.end(), values, values + 3);
+                chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+            } else if (token[0] == 'v' && token[1] == 'n' && lineEnd - token > 2 && isSpace(token[2])) {
+                token += 3;
+                float values[3] = {0, 0, 0};
+                for (float &value: values) {
+                    if (!parseFloat(token, lineEnd, value)) break;
+                }
+                chunk.normals.insert(chunk.normals.end(), values, values + 3);
+            } else if (token[0] == 'v' && token[1] == 't' && lineEnd - token > 2 && isSpace(token[2])) {
+                token += 3;
+                float values[2] = {0, 0};
+                for (float &value: values) {
+                    if (!parseFloat(token, lineEnd, value)) break;
+                }
+                chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+            } else if (token[0] == 'f' && isSpace(token[1])) {
+                token += 2;
+                size_t faceStart = chunk.corners.size();
+                while (true) {
+                    skipSpaces(token, lineEnd);
+                    if (token >= lineEnd || *token == '\r') break;
+                    RawCorner corner{};
+                    if (!parseCorner(token, lineEnd, chunk, corner)) {
+                        chunk.error = "Failed parse `f' line (e.g. zero value for face index)";
+                        return;
+                    }
+                    chunk.corners.push_back(corner);
+                }
+
+                size_t faceSize = chunk.corners.size() - faceStart;
+                if (faceSize < 3) {
+                    //Degenerated face, tinyobj drops it as well
+                    chunk.corners.resize(faceStart);
+                } else if (faceSize > 4) {
+                    //tinyobj ear clips these, let it handle the whole file
+                    chunk.unsupported = true;
+                    return;
+                } else {
+                    chunk.faceSizes.push_back(static_cast<uint8_t>(faceSize));
+                    chunk.triangleCount += faceSize - 2;
+                }
+            }
+        }
+    }
+
+    bool ObjParser::Parse(const uint8_t *data, size_t size, tinyobj::attrib_t &attrib, std::vector<tinyobj::index_t> &corners) {
+        JobSystem &jobSystem = JobSystem::GetInstance();
+        const char *text = reinterpret_cast<const char *>(data);
+        const char *textEnd = text + size;
+
+        //Split on line boundaries, a few chunks per thread so uneven lines still balance
+        size_t chunkCount = std::max<size_t>(1, std::min(size / MinChunkSize, jobSystem.GetConcurrency() * 4));
+        std::vector<Chunk> chunks;
+        chunks.reserve(chunkCount);
+        const char *chunkBegin = text;
+        for (size_t i = 0; i < chunkCount && chunkBegin < textEnd; i++) {
+            const char *chunkEnd = i + 1 == chunkCount ? textEnd : text + size / chunkCount * (i + 1);
+            if (chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+            const char *newLine = static_cast<const char *>(std::memchr(chunkEnd, '\n', textEnd - chunkEnd));
+            chunkEnd = newLine == nullptr ? textEnd : newLine + 1;
+            Chunk chunk{};
+            chunk.begin = chunkBegin;
+            chunk.end = chunkEnd;
+            chunks.push_back(std::move(chunk));
+            chunkBegin = chunkEnd;
+        }
+
+        jobSystem.ParallelFor(chunks.size(), 1, [&chunks](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                parseChunk(chunks[i]);
+            }
+        });
+
+        for (auto &chunk: chunks) {
+            if (chunk.unsupported) return false;
+            if (!chunk.error.empty()) throw std::runtime_error(chunk.error);
+        }
+
+        //Prefix sums give every chunk its slice of the merged arrays, so the merge itself runs in parallel
+        std::vector<size_t> positionBases(chunks.size()), normalBases(chunks.size()), texcoordBases(chunks.size()), cornerBases(chunks.size());
+        size_t positionCount = 0, normalCount = 0, texcoordCount = 0, cornerCount = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            positionBases[i] = positionCount;
+            normalBases[i] = normalCount;
+            texcoordBases[i] = texcoordCount;
+            cornerBases[i] = cornerCount;
+            positionCount += chunks[i].positions.size() / 3;
+            normalCount += chunks[i].normals.size() / 3;
+            texcoordCount += chunks[i].texcoords.size() / 2;
+            cornerCount += chunks[i].triangleCount * 3;
+        }
+
+        attrib = tinyobj::attrib_t{};
+        attrib.vertices.resize(positionCount * 3);
+        attrib.colors.resize(positionCount * 3);
+        attrib.normals.resize(normalCount * 3);
+        attrib.texcoords.resize(texcoordCount * 2);
+        corners.resize(cornerCount);
+
+        jobSystem.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Chunk &chunk = chunks[i];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), attrib.vertices.begin() + positionBases[i] * 3);
+                std::copy(chunk.colors.begin(), chunk.colors.end(), attrib.colors.begin() + positionBases[i] * 3);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + normalBases[i] * 3);
+                std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + texcoordBases[i] * 2);
+                chunk.positions = {};
+                chunk.colors = {};
+                chunk.normals = {};
+                chunk.texcoords = {};
+            }
+        });
+
+        jobSystem.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Chunk &chunk = chunks[i];
+                auto resolve = [&](const RawCorner &rawCorner) {
+                    tinyobj::index_t index{};
+                    index.vertex_index = rawCorner.vertexIndex + (rawCorner.relativeMask & RelativeVertex ? static_cast<int>(positionBases[i]) : 0);
+                    index.texcoord_index = rawCorner.texcoordIndex + (rawCorner.relativeMask & RelativeTexcoord ? static_cast<int>(texcoordBases[i]) : 0);
+                    index.normal_index = rawCorner.normalIndex + (rawCorner.relativeMask & RelativeNormal ? static_cast<int>(normalBases[i]) : 0);
+                    if (index.vertex_index < 0 || index.vertex_index >= static_cast<int>(positionCount) ||
+                        index.texcoord_index >= static_cast<int>(texcoordCount) || index.normal_index >= static_cast<int>(normalCount) ||
+                        (rawCorner.relativeMask & RelativeTexcoord && index.texcoord_index < 0) ||
+                        (rawCorner.relativeMask & RelativeNormal && index.normal_index < 0)) {
+                        throw std::runtime_error("Face index out of bounds in OBJ file");
+                    }
+                    return index;
+                };
+
+                tinyobj::index_t *output = corners.data() + cornerBases[i];
+                const RawCorner *input = chunk.corners.data();
+                for (uint8_t faceSize: chunk.faceSizes) {
+                    if (faceSize == 3) {
+                        *output++ = resolve(input[0]);
+                        *output++ = resolve(input[1]);
+                        *output++ = resolve(input[2]);
+                    } else {
+                        //Same diagonal choice as tinyobj: split along the shorter one
+                        tinyobj::index_t quad[4] = {resolve(input[0]), resolve(input[1]), resolve(input[2]), resolve(input[3])};
+                        auto squaredDistance = [&attrib](const tinyobj::index_t &a, const tinyobj::index_t &b) {
+                            const float *pa = &attrib.vertices[3 * a.vertex_index];
+                            const float *pb = &attrib.vertices[3 * b.vertex_index];
+                            float x = pb[0] - pa[0], y = pb[1] - pa[1], z = pb[2] - pa[2];
+                            return x * x + y * y + z * z;
+                        };
+                        if (squaredDistance(quad[0], quad[2]) < squaredDistance(quad[1], quad[3])) {
+                            *output++ = quad[0];
+                            *output++ = quad[1];
+                            *output++ = quad[2];
+                            *output++ = quad[0];
+                            *output++ = quad[2];
+                            *output++ = quad[3];
+                        } else {
+                            *output++ = quad[0];
+                            *output++ = quad[1];
+                            *output++ = quad[3];
+                            *output++ = quad[1];
+                            *output++ = quad[2];
+                            *output++ = quad[3];
+                        }
+                    }
+                    input += faceSize;
+                }
+                chunk.corners = {};
+            }
+        });
+        return true;
+    }
+}
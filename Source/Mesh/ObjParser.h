@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tinyobj {
+    struct attrib_t;
+    struct index_t;
+}
+
+namespace Kaamoo {
+    //Parallel OBJ importer for large files. Produces the same attributes and the same corner order as tinyobj,
+    //so Model::Builder can weld its output exactly like the single threaded path.
+    class ObjParser {
+    public:
+        //Smaller files are parsed by tinyobj. Even as a single chunk on one thread ObjParser reads about 3x faster than
+        //tinyobj (Benchmarks/ObjParserBenchmark), so only the few kilobyte meshes where the job overhead shows stay on tinyobj
+        inline static const size_t ParallelThreshold = 64 * 1024;
+
+        //Returns false if the file uses something only tinyobj reproduces, e.g. polygons with more than 4 vertices.
+        //Throws std::runtime_error on malformed indices.
+        static bool Parse(const uint8_t *data, size_t size, tinyobj::attrib_t &attrib, std::vector<tinyobj::index_t> &corners);
+
+    private:
+        inline static const size_t MinChunkSize = 1024 * 1024;
+
+        struct RawCorner {
+            int vertexIndex;
+            int texcoordIndex;
+            int normalIndex;
+            //Bit per index that was negative in the file and is still relative to the chunk's first element
+            uint8_t relativeMask;
+        };
+
+        struct Chunk {
+            const char *begin;
+            const char *end;
+            std::vector<float> positions;
+            std::vector<float> colors;
+            std::vector<float> normals;
+            std::vector<float> texcoords;
+            std::vector<RawCorner> corners;
+            std::vector<uint8_t> faceSizes;
+            size_t triangleCount = 0;
+            bool unsupported = false;
+            std::string error;
+        };
+
+        static void parseChunk(Chunk &chunk);
+
+        static bool parseFloat(const char *&cursor, const char *end, float &value);
+
+        static bool parseCorner(const char *&cursor, const char *end, const Chunk &chunk, RawCorner &corner);
+    };
+}
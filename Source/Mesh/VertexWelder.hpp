@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include "../Model.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace Kaamoo {
+    //Flat open addressing table that merges vertices whose quantized attributes are equal
+    class VertexWelder {
+    public:
+        enum class Mode {
+            //Position, color, normal and uv must all match, keeps uv and normal seams intact
+            AllAttributes,
+            //Only positions must match, used to find every corner sharing a point for smoothed normals
+            PositionOnly
+        };
+
+        inline static const float PositionStep = 1e-5f;
+        inline static const float NormalStep = 1e-4f;
+        inline static const float ColorStep = 1.0f / 1024.0f;
+        inline static const float UvStep = 1e-5f;
+
+        explicit VertexWelder(Mode mode, size_t expectedVertexCount = 0) : m_mode(mode) {
+            size_t capacity = 16;
+            while (capacity < expectedVertexCount * 2) capacity <<= 1;
+            m_slots.assign(capacity, EmptySlot);
+            m_entries.reserve(expectedVertexCount);
+        }
+
+        //Returns the value stored for an equal vertex, or stores newValue and returns it if there is none
+        uint32_t FindOrInsert(const Model::Vertex &vertex, uint32_t newValue, bool &inserted) {
+            Key key = makeKey(vertex);
+            uint64_t hash = hashKey(key);
+            size_t mask = m_slots.size() - 1;
+            for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+                uint32_t entryIndex = m_slots[slot];
+                if (entryIndex == EmptySlot) {
+                    m_slots[slot] = static_cast<uint32_t>(m_entries.size());
+                    m_entries.push_back({key, hash, newValue});
+                    inserted = true;
+                    if (m_entries.size() * 2 > m_slots.size()) grow();
+                    return newValue;
+                }
+                const Entry &entry = m_entries[entryIndex];
+                if (entry.hash == hash && entry.key == key) {
+                    inserted = false;
+                    return entry.value;
+                }
+            }
+        }
+
+        size_t Size() const { return m_entries.size(); }
+
+    private:
+        inline static const uint32_t EmptySlot = ~0u;
+
+        struct Key {
+            int64_t position[3];
+            int32_t color[3];
+            int32_t normal[3];
+            int32_t uv[2];
+
+            bool operator==(const Key &other) const {
+                return std::memcmp(this, &other, sizeof(Key)) == 0;
+            }
+        };
+
+        struct Entry {
+            Key key;
+            uint64_t hash;
+            uint32_t value;
+        };
+
+        static int32_t quantize(float value, float step) {
+            return static_cast<int32_t>(std::lround(value / step));
+        }
+
+        Key makeKey(const Model::Vertex &vertex) const {
+            Key key{};
+            for (int i = 0; i < 3; i++) {
+                key.position[i] = std::llround(static_cast<double>(vertex.position[i]) / PositionStep);
+            }
+            if (m_mode == Mode::AllAttributes) {
+                for (int i = 0; i < 3; i++) {
+                    key.color[i] = quantize(vertex.color[i], ColorStep);
+                    key.normal[i] = quantize(vertex.normal[i], NormalStep);
+                }
+                key.uv[0] = quantize(vertex.uv.x, UvStep);
+                key.uv[1] = quantize(vertex.uv.y, UvStep);
+            }
+            return key;
+        }
+
+        static uint64_t hashKey(const Key &key) {
+            uint64_t hash = 0x9E3779B97F4A7C15ULL;
+            auto mix = [&hash](uint64_t value) {
+                hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            };
+            for (int64_t value: key.position) mix(static_cast<uint64_t>(value));
+            for (int32_t value: key.color) mix(static_cast<uint32_t>(value));
+            for (int32_t value: key.normal) mix(static_cast<uint32_t>(value));
+            for (int32_t value: key.uv) mix(static_cast<uint32_t>(value));
+            //Finalizer from splitmix64, linear probing needs well spread low bits
+            hash ^= hash >> 30;
+            hash *= 0xBF58476D1CE4E5B9ULL;
+            hash ^= hash >> 27;
+            hash *= 0x94D049BB133111EBULL;
+            hash ^= hash >> 31;
+            return hash;
+        }
+
+        void grow() {
+            m_slots.assign(m_slots.size() * 2, EmptySlot);
+            size_t mask = m_slots.size() - 1;
+            for (uint32_t entryIndex = 0; entryIndex < m_entries.size(); entryIndex++) {
+                size_t slot = m_entries[entryIndex].hash & mask;
+                while (m_slots[slot] != EmptySlot) slot = (slot + 1) & mask;
+                m_slots[slot] = entryIndex;
+            }
+        }
+
+        Mode m_mode;
+        std::vector<uint32_t> m_slots;
+        std::vector<Entry> m_entries;
+    };
+}
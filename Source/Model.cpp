@@ -1,4 +1,6 @@
 ﻿#include "Model.hpp"
+#include "Mesh/ObjParser.h"
+#include "Utils/JobSystem.h"
 
 //引用tiny obj loader库读取模型
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -6,195 +8,446 @@
 #include "../External/tiny_obj_loader.h"
 #include <iostream>
 #include "Untils.h"
+#include "Mesh/VertexWelder.hpp"
+#include "Mesh/MeshCache.h"
+#include "Mesh/MeshOptimizer.h"
+#include "Mesh/MeshSimplifier.h"
+#include "Mesh/MeshletBuilder.h"
+#include "Utils/MappedFile.h"
+#include "Utils/Profiler.h"
+#include "AssetLoader.h"
+#include "UploadBatcher.h"
 #include <unordered_map>
-
-#define GLM_ENABLE_EXPERIMENTAL
-
-#include <glm/gtx/hash.hpp>
-
-namespace std {
-    //模板特化
-    template<>
-    struct hash<Kaamoo::Model::Vertex> {
-        //重载哈希函数对象的调用运算符
-        size_t operator()(Kaamoo::Model::Vertex const &vertex) const {
-            size_t seed = 0;
-//            Kaamoo::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-//            Kaamoo::hashCombine(seed, vertex.position);
-//            return seed;
-//            return ((hash<glm::vec3>()(vertex.position) ^
-//                     (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-//                   (hash<glm::vec3>()(vertex.normal) << 1) ^
-//                   (hash<glm::vec2>()(vertex.uv) << 1); 
-            seed = hash<glm::vec3>()(vertex.position);
-            return seed;
-        }
-    };
-}
-
+#include <chrono>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
 
 namespace Kaamoo {
+    std::unique_ptr<Model> Model::createModelFromFile(Device &device, const std::string &filePath) {
+        auto builder = AssetLoader::GetInstance().GetModelBuilder(filePath);
+        return std::make_unique<Model>(device, *builder);
+    }
+
     Model::Model(Kaamoo::Device &device, const Builder &builder) : device{device} {
         static uint32_t modelIndex = 0;
         indexReference = modelIndex++;
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
-        m_vertices = builder.vertices;
-        m_indices = builder.indices;
+        if (builder.cooked != nullptr) {
+            m_cooked = builder.cooked;
+            createBuffersFromCooked(*m_cooked);
+        } else {
+            createVertexBuffers(builder.vertices);
+            createIndexBuffers(builder.indices, builder.lodIndices);
+            m_vertices = builder.vertices;
+            m_indices = builder.indices;
+        }
         m_maxRadius = builder.maxRadius;
+        m_boundsMin = builder.boundsMin;
+        m_boundsMax = builder.boundsMax;
+        m_lods = builder.lods;
+        if (m_lods.empty()) {
+            m_lods.push_back({0, indexCount, 0.0f});
+        }
+        m_meshlets = builder.meshlets;
+        if (!m_meshlets.empty()) {
+            uint32_t meshletSize = sizeof(Meshlet);
+            uint32_t meshletCount = static_cast<uint32_t>(m_meshlets.size());
+            m_meshletBuffer = std::make_unique<Buffer>(device, meshletSize, meshletCount,
+                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            device.uploadBatcher().uploadBuffer(m_meshletBuffer->getBuffer(), m_meshlets.data(), meshletSize * meshletCount);
+        }
     }
 
-    void Model::draw(VkCommandBuffer commandBuffer) {
+    void Model::draw(VkCommandBuffer commandBuffer, uint32_t lodIndex) {
         if (hasIndexBuffer) {
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+            const LodLevel &lod = m_lods[std::min(lodIndex, static_cast<uint32_t>(m_lods.size() - 1))];
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.indexOffset, 0, 0);
         } else {
             vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
         }
     }
 
+    void Model::drawClusters(VkCommandBuffer commandBuffer, const ClusterDraw &clusterDraw) {
+        vkCmdDrawIndexedIndirectCount(commandBuffer, clusterDraw.drawBuffer, clusterDraw.drawOffset, clusterDraw.countBuffer,
+                                      clusterDraw.countOffset, clusterDraw.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
     void Model::bind(VkCommandBuffer commandBuffer) {
-        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+        VkBuffer buffers[] = {positionBuffer->getBuffer(), attributeBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+        if (hasIndexBuffer) {
+            vkCmdBindIndexBuffer(commandBuffer, rasterIndexBuffer->getBuffer(), 0, rasterIndexType);
+        }
+    }
+
+    void Model::bindPositions(VkCommandBuffer commandBuffer) {
+        VkBuffer buffers[] = {positionBuffer->getBuffer()};
         VkDeviceSize offsets[] = {0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
         if (hasIndexBuffer) {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, rasterIndexBuffer->getBuffer(), 0, rasterIndexType);
         }
     }
 
-    void Model::createIndexBuffers(const std::vector<uint32_t> &indices) {
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffer = !indices.empty();
-        if (!hasIndexBuffer)return;
+    void Model::RefreshVertexBuffer(const std::vector<Vertex> &vertices) {
+        vertexCount = static_cast<uint32_t>(vertices.size());
 
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-        uint32_t indexSize = sizeof(indices[0]);
+        std::vector<PackedPosition> positions(vertices.size());
+        std::vector<PackedAttributes> attributes(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            PackedVertex packed = PackedVertex::pack(vertices[i]);
+            positions[i] = packed.position;
+            attributes[i] = packed.attributes;
+        }
 
-        Buffer stagingBuffer(device, indexSize, indexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) indices.data());
+        //Copied into the staging ring right away, the GPU copy runs with the next batch
+        auto upload = [&](const void *data, uint32_t elementSize, Buffer &target) {
+            device.uploadBatcher().uploadBuffer(target.getBuffer(), data, static_cast<VkDeviceSize>(elementSize) * vertexCount);
+        };
+        upload(positions.data(), sizeof(PackedPosition), *positionBuffer);
+        upload(attributes.data(), sizeof(PackedAttributes), *attributeBuffer);
 #ifdef RAY_TRACING
-        indexBuffer = std::make_unique<Buffer>(
-                device, indexSize, indexCount,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags,
+        upload(vertices.data(), sizeof(Vertex), *vertexBuffer);
+#endif
+    }
+
+    void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
+        vertexCount = static_cast<uint32_t>(vertices.size());
+        allocateVertexBuffers();
+        RefreshVertexBuffer(vertices);
+    }
+
+    void Model::allocateVertexBuffers() {
+        assert(vertexCount >= 3 && "vertex count must be at least 3");
+
+        positionBuffer = std::make_unique<Buffer>(
+                device, sizeof(PackedPosition), vertexCount,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+        attributeBuffer = std::make_unique<Buffer>(
+                device, sizeof(PackedAttributes), vertexCount,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
-#else
-        indexBuffer = std::make_unique<Buffer>(
-                device, indexSize, indexCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+#ifdef RAY_TRACING
+        vertexBuffer = std::make_unique<Buffer>(
+                device, sizeof(Vertex), vertexCount,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT | rayTracingFlags,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 #endif
+    }
+
+    std::unique_ptr<Buffer> Model::createUploadedBuffer(const void *data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage) {
+        auto buffer = std::make_unique<Buffer>(device, elementSize, elementCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        device.uploadBatcher().uploadBuffer(buffer->getBuffer(), data, static_cast<VkDeviceSize>(elementSize) * elementCount);
+        return buffer;
+    }
+
+    void Model::createIndexBuffers(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &lodIndices) {
+        indexCount = static_cast<uint32_t>(indices.size());
+        hasIndexBuffer = !indices.empty();
+        if (!hasIndexBuffer)return;
+
+        //Coarser LODs follow the full resolution indices in the raster index buffer
+        std::vector<uint32_t> rasterIndices(indices);
+        rasterIndices.insert(rasterIndices.end(), lodIndices.begin(), lodIndices.end());
+        uint32_t rasterIndexCount = static_cast<uint32_t>(rasterIndices.size());
+
+        if (UsesShortIndices(vertexCount)) {
+            std::vector<uint16_t> shortIndices(rasterIndices.begin(), rasterIndices.end());
+            rasterIndexBuffer = createUploadedBuffer(shortIndices.data(), sizeof(uint16_t), rasterIndexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            rasterIndexType = VK_INDEX_TYPE_UINT16;
+        } else {
+            rasterIndexBuffer = createUploadedBuffer(rasterIndices.data(), sizeof(uint32_t), rasterIndexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            rasterIndexType = VK_INDEX_TYPE_UINT32;
+        }
+
+#ifdef RAY_TRACING
+        //BLAS builds and the closest hit shader only see the full resolution mesh
+        indexBuffer = createUploadedBuffer(indices.data(), sizeof(uint32_t), indexCount, rayTracingFlags);
+#endif
+    }
+
+    void Model::createBuffersFromCooked(const CookedStreams &cooked) {
+        //Straight from the mapping into the staging ring, the packing was done when the mesh was cooked
+        vertexCount = cooked.vertexCount;
+        allocateVertexBuffers();
+        auto &uploadBatcher = device.uploadBatcher();
+        uploadBatcher.uploadBuffer(positionBuffer->getBuffer(), cooked.positions, static_cast<VkDeviceSize>(sizeof(PackedPosition)) * vertexCount);
+        uploadBatcher.uploadBuffer(attributeBuffer->getBuffer(), cooked.attributes, static_cast<VkDeviceSize>(sizeof(PackedAttributes)) * vertexCount);
+#ifdef RAY_TRACING
+        uploadBatcher.uploadBuffer(vertexBuffer->getBuffer(), cooked.vertices, static_cast<VkDeviceSize>(sizeof(Vertex)) * vertexCount);
+#endif
+
+        indexCount = cooked.indexCount;
+        hasIndexBuffer = indexCount > 0;
+        if (!hasIndexBuffer)return;
+
+        if (UsesShortIndices(vertexCount)) {
+            rasterIndexBuffer = createUploadedBuffer(cooked.rasterIndices, sizeof(uint16_t), cooked.rasterIndexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            rasterIndexType = VK_INDEX_TYPE_UINT16;
+        } else {
+            rasterIndexBuffer = createUploadedBuffer(cooked.rasterIndices, sizeof(uint32_t), cooked.rasterIndexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            rasterIndexType = VK_INDEX_TYPE_UINT32;
+        }
+#ifdef RAY_TRACING
+        indexBuffer = createUploadedBuffer(cooked.indices, sizeof(uint32_t), indexCount, rayTracingFlags);
+#endif
+    }
+
+    void Model::loadCpuCopies() {
+        if (m_cooked == nullptr) return;
+        //Physics may ask from its own thread
+        std::call_once(m_cpuCopiesLoaded, [this]() {
+            m_vertices.resize(m_cooked->vertexCount);
+            std::memcpy(m_vertices.data(), m_cooked->vertices, m_vertices.size() * sizeof(Vertex));
+            m_indices.resize(m_cooked->indexCount);
+            std::memcpy(m_indices.data(), m_cooked->indices, m_indices.size() * sizeof(uint32_t));
+        });
+    }
+
+    Model::PackedVertex Model::PackedVertex::pack(const Vertex &vertex) {
+        PackedVertex packed{};
+        packed.position.position[0] = glm::packHalf1x16(vertex.position.x);
+        packed.position.position[1] = glm::packHalf1x16(vertex.position.y);
+        packed.position.position[2] = glm::packHalf1x16(vertex.position.z);
+        packed.position.position[3] = glm::packHalf1x16(1.0f);
+
+        auto encodeOctahedral = [](glm::vec3 n, int16_t out[2]) {
+            float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            glm::vec2 p = length > 0.0f ? glm::vec2(n.x, n.y) / length : glm::vec2(0.0f);
+            if (n.z < 0.0f) {
+                p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) *
+                    glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+            }
+            out[0] = static_cast<int16_t>(std::round(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f));
+            out[1] = static_cast<int16_t>(std::round(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f));
+        };
+        encodeOctahedral(vertex.normal, packed.attributes.normal);
+        encodeOctahedral(vertex.smoothedNormal, packed.attributes.smoothedNormal);
 
-        device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        packed.attributes.uv[0] = glm::packHalf1x16(vertex.uv.x);
+        packed.attributes.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+        for (int i = 0; i < 3; ++i) {
+            packed.attributes.color[i] = static_cast<uint8_t>(std::round(glm::clamp(vertex.color[i], 0.0f, 1.0f) * 255.0f));
+        }
+        packed.attributes.color[3] = 255;
+        return packed;
     }
 
-    std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> Model::PackedPosition::getBindingDescriptions() {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
         bindingDescriptions[0].binding = 0;
         bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        bindingDescriptions[0].stride = sizeof(Vertex);
+        bindingDescriptions[0].stride = sizeof(PackedPosition);
         return bindingDescriptions;
     }
 
-    std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> Model::PackedPosition::getAttributeDescriptions() {
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(PackedPosition, position)});
+        return attributeDescriptions;
+    }
+
+    std::vector<VkVertexInputBindingDescription> Model::PackedVertex::getBindingDescriptions() {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions = PackedPosition::getBindingDescriptions();
+        VkVertexInputBindingDescription attributeBinding{};
+        attributeBinding.binding = 1;
+        attributeBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        attributeBinding.stride = sizeof(PackedAttributes);
+        bindingDescriptions.push_back(attributeBinding);
+        return bindingDescriptions;
+    }
 
-        //position,color,normal,uv
-        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0});
-        attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-        attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-        attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, smoothedNormal)});
-        attributeDescriptions.push_back({4, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+    std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::getAttributeDescriptions() {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions = PackedPosition::getAttributeDescriptions();
+
+        //color,normal,smoothedNormal,uv
+        attributeDescriptions.push_back({1, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedAttributes, color)});
+        attributeDescriptions.push_back({2, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedAttributes, normal)});
+        attributeDescriptions.push_back({3, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedAttributes, smoothedNormal)});
+        attributeDescriptions.push_back({4, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedAttributes, uv)});
 
         return attributeDescriptions;
     }
 
     void Model::Builder::loadModel(const std::string &filePath) {
+        PROFILE_SCOPE("Model::Builder::loadModel");
+#ifdef ASSET_STATISTICS
+        auto startTime = std::chrono::high_resolution_clock::now();
+#endif
         tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())) {
-            throw std::runtime_error(warn + err);
-        }
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-        for (const auto &shape: shapes) {
-            for (int i = 0; i < shape.mesh.indices.size(); i++) {
-                const auto &index = shape.mesh.indices[i];
-
-                Vertex vertex{};
-
-                if (index.vertex_index >= 0) {
-                    vertex.position = {
-                            attrib.vertices[3 * index.vertex_index + 0],
-                            attrib.vertices[3 * index.vertex_index + 1],
-                            attrib.vertices[3 * index.vertex_index + 2]
-                    };
-                    maxRadius = std::max(maxRadius, glm::length(vertex.position));
-                    
-                    vertex.color = {
-                            attrib.colors[3 * index.vertex_index + 0],
-                            attrib.colors[3 * index.vertex_index + 1],
-                            attrib.colors[3 * index.vertex_index + 2],
-                    };
-                }
-
-                if (index.normal_index >= 0) {
-                    vertex.normal = {
-                            attrib.normals[3 * index.normal_index + 0],
-                            attrib.normals[3 * index.normal_index + 1],
-                            attrib.normals[3 * index.normal_index + 2]
-                    };
-                }
-
-                if (i % 3 == 2) {
-                    auto idx0 = shape.mesh.indices[i - 2];
-                    auto idx1 = shape.mesh.indices[i - 1];
-                    auto idx2 = shape.mesh.indices[i];
-
-                    glm::vec3 v0 = glm::vec3(
-                            attrib.vertices[3 * idx0.vertex_index + 0],
-                            attrib.vertices[3 * idx0.vertex_index + 1],
-                            attrib.vertices[3 * idx0.vertex_index + 2]
-                    );
-                    glm::vec3 v1 = glm::vec3(
-                            attrib.vertices[3 * idx1.vertex_index + 0],
-                            attrib.vertices[3 * idx1.vertex_index + 1],
-                            attrib.vertices[3 * idx1.vertex_index + 2]
-                    );
-                    glm::vec3 v2 = glm::vec3(
-                            attrib.vertices[3 * idx2.vertex_index + 0],
-                            attrib.vertices[3 * idx2.vertex_index + 1],
-                            attrib.vertices[3 * idx2.vertex_index + 2]
-                    );
-
-                    glm::vec3 faceNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-
-                    auto back = indices.size() - 1;
-                    vertices[indices[back - 1]].smoothedNormal += faceNormal;
-                    vertices[indices[back]].smoothedNormal += faceNormal;
-                    vertex.smoothedNormal += faceNormal;
-                }
-
-                if (index.texcoord_index >= 0) {
-                    vertex.uv = {
-                            attrib.texcoords[2 * index.texcoord_index + 0],
-                            attrib.texcoords[2 * index.texcoord_index + 1],
-                    };
-                }
-
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
+        std::vector<tinyobj::index_t> corners;
+
+        size_t fileSize = 0;
+        bool parsedInParallel = false;
+        {
+            MappedFile source(filePath);
+            fileSize = source.size();
+            if (source.data() != nullptr && fileSize >= ObjParser::ParallelThreshold) {
+                parsedInParallel = ObjParser::Parse(source.data(), fileSize, attrib, corners);
+            }
+        }
+
+        if (!parsedInParallel) {
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn, err;
+
+            attrib = tinyobj::attrib_t{};
+            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())) {
+                throw std::runtime_error(warn + err);
+            }
+            corners.clear();
+            for (const auto &shape: shapes) {
+                corners.insert(corners.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+            }
+        }
+#ifdef ASSET_STATISTICS
+        float parseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+#endif
+
+        VertexWelder welder(VertexWelder::Mode::AllAttributes, corners.size() / 2);
+        vertices.reserve(corners.size() / 2);
+        indices.reserve(corners.size());
+
+        for (const auto &index: corners) {
+            Vertex vertex{};
+
+            if (index.vertex_index >= 0) {
+                vertex.position = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]
+                };
+                maxRadius = std::max(maxRadius, glm::length(vertex.position));
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+
+                vertex.color = {
+                        attrib.colors[3 * index.vertex_index + 0],
+                        attrib.colors[3 * index.vertex_index + 1],
+                        attrib.colors[3 * index.vertex_index + 2],
+                };
+            }
+
+            if (index.normal_index >= 0) {
+                vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                };
             }
+
+            if (index.texcoord_index >= 0) {
+                vertex.uv = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        attrib.texcoords[2 * index.texcoord_index + 1],
+                };
+            }
+
+            bool inserted;
+            uint32_t vertexIndex = welder.FindOrInsert(vertex, static_cast<uint32_t>(vertices.size()), inserted);
+            if (inserted) {
+                vertices.push_back(vertex);
+            }
+            indices.push_back(vertexIndex);
+        }
+
+        computeSmoothedNormals();
+
+#ifdef ASSET_STATISTICS
+        float megabytes = static_cast<float>(fileSize) / (1024.0f * 1024.0f);
+        std::cout << "Parsed " << filePath << ": " << megabytes << " MB in " << parseMilliseconds << " ms ("
+                  << megabytes / std::max(parseMilliseconds, 0.001f) * 1000.0f << " MB/s, "
+                  << (parsedInParallel ? std::to_string(JobSystem::GetInstance().GetConcurrency()) + " threads" : std::string("tinyobj"))
+                  << ")" << std::endl;
+#endif
+    }
+
+    void Model::Builder::computeSmoothedNormals() {
+        //Face normals only need the welded positions, compute them on the pool
+        std::vector<glm::vec3> faceNormals(indices.size() / 3);
+        JobSystem::GetInstance().ParallelFor(faceNormals.size(), 16384, [this, &faceNormals](size_t begin, size_t end) {
+            for (size_t face = begin; face < end; face++) {
+                const glm::vec3 &v0 = vertices[indices[3 * face + 0]].position;
+                const glm::vec3 &v1 = vertices[indices[3 * face + 1]].position;
+                const glm::vec3 &v2 = vertices[indices[3 * face + 2]].position;
+                glm::vec3 faceNormal = glm::cross(v1 - v0, v2 - v0);
+                float length = glm::length(faceNormal);
+                faceNormals[face] = length > 0.0f ? faceNormal / length : glm::vec3(0.0f);
+            }
+        });
+
+        //Corners split by uv or normal seams still share one smoothed normal through the position only weld
+        VertexWelder positionWelder(VertexWelder::Mode::PositionOnly, vertices.size());
+        std::vector<uint32_t> positionGroups(vertices.size());
+        uint32_t groupCount = 0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            bool inserted;
+            positionGroups[i] = positionWelder.FindOrInsert(vertices[i], groupCount, inserted);
+            if (inserted) groupCount++;
+        }
+
+        std::vector<glm::vec3> groupNormals(groupCount, glm::vec3(0.0f));
+        for (size_t i = 0; i < indices.size(); i++) {
+            groupNormals[positionGroups[indices[i]]] += faceNormals[i / 3];
         }
-        
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const glm::vec3 &groupNormal = groupNormals[positionGroups[i]];
+            float length = glm::length(groupNormal);
+            vertices[i].smoothedNormal = length > 0.0f ? groupNormal / length : glm::vec3(0.0f);
+        }
+    }
+
+    void Model::Builder::loadCached(const std::string &filePath) {
+        PROFILE_SCOPE("Model::Builder::loadCached");
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto elapsedMilliseconds = [&startTime]() {
+            return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        };
+
+        uint64_t sourceHash;
+        {
+            MappedFile source(filePath);
+            if (!source.isValid()) {
+                throw std::runtime_error("Failed to open model: " + filePath);
+            }
+            sourceHash = MeshCache::HashBytes(source.data(), source.size());
+        }
+
+        std::string cookedPath = MeshCache::GetCookedPath(filePath);
+        float cookMilliseconds = 0;
+        if (MeshCache::TryLoad(cookedPath, sourceHash, *this, cookMilliseconds)) {
+#ifdef ASSET_STATISTICS
+            std::cout << "Loaded cooked mesh " << filePath << " in " << elapsedMilliseconds() << " ms (cold OBJ import: "
+                      << cookMilliseconds << " ms)" << std::endl;
+#endif
+            return;
+        }
+
+        Profiler::GetInstance().MarkCold("Cooked mesh " + filePath);
+        loadModel(filePath);
+        if (optimize) {
+            MeshOptimizer::Optimize(*this, filePath);
+        }
+        if (buildMeshlets) {
+            MeshletBuilder::Build(*this, filePath);
+        }
+        if (generateLods) {
+            MeshSimplifier::GenerateLods(*this, filePath);
+        }
+        cookMilliseconds = elapsedMilliseconds();
+        MeshCache::Save(cookedPath, sourceHash, *this, cookMilliseconds);
+#ifdef ASSET_STATISTICS
+        std::cout << "Imported " << filePath << " from OBJ in " << cookMilliseconds << " ms, cooked to " << cookedPath << std::endl;
+#endif
     }
 }
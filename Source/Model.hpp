@@ -5,8 +5,12 @@
 #include <memory>
 #include <iostream>
 #include <unordered_map>
+#include <limits>
+#include <mutex>
 
 namespace Kaamoo {
+    class MappedFile;
+
     class Model {
     public:
 
@@ -26,34 +30,133 @@ namespace Kaamoo {
             alignas(16) glm::vec3 smoothedNormal = glm::vec3(0.0f);
             alignas(16) glm::vec2 uv;
 
+            bool operator==(const Vertex &other) const {
+                return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
+            }
+        };
+
+        //Binding 0 of the raster pipelines, the only stream shadow and stencil passes fetch
+        struct PackedPosition {
+            //Half floats, w is always 1
+            uint16_t position[4];
+
             static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 
             static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        };
+        static_assert(sizeof(PackedPosition) == 8, "PackedPosition must stay 8 bytes");
+
+        //Binding 1 of the raster pipelines
+        struct PackedAttributes {
+            //Octahedral encoded, snorm16
+            int16_t normal[2];
+            int16_t smoothedNormal[2];
+            //Half floats
+            uint16_t uv[2];
+            uint8_t color[4];
+        };
+        static_assert(sizeof(PackedAttributes) == 16, "PackedAttributes must stay 16 bytes");
 
-            bool operator==(const Vertex &other) const {
-//                return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
-                return position == other.position;
-            }
+        //Compact vertex read by the raster pipelines, 24 bytes over two streams instead of the 80 bytes of Vertex
+        struct PackedVertex {
+            PackedPosition position;
+            PackedAttributes attributes;
+
+            static PackedVertex pack(const Vertex &vertex);
+
+            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+
+            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        };
+
+        //One level of detail, a range of the raster index buffer that reuses the shared vertices
+        struct LodLevel {
+            uint32_t indexOffset;
+            uint32_t indexCount;
+            //Simplification error relative to the model radius
+            float error;
+        };
+
+        //Cluster of at most MeshletBuilder::MaxVertices vertices and MaxTriangles triangles, laid out like the culling shader reads it
+        struct Meshlet {
+            //Bounding sphere in object space, xyz center and w radius
+            glm::vec4 sphere;
+            //Normal cone, xyz axis and w cutoff, a cutoff of 1 never culls
+            glm::vec4 cone;
+            //Range of the full resolution indices
+            uint32_t indexOffset;
+            uint32_t indexCount;
+            uint32_t padding[2];
+        };
+        static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout in MeshletCull.comp");
+
+        //Indirect draws written by the meshlet culling pass for one object this frame
+        struct ClusterDraw {
+            VkBuffer drawBuffer = VK_NULL_HANDLE;
+            VkDeviceSize drawOffset = 0;
+            VkBuffer countBuffer = VK_NULL_HANDLE;
+            VkDeviceSize countOffset = 0;
+            uint32_t maxDrawCount = 0;
+        };
+
+        //GPU ready data of a cooked mesh, pointing into the mapped .kmesh that file keeps alive.
+        //Vertices and indices hold vertexCount Vertex and indexCount uint32, the rest follows the PackedVertex streams
+        struct CookedStreams {
+            std::shared_ptr<const MappedFile> file;
+            const uint8_t *vertices = nullptr;
+            uint32_t vertexCount = 0;
+            const uint8_t *indices = nullptr;
+            uint32_t indexCount = 0;
+            const uint8_t *positions = nullptr;
+            const uint8_t *attributes = nullptr;
+            //Full resolution indices followed by the coarser LODs, uint16 when UsesShortIndices(vertexCount)
+            const uint8_t *rasterIndices = nullptr;
+            uint32_t rasterIndexCount = 0;
         };
 
         struct Builder {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            //lods[0] is the full resolution mesh in indices, coarser levels index into lodIndices placed after it
+            std::vector<LodLevel> lods{};
+            std::vector<uint32_t> lodIndices{};
+            //Clusters over the full resolution indices, only built for large meshes
+            std::vector<Meshlet> meshlets{};
             float maxRadius = 0.0f;
+            glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+            glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+            //Run the vertex cache, overdraw and vertex fetch optimisation after importing
+            bool optimize = true;
+            //Build the LOD chain with MeshSimplifier after importing
+            bool generateLods = true;
+            //Partition large meshes into meshlets for GPU cluster culling
+            bool buildMeshlets = true;
+            //Set instead of vertices and indices when loadCached hit the cooked mesh
+            std::shared_ptr<const CookedStreams> cooked;
             void loadModel(const std::string &filePath);
+            //Averages face normals over every vertex sharing a position, ignoring uv and normal seams
+            void computeSmoothedNormals();
+            //Loads the cooked mesh of filePath, re-cooks it from the OBJ when it is missing or stale
+            void loadCached(const std::string &filePath);
         };
 
-        static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &filePath) {
-            Builder builder;
-            builder.loadModel(filePath);
-            return std::make_unique<Model>(device, builder);
-        }
+        //Uses the builder AssetLoader prefetched for filePath when there is one
+        static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &filePath);
+
+        //Small meshes index with uint16 in the raster index buffer, halving index fetch bandwidth
+        static bool UsesShortIndices(uint32_t vertexCount) { return vertexCount <= std::numeric_limits<uint16_t>::max(); }
 
         Model(Device &device, const Builder &builder);
 
         void bind(VkCommandBuffer commandBuffer);
 
-        void draw(VkCommandBuffer commandBuffer);
+        //Binds the position stream alone, for pipelines built with PackedPosition descriptions
+        void bindPositions(VkCommandBuffer commandBuffer);
+
+        void draw(VkCommandBuffer commandBuffer, uint32_t lodIndex = 0);
+
+        //Draws the meshlets that survived culling, the count comes from the GPU
+        void drawClusters(VkCommandBuffer commandBuffer, const ClusterDraw &clusterDraw);
 
         std::unique_ptr<Buffer> &getVertexBuffer() { return vertexBuffer; }
 
@@ -71,58 +174,47 @@ namespace Kaamoo {
 
         std::string GetName() const { return name; }
 
-        std::vector<Vertex> &GetVertices() { return m_vertices; }
+        //Models loaded from a cooked mesh copy these out of the mapping on first use
+        std::vector<Vertex> &GetVertices() {
+            loadCpuCopies();
+            return m_vertices;
+        }
 
-        std::vector<uint32_t> &GetIndices() { return m_indices; }
-        
-        void RefreshVertexBuffer(const std::vector<Vertex> &vertices){
-            vertexCount = static_cast<uint32_t>(vertices.size());
-
-            uint32_t vertexSize = sizeof(vertices[0]);
-            uint32_t bufferSize = vertexSize * vertexCount;
-
-            Buffer stagingBuffer(device, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            stagingBuffer.map();
-            stagingBuffer.writeToBuffer((void *) vertices.data());
-            
-            device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        std::vector<uint32_t> &GetIndices() {
+            loadCpuCopies();
+            return m_indices;
         }
         
-        void createVertexBuffers(const std::vector<Vertex> &vertices){
-            vertexCount = static_cast<uint32_t>(vertices.size());
-
-            assert(vertexCount >= 3 && "vertex count must be at least 3");
-            uint32_t vertexSize = sizeof(vertices[0]);
-            uint32_t bufferSize = vertexSize * vertexCount;
+        void RefreshVertexBuffer(const std::vector<Vertex> &vertices);
 
-            Buffer stagingBuffer(device, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            stagingBuffer.map();
-            stagingBuffer.writeToBuffer((void *) vertices.data());
+        void createVertexBuffers(const std::vector<Vertex> &vertices);
 
-#ifdef RAY_TRACING
-            vertexBuffer = std::make_unique<Buffer>(
-                device, vertexSize, vertexCount,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-#else
-            vertexBuffer = std::make_unique<Buffer>(
-                    device, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-            );
-#endif
-            device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
-        }
-
-        void createIndexBuffers(const std::vector<uint32_t> &indices);
+        void createIndexBuffers(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &lodIndices = {});
         
         float GetMaxRadius() const { return m_maxRadius; }
         
         void SetMaxRadius(float maxRadius) { m_maxRadius = maxRadius; }
 
+        glm::vec3 GetBoundsMin() const { return m_boundsMin; }
+
+        glm::vec3 GetBoundsMax() const { return m_boundsMax; }
+
+        const std::vector<LodLevel> &GetLods() const { return m_lods; }
+
+        const std::vector<Meshlet> &GetMeshlets() const { return m_meshlets; }
+
+        //Storage buffer with GetMeshlets(), null when the model has no meshlets
+        std::unique_ptr<Buffer> &GetMeshletBuffer() { return m_meshletBuffer; }
+
     private:
+        void allocateVertexBuffers();
+
+        std::unique_ptr<Buffer> createUploadedBuffer(const void *data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage);
+
+        //Uploads every stream straight from the mapped cooked mesh
+        void createBuffersFromCooked(const CookedStreams &cooked);
+
+        void loadCpuCopies();
 
 #ifdef RAY_TRACING
         const VkBufferUsageFlags flags = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
@@ -134,6 +226,7 @@ namespace Kaamoo {
         Device &device;
         std::string name;
 
+        //Full Vertex layout and 32 bit indices, read by BLAS builds and the closest hit shader
         std::unique_ptr<Buffer> vertexBuffer;
         uint32_t vertexCount{};
 
@@ -141,11 +234,25 @@ namespace Kaamoo {
         std::unique_ptr<Buffer> indexBuffer;
         uint32_t indexCount{};
 
+        //PackedVertex layout split in two streams, indices are 16 bit when every vertex fits
+        std::unique_ptr<Buffer> positionBuffer;
+        std::unique_ptr<Buffer> attributeBuffer;
+        std::unique_ptr<Buffer> rasterIndexBuffer;
+        VkIndexType rasterIndexType = VK_INDEX_TYPE_UINT32;
+
         uint32_t indexReference;
 
         std::vector<Vertex> m_vertices{};
         std::vector<uint32_t> m_indices{};
         
         float m_maxRadius;
+        glm::vec3 m_boundsMin{};
+        glm::vec3 m_boundsMax{};
+        std::vector<LodLevel> m_lods{};
+        std::vector<Meshlet> m_meshlets{};
+        std::unique_ptr<Buffer> m_meshletBuffer;
+
+        std::shared_ptr<const CookedStreams> m_cooked;
+        std::once_flag m_cpuCopiesLoaded;
     };
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 ﻿#include "Pipeline.hpp"
 #include "Material.hpp"
+#include "Utils/JobSystem.h"
+#include "Utils/Profiler.h"
+#include <algorithm>
+#include <thread>
 
 namespace Kaamoo {
     Pipeline::Pipeline(Device &device, const PipelineConfigureInfo &pipelineConfigureInfo, std::shared_ptr<Material> material)
@@ -25,6 +29,7 @@ namespace Kaamoo {
 #ifdef RAY_TRACING
 
     void Pipeline::createComputePipeline(const Kaamoo::PipelineConfigureInfo &pipelineConfigureInfo) {
+        PROFILE_SCOPE("Pipeline::createComputePipeline");
         VkComputePipelineCreateInfo computePipelineCreateInfo{};
         computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -33,12 +38,13 @@ namespace Kaamoo {
         computePipelineCreateInfo.stage.pName = "main";
         computePipelineCreateInfo.layout = pipelineConfigureInfo.pipelineLayout;
         
-        if (vkCreateComputePipelines(device.device(), VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+        if (vkCreateComputePipelines(device.device(), device.pipelineCache(), 1, &computePipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
             throw std::runtime_error("Creating compute pipeline failed");
         }
     }
 
     void Pipeline::createRayTracingPipeline(const PipelineConfigureInfo &pipelineConfigureInfo) {
+        PROFILE_SCOPE("Pipeline::createRayTracingPipeline");
         //Shader
         uint32_t shaderStageCount = m_material->getShaderModulePointers().size();
         VkPipelineShaderStageCreateInfo shaderStageCreateInfo[shaderStageCount];
@@ -96,7 +102,34 @@ namespace Kaamoo {
         rayTracingPipelineCreateInfo.pGroups = m_rayTracingGroups.data();
         rayTracingPipelineCreateInfo.maxPipelineRayRecursionDepth = 16;
         rayTracingPipelineCreateInfo.layout = pipelineConfigureInfo.pipelineLayout;
-        Device::pfn_vkCreateRayTracingPipelinesKHR(device.device(), VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCreateInfo, nullptr, &m_pipeline);
+
+        //One hit group per material makes this the slowest pipeline by far, so the driver gets to compile it on the worker pool
+        VkDeferredOperationKHR deferredOperation = VK_NULL_HANDLE;
+        if (Device::pfn_vkCreateDeferredOperationKHR(device.device(), nullptr, &deferredOperation) != VK_SUCCESS) {
+            deferredOperation = VK_NULL_HANDLE;
+        }
+        VkResult result = Device::pfn_vkCreateRayTracingPipelinesKHR(device.device(), deferredOperation, device.pipelineCache(), 1, &rayTracingPipelineCreateInfo, nullptr, &m_pipeline);
+        if (result == VK_OPERATION_DEFERRED_KHR) {
+            auto joinUntilDone = [this, deferredOperation]() {
+                VkResult joinResult;
+                while ((joinResult = Device::pfn_vkDeferredOperationJoinKHR(device.device(), deferredOperation)) == VK_THREAD_IDLE_KHR) {
+                    std::this_thread::yield();
+                }
+            };
+            size_t threadCount = std::min<size_t>(JobSystem::GetInstance().GetConcurrency(),
+                                                  std::max(1u, Device::pfn_vkGetDeferredOperationMaxConcurrencyKHR(device.device(), deferredOperation)));
+            JobSystem::GetInstance().ParallelFor(threadCount, 1, [&joinUntilDone](size_t begin, size_t end) { joinUntilDone(); });
+            //VK_THREAD_DONE_KHR only says this thread ran out of work, the last piece may still be finishing elsewhere
+            while ((result = Device::pfn_vkGetDeferredOperationResultKHR(device.device(), deferredOperation)) == VK_NOT_READY) {
+                joinUntilDone();
+            }
+        } else if (result == VK_OPERATION_NOT_DEFERRED_KHR) {
+            result = VK_SUCCESS;
+        }
+        if (deferredOperation != VK_NULL_HANDLE) Device::pfn_vkDestroyDeferredOperationKHR(device.device(), deferredOperation, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Creating ray tracing pipeline failed");
+        }
 
         createShaderBindingTable();
     }
@@ -159,6 +192,7 @@ namespace Kaamoo {
 #endif
 
     void Pipeline::createGraphicsPipeline(const PipelineConfigureInfo &pipelineConfigureInfo) {
+        PROFILE_SCOPE("Pipeline::createGraphicsPipeline");
         //Shader
         uint32_t shaderStageCount = m_material->getShaderModulePointers().size();
         VkPipelineShaderStageCreateInfo shaderStageCreateInfo[shaderStageCount];
@@ -222,7 +256,7 @@ namespace Kaamoo {
         pipelineCreateInfo.basePipelineIndex = -1;
         pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+        if (vkCreateGraphicsPipelines(device.device(), device.pipelineCache(), 1, &pipelineCreateInfo, nullptr,
                                       &m_pipeline) != VK_SUCCESS) {
             throw std::runtime_error("Creating graphics m_pipeline failed");
         }
@@ -303,8 +337,8 @@ namespace Kaamoo {
         configureInfo.dynamicStateCreateInfo.flags = 0;
         configureInfo.dynamicStateCreateInfo.pNext = nullptr;
 
-        configureInfo.vertexBindingDescriptions = Model::Vertex::getBindingDescriptions();
-        configureInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+        configureInfo.vertexBindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+        configureInfo.attributeDescriptions = Model::PackedVertex::getAttributeDescriptions();
     }
 
     void Pipeline::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) {
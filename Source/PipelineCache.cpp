@@ -0,0 +1,97 @@
+﻿#include "PipelineCache.h"
+#include "Device.hpp"
+#include "Utils/Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace Kaamoo {
+    PipelineCache::PipelineCache(Device &device, std::string path) : device{device}, m_path{std::move(path)} {
+        auto initialData = load();
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = initialData.size();
+        createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+        if (vkCreatePipelineCache(device.device(), &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache");
+        }
+        m_loadedSize = initialData.size();
+        if (isWarm()) {
+            std::cout << "Loaded pipeline cache " << m_path << " (" << m_loadedSize / 1024 << " KB)" << std::endl;
+        } else {
+            Profiler::GetInstance().MarkCold("No usable pipeline cache at " + m_path);
+        }
+    }
+
+    PipelineCache::~PipelineCache() {
+        save();
+        vkDestroyPipelineCache(device.device(), m_pipelineCache, nullptr);
+    }
+
+    void PipelineCache::save() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device.device(), m_pipelineCache, &size, nullptr) != VK_SUCCESS || size <= m_loadedSize) return;
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device.device(), m_pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+        data.resize(size);
+
+        //Same temporary file dance as MeshCache::Save
+        std::string tempPath = m_path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Failed to write pipeline cache: " << m_path << std::endl;
+                return;
+            }
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file.good()) {
+                file.close();
+                std::remove(tempPath.c_str());
+                std::cerr << "Failed to write pipeline cache: " << m_path << std::endl;
+                return;
+            }
+        }
+        std::remove(m_path.c_str());
+        if (std::rename(tempPath.c_str(), m_path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            std::cerr << "Failed to write pipeline cache: " << m_path << std::endl;
+            return;
+        }
+        m_loadedSize = data.size();
+        std::cout << "Saved pipeline cache " << m_path << " (" << data.size() / 1024 << " KB)" << std::endl;
+    }
+
+    std::vector<char> PipelineCache::load() const {
+        std::ifstream file(m_path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return {};
+        std::vector<char> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file.good() || !validateHeader(data)) return {};
+        return data;
+    }
+
+    bool PipelineCache::validateHeader(const std::vector<char> &data) const {
+        VkPipelineCacheHeaderVersionOne header{};
+        if (data.size() < sizeof(header)) {
+            std::cout << "Pipeline cache " << m_path << " is truncated, starting cold" << std::endl;
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.headerSize < sizeof(header) || header.headerSize > data.size() || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+            std::cout << "Pipeline cache " << m_path << " has an unknown header, starting cold" << std::endl;
+            return false;
+        }
+        //Drivers are meant to reject foreign data themselves, but not all of them do it gracefully
+        const auto &properties = device.properties;
+        if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+            std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "Pipeline cache " << m_path << " was written by another device or driver, starting cold" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace Kaamoo {
+    class Device;
+
+    //One VkPipelineCache shared by every pipeline, read from disk at startup and written back on shutdown.
+    //Data saved by another driver, GPU or cache version is dropped by checking the header before it reaches the driver
+    class PipelineCache {
+    public:
+        inline static const char *DefaultPath = "pipeline.cache";
+
+        explicit PipelineCache(Device &device, std::string path = DefaultPath);
+
+        //Saves before the cache is destroyed
+        ~PipelineCache();
+
+        PipelineCache(const PipelineCache &) = delete;
+
+        PipelineCache &operator=(const PipelineCache &) = delete;
+
+        VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+
+        //Whether data from a previous run was accepted
+        bool isWarm() const { return m_loadedSize > 0; }
+
+        //Writes the cache when it grew since it was loaded or last saved
+        void save();
+
+    private:
+        //Empty when there is no file or it belongs to another device
+        std::vector<char> load() const;
+
+        bool validateHeader(const std::vector<char> &data) const;
+
+        Device &device;
+        std::string m_path;
+        VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+        size_t m_loadedSize = 0;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Model.hpp"
+#include "../Utils/Profiler.h"
 #ifdef RAY_TRACING
 
 namespace Kaamoo {
@@ -73,6 +74,7 @@ namespace Kaamoo {
             blasInputs.emplace_back(blasInput);
         };
         static void buildBLAS(VkBuildAccelerationStructureFlagsKHR flags) {
+            PROFILE_SCOPE("BLAS::buildBLAS");
             uint32_t blasCount = blasInputs.size();
             VkDeviceSize blasTotalSize = 0;
             uint32_t compactionCount = 0;
@@ -112,14 +114,16 @@ namespace Kaamoo {
                         buildInfos[i]->buildGeometryInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR
                         ? 1 : 0;
             }
-            auto scratchBuffer = new Buffer(
+            //Only needed while building, released once the builds below have finished
+            auto scratchBuffer = std::make_unique<Buffer>(
                     *Device::getDeviceSingleton(),
                     maxScratchSize,
                     1,
                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    1,
+                    MemoryAllocator::Strategy::Linear
             );
-            buffers.emplace_back(scratchBuffer);
             VkDeviceAddress scratchBufferDeviceAddress = scratchBuffer->getDeviceAddress();
 
             VkQueryPool queryPool;
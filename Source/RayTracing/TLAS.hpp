@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "../Utils/Utils.hpp"
 #include "BLAS.hpp"
 
@@ -7,7 +8,8 @@
 namespace Kaamoo {
     class TLAS {
     public:
-        inline static bool shouldUpdate = false;
+        //Set by MeshRendererComponent updates running on the worker pool
+        inline static std::atomic<bool> shouldUpdate{false};
         inline static VkAccelerationStructureKHR tlas{};
 
         static void release() {
@@ -18,7 +20,7 @@ namespace Kaamoo {
         }
 
         static void updateTLAS(id_t tlasId, glm::mat4 translation, uint32_t mask = 0xFF){
-            id_t instanceIndex = tlasIdToInstanceIndexMap[tlasId];
+            id_t instanceIndex = tlasIdToInstanceIndexMap.at(tlasId);
             instances[instanceIndex].transform = Utils::GlmMatrixToVulkanMatrix(translation);
             instances[instanceIndex].mask = mask;
             shouldUpdate = true;
@@ -40,20 +42,21 @@ namespace Kaamoo {
         static void buildTLAS(
                 VkBuildAccelerationStructureFlagBitsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
                 bool update = false, bool motion = false) {
+            PROFILE_SCOPE("TLAS::buildTLAS");
             uint32_t instanceCount = static_cast<uint32_t>(instances.size());
 
             auto device = Device::getDeviceSingleton();
 
             auto commandBuffer = device->beginSingleTimeCommands();
 
-            auto instanceBuffer = new Buffer(
+            //Instance and scratch buffers only live until the build below has finished, updates rebuild every few frames
+            auto instanceBuffer = std::make_unique<Buffer>(
                     *device, sizeof(VkAccelerationStructureInstanceKHR) * instanceCount, 1,
                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
                     VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, MemoryAllocator::Strategy::Linear);
             instanceBuffer->map();
             instanceBuffer->writeToBuffer(instances.data(), sizeof(VkAccelerationStructureInstanceKHR) * instanceCount);
-            buffers.emplace_back(instanceBuffer);
 
             VkBufferDeviceAddressInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
             bufferInfo.buffer = instanceBuffer->getBuffer();
@@ -72,7 +75,8 @@ namespace Kaamoo {
                     0, nullptr
             );
 
-            cmdCreateTLAS(commandBuffer, instanceAddress, flags, update, motion);
+            std::unique_ptr<Buffer> scratchBuffer;
+            cmdCreateTLAS(commandBuffer, instanceAddress, flags, update, motion, scratchBuffer);
 
             device->endSingleTimeCommands(commandBuffer);
         }
@@ -83,7 +87,7 @@ namespace Kaamoo {
         inline static std::unordered_map<id_t, id_t> tlasIdToInstanceIndexMap{};
 
         static void cmdCreateTLAS(VkCommandBuffer &commandBuffer, VkDeviceAddress instanceBufferDeviceAddress,
-                                  VkBuildAccelerationStructureFlagsKHR flags, bool update, bool motion) {
+                                  VkBuildAccelerationStructureFlagsKHR flags, bool update, bool motion, std::unique_ptr<Buffer> &scratchBuffer) {
             VkAccelerationStructureGeometryInstancesDataKHR instancesData{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR};
             instancesData.data.deviceAddress = instanceBufferDeviceAddress;
 
@@ -129,13 +133,14 @@ namespace Kaamoo {
                 );
             }
 
-            auto scratchBuffer = new Buffer(
+            scratchBuffer = std::make_unique<Buffer>(
                     *Device::getDeviceSingleton(),
                     sizeInfo.buildScratchSize, 1,
                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    1,
+                    MemoryAllocator::Strategy::Linear
             );
-            buffers.emplace_back(scratchBuffer);
             VkBufferDeviceAddressInfo bufferDeviceAddressInfo{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
             bufferDeviceAddressInfo.buffer = scratchBuffer->getBuffer();
             VkDeviceAddress scratchBufferDeviceAddress = vkGetBufferDeviceAddress(Device::getDeviceSingleton()->device(), &bufferDeviceAddressInfo);
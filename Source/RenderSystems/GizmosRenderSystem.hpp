@@ -35,7 +35,7 @@ namespace Kaamoo {
                 std::shared_ptr<Model> modelFromFile = Model::createModelFromFile(*Device::getDeviceSingleton(), Model::BaseModelsPath + GIZMOS_MODEL_PATH + axisModelName);
                 Model::models.emplace(axisModelName, modelFromFile);
                 auto *meshRendererComponent = new MeshRendererComponent(modelFromFile, material->getMaterialId());
-                m_axisObjPtr = std::make_shared<GameObject>(std::move(GameObject::createGameObject("Axis")));
+                m_axisObjPtr = std::make_shared<GameObject>(GameObject::createGameObject("Axis"));
                 m_axisObjPtr->TryAddComponent(meshRendererComponent);
                 m_axisObjPtr->transform->SetScale(glm::vec3(0.4f));
                 m_axisMaterial = std::make_shared<Material>(*material);
@@ -61,8 +61,8 @@ namespace Kaamoo {
 //                m_edgeDetectionMaterial->getShaderModulePointers().push_back(std::make_shared<ShaderModule>(shaderBuilder.createShaderModule(geometryShaderPath), ShaderCategory::geometry));
                 m_edgeDetectionMaterial->getShaderModulePointers().push_back(std::make_shared<ShaderModule>(shaderBuilder.createShaderModule(fragmentShaderPath), ShaderCategory::fragment));
 
-                std::string stencilVertexShaderName = "MyShader.vert.spv";
-                const std::string stencilVertexShaderPath = stencilVertexShaderName;
+                std::string stencilVertexShaderName = "edgeDetectionStencil.vert.spv";
+                const std::string stencilVertexShaderPath = GIZMOS_SHADER_PATH + stencilVertexShaderName;
                 m_edgeDetectionStencilMaterial->getShaderModulePointers().push_back(std::make_shared<ShaderModule>(shaderBuilder.createShaderModule(stencilVertexShaderPath), ShaderCategory::vertex));
                 m_edgeDetectionStencilMaterial->getShaderModulePointers().push_back(std::make_shared<ShaderModule>(shaderBuilder.createShaderModule(fragmentShaderPath), ShaderCategory::fragment));
 
@@ -132,6 +132,9 @@ namespace Kaamoo {
                     break;
                 }
                 case GizmosType::EdgeDetectionStencil: {
+                    //Only writes stencil, the position stream is enough
+                    pipelineConfigureInfo.vertexBindingDescriptions = Model::PackedPosition::getBindingDescriptions();
+                    pipelineConfigureInfo.attributeDescriptions = Model::PackedPosition::getAttributeDescriptions();
                     pipelineConfigureInfo.colorBlendAttachment.colorWriteMask = 0;
                     VkStencilOpState front{};
                     front.failOp = VK_STENCIL_OP_ZERO;
@@ -214,8 +217,8 @@ namespace Kaamoo {
                             0,
                             nullptr
                     );
-                    if (frameInfo.gameObjects.find(frameInfo.selectedGameObjectId) != frameInfo.gameObjects.end()) {
-                        auto &selectedGameObject = frameInfo.gameObjects.at(frameInfo.selectedGameObjectId);
+                    if (auto *selectedObject = frameInfo.gameObjects.get(frameInfo.selectedGameObject)) {
+                        auto &selectedGameObject = *selectedObject;
                         MeshRendererComponent *meshRendererComponent;
                         if (selectedGameObject.TryGetComponent<MeshRendererComponent>(meshRendererComponent) && meshRendererComponent->GetModelPtr()) {
                             m_edgeDetectionStencilPipeline->bind(frameInfo.commandBuffer);
@@ -228,7 +231,7 @@ namespace Kaamoo {
                                                0,
                                                sizeof(SimplePushConstantData),
                                                &push);
-                            meshRendererComponent->GetModelPtr()->bind(frameInfo.commandBuffer);
+                            meshRendererComponent->GetModelPtr()->bindPositions(frameInfo.commandBuffer);
                             meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer);
                         };
                     }
@@ -246,8 +249,8 @@ namespace Kaamoo {
                             0,
                             nullptr
                     );
-                    if (frameInfo.gameObjects.find(frameInfo.selectedGameObjectId) != frameInfo.gameObjects.end()) {
-                        auto &selectedGameObject = frameInfo.gameObjects.at(frameInfo.selectedGameObjectId);
+                    if (auto *selectedObject = frameInfo.gameObjects.get(frameInfo.selectedGameObject)) {
+                        auto &selectedGameObject = *selectedObject;
                         MeshRendererComponent *meshRendererComponent;
                         if (selectedGameObject.TryGetComponent<MeshRendererComponent>(meshRendererComponent) && meshRendererComponent->GetModelPtr()) {
                             m_edgeDetectionPipeline->bind(frameInfo.commandBuffer);
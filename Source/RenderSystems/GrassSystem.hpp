@@ -84,11 +84,11 @@ namespace Kaamoo {
 
             GrassPushConstant push{};
             //Todo: Huh?
-            if (moveObject == nullptr && gameObject->GetName() == "Vase") {
-                moveObject = gameObject;
+            if (!moveObject.IsValid() && gameObject->GetName() == "Vase") {
+                moveObject = gameObject->GetHandle();
             }
-            if (moveObject != nullptr)
-                push.vaseModelMatrix = moveObject->transform->mat4();
+            if (auto *_moveObject = frameInfo.gameObjects.get(moveObject))
+                push.vaseModelMatrix = _moveObject->transform->mat4();
             push.modelMatrix = gameObject->transform->mat4();
             vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout,
                                VK_SHADER_STAGE_ALL_GRAPHICS,
@@ -101,7 +101,7 @@ namespace Kaamoo {
             meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer);
         }
 
-        GameObject *moveObject = nullptr;
+        GameObject::Handle moveObject{};
     };
 }
 
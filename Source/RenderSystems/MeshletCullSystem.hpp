@@ -0,0 +1,192 @@
+﻿#pragma once
+
+#include <array>
+#include "../Device.hpp"
+#include "../Descriptor.h"
+#include "../ShaderBuilder.h"
+#include "../SwapChain.hpp"
+#include "../Model.hpp"
+#include "../GameObject.hpp"
+#include "../StructureInfos.h"
+#include "../Mesh/MeshletCuller.h"
+#include "../Components/MeshRendererComponent.hpp"
+
+namespace Kaamoo {
+    //Culls the meshlets of large opaque models by frustum and normal cone on the GPU, the opaque pass then draws the survivors indirectly
+    class MeshletCullSystem {
+    public:
+        //Draw command slots and counters shared by every culled object in one frame
+        inline static const uint32_t MaxDrawCommands = 65536;
+        inline static const uint32_t MaxCulledObjects = 256;
+        inline static const uint32_t GroupSize = 64;
+
+        explicit MeshletCullSystem(Device &device) : device{device} {
+            createBuffers();
+            createDescriptors();
+            createPipeline();
+        }
+
+        ~MeshletCullSystem() {
+            vkDestroyPipeline(device.device(), m_pipeline, nullptr);
+            vkDestroyPipelineLayout(device.device(), m_pipelineLayout, nullptr);
+        }
+
+        MeshletCullSystem(const MeshletCullSystem &) = delete;
+
+        MeshletCullSystem &operator=(const MeshletCullSystem &) = delete;
+
+        //Records the culling dispatches and hands each object its indirect draws, must be recorded outside a render pass
+        void cull(FrameInfo &frameInfo) {
+            auto commandBuffer = frameInfo.commandBuffer;
+            auto frameIndex = frameInfo.frameIndex;
+            auto &drawBuffer = m_drawBuffers[frameIndex];
+            auto &countBuffer = m_countBuffers[frameIndex];
+
+            vkCmdFillBuffer(commandBuffer, countBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+            insertBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+            glm::mat4 projectionView = frameInfo.globalUbo.projectionMatrix * frameInfo.globalUbo.viewMatrix;
+            glm::vec3 cameraPosition = glm::vec3(frameInfo.globalUbo.inverseViewMatrix[3]);
+
+            uint32_t drawOffset = 0;
+            uint32_t countIndex = 0;
+            for (auto &gameObject: frameInfo.gameObjects) {
+                MeshRendererComponent *meshRendererComponent;
+                if (!gameObject.TryGetComponent(meshRendererComponent)) continue;
+                meshRendererComponent->SetClusterDraw({});
+
+                auto model = meshRendererComponent->GetModelPtr();
+                if (!gameObject.IsActive() || model == nullptr || model->GetMeshlets().empty()) continue;
+                if (frameInfo.materials.at(meshRendererComponent->GetMaterialID())->getPipelineCategory() != PipelineCategory.Opaque) continue;
+                //Coarser LODs are cheap enough to draw whole
+                if (meshRendererComponent->GetLodIndex() != 0) continue;
+                glm::mat4 modelMatrix = gameObject.transform->mat4();
+                auto meshletCount = static_cast<uint32_t>(model->GetMeshlets().size());
+                if (countIndex >= MaxCulledObjects || drawOffset + meshletCount > MaxDrawCommands) continue;
+
+                MeshletCuller::CullParameters parameters = MeshletCuller::MakeParameters(projectionView, modelMatrix, cameraPosition);
+                parameters.meshletCount = meshletCount;
+                parameters.drawOffset = drawOffset;
+                parameters.countIndex = countIndex;
+
+                VkDescriptorSet descriptorSet = getDescriptorSet(*model, frameIndex);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+                vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCuller::CullParameters), &parameters);
+                vkCmdDispatch(commandBuffer, (meshletCount + GroupSize - 1) / GroupSize, 1, 1);
+
+                Model::ClusterDraw clusterDraw{};
+                clusterDraw.drawBuffer = drawBuffer->getBuffer();
+                clusterDraw.drawOffset = static_cast<VkDeviceSize>(drawOffset) * sizeof(VkDrawIndexedIndirectCommand);
+                clusterDraw.countBuffer = countBuffer->getBuffer();
+                clusterDraw.countOffset = static_cast<VkDeviceSize>(countIndex) * sizeof(uint32_t);
+                clusterDraw.maxDrawCount = meshletCount;
+                meshRendererComponent->SetClusterDraw(clusterDraw);
+
+                drawOffset += meshletCount;
+                countIndex++;
+            }
+
+            insertBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        }
+
+    private:
+        struct FrameDescriptorSets {
+            std::array<std::shared_ptr<VkDescriptorSet>, SwapChain::MAX_FRAMES_IN_FLIGHT> sets;
+        };
+
+        void createBuffers() {
+            for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+                m_drawBuffers[i] = std::make_unique<Buffer>(
+                        device, sizeof(VkDrawIndexedIndirectCommand), MaxDrawCommands,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                m_countBuffers[i] = std::make_unique<Buffer>(
+                        device, sizeof(uint32_t), MaxCulledObjects,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+        }
+
+        void createDescriptors() {
+            m_descriptorSetLayout = DescriptorSetLayout::Builder(device).
+                    addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT).
+                    addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT).
+                    addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT).
+                    build();
+            uint32_t maxSets = MaxCulledObjects * SwapChain::MAX_FRAMES_IN_FLIGHT;
+            m_descriptorPool = DescriptorPool::Builder(device).
+                    setMaxSets(maxSets).
+                    addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets * 3).
+                    build();
+        }
+
+        void createPipeline() {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(MeshletCuller::CullParameters);
+
+            VkDescriptorSetLayout descriptorSetLayout = m_descriptorSetLayout->getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+            pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutCreateInfo.setLayoutCount = 1;
+            pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+            pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+            pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+            if (vkCreatePipelineLayout(device.device(), &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create meshlet culling pipeline layout");
+            }
+
+            ShaderBuilder shaderBuilder(device);
+            auto shaderModule = shaderBuilder.createShaderModule("Compute/MeshletCull.comp.spv");
+            VkComputePipelineCreateInfo computePipelineCreateInfo{};
+            computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            computePipelineCreateInfo.stage.module = *shaderModule;
+            computePipelineCreateInfo.stage.pName = "main";
+            computePipelineCreateInfo.layout = m_pipelineLayout;
+            VkResult result = vkCreateComputePipelines(device.device(), device.pipelineCache(), 1, &computePipelineCreateInfo, nullptr, &m_pipeline);
+            vkDestroyShaderModule(device.device(), *shaderModule, nullptr);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to create meshlet culling pipeline");
+            }
+        }
+
+        //One set per model and frame in flight, written the first time the model is culled
+        VkDescriptorSet getDescriptorSet(Model &model, int frameIndex) {
+            auto &frameSets = m_descriptorSets[&model];
+            auto &set = frameSets.sets[frameIndex];
+            if (set == nullptr) {
+                set = std::make_shared<VkDescriptorSet>();
+                DescriptorWriter(m_descriptorSetLayout, *m_descriptorPool).
+                        writeBuffer(0, model.GetMeshletBuffer()->descriptorInfo()).
+                        writeBuffer(1, m_drawBuffers[frameIndex]->descriptorInfo()).
+                        writeBuffer(2, m_countBuffers[frameIndex]->descriptorInfo()).
+                        build(set);
+            }
+            return *set;
+        }
+
+        static void insertBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags sourceStage, VkAccessFlags sourceAccess,
+                                  VkPipelineStageFlags destinationStage, VkAccessFlags destinationAccess) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = sourceAccess;
+            barrier.dstAccessMask = destinationAccess;
+            vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        Device &device;
+        VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
+        std::shared_ptr<DescriptorSetLayout> m_descriptorSetLayout;
+        std::unique_ptr<DescriptorPool> m_descriptorPool;
+        std::unordered_map<Model *, FrameDescriptorSets> m_descriptorSets;
+        std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_drawBuffers;
+        std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_countBuffers;
+    };
+}
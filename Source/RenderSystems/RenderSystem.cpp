@@ -119,8 +119,14 @@ namespace Kaamoo {
                                &push);
             MeshRendererComponent *meshRendererComponent;
             if (!gameObject->TryGetComponent(meshRendererComponent)) return;
+            uint32_t lodIndex = meshRendererComponent->GetLodIndex();
             meshRendererComponent->GetModelPtr()->bind(frameInfo.commandBuffer);
-            meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer);
+            const auto &clusterDraw = meshRendererComponent->GetClusterDraw();
+            if (lodIndex == 0 && clusterDraw.drawBuffer != VK_NULL_HANDLE) {
+                meshRendererComponent->GetModelPtr()->drawClusters(frameInfo.commandBuffer, clusterDraw);
+            } else {
+                meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer, lodIndex);
+            }
         }
     }
 
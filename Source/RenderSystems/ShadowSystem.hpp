@@ -45,8 +45,7 @@ namespace Kaamoo {
                     nullptr
             );
 
-            for (auto &pair: frameInfo.gameObjects) {
-                auto &obj = pair.second;
+            for (auto &obj: frameInfo.gameObjects) {
 
                 MeshRendererComponent *meshRendererComponent;
                 if (!obj.TryGetComponent<MeshRendererComponent>(meshRendererComponent))continue;
@@ -62,8 +61,9 @@ namespace Kaamoo {
                                    &push);
                 //too much draw call here, but currently I have no better ideas about how to batch all models together
                 if (meshRendererComponent->GetModelPtr() != nullptr && obj.IsActive()) {
-                    meshRendererComponent->GetModelPtr()->bind(frameInfo.commandBuffer);
-                    meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer);
+                    meshRendererComponent->GetModelPtr()->bindPositions(frameInfo.commandBuffer);
+                    //Shadows draw the level selected for the camera view this frame
+                    meshRendererComponent->GetModelPtr()->draw(frameInfo.commandBuffer, meshRendererComponent->GetLodIndex());
 //                break;
                 }
             }
@@ -125,21 +125,9 @@ namespace Kaamoo {
             PipelineConfigureInfo pipelineConfigureInfo{};
             Pipeline::setDefaultPipelineConfigureInfo(pipelineConfigureInfo);
 
-            VkVertexInputBindingDescription bindingDescription[1];
-            VkVertexInputAttributeDescription attributeDescription[1];
-            bindingDescription[0].binding = 0;
-            bindingDescription[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-            bindingDescription[0].stride = 2 * sizeof(glm::vec3);
-
-            attributeDescription[0].binding = 0;
-            attributeDescription[0].location = 0;
-            attributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attributeDescription[0].location = 0;
-
-//        pipelineConfigureInfo.attributeDescriptions.clear();
-//        pipelineConfigureInfo.attributeDescriptions.push_back(attributeDescription[0]);
-//        pipelineConfigureInfo.vertexBindingDescriptions.clear();
-//        pipelineConfigureInfo.vertexBindingDescriptions.push_back(bindingDescription[0]);
+            //Depth only, fetch the position stream and nothing else
+            pipelineConfigureInfo.vertexBindingDescriptions = Model::PackedPosition::getBindingDescriptions();
+            pipelineConfigureInfo.attributeDescriptions = Model::PackedPosition::getAttributeDescriptions();
             pipelineConfigureInfo.renderPass = renderPass;
             pipelineConfigureInfo.pipelineLayout = pipelineLayout;
             pipeline = std::make_unique<Pipeline>(
@@ -303,8 +303,7 @@ namespace Kaamoo {
         shadowImage->createImageView(*imageViewCreateInfo);
 
         //create shadow sampler
-        shadowSampler = std::make_shared<Sampler>(device);
-        shadowSampler->createTextureSampler();
+        shadowSampler = device.samplerCache().getDefaultSampler();
 
         //create shadow pass
         VkAttachmentDescription attachmentDescriptions[2];
@@ -386,8 +385,7 @@ namespace Kaamoo {
     void Renderer::loadOffscreenResources() {
         freeOffscreenResources();
         {
-            m_offscreenSampler = std::make_shared<Sampler>(device);
-            m_offscreenSampler->createTextureSampler();
+            m_offscreenSampler = device.samplerCache().getDefaultSampler();
             //Color
 
             VkImageCreateInfo imageCreateInfo{};
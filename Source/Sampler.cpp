@@ -1,22 +1,25 @@
 ﻿#include "Sampler.h"
 #include "Device.hpp"
+#include <cstddef>
+#include <cstring>
 
 namespace Kaamoo{
 
 
     void Sampler::createTextureSampler() {
         VkSamplerCreateInfo defaultCreateInfo{};
-        setDefaultSamplerCreateInfo(defaultCreateInfo);
+        setDefaultSamplerCreateInfo(device, defaultCreateInfo);
         createTextureSampler(defaultCreateInfo);
     }
 
     void Sampler::createTextureSampler(VkSamplerCreateInfo createInfo) {
+        samplerCreateInfo = createInfo;
         if (vkCreateSampler(device.device(),&createInfo, nullptr,&sampler)!=VK_SUCCESS){
             throw std::runtime_error("failed to create sampler");
         }
     }
 
-    void Sampler::setDefaultSamplerCreateInfo(VkSamplerCreateInfo &createInfo) const {
+    void Sampler::setDefaultSamplerCreateInfo(Device &device, VkSamplerCreateInfo &createInfo) {
         createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         createInfo.magFilter = VK_FILTER_LINEAR;
         createInfo.minFilter = VK_FILTER_LINEAR;
@@ -33,11 +36,53 @@ namespace Kaamoo{
         createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         createInfo.mipLodBias = 0.0f;
         createInfo.minLod = 0.0f;
-        createInfo.maxLod = 0.0f;
+        //Cooked textures carry a full mip chain
+        createInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     }
 
     Sampler::~Sampler() {
         vkDestroySampler(device.device(),sampler, nullptr);
     }
-}
\ No newline at end of file
+
+    std::shared_ptr<Sampler> SamplerCache::getSampler(const VkSamplerCreateInfo &createInfo) {
+        size_t hash = Hash(createInfo);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto range = m_samplers.equal_range(hash);
+        for (auto iterator = range.first; iterator != range.second; ++iterator) {
+            if (Equal(iterator->second->getCreateInfo(), createInfo)) return iterator->second;
+        }
+        auto sampler = std::make_shared<Sampler>(device);
+        sampler->createTextureSampler(createInfo);
+        m_samplers.emplace(hash, sampler);
+        return sampler;
+    }
+
+    std::shared_ptr<Sampler> SamplerCache::getDefaultSampler() {
+        VkSamplerCreateInfo createInfo{};
+        Sampler::setDefaultSamplerCreateInfo(device, createInfo);
+        return getSampler(createInfo);
+    }
+
+    size_t SamplerCache::size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_samplers.size();
+    }
+
+    //Every field from flags on is four bytes wide, so the key is one packed range without padding
+    size_t SamplerCache::Hash(const VkSamplerCreateInfo &createInfo) {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(&createInfo) + offsetof(VkSamplerCreateInfo, flags);
+        size_t size = sizeof(VkSamplerCreateInfo) - offsetof(VkSamplerCreateInfo, flags);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    bool SamplerCache::Equal(const VkSamplerCreateInfo &a, const VkSamplerCreateInfo &b) {
+        size_t offset = offsetof(VkSamplerCreateInfo, flags);
+        return std::memcmp(reinterpret_cast<const char *>(&a) + offset, reinterpret_cast<const char *>(&b) + offset,
+                           sizeof(VkSamplerCreateInfo) - offset) == 0;
+    }
+}
@@ -1,12 +1,14 @@
 ﻿#pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vulkan/vulkan.h>
 #include "Device.hpp"
 
 namespace Kaamoo {
     class Sampler {
     public:
-        //Todo: Make a sampler pool
         Sampler(Device &device) : device{device} {};
 
         ~Sampler();
@@ -15,15 +17,45 @@ namespace Kaamoo {
 
         void createTextureSampler(VkSamplerCreateInfo createInfo);
 
-        void setDefaultSamplerCreateInfo(VkSamplerCreateInfo &createInfo) const;
+        static void setDefaultSamplerCreateInfo(Device &device, VkSamplerCreateInfo &createInfo);
 
         VkSampler getSampler() const {
             return sampler;
         }
 
+        const VkSamplerCreateInfo &getCreateInfo() const { return samplerCreateInfo; }
+
+    private:
+        VkSampler sampler = VK_NULL_HANDLE;
+        VkSamplerCreateInfo samplerCreateInfo{};
+        Device &device;
+    };
+
+    //Hands out one Sampler per distinct create info, everything that samples the same way shares it.
+    //Keyed by the create info fields, pNext chains are not part of the key
+    class SamplerCache {
+    public:
+        explicit SamplerCache(Device &device) : device{device} {};
+
+        SamplerCache(const SamplerCache &) = delete;
+
+        SamplerCache &operator=(const SamplerCache &) = delete;
+
+        std::shared_ptr<Sampler> getSampler(const VkSamplerCreateInfo &createInfo);
+
+        //Sampler with Sampler::setDefaultSamplerCreateInfo
+        std::shared_ptr<Sampler> getDefaultSampler();
+
+        size_t size() const;
+
     private:
-        VkSampler sampler;
+        static size_t Hash(const VkSamplerCreateInfo &createInfo);
+
+        static bool Equal(const VkSamplerCreateInfo &a, const VkSamplerCreateInfo &b);
+
         Device &device;
+        mutable std::mutex m_mutex;
+        std::unordered_multimap<size_t, std::shared_ptr<Sampler>> m_samplers;
     };
 
 }
\ No newline at end of file
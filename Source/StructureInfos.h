@@ -1,8 +1,10 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <vulkan/vulkan.h>
 #include "GameObject.hpp"
 #include "Material.hpp"
+#include "Utils/SlotMap.hpp"
 
 namespace Kaamoo {
 
@@ -62,12 +64,13 @@ namespace Kaamoo {
         float frameTime;
         float totalTime;
         VkCommandBuffer commandBuffer;
-        std::unordered_map<id_t, GameObject> &gameObjects;
+        SlotMap<GameObject> &gameObjects;
         Material::Map &materials;
         GlobalUbo& globalUbo;
         VkExtent2D extent;
-        id_t selectedGameObjectId;
-        bool sceneUpdated;
+        SlotMapHandle selectedGameObject;
+        //Set from component updates on the worker pool
+        std::atomic<bool> sceneUpdated;
 #ifdef RAY_TRACING
         std::shared_ptr<Buffer> pGameObjectDescBuffer;
         std::vector<GameObjectDesc> pGameObjectDescs;
@@ -1,4 +1,5 @@
 #include "SwapChain.hpp"
+#include "UploadBatcher.h"
 
 // std
 #include <array>
@@ -46,7 +47,7 @@ namespace Kaamoo {
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemories[i], nullptr);
+            device.memoryAllocator().free(depthImageAllocations[i]);
         }
 
         for (auto framebuffer: swapChainFrameBuffers) {
@@ -103,8 +104,19 @@ namespace Kaamoo {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        //Uploads recorded while building this frame must land before it runs
+        device.uploadBatcher().flush();
+
+        //Transfer batches submitted later wait for this value before overwriting what the frame reads
+        UploadBatcher::FrameSignal frameSignal = device.uploadBatcher().frameSubmitSignal();
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], frameSignal.semaphore};
+        uint64_t signalValues[] = {0, frameSignal.value};
+        VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+        timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineSubmitInfo.signalSemaphoreValueCount = 2;
+        timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineSubmitInfo;
+        submitInfo.signalSemaphoreCount = 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
@@ -355,7 +367,7 @@ namespace Kaamoo {
         swapChainDepthFormat = depthFormat;
 
         depthImages.resize(imageCount());
-        depthImageMemories.resize(imageCount());
+        depthImageAllocations.resize(imageCount());
         depthImageViews.resize(imageCount());
 
         for (int i = 0; i < depthImages.size(); i++) {
@@ -379,7 +391,7 @@ namespace Kaamoo {
                     imageInfo,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                     depthImages[i],
-                    depthImageMemories[i]);
+                    depthImageAllocations[i]);
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
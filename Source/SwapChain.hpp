@@ -89,7 +89,7 @@ namespace Kaamoo {
         VkRenderPass m_gizmosRenderPass;
 
         std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImageMemories;
+        std::vector<MemoryAllocator::Allocation> depthImageAllocations;
         std::vector<VkImageView> depthImageViews;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
@@ -0,0 +1,320 @@
+﻿#include "BlockCompressor.h"
+#include "../Utils/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Kaamoo {
+    namespace {
+        const int BC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        void WriteBits(uint8_t *block, uint32_t &bitOffset, uint32_t value, uint32_t bitCount) {
+            for (uint32_t i = 0; i < bitCount; i++, bitOffset++) {
+                if (value & (1u << i)) block[bitOffset >> 3] |= static_cast<uint8_t>(1u << (bitOffset & 7));
+            }
+        }
+
+        uint32_t ReadBits(const uint8_t *block, uint32_t &bitOffset, uint32_t bitCount) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < bitCount; i++, bitOffset++) {
+                value |= static_cast<uint32_t>((block[bitOffset >> 3] >> (bitOffset & 7)) & 1u) << i;
+            }
+            return value;
+        }
+
+        //Mode 6 endpoint with its shared low bit, as 7 stored bits per channel
+        struct QuantizedLine {
+            uint8_t endpoints[2][4];
+            uint32_t pBits[2];
+            uint8_t indices[16];
+            uint64_t error;
+        };
+
+        void QuantizeEndpoint(const float endpoint[4], uint32_t pBit, uint8_t quantized[4]) {
+            for (int c = 0; c < 4; c++) {
+                int value = static_cast<int>(std::lround((std::clamp(endpoint[c], 0.0f, 255.0f) - static_cast<float>(pBit)) * 0.5f));
+                quantized[c] = static_cast<uint8_t>(std::clamp(value, 0, 127));
+            }
+        }
+
+        //Picks the best index per texel for the quantized endpoints and sums the squared error. The palette is a line, so the
+        //projection onto it lands next to the best entry and only its neighbours need checking
+        void EvaluateLine(const uint8_t texels[16][4], QuantizedLine &line) {
+            int palette[16][4];
+            float direction[4];
+            float origin[4];
+            float lengthSquared = 0;
+            for (int c = 0; c < 4; c++) {
+                int e0 = (line.endpoints[0][c] << 1) | line.pBits[0];
+                int e1 = (line.endpoints[1][c] << 1) | line.pBits[1];
+                for (int i = 0; i < 16; i++) {
+                    palette[i][c] = ((64 - BC7Weights4[i]) * e0 + BC7Weights4[i] * e1 + 32) >> 6;
+                }
+                origin[c] = static_cast<float>(e0);
+                direction[c] = static_cast<float>(e1 - e0);
+                lengthSquared += direction[c] * direction[c];
+            }
+            line.error = 0;
+            for (int t = 0; t < 16; t++) {
+                int guess = 0;
+                if (lengthSquared > 0) {
+                    float projection = 0;
+                    for (int c = 0; c < 4; c++) projection += (texels[t][c] - origin[c]) * direction[c];
+                    guess = std::clamp(static_cast<int>(projection / lengthSquared * 15.0f + 0.5f), 0, 15);
+                }
+                uint32_t bestError = ~0u;
+                for (int i = std::max(guess - 1, 0); i <= std::min(guess + 1, 15); i++) {
+                    uint32_t error = 0;
+                    for (int c = 0; c < 4; c++) {
+                        int delta = palette[i][c] - texels[t][c];
+                        error += static_cast<uint32_t>(delta * delta);
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        line.indices[t] = static_cast<uint8_t>(i);
+                    }
+                }
+                line.error += bestError;
+            }
+        }
+    }
+
+    void BlockCompressor::CompressBC7(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks) {
+        uint32_t blocksX = (width + BlockExtent - 1) / BlockExtent;
+        uint32_t blocksY = (height + BlockExtent - 1) / BlockExtent;
+        JobSystem::GetInstance().ParallelFor(blocksY, 4, [&](size_t begin, size_t end) {
+            uint8_t texels[16][4];
+            for (size_t y = begin; y < end; y++) {
+                for (uint32_t x = 0; x < blocksX; x++) {
+                    LoadBlock(rgba, width, height, x, static_cast<uint32_t>(y), texels);
+                    EncodeBC7Block(texels, blocks + (y * blocksX + x) * BlockBytes);
+                }
+            }
+        });
+    }
+
+    void BlockCompressor::CompressBC5(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks) {
+        uint32_t blocksX = (width + BlockExtent - 1) / BlockExtent;
+        uint32_t blocksY = (height + BlockExtent - 1) / BlockExtent;
+        JobSystem::GetInstance().ParallelFor(blocksY, 4, [&](size_t begin, size_t end) {
+            uint8_t texels[16][4];
+            uint8_t channel[16];
+            for (size_t y = begin; y < end; y++) {
+                for (uint32_t x = 0; x < blocksX; x++) {
+                    LoadBlock(rgba, width, height, x, static_cast<uint32_t>(y), texels);
+                    uint8_t *block = blocks + (y * blocksX + x) * BlockBytes;
+                    for (int c = 0; c < 2; c++) {
+                        for (int i = 0; i < 16; i++) channel[i] = texels[i][c];
+                        EncodeBC4Block(channel, block + c * 8);
+                    }
+                }
+            }
+        });
+    }
+
+    void BlockCompressor::LoadBlock(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+                                    uint8_t texels[16][4]) {
+        for (uint32_t y = 0; y < BlockExtent; y++) {
+            uint32_t sourceY = std::min(blockY * BlockExtent + y, height - 1);
+            for (uint32_t x = 0; x < BlockExtent; x++) {
+                uint32_t sourceX = std::min(blockX * BlockExtent + x, width - 1);
+                std::memcpy(texels[y * BlockExtent + x], rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+            }
+        }
+    }
+
+    void BlockCompressor::EncodeBC7Block(const uint8_t texels[16][4], uint8_t *block) {
+        float mean[4] = {};
+        for (int t = 0; t < 16; t++) {
+            for (int c = 0; c < 4; c++) mean[c] += texels[t][c];
+        }
+        for (float &value: mean) value /= 16.0f;
+
+        //Principal axis by power iteration on the covariance, seeded with the bounding box diagonal
+        float covariance[4][4] = {};
+        float boxMin[4] = {255, 255, 255, 255};
+        float boxMax[4] = {};
+        for (int t = 0; t < 16; t++) {
+            float delta[4];
+            for (int c = 0; c < 4; c++) {
+                delta[c] = texels[t][c] - mean[c];
+                boxMin[c] = std::min(boxMin[c], static_cast<float>(texels[t][c]));
+                boxMax[c] = std::max(boxMax[c], static_cast<float>(texels[t][c]));
+            }
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) covariance[i][j] += delta[i] * delta[j];
+            }
+        }
+        float axis[4];
+        for (int c = 0; c < 4; c++) axis[c] = boxMax[c] - boxMin[c];
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) next[i] += covariance[i][j] * axis[j];
+            }
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f) break;
+            for (int c = 0; c < 4; c++) axis[c] = next[c] / length;
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+
+        float endpoints[2][4];
+        if (axisLength < 1e-6f) {
+            std::memcpy(endpoints[0], mean, sizeof(mean));
+            std::memcpy(endpoints[1], mean, sizeof(mean));
+        } else {
+            for (float &value: axis) value /= axisLength;
+            float minProjection = 0, maxProjection = 0;
+            for (int t = 0; t < 16; t++) {
+                float projection = 0;
+                for (int c = 0; c < 4; c++) projection += (texels[t][c] - mean[c]) * axis[c];
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+            for (int c = 0; c < 4; c++) {
+                endpoints[0][c] = mean[c] + axis[c] * minProjection;
+                endpoints[1][c] = mean[c] + axis[c] * maxProjection;
+            }
+        }
+
+        QuantizedLine best{};
+        best.error = ~0ull;
+        for (int refinement = 0; refinement < 3; refinement++) {
+            QuantizedLine candidate{};
+            QuantizedLine refinementBest{};
+            refinementBest.error = ~0ull;
+            for (uint32_t pBits = 0; pBits < 4; pBits++) {
+                candidate.pBits[0] = pBits & 1;
+                candidate.pBits[1] = pBits >> 1;
+                QuantizeEndpoint(endpoints[0], candidate.pBits[0], candidate.endpoints[0]);
+                QuantizeEndpoint(endpoints[1], candidate.pBits[1], candidate.endpoints[1]);
+                EvaluateLine(texels, candidate);
+                if (candidate.error < refinementBest.error) refinementBest = candidate;
+            }
+            if (refinementBest.error < best.error) best = refinementBest;
+            if (best.error == 0) break;
+
+            //Least squares endpoints for the chosen indices
+            float a = 0, b = 0, c = 0, x0[4] = {}, x1[4] = {};
+            for (int t = 0; t < 16; t++) {
+                float weight = BC7Weights4[refinementBest.indices[t]] / 64.0f;
+                a += (1 - weight) * (1 - weight);
+                b += (1 - weight) * weight;
+                c += weight * weight;
+                for (int channel = 0; channel < 4; channel++) {
+                    x0[channel] += (1 - weight) * texels[t][channel];
+                    x1[channel] += weight * texels[t][channel];
+                }
+            }
+            float determinant = a * c - b * b;
+            if (std::abs(determinant) < 1e-6f) break;
+            for (int channel = 0; channel < 4; channel++) {
+                endpoints[0][channel] = (c * x0[channel] - b * x1[channel]) / determinant;
+                endpoints[1][channel] = (a * x1[channel] - b * x0[channel]) / determinant;
+            }
+        }
+
+        //The anchor index has an implicit zero high bit, flip the line when it does not
+        if (best.indices[0] & 8) {
+            std::swap(best.endpoints[0], best.endpoints[1]);
+            std::swap(best.pBits[0], best.pBits[1]);
+            for (uint8_t &index: best.indices) index = static_cast<uint8_t>(15 - index);
+        }
+
+        std::memset(block, 0, BlockBytes);
+        uint32_t bitOffset = 0;
+        WriteBits(block, bitOffset, 1u << 6, 7);
+        for (int channel = 0; channel < 4; channel++) {
+            WriteBits(block, bitOffset, best.endpoints[0][channel], 7);
+            WriteBits(block, bitOffset, best.endpoints[1][channel], 7);
+        }
+        WriteBits(block, bitOffset, best.pBits[0], 1);
+        WriteBits(block, bitOffset, best.pBits[1], 1);
+        WriteBits(block, bitOffset, best.indices[0], 3);
+        for (int t = 1; t < 16; t++) {
+            WriteBits(block, bitOffset, best.indices[t], 4);
+        }
+    }
+
+    void BlockCompressor::EncodeBC4Block(const uint8_t values[16], uint8_t *block) {
+        uint8_t minValue = *std::min_element(values, values + 16);
+        uint8_t maxValue = *std::max_element(values, values + 16);
+        std::memset(block, 0, 8);
+        block[0] = maxValue;
+        block[1] = minValue;
+        if (maxValue == minValue) return;
+
+        //maxValue > minValue selects the eight value palette
+        int palette[8];
+        palette[0] = maxValue;
+        palette[1] = minValue;
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+        }
+        uint64_t indexBits = 0;
+        for (int t = 0; t < 16; t++) {
+            int bestIndex = 0;
+            int bestError = 256;
+            for (int i = 0; i < 8; i++) {
+                int error = std::abs(palette[i] - values[t]);
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = i;
+                }
+            }
+            indexBits |= static_cast<uint64_t>(bestIndex) << (t * 3);
+        }
+        for (int i = 0; i < 6; i++) {
+            block[2 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+        }
+    }
+
+    void BlockCompressor::DecodeBC7Block(const uint8_t *block, uint8_t texels[16][4]) {
+        uint32_t bitOffset = 0;
+        if (ReadBits(block, bitOffset, 7) != (1u << 6)) {
+            //Only mode 6 is ever written, anything else decodes to the error colour
+            for (int t = 0; t < 16; t++) {
+                texels[t][0] = 255;
+                texels[t][1] = 0;
+                texels[t][2] = 255;
+                texels[t][3] = 255;
+            }
+            return;
+        }
+        uint32_t endpoints[2][4];
+        for (int channel = 0; channel < 4; channel++) {
+            endpoints[0][channel] = ReadBits(block, bitOffset, 7);
+            endpoints[1][channel] = ReadBits(block, bitOffset, 7);
+        }
+        uint32_t pBit0 = ReadBits(block, bitOffset, 1);
+        uint32_t pBit1 = ReadBits(block, bitOffset, 1);
+        for (int t = 0; t < 16; t++) {
+            uint32_t index = ReadBits(block, bitOffset, t == 0 ? 3 : 4);
+            for (int channel = 0; channel < 4; channel++) {
+                int e0 = static_cast<int>((endpoints[0][channel] << 1) | pBit0);
+                int e1 = static_cast<int>((endpoints[1][channel] << 1) | pBit1);
+                texels[t][channel] = static_cast<uint8_t>(((64 - BC7Weights4[index]) * e0 + BC7Weights4[index] * e1 + 32) >> 6);
+            }
+        }
+    }
+
+    void BlockCompressor::DecodeBC4Block(const uint8_t *block, uint8_t values[16]) {
+        int palette[8];
+        palette[0] = block[0];
+        palette[1] = block[1];
+        if (palette[0] > palette[1]) {
+            for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1] + 3) / 7;
+        } else {
+            for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1] + 2) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        uint64_t indexBits = 0;
+        for (int i = 0; i < 6; i++) {
+            indexBits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+        }
+        for (int t = 0; t < 16; t++) {
+            values[t] = static_cast<uint8_t>(palette[(indexBits >> (t * 3)) & 7]);
+        }
+    }
+}
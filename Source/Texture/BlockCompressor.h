@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Kaamoo {
+    //CPU encoders for the block compressed formats textures are cooked to. Both take tightly packed RGBA8 texels and write
+    //ceil(width / 4) * ceil(height / 4) blocks of 16 bytes row by row, edge blocks repeat the last row and column
+    class BlockCompressor {
+    public:
+        inline static const uint32_t BlockExtent = 4;
+        inline static const uint32_t BlockBytes = 16;
+
+        static size_t GetCompressedSize(uint32_t width, uint32_t height) {
+            return static_cast<size_t>((width + BlockExtent - 1) / BlockExtent) * ((height + BlockExtent - 1) / BlockExtent) * BlockBytes;
+        }
+
+        //BC7 mode 6 only: one RGBA line per block with 4 bit indices. Endpoints come from the principal axis and are refined by
+        //least squares, which is close to what fuller mode searches give on photographic albedo
+        static void CompressBC7(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks);
+
+        //Two BC4 blocks holding the red and green channels, for tangent space normal maps
+        static void CompressBC5(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks);
+
+        //Reference decoders, used to report the error of a cook
+        static void DecodeBC7Block(const uint8_t *block, uint8_t texels[16][4]);
+
+        static void DecodeBC4Block(const uint8_t *block, uint8_t values[16]);
+
+    private:
+        static void LoadBlock(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4]);
+
+        static void EncodeBC7Block(const uint8_t texels[16][4], uint8_t *block);
+
+        static void EncodeBC4Block(const uint8_t values[16], uint8_t *block);
+    };
+}
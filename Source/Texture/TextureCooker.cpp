@@ -0,0 +1,285 @@
+﻿#include "TextureCooker.h"
+#include "BlockCompressor.h"
+#include "../Image.h"
+#include "../Mesh/MeshCache.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace Kaamoo {
+    bool TextureCooker::IsNormalMap(const std::string &path) {
+        size_t nameBegin = path.find_last_of("/\\");
+        return path.find("Normal", nameBegin == std::string::npos ? 0 : nameBegin) != std::string::npos;
+    }
+
+    uint32_t TextureCooker::GetMipCount(uint32_t width, uint32_t height) {
+        uint32_t mipCount = 1;
+        while ((width | height) >> mipCount) mipCount++;
+        return mipCount;
+    }
+
+    uint32_t TextureCooker::GetFirstMip(uint32_t width, uint32_t height, uint32_t maxExtent) {
+        uint32_t mipCount = GetMipCount(width, height);
+        uint32_t firstMip = 0;
+        while (firstMip + 1 < mipCount && std::max(width >> firstMip, height >> firstMip) > maxExtent) firstMip++;
+        return firstMip;
+    }
+
+    std::shared_ptr<const TextureCooker::CookedTexture> TextureCooker::LoadCached(const std::string &path, bool cubeMap, uint32_t maxExtent) {
+        PROFILE_SCOPE("TextureCooker::LoadCached");
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto elapsedMilliseconds = [&startTime]() {
+            return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        };
+
+        //A cube map is cooked from its six faces, all of them go into the hash
+        uint64_t sourceHash = 0;
+        for (uint32_t i = 0; i < (cubeMap ? 6u : 1u); i++) {
+            std::string sourcePath = cubeMap ? path + "/" + Image::CubeMapFaceNames[i] : path;
+            MappedFile source(sourcePath);
+            if (!source.isValid()) {
+                throw std::runtime_error("Failed to open texture: " + sourcePath);
+            }
+            sourceHash = sourceHash * 0x100000001b3ULL ^ MeshCache::HashBytes(source.data(), source.size());
+        }
+
+        Format format = IsNormalMap(path) ? Format::BC5 : Format::BC7;
+        std::string cookedPath = GetCookedPath(path);
+        float cookMilliseconds = 0;
+        auto texture = std::make_shared<CookedTexture>();
+        if (TryLoad(cookedPath, sourceHash, format, cubeMap ? 6 : 1, maxExtent, *texture, cookMilliseconds)) {
+#ifdef ASSET_STATISTICS
+            std::cout << "Loaded cooked texture " << path << " in " << elapsedMilliseconds() << " ms (cold cook: " << cookMilliseconds
+                      << " ms)" << std::endl;
+#endif
+            return texture;
+        }
+
+        Profiler::GetInstance().MarkCold("Cooked texture " + path);
+        texture = Cook(path, cubeMap, format);
+        cookMilliseconds = elapsedMilliseconds();
+        Save(cookedPath, sourceHash, *texture, cookMilliseconds);
+        DropMips(*texture, GetFirstMip(texture->width, texture->height, maxExtent));
+        return texture;
+    }
+
+    void TextureCooker::DropMips(CookedTexture &texture, uint32_t firstMip) {
+        uint32_t dropCount = firstMip - texture.firstMip;
+        if (dropCount == 0) return;
+        size_t droppedBytes = texture.mipOffsets[dropCount];
+        texture.data.erase(texture.data.begin(), texture.data.begin() + static_cast<std::ptrdiff_t>(droppedBytes));
+        texture.mipOffsets.erase(texture.mipOffsets.begin(), texture.mipOffsets.begin() + dropCount);
+        for (auto &offset: texture.mipOffsets) offset -= droppedBytes;
+        texture.firstMip = firstMip;
+    }
+
+    std::shared_ptr<TextureCooker::CookedTexture> TextureCooker::Cook(const std::string &path, bool cubeMap, Format format) {
+        PROFILE_SCOPE("TextureCooker::Cook");
+#ifdef ASSET_STATISTICS
+        auto startTime = std::chrono::high_resolution_clock::now();
+#endif
+        auto pixels = Image::LoadPixels(path, cubeMap);
+
+        auto texture = std::make_shared<CookedTexture>();
+        texture->format = format;
+        texture->width = static_cast<uint32_t>(pixels->width);
+        texture->height = static_cast<uint32_t>(pixels->height);
+        texture->layerCount = pixels->layerCount;
+        texture->mipCount = GetMipCount(texture->width, texture->height);
+
+        bool normalMap = format == Format::BC5;
+        size_t layerBytes = static_cast<size_t>(texture->width) * texture->height * 4;
+        std::vector<std::vector<uint8_t>> levels(texture->layerCount);
+        for (uint32_t layer = 0; layer < texture->layerCount; layer++) {
+            auto layerBegin = pixels->data.begin() + static_cast<std::ptrdiff_t>(layer * layerBytes);
+            levels[layer].assign(layerBegin, layerBegin + static_cast<std::ptrdiff_t>(layerBytes));
+        }
+
+#ifdef ASSET_STATISTICS
+        float psnr = 0;
+#endif
+        uint32_t mipWidth = texture->width;
+        uint32_t mipHeight = texture->height;
+        for (uint32_t mip = 0; mip < texture->mipCount; mip++) {
+            texture->mipOffsets.push_back(texture->data.size());
+            size_t mipBytes = BlockCompressor::GetCompressedSize(mipWidth, mipHeight);
+            for (uint32_t layer = 0; layer < texture->layerCount; layer++) {
+                size_t offset = texture->data.size();
+                texture->data.resize(offset + mipBytes);
+                if (format == Format::BC5) {
+                    BlockCompressor::CompressBC5(levels[layer].data(), mipWidth, mipHeight, texture->data.data() + offset);
+                } else {
+                    BlockCompressor::CompressBC7(levels[layer].data(), mipWidth, mipHeight, texture->data.data() + offset);
+                }
+#ifdef ASSET_STATISTICS
+                if (mip == 0 && layer == 0) {
+                    psnr = MeasurePsnr(levels[layer].data(), mipWidth, mipHeight, texture->data.data() + offset, format);
+                }
+#endif
+                if (mip + 1 < texture->mipCount) {
+                    levels[layer] = Downsample(levels[layer], mipWidth, mipHeight, normalMap);
+                }
+            }
+            mipWidth = std::max(1u, mipWidth / 2);
+            mipHeight = std::max(1u, mipHeight / 2);
+        }
+
+#ifdef ASSET_STATISTICS
+        float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Cooked " << path << " to " << (format == Format::BC5 ? "BC5" : "BC7") << " with " << texture->mipCount << " mips in "
+                  << milliseconds << " ms, " << pixels->data.size() / 1024 << " KB RGBA8 -> " << texture->data.size() / 1024
+                  << " KB, PSNR " << psnr << " dB" << std::endl;
+#endif
+        return texture;
+    }
+
+    std::vector<uint8_t> TextureCooker::Downsample(const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height, bool normalMap) {
+        uint32_t nextWidth = std::max(1u, width / 2);
+        uint32_t nextHeight = std::max(1u, height / 2);
+        std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        for (uint32_t y = 0; y < nextHeight; y++) {
+            for (uint32_t x = 0; x < nextWidth; x++) {
+                //Odd sizes fold the last row or column into the one before
+                const uint8_t *samples[4];
+                uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                samples[0] = &rgba[(static_cast<size_t>(y0) * width + x0) * 4];
+                samples[1] = &rgba[(static_cast<size_t>(y0) * width + x1) * 4];
+                samples[2] = &rgba[(static_cast<size_t>(y1) * width + x0) * 4];
+                samples[3] = &rgba[(static_cast<size_t>(y1) * width + x1) * 4];
+                uint8_t *texel = &next[(static_cast<size_t>(y) * nextWidth + x) * 4];
+
+                if (normalMap) {
+                    float normal[3] = {};
+                    for (auto sample: samples) {
+                        for (int c = 0; c < 3; c++) normal[c] += sample[c] / 127.5f - 1.0f;
+                    }
+                    float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                    for (int c = 0; c < 3; c++) {
+                        float value = length > 1e-6f ? normal[c] / length : (c == 2 ? 1.0f : 0.0f);
+                        texel[c] = static_cast<uint8_t>(std::clamp(std::lround((value * 0.5f + 0.5f) * 255.0f), 0L, 255L));
+                    }
+                    texel[3] = static_cast<uint8_t>((samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 2) / 4);
+                } else {
+                    for (int c = 0; c < 4; c++) {
+                        texel[c] = static_cast<uint8_t>((samples[0][c] + samples[1][c] + samples[2][c] + samples[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+        return next;
+    }
+
+    float TextureCooker::MeasurePsnr(const uint8_t *rgba, uint32_t width, uint32_t height, const uint8_t *blocks, Format format) {
+        uint32_t blocksX = (width + BlockCompressor::BlockExtent - 1) / BlockCompressor::BlockExtent;
+        uint32_t blocksY = (height + BlockCompressor::BlockExtent - 1) / BlockCompressor::BlockExtent;
+        int channelCount = format == Format::BC5 ? 2 : 4;
+        double squaredError = 0;
+        uint8_t texels[16][4];
+        for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                const uint8_t *block = blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * BlockCompressor::BlockBytes;
+                if (format == Format::BC5) {
+                    uint8_t values[2][16];
+                    BlockCompressor::DecodeBC4Block(block, values[0]);
+                    BlockCompressor::DecodeBC4Block(block + 8, values[1]);
+                    for (int t = 0; t < 16; t++) {
+                        texels[t][0] = values[0][t];
+                        texels[t][1] = values[1][t];
+                    }
+                } else {
+                    BlockCompressor::DecodeBC7Block(block, texels);
+                }
+                for (uint32_t t = 0; t < 16; t++) {
+                    uint32_t x = blockX * 4 + t % 4, y = blockY * 4 + t / 4;
+                    if (x >= width || y >= height) continue;
+                    for (int c = 0; c < channelCount; c++) {
+                        double delta = static_cast<double>(texels[t][c]) - rgba[(static_cast<size_t>(y) * width + x) * 4 + c];
+                        squaredError += delta * delta;
+                    }
+                }
+            }
+        }
+        double meanSquaredError = squaredError / (static_cast<double>(width) * height * channelCount);
+        if (meanSquaredError <= 0) return 99.0f;
+        return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+    }
+
+    bool TextureCooker::TryLoad(const std::string &cookedPath, uint64_t sourceHash, Format format, uint32_t layerCount, uint32_t maxExtent,
+                                CookedTexture &texture, float &cookMilliseconds) {
+        MappedFile cooked(cookedPath);
+        if (cooked.data() == nullptr || cooked.size() < sizeof(Header)) return false;
+
+        Header header{};
+        std::memcpy(&header, cooked.data(), sizeof(Header));
+        if (header.magic != Magic || header.version != Version || header.sourceHash != sourceHash ||
+            header.format != static_cast<uint32_t>(format) || header.layerCount != layerCount || header.width == 0 || header.height == 0 ||
+            header.mipCount != GetMipCount(header.width, header.height)) {
+            return false;
+        }
+
+        texture.format = format;
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.layerCount = header.layerCount;
+        texture.mipCount = header.mipCount;
+        texture.firstMip = GetFirstMip(header.width, header.height, maxExtent);
+        texture.mipOffsets.clear();
+        //Only the mips from firstMip on are copied out of the mapping, the larger ones are never touched
+        size_t dataBegin = 0;
+        size_t dataSize = 0;
+        for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+            if (mip == texture.firstMip) dataBegin = dataSize;
+            if (mip >= texture.firstMip) texture.mipOffsets.push_back(dataSize - dataBegin);
+            dataSize += BlockCompressor::GetCompressedSize(std::max(1u, header.width >> mip), std::max(1u, header.height >> mip)) * header.layerCount;
+        }
+        if (cooked.size() < sizeof(Header) + dataSize) return false;
+
+        texture.data.assign(cooked.data() + sizeof(Header) + dataBegin, cooked.data() + sizeof(Header) + dataSize);
+        cookMilliseconds = header.cookMilliseconds;
+        return true;
+    }
+
+    void TextureCooker::Save(const std::string &cookedPath, uint64_t sourceHash, const CookedTexture &texture, float cookMilliseconds) {
+        Header header{};
+        header.magic = Magic;
+        header.version = Version;
+        header.sourceHash = sourceHash;
+        header.format = static_cast<uint32_t>(texture.format);
+        header.width = texture.width;
+        header.height = texture.height;
+        header.layerCount = texture.layerCount;
+        header.mipCount = texture.mipCount;
+        header.cookMilliseconds = cookMilliseconds;
+
+        //Same temporary file dance as MeshCache::Save
+        std::string tempPath = cookedPath + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Failed to write cooked texture: " << cookedPath << std::endl;
+                return;
+            }
+            file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            file.write(reinterpret_cast<const char *>(texture.data.data()), static_cast<std::streamsize>(texture.data.size()));
+            if (!file.good()) {
+                file.close();
+                std::remove(tempPath.c_str());
+                std::cerr << "Failed to write cooked texture: " << cookedPath << std::endl;
+                return;
+            }
+        }
+        std::remove(cookedPath.c_str());
+        if (std::rename(tempPath.c_str(), cookedPath.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            std::cerr << "Failed to write cooked texture: " << cookedPath << std::endl;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+namespace Kaamoo {
+    //Turns source images into block compressed containers with a full mip chain, cached next to the source as .ktex
+    class TextureCooker {
+    public:
+        enum class Format : uint32_t {
+            BC7 = 1,
+            BC5 = 2
+        };
+
+        struct CookedTexture {
+            Format format = Format::BC7;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t layerCount = 1;
+            uint32_t mipCount = 1;
+            //Mips above firstMip were left out of data, width and height still describe mip 0
+            uint32_t firstMip = 0;
+            //Mips one after another starting with firstMip, each holding every layer as rows of 4x4 blocks.
+            //mipOffsets[i] is where mip firstMip + i begins
+            std::vector<uint8_t> data;
+            std::vector<size_t> mipOffsets;
+        };
+
+        inline static const std::string CookedExtension = ".ktex";
+
+        static std::string GetCookedPath(const std::string &sourcePath) { return sourcePath + CookedExtension; }
+
+        //Normal maps go to BC5. They are told apart by name, every normal map in Textures carries Normal in its file name
+        static bool IsNormalMap(const std::string &path);
+
+        static uint32_t GetMipCount(uint32_t width, uint32_t height);
+
+        //Largest mip whose width and height both fit in maxExtent, the last mip when none does
+        static uint32_t GetFirstMip(uint32_t width, uint32_t height, uint32_t maxExtent);
+
+        //Loads the cooked container when it was cooked from the current source, otherwise cooks and saves it.
+        //Only the mips from GetFirstMip(maxExtent) down are returned. Safe to call from worker threads
+        static std::shared_ptr<const CookedTexture> LoadCached(const std::string &path, bool cubeMap,
+                                                               uint32_t maxExtent = std::numeric_limits<uint32_t>::max());
+
+    private:
+        inline static const uint32_t Magic = 0x5845544B; // "KTEX"
+        inline static const uint32_t Version = 1;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t sourceHash;
+            uint32_t format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t layerCount;
+            uint32_t mipCount;
+            //Time the cook took, used to report the warm start speed up
+            float cookMilliseconds;
+            uint32_t reserved[2];
+        };
+        static_assert(sizeof(Header) % 16 == 0, "Cooked texture payload must stay 16 byte aligned");
+
+        static std::shared_ptr<CookedTexture> Cook(const std::string &path, bool cubeMap, Format format);
+
+        //Box filters one level down, normal maps are renormalized after averaging
+        static std::vector<uint8_t> Downsample(const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height, bool normalMap);
+
+        //Peak signal to noise ratio of the decoded blocks against the source, over the channels the format keeps
+        static float MeasurePsnr(const uint8_t *rgba, uint32_t width, uint32_t height, const uint8_t *blocks, Format format);
+
+        static bool TryLoad(const std::string &cookedPath, uint64_t sourceHash, Format format, uint32_t layerCount, uint32_t maxExtent,
+                            CookedTexture &texture, float &cookMilliseconds);
+
+        static void DropMips(CookedTexture &texture, uint32_t firstMip);
+
+        static void Save(const std::string &cookedPath, uint64_t sourceHash, const CookedTexture &texture, float cookMilliseconds);
+    };
+}
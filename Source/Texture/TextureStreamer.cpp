@@ -0,0 +1,390 @@
+﻿#include "TextureStreamer.h"
+#include "BlockCompressor.h"
+#include "../Utils/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace Kaamoo {
+    TextureStreamer::TextureStreamer(Device &device, VkDeviceSize budget) : device{device}, m_budget{budget} {
+        m_sampler = device.samplerCache().getDefaultSampler();
+        m_colorPlaceholder = createPlaceholder(false);
+        m_normalPlaceholder = createPlaceholder(true);
+    }
+
+    TextureStreamer::~TextureStreamer() {
+        //Workers append to m_finishedLoads, none may outlive it
+        for (auto &texture: m_textures) {
+            if (texture.load.valid()) texture.load.wait();
+        }
+    }
+
+    std::shared_ptr<Image> TextureStreamer::createPlaceholder(bool normalMap) {
+        //Mid grey for colour and PBR maps, a flat normal for normal maps
+        uint8_t rgba[BlockCompressor::BlockExtent * BlockCompressor::BlockExtent * 4];
+        for (size_t i = 0; i < sizeof(rgba); i += 4) {
+            rgba[i] = 128;
+            rgba[i + 1] = 128;
+            rgba[i + 2] = normalMap ? 255 : 128;
+            rgba[i + 3] = 255;
+        }
+
+        TextureCooker::CookedTexture texture;
+        texture.format = normalMap ? TextureCooker::Format::BC5 : TextureCooker::Format::BC7;
+        texture.width = BlockCompressor::BlockExtent;
+        texture.height = BlockCompressor::BlockExtent;
+        texture.data.resize(BlockCompressor::BlockBytes);
+        texture.mipOffsets.push_back(0);
+        if (normalMap) {
+            BlockCompressor::CompressBC5(rgba, texture.width, texture.height, texture.data.data());
+        } else {
+            BlockCompressor::CompressBC7(rgba, texture.width, texture.height, texture.data.data());
+        }
+
+        auto image = std::make_shared<Image>(device, ImageType.Default);
+        image->createTextureImage(texture);
+        image->createImageView();
+        return image;
+    }
+
+    TextureStreamer::Handle TextureStreamer::registerTexture(const std::string &path, Material::id_t materialId, bool SRGB) {
+        std::string key = SRGB ? path + "|SRGB" : path;
+        auto iterator = m_handles.find(key);
+        Handle handle;
+        if (iterator != m_handles.end()) {
+            handle = iterator->second;
+        } else {
+            handle = static_cast<Handle>(m_textures.size());
+            m_textures.emplace_back();
+            m_textures.back().path = path;
+            m_textures.back().SRGB = SRGB;
+            m_textures.back().normalMap = TextureCooker::IsNormalMap(path);
+            m_handles.emplace(key, handle);
+        }
+
+        auto &materialIds = m_textures[handle].materialIds;
+        if (std::find(materialIds.begin(), materialIds.end(), materialId) == materialIds.end()) {
+            materialIds.push_back(materialId);
+            m_materialTextures[materialId].push_back(handle);
+        }
+        return handle;
+    }
+
+    VkDescriptorImageInfo TextureStreamer::descriptorInfo(Handle handle) const {
+        const auto &texture = m_textures[handle];
+        const auto &image = texture.image ? texture.image : texture.normalMap ? m_normalPlaceholder : m_colorPlaceholder;
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = m_sampler->getSampler();
+        imageInfo.imageView = image->imageView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        return imageInfo;
+    }
+
+    void TextureStreamer::bindDescriptor(Handle handle, const std::shared_ptr<VkDescriptorSet> &set,
+                                         const std::shared_ptr<DescriptorSetLayout> &layout, uint32_t binding, uint32_t arrayElement) {
+        if (m_framePool != nullptr) {
+            throw std::runtime_error("TextureStreamer: descriptors must be bound before the first update");
+        }
+        auto iterator = std::find_if(m_streamedSets.begin(), m_streamedSets.end(), [&set](const StreamedSet &streamedSet) {
+            return streamedSet.set == set;
+        });
+        if (iterator == m_streamedSets.end()) {
+            m_streamedSets.push_back({set, layout});
+            iterator = std::prev(m_streamedSets.end());
+        }
+        auto streamedSet = static_cast<uint32_t>(iterator - m_streamedSets.begin());
+        m_textures[handle].slots.push_back({streamedSet, binding, arrayElement});
+    }
+
+    void TextureStreamer::requestMaterial(Material::id_t materialId, float screenDiameter) {
+        auto iterator = m_materialTextures.find(materialId);
+        if (iterator == m_materialTextures.end()) return;
+        for (auto handle: iterator->second) {
+            auto &texture = m_textures[handle];
+            texture.screenDiameter = std::max(texture.screenDiameter, screenDiameter);
+        }
+    }
+
+    uint32_t TextureStreamer::demandedMip(const Texture &texture) const {
+        if (texture.screenDiameter <= 0) return texture.tailMip;
+        if (std::isinf(texture.screenDiameter)) return 0;
+        float extent = static_cast<float>(std::max(texture.width, texture.height));
+        float mip = std::floor(std::log2(extent / (texture.screenDiameter * TexelsPerScreenPixel)));
+        return static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.tailMip)));
+    }
+
+    VkDeviceSize TextureStreamer::estimateBytes(const Texture &texture, uint32_t firstMip) const {
+        if (firstMip == Unknown) return 0;
+        VkDeviceSize bytes = 0;
+        for (uint32_t mip = firstMip; mip < texture.mipCount; mip++) {
+            bytes += BlockCompressor::GetCompressedSize(std::max(1u, texture.width >> mip), std::max(1u, texture.height >> mip)) *
+                     texture.layerCount;
+        }
+        return bytes;
+    }
+
+    void TextureStreamer::fitToBudget(std::vector<uint32_t> &targets) const {
+        VkDeviceSize total = 0;
+        for (size_t i = 0; i < m_textures.size(); i++) {
+            total += estimateBytes(m_textures[i], targets[i]);
+        }
+        while (total > m_budget) {
+            size_t largest = m_textures.size();
+            VkDeviceSize largestBytes = 0;
+            for (size_t i = 0; i < m_textures.size(); i++) {
+                if (targets[i] == Unknown || targets[i] >= m_textures[i].tailMip) continue;
+                VkDeviceSize bytes = estimateBytes(m_textures[i], targets[i]);
+                if (bytes > largestBytes) {
+                    largest = i;
+                    largestBytes = bytes;
+                }
+            }
+            //Only tails are left, they stay even over budget
+            if (largest == m_textures.size()) break;
+            targets[largest]++;
+            total -= largestBytes - estimateBytes(m_textures[largest], targets[largest]);
+        }
+    }
+
+    void TextureStreamer::startLoad(Handle handle, uint32_t firstMip) {
+        auto &texture = m_textures[handle];
+        //The first load does not know the size yet and asks for the tail by extent
+        uint32_t maxExtent = firstMip == Unknown ? TailExtent : std::max(texture.width, texture.height) >> firstMip;
+        texture.loading = true;
+        texture.loadingMip = firstMip;
+        m_loadsInFlight++;
+        texture.load = JobSystem::GetInstance().Submit([this, handle, path = texture.path, maxExtent]() {
+            FinishedLoad finishedLoad{handle};
+            try {
+                finishedLoad.texture = TextureCooker::LoadCached(path, false, maxExtent);
+            } catch (const std::exception &exception) {
+                finishedLoad.error = exception.what();
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finishedLoads.push_back(std::move(finishedLoad));
+        });
+    }
+
+    void TextureStreamer::collectFinishedLoads() {
+        std::vector<FinishedLoad> finishedLoads;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            finishedLoads.swap(m_finishedLoads);
+        }
+        if (finishedLoads.empty()) return;
+
+        for (auto &finishedLoad: finishedLoads) {
+            m_loadsInFlight--;
+            auto &texture = m_textures[finishedLoad.handle];
+            if (finishedLoad.texture == nullptr) {
+                //Stays on whatever it shows now
+                std::cout << "Streaming " << texture.path << " failed: " << finishedLoad.error << std::endl;
+                texture.loading = false;
+                texture.failed = true;
+                continue;
+            }
+
+            const auto &cooked = *finishedLoad.texture;
+            texture.width = cooked.width;
+            texture.height = cooked.height;
+            texture.layerCount = cooked.layerCount;
+            texture.mipCount = cooked.mipCount;
+            texture.tailMip = TextureCooker::GetFirstMip(cooked.width, cooked.height, TailExtent);
+            texture.loadingMip = cooked.firstMip;
+
+            auto image = std::make_shared<Image>(device, ImageType.Default);
+            image->createTextureImage(cooked, texture.SRGB);
+            image->createImageView();
+            m_pendingSwaps.push_back({finishedLoad.handle, std::move(image), cooked.firstMip, 0});
+        }
+
+        //One submission covers every image created above
+        UploadBatcher::Token token = device.uploadBatcher().flush();
+        for (auto &pendingSwap: m_pendingSwaps) {
+            if (pendingSwap.token == 0) pendingSwap.token = token;
+        }
+    }
+
+    void TextureStreamer::createFrameSets() {
+        std::unordered_map<VkDescriptorType, uint32_t> descriptorCounts;
+        for (const auto &streamedSet: m_streamedSets) {
+            for (const auto &binding: streamedSet.layout->getBindings()) {
+                descriptorCounts[binding.descriptorType] += binding.descriptorCount * SwapChain::MAX_FRAMES_IN_FLIGHT;
+            }
+        }
+        DescriptorPool::Builder poolBuilder(device);
+        poolBuilder.setMaxSets(static_cast<uint32_t>(m_streamedSets.size()) * SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (const auto &[descriptorType, count]: descriptorCounts) {
+            poolBuilder.addPoolSize(descriptorType, count);
+        }
+        m_framePool = poolBuilder.build();
+
+        //Every copy starts as the set the ResourceManager wrote, buffers and non-streamed images included
+        std::vector<VkCopyDescriptorSet> copies;
+        for (auto &streamedSet: m_streamedSets) {
+            for (auto &frameSet: streamedSet.frameSets) {
+                auto frameSetPointer = std::make_shared<VkDescriptorSet>();
+                m_framePool->allocateDescriptor(streamedSet.layout->getDescriptorSetLayout(), frameSetPointer);
+                frameSet = *frameSetPointer;
+                for (const auto &binding: streamedSet.layout->getBindings()) {
+                    VkCopyDescriptorSet copy{};
+                    copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+                    copy.srcSet = *streamedSet.set;
+                    copy.srcBinding = binding.binding;
+                    copy.dstSet = frameSet;
+                    copy.dstBinding = binding.binding;
+                    copy.descriptorCount = binding.descriptorCount;
+                    copies.push_back(copy);
+                }
+            }
+        }
+        vkUpdateDescriptorSets(device.device(), 0, nullptr, static_cast<uint32_t>(copies.size()), copies.data());
+    }
+
+    void TextureStreamer::applySwaps() {
+        if (m_pendingSwaps.empty()) return;
+
+        auto &uploadBatcher = device.uploadBatcher();
+        auto readyEnd = std::partition(m_pendingSwaps.begin(), m_pendingSwaps.end(), [&uploadBatcher](const PendingSwap &pendingSwap) {
+            return uploadBatcher.isComplete(pendingSwap.token);
+        });
+        if (readyEnd == m_pendingSwaps.begin()) return;
+
+        for (auto iterator = m_pendingSwaps.begin(); iterator != readyEnd; ++iterator) {
+            auto &texture = m_textures[iterator->handle];
+            if (texture.image) {
+                m_residentBytes -= texture.image->getMemorySize();
+                //The copies of the other frames still show it until those frames are recorded again
+                m_retiredImages.push_back({std::move(texture.image), SwapChain::MAX_FRAMES_IN_FLIGHT});
+            }
+            texture.image = std::move(iterator->image);
+            m_residentBytes += texture.image->getMemorySize();
+            texture.residentMip = iterator->firstMip;
+            texture.loadingMip = Unknown;
+            texture.loading = false;
+            texture.staleFrames = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+            m_swapCount++;
+        }
+        m_pendingSwaps.erase(m_pendingSwaps.begin(), readyEnd);
+    }
+
+    void TextureStreamer::refreshFrameSets(uint32_t frameIndex) {
+        //The fence of frameIndex was waited on, no pending command buffer reads its copies
+        uint32_t frameBit = 1u << frameIndex;
+        for (Handle handle = 0; handle < m_textures.size(); handle++) {
+            auto &texture = m_textures[handle];
+            if ((texture.staleFrames & frameBit) == 0) continue;
+            writeDescriptors(handle, frameIndex);
+            texture.staleFrames &= ~frameBit;
+        }
+        for (auto &streamedSet: m_streamedSets) {
+            *streamedSet.set = streamedSet.frameSets[frameIndex];
+        }
+    }
+
+    void TextureStreamer::writeDescriptors(Handle handle, uint32_t frameIndex) {
+        const auto &texture = m_textures[handle];
+        VkDescriptorImageInfo imageInfo = descriptorInfo(handle);
+        std::vector<VkWriteDescriptorSet> writes;
+        writes.reserve(texture.slots.size());
+        for (const auto &slot: texture.slots) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = m_streamedSets[slot.streamedSet].frameSets[frameIndex];
+            write.dstBinding = slot.binding;
+            write.dstArrayElement = slot.arrayElement;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &imageInfo;
+            writes.push_back(write);
+        }
+        vkUpdateDescriptorSets(device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    void TextureStreamer::update(uint32_t frameIndex) {
+        if (m_framePool == nullptr && !m_streamedSets.empty()) createFrameSets();
+        collectFinishedLoads();
+        applySwaps();
+        if (m_framePool != nullptr) refreshFrameSets(frameIndex);
+
+        //An image retired this update is still read by the other frames in flight, each of their fences is waited on by a later update
+        for (auto &retiredImage: m_retiredImages) {
+            retiredImage.framesLeft--;
+        }
+        m_retiredImages.erase(std::remove_if(m_retiredImages.begin(), m_retiredImages.end(), [](const RetiredImage &retiredImage) {
+            return retiredImage.framesLeft == 0;
+        }), m_retiredImages.end());
+
+        //Targets only move past the hysteresis band, then the budget gets the last word
+        std::vector<uint32_t> targets(m_textures.size(), Unknown);
+        for (size_t i = 0; i < m_textures.size(); i++) {
+            const auto &texture = m_textures[i];
+            if (texture.residentMip == Unknown || texture.failed) continue;
+            uint32_t demanded = demandedMip(texture);
+            bool finer = demanded < texture.residentMip;
+            bool coarser = demanded > texture.residentMip + EvictionHysteresis;
+            targets[i] = finer || coarser ? demanded : texture.residentMip;
+        }
+        fitToBudget(targets);
+
+        //What is resident once every load in flight is swapped in
+        VkDeviceSize projectedBytes = 0;
+        for (const auto &texture: m_textures) {
+            projectedBytes += estimateBytes(texture, texture.loading ? texture.loadingMip : texture.residentMip);
+        }
+
+        //Tails first so every texture leaves its placeholder, then evictions, which free memory, then the biggest upgrades
+        std::vector<Handle> tailLoads;
+        std::vector<Handle> evictions;
+        std::vector<Handle> upgrades;
+        for (Handle handle = 0; handle < m_textures.size(); handle++) {
+            const auto &texture = m_textures[handle];
+            if (texture.loading || texture.failed) continue;
+            if (texture.residentMip == Unknown) {
+                tailLoads.push_back(handle);
+            } else if (targets[handle] > texture.residentMip) {
+                evictions.push_back(handle);
+            } else if (targets[handle] < texture.residentMip) {
+                upgrades.push_back(handle);
+            }
+        }
+        std::sort(upgrades.begin(), upgrades.end(), [this, &targets](Handle a, Handle b) {
+            return m_textures[a].residentMip - targets[a] > m_textures[b].residentMip - targets[b];
+        });
+
+        for (auto handle: tailLoads) {
+            if (m_loadsInFlight >= MaxLoadsInFlight) break;
+            startLoad(handle, Unknown);
+        }
+        for (auto handle: evictions) {
+            if (m_loadsInFlight >= MaxLoadsInFlight) break;
+            const auto &texture = m_textures[handle];
+            projectedBytes -= estimateBytes(texture, texture.residentMip) - estimateBytes(texture, targets[handle]);
+            startLoad(handle, targets[handle]);
+        }
+        for (auto handle: upgrades) {
+            if (m_loadsInFlight >= MaxLoadsInFlight) break;
+            const auto &texture = m_textures[handle];
+            VkDeviceSize growth = estimateBytes(texture, targets[handle]) - estimateBytes(texture, texture.residentMip);
+            if (projectedBytes + growth > m_budget) continue;
+            projectedBytes += growth;
+            startLoad(handle, targets[handle]);
+        }
+
+        for (auto &texture: m_textures) {
+            texture.screenDiameter = 0;
+        }
+    }
+
+    TextureStreamer::Statistics TextureStreamer::getStatistics() const {
+        Statistics statistics{};
+        statistics.textureCount = static_cast<uint32_t>(m_textures.size());
+        statistics.loadsInFlight = m_loadsInFlight;
+        statistics.swapCount = m_swapCount;
+        statistics.residentBytes = m_residentBytes;
+        statistics.budgetBytes = m_budget;
+        return statistics;
+    }
+}
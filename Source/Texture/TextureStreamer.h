@@ -0,0 +1,185 @@
+﻿#pragma once
+
+#include <array>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TextureCooker.h"
+#include "../Descriptor.h"
+#include "../Image.h"
+#include "../Material.hpp"
+#include "../Sampler.h"
+#include "../SwapChain.hpp"
+#include "../UploadBatcher.h"
+
+namespace Kaamoo {
+    //Keeps material textures resident only down to the mips their objects need on screen.
+    //Every texture starts as a shared 4x4 placeholder. Mips are read on the worker pool, uploaded through the UploadBatcher and
+    //swapped into every descriptor that shows the texture. Resident mips stay under a fixed budget, when the demand does not fit
+    //the largest textures give up mips first.
+    //Bound sets are replaced by one copy per frame in flight, a swap only rewrites the copy of the frame being recorded and the
+    //old image is released once no frame in flight can read it, so swapping never waits for the GPU
+    class TextureStreamer {
+    public:
+        using Handle = uint32_t;
+
+        struct Statistics {
+            uint32_t textureCount;
+            uint32_t loadsInFlight;
+            uint64_t swapCount;
+            VkDeviceSize residentBytes;
+            VkDeviceSize budgetBytes;
+        };
+
+        inline static const VkDeviceSize DefaultBudget = 256 * 1024 * 1024;
+        //The first load of every texture brings in the mips up to this size, they are never given back
+        inline static const uint32_t TailExtent = 64;
+        //Texels wanted per pixel of an object's screen diameter, covers UV tiling and surfaces seen at an angle
+        inline static const float TexelsPerScreenPixel = 2.0f;
+        //Demand has to drop more than this many mips below the resident ones before they are given back
+        inline static const uint32_t EvictionHysteresis = 1;
+        inline static const uint32_t MaxLoadsInFlight = 4;
+
+        explicit TextureStreamer(Device &device, VkDeviceSize budget = DefaultBudget);
+
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer &) = delete;
+
+        TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+        //Handle of path, registered with a placeholder on first use. Objects drawn with materialId drive its mips
+        //Textures are keyed by path and SRGB, so materials naming the same file share one image and one descriptor
+        Handle registerTexture(const std::string &path, Material::id_t materialId, bool SRGB = false);
+
+        //What is resident right now, the placeholder until the first load arrives
+        VkDescriptorImageInfo descriptorInfo(Handle handle) const;
+
+        //Combined image sampler element of set showing handle. From the first update on, *set holds the copy of set for the
+        //frame being recorded, so it has to be fully written here and read through the pointer at record time
+        void bindDescriptor(Handle handle, const std::shared_ptr<VkDescriptorSet> &set, const std::shared_ptr<DescriptorSetLayout> &layout,
+                            uint32_t binding, uint32_t arrayElement = 0);
+
+        //Objects with materialId cover screenDiameter pixels this frame, the largest request of a frame wins
+        void requestMaterial(Material::id_t materialId, float screenDiameter);
+
+        //Swaps in finished loads, turns this frame's requests into mip targets and starts loads.
+        //Called once per frame after the fence of frameIndex was waited on, before any command buffer of the frame binds the descriptors
+        void update(uint32_t frameIndex);
+
+        Statistics getStatistics() const;
+
+    private:
+        inline static const uint32_t Unknown = std::numeric_limits<uint32_t>::max();
+
+        struct StreamedSet {
+            //What the renderer binds, pointed at frameSets[frameIndex] by every update
+            std::shared_ptr<VkDescriptorSet> set;
+            std::shared_ptr<DescriptorSetLayout> layout;
+            std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> frameSets{};
+        };
+
+        struct DescriptorSlot {
+            //Index into m_streamedSets
+            uint32_t streamedSet;
+            uint32_t binding;
+            uint32_t arrayElement;
+        };
+
+        struct Texture {
+            std::string path;
+            bool SRGB = false;
+            bool normalMap = false;
+            std::vector<Material::id_t> materialIds;
+            std::vector<DescriptorSlot> slots;
+            //Null while the placeholder is shown
+            std::shared_ptr<Image> image;
+            //Known once the first load came back
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t layerCount = 1;
+            uint32_t mipCount = 0;
+            uint32_t tailMip = 0;
+            //First mip of image, Unknown while the placeholder is shown
+            uint32_t residentMip = Unknown;
+            //First mip of the load or swap in flight, Unknown for the first load
+            uint32_t loadingMip = Unknown;
+            bool loading = false;
+            bool failed = false;
+            //Bit per frame in flight whose set copies still show the previous image
+            uint32_t staleFrames = 0;
+            float screenDiameter = 0;
+            std::future<void> load;
+        };
+
+        struct FinishedLoad {
+            Handle handle;
+            std::shared_ptr<const TextureCooker::CookedTexture> texture;
+            std::string error;
+        };
+
+        struct PendingSwap {
+            Handle handle;
+            std::shared_ptr<Image> image;
+            uint32_t firstMip;
+            UploadBatcher::Token token;
+        };
+
+        struct RetiredImage {
+            std::shared_ptr<Image> image;
+            //Updates left until every frame in flight that could read image has finished
+            uint32_t framesLeft;
+        };
+
+        std::shared_ptr<Image> createPlaceholder(bool normalMap);
+
+        //Finest mip the objects using texture asked for this frame, never finer than mip 0 or coarser than the tail
+        uint32_t demandedMip(const Texture &texture) const;
+
+        //Size of mips [firstMip, mipCount) once uploaded, before allocation rounding
+        VkDeviceSize estimateBytes(const Texture &texture, uint32_t firstMip) const;
+
+        //Coarsens the largest targets one mip at a time until they fit in the budget
+        void fitToBudget(std::vector<uint32_t> &targets) const;
+
+        void startLoad(Handle handle, uint32_t firstMip);
+
+        //Creates and uploads images for loads the workers finished
+        void collectFinishedLoads();
+
+        //Allocates the per-frame copies of every bound set, once all sets are bound
+        void createFrameSets();
+
+        void applySwaps();
+
+        //Rewrites the copies of frameIndex for textures swapped since that frame was last recorded, then points the bound sets at them
+        void refreshFrameSets(uint32_t frameIndex);
+
+        void writeDescriptors(Handle handle, uint32_t frameIndex);
+
+        Device &device;
+        VkDeviceSize m_budget;
+        std::shared_ptr<Sampler> m_sampler;
+        std::shared_ptr<Image> m_colorPlaceholder;
+        std::shared_ptr<Image> m_normalPlaceholder;
+
+        std::vector<Texture> m_textures;
+        std::unordered_map<std::string, Handle> m_handles;
+        std::unordered_map<Material::id_t, std::vector<Handle>> m_materialTextures;
+        std::vector<StreamedSet> m_streamedSets;
+        std::unique_ptr<DescriptorPool> m_framePool;
+
+        //Guards m_finishedLoads, which the workers append to
+        std::mutex m_mutex;
+        std::vector<FinishedLoad> m_finishedLoads;
+        std::vector<PendingSwap> m_pendingSwaps;
+        std::vector<RetiredImage> m_retiredImages;
+        uint32_t m_loadsInFlight = 0;
+        uint64_t m_swapCount = 0;
+        VkDeviceSize m_residentBytes = 0;
+    };
+}
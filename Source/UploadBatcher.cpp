@@ -0,0 +1,462 @@
+﻿#include "UploadBatcher.h"
+#include "Utils/Profiler.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace Kaamoo {
+    UploadBatcher::UploadBatcher(Device &device) : device{device} {
+        QueueFamilyIndices queueFamilyIndices = device.getQueueFamilyIndices();
+        m_graphicsFamily = queueFamilyIndices.graphicsFamily;
+        m_dedicatedTransfer = queueFamilyIndices.transferFamilyHasValue;
+        m_transferFamily = m_dedicatedTransfer ? queueFamilyIndices.transferFamily : m_graphicsFamily;
+        m_transferCommandPool = createCommandPool(m_transferFamily);
+        if (m_dedicatedTransfer) {
+            m_graphicsCommandPool = createCommandPool(m_graphicsFamily);
+        }
+
+        auto createTimeline = [&device]() {
+            VkSemaphoreTypeCreateInfo typeCreateInfo{};
+            typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeCreateInfo.initialValue = 0;
+            VkSemaphoreCreateInfo createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            createInfo.pNext = &typeCreateInfo;
+            VkSemaphore semaphore;
+            if (vkCreateSemaphore(device.device(), &createInfo, nullptr, &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload timeline semaphore");
+            }
+            return semaphore;
+        };
+        m_transferTimeline = createTimeline();
+        m_uploadTimeline = createTimeline();
+        m_frameTimeline = createTimeline();
+
+        //One batch records while the others are in flight
+        m_batches.resize(MaxBatchesInFlight + 1);
+        for (auto &batch: m_batches) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = m_transferCommandPool;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate upload command buffer");
+            }
+            if (m_dedicatedTransfer) {
+                allocInfo.commandPool = m_graphicsCommandPool;
+                if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch.acquireCommandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate upload acquire command buffer");
+                }
+            }
+            m_freeBatches.push_back(&batch);
+        }
+
+        m_stagingRing = std::make_unique<Buffer>(device, StagingRingSize, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_stagingRing->map();
+    }
+
+    UploadBatcher::~UploadBatcher() {
+        waitIdle();
+        //Frames in flight still signal the frame timeline
+        vkDeviceWaitIdle(device.device());
+        vkDestroySemaphore(device.device(), m_transferTimeline, nullptr);
+        vkDestroySemaphore(device.device(), m_uploadTimeline, nullptr);
+        vkDestroySemaphore(device.device(), m_frameTimeline, nullptr);
+        vkDestroyCommandPool(device.device(), m_transferCommandPool, nullptr);
+        if (m_graphicsCommandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device.device(), m_graphicsCommandPool, nullptr);
+        }
+    }
+
+    VkCommandPool UploadBatcher::createCommandPool(uint32_t queueFamilyIndex) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool");
+        }
+        return commandPool;
+    }
+
+    UploadBatcher::Token UploadBatcher::uploadBuffer(VkBuffer destination, const void *data, VkDeviceSize size, VkDeviceSize destinationOffset) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (size == 0) return m_submittedToken;
+
+        VkBuffer stagingBuffer;
+        void *mapped;
+        VkDeviceSize stagingOffset = allocateStaging(size, stagingBuffer, mapped);
+        std::memcpy(static_cast<char *>(mapped) + stagingOffset, data, size);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = destinationOffset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(m_recordingBatch->commandBuffer, stagingBuffer, destination, 1, &copyRegion);
+
+        if (m_dedicatedTransfer) {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.buffer = destination;
+            barrier.offset = destinationOffset;
+            barrier.size = size;
+            m_recordingBatch->bufferOwnershipBarriers.push_back(barrier);
+        }
+
+        m_uploadCount++;
+        m_uploadedBytes += size;
+        return m_recordingBatch->token;
+    }
+
+    UploadBatcher::Token UploadBatcher::uploadImage(VkImage destination, const void *data, VkDeviceSize size, uint32_t width, uint32_t height,
+                                                    uint32_t layerCount, VkImageLayout finalLayout) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = layerCount;
+        region.imageExtent = {width, height, 1};
+        return uploadImage(destination, data, size, {region}, 1, layerCount, finalLayout);
+    }
+
+    UploadBatcher::Token UploadBatcher::uploadImage(VkImage destination, const void *data, VkDeviceSize size,
+                                                    std::vector<VkBufferImageCopy> regions, uint32_t mipLevels, uint32_t layerCount,
+                                                    VkImageLayout finalLayout) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        VkBuffer stagingBuffer;
+        void *mapped;
+        VkDeviceSize stagingOffset = allocateStaging(size, stagingBuffer, mapped);
+        std::memcpy(static_cast<char *>(mapped) + stagingOffset, data, size);
+        VkCommandBuffer commandBuffer = m_recordingBatch->commandBuffer;
+
+        //The previous contents are discarded, so the image needs no ownership before the copy
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = destination;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = layerCount;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        for (auto &region: regions) {
+            region.bufferOffset += stagingOffset;
+        }
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = finalLayout;
+        if (m_dedicatedTransfer) {
+            //The layout transition happens once, as part of the release and acquire pair
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            m_recordingBatch->imageOwnershipBarriers.push_back(barrier);
+        } else {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = device.accessFlagsForImageLayout(finalLayout);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, device.pipelineStageForLayout(finalLayout), 0,
+                                 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        m_uploadCount++;
+        m_uploadedBytes += size;
+        return m_recordingBatch->token;
+    }
+
+    UploadBatcher::Token UploadBatcher::flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return flushLocked();
+    }
+
+    bool UploadBatcher::isComplete(Token token) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        retireBatches(false);
+        return token <= m_completedToken;
+    }
+
+    void UploadBatcher::wait(Token token) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_recordingBatch != nullptr && token >= m_recordingBatch->token) {
+            flushLocked();
+        }
+        while (token > m_completedToken && !m_inFlightBatches.empty()) {
+            retireBatches(true);
+        }
+    }
+
+    void UploadBatcher::waitIdle() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        flushLocked();
+        while (!m_inFlightBatches.empty()) {
+            retireBatches(true);
+        }
+    }
+
+    UploadBatcher::FrameSignal UploadBatcher::frameSubmitSignal() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return {m_frameTimeline, ++m_frameValue};
+    }
+
+    UploadBatcher::Batch &UploadBatcher::recordingBatch() {
+        if (m_recordingBatch != nullptr) return *m_recordingBatch;
+        while (m_freeBatches.empty()) {
+            retireBatches(true);
+        }
+        m_recordingBatch = m_freeBatches.back();
+        m_freeBatches.pop_back();
+        m_recordingBatch->token = m_nextToken++;
+
+        vkResetCommandBuffer(m_recordingBatch->commandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(m_recordingBatch->commandBuffer, &beginInfo);
+
+        //On the graphics queue earlier frames may still read buffers this batch overwrites, the transfer queue waits
+        //on the frame timeline instead
+        if (!m_dedicatedTransfer) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(m_recordingBatch->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        return *m_recordingBatch;
+    }
+
+    VkDeviceSize UploadBatcher::allocateStaging(VkDeviceSize size, VkBuffer &stagingBuffer, void *&mapped) {
+        if (size > StagingRingSize) {
+            auto dedicatedBuffer = std::make_unique<Buffer>(device, size, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1,
+                                                            MemoryAllocator::Strategy::Linear);
+            dedicatedBuffer->map();
+            stagingBuffer = dedicatedBuffer->getBuffer();
+            mapped = dedicatedBuffer->getMappedMemory();
+            recordingBatch().dedicatedStagingBuffers.push_back(std::move(dedicatedBuffer));
+            return 0;
+        }
+
+        VkDeviceSize offset;
+        while (!tryAllocateRing(size, offset)) {
+            if (m_recordingBatch == nullptr && m_inFlightBatches.empty()) {
+                throw std::runtime_error("staging ring is empty but the upload does not fit");
+            }
+            flushLocked();
+            retireBatches(true);
+        }
+
+        Batch &batch = recordingBatch();
+        if (!batch.hasRingAllocation) {
+            batch.ringBegin = offset;
+            batch.hasRingAllocation = true;
+        }
+        m_ringHead = offset + size;
+        stagingBuffer = m_stagingRing->getBuffer();
+        mapped = m_stagingRing->getMappedMemory();
+        return offset;
+    }
+
+    bool UploadBatcher::tryAllocateRing(VkDeviceSize size, VkDeviceSize &offset) {
+        //The oldest batch still holding ring bytes marks the tail
+        const Batch *oldest = nullptr;
+        for (const Batch *batch: m_inFlightBatches) {
+            if (batch->hasRingAllocation) {
+                oldest = batch;
+                break;
+            }
+        }
+        if (oldest == nullptr && m_recordingBatch != nullptr && m_recordingBatch->hasRingAllocation) {
+            oldest = m_recordingBatch;
+        }
+        if (oldest == nullptr) {
+            m_ringHead = 0;
+            offset = 0;
+            return true;
+        }
+
+        //The head never catches up with the tail, so head == tail always means an empty ring
+        VkDeviceSize tail = oldest->ringBegin;
+        VkDeviceSize alignedHead = (m_ringHead + CopyAlignment - 1) & ~(CopyAlignment - 1);
+        if (m_ringHead > tail) {
+            if (alignedHead + size <= StagingRingSize) {
+                offset = alignedHead;
+                return true;
+            }
+            if (size < tail) {
+                offset = 0;
+                return true;
+            }
+            return false;
+        }
+        if (alignedHead + size < tail) {
+            offset = alignedHead;
+            return true;
+        }
+        return false;
+    }
+
+    UploadBatcher::Token UploadBatcher::flushLocked() {
+        if (m_recordingBatch == nullptr) return m_submittedToken;
+        Batch *batch = m_recordingBatch;
+        m_recordingBatch = nullptr;
+
+        while (m_inFlightBatches.size() >= MaxBatchesInFlight) {
+            retireBatches(true);
+        }
+
+        if (m_dedicatedTransfer) {
+            //Release on the transfer queue, acquire with the same barriers on the graphics queue
+            for (auto &barrier: batch->bufferOwnershipBarriers) {
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = 0;
+            }
+            for (auto &barrier: batch->imageOwnershipBarriers) {
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = 0;
+            }
+            vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                 static_cast<uint32_t>(batch->bufferOwnershipBarriers.size()), batch->bufferOwnershipBarriers.data(),
+                                 static_cast<uint32_t>(batch->imageOwnershipBarriers.size()), batch->imageOwnershipBarriers.data());
+            vkEndCommandBuffer(batch->commandBuffer);
+
+            for (auto &barrier: batch->bufferOwnershipBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            }
+            for (auto &barrier: batch->imageOwnershipBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = device.accessFlagsForImageLayout(barrier.newLayout);
+            }
+            vkResetCommandBuffer(batch->acquireCommandBuffer, 0);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(batch->acquireCommandBuffer, &beginInfo);
+            vkCmdPipelineBarrier(batch->acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                                 static_cast<uint32_t>(batch->bufferOwnershipBarriers.size()), batch->bufferOwnershipBarriers.data(),
+                                 static_cast<uint32_t>(batch->imageOwnershipBarriers.size()), batch->imageOwnershipBarriers.data());
+            vkEndCommandBuffer(batch->acquireCommandBuffer);
+
+            //Copies wait for the frames submitted so far, they may still read the buffers being overwritten
+            uint64_t transferWaitValue = m_frameValue;
+            uint64_t transferSignalValue = batch->token;
+            VkTimelineSemaphoreSubmitInfo transferTimelineInfo{};
+            transferTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            transferTimelineInfo.waitSemaphoreValueCount = 1;
+            transferTimelineInfo.pWaitSemaphoreValues = &transferWaitValue;
+            transferTimelineInfo.signalSemaphoreValueCount = 1;
+            transferTimelineInfo.pSignalSemaphoreValues = &transferSignalValue;
+            VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            VkSubmitInfo transferSubmitInfo{};
+            transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            transferSubmitInfo.pNext = &transferTimelineInfo;
+            transferSubmitInfo.waitSemaphoreCount = 1;
+            transferSubmitInfo.pWaitSemaphores = &m_frameTimeline;
+            transferSubmitInfo.pWaitDstStageMask = &transferWaitStage;
+            transferSubmitInfo.commandBufferCount = 1;
+            transferSubmitInfo.pCommandBuffers = &batch->commandBuffer;
+            transferSubmitInfo.signalSemaphoreCount = 1;
+            transferSubmitInfo.pSignalSemaphores = &m_transferTimeline;
+            if (vkQueueSubmit(device.transferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload batch");
+            }
+
+            uint64_t acquireWaitValue = batch->token;
+            uint64_t acquireSignalValue = batch->token;
+            VkTimelineSemaphoreSubmitInfo acquireTimelineInfo{};
+            acquireTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            acquireTimelineInfo.waitSemaphoreValueCount = 1;
+            acquireTimelineInfo.pWaitSemaphoreValues = &acquireWaitValue;
+            acquireTimelineInfo.signalSemaphoreValueCount = 1;
+            acquireTimelineInfo.pSignalSemaphoreValues = &acquireSignalValue;
+            VkPipelineStageFlags acquireWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            VkSubmitInfo acquireSubmitInfo{};
+            acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireSubmitInfo.pNext = &acquireTimelineInfo;
+            acquireSubmitInfo.waitSemaphoreCount = 1;
+            acquireSubmitInfo.pWaitSemaphores = &m_transferTimeline;
+            acquireSubmitInfo.pWaitDstStageMask = &acquireWaitStage;
+            acquireSubmitInfo.commandBufferCount = 1;
+            acquireSubmitInfo.pCommandBuffers = &batch->acquireCommandBuffer;
+            acquireSubmitInfo.signalSemaphoreCount = 1;
+            acquireSubmitInfo.pSignalSemaphores = &m_uploadTimeline;
+            if (vkQueueSubmit(device.graphicsQueue(), 1, &acquireSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload acquire");
+            }
+        } else {
+            //Makes the copies visible to every later submission on the queue
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+            vkEndCommandBuffer(batch->commandBuffer);
+
+            uint64_t signalValue = batch->token;
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &signalValue;
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &batch->commandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &m_uploadTimeline;
+            if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload batch");
+            }
+        }
+
+        m_inFlightBatches.push_back(batch);
+        m_submittedToken = batch->token;
+        m_submitCount++;
+        return m_submittedToken;
+    }
+
+    void UploadBatcher::retireBatches(bool wait) {
+        if (m_inFlightBatches.empty()) return;
+        if (wait) {
+            uint64_t value = m_inFlightBatches.front()->token;
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &m_uploadTimeline;
+            waitInfo.pValues = &value;
+            PROFILE_GPU_WAIT("UploadBatcher::retireBatches");
+            vkWaitSemaphores(device.device(), &waitInfo, UINT64_MAX);
+        }
+
+        uint64_t completedValue = 0;
+        vkGetSemaphoreCounterValue(device.device(), m_uploadTimeline, &completedValue);
+        while (!m_inFlightBatches.empty() && m_inFlightBatches.front()->token <= completedValue) {
+            Batch *batch = m_inFlightBatches.front();
+            m_inFlightBatches.pop_front();
+            m_completedToken = batch->token;
+            batch->hasRingAllocation = false;
+            batch->dedicatedStagingBuffers.clear();
+            batch->bufferOwnershipBarriers.clear();
+            batch->imageOwnershipBarriers.clear();
+            m_freeBatches.push_back(batch);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "Buffer.h"
+
+namespace Kaamoo {
+    //Records host to device copies from a persistent staging ring into one command buffer per batch.
+    //A batch is submitted once it is flushed or the ring runs out of room, callers get the batch token back.
+    //With a dedicated transfer family the copies run on the transfer queue and a short acquire submission on the
+    //graphics queue waits for them on a timeline semaphore, so neither the CPU nor frame recording stalls on uploads
+    class UploadBatcher {
+    public:
+        using Token = uint64_t;
+
+        //Timeline semaphore and value a frame submission signals, see frameSubmitSignal
+        struct FrameSignal {
+            VkSemaphore semaphore;
+            uint64_t value;
+        };
+
+        inline static const VkDeviceSize StagingRingSize = 32 * 1024 * 1024;
+        inline static const uint32_t MaxBatchesInFlight = 4;
+        //Copies start at this alignment, enough for every texel format and optimalBufferCopyOffsetAlignment in practice
+        inline static const VkDeviceSize CopyAlignment = 16;
+
+        explicit UploadBatcher(Device &device);
+
+        ~UploadBatcher();
+
+        UploadBatcher(const UploadBatcher &) = delete;
+
+        UploadBatcher &operator=(const UploadBatcher &) = delete;
+
+        //Overwrites [destinationOffset, destinationOffset + size). On a dedicated transfer queue the rest of the buffer
+        //is not handed back to graphics, so a buffer is always refreshed whole
+        Token uploadBuffer(VkBuffer destination, const void *data, VkDeviceSize size, VkDeviceSize destinationOffset = 0);
+
+        //Copies tightly packed texels into every layer of mip 0 and leaves the image in finalLayout
+        Token uploadImage(VkImage destination, const void *data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t layerCount,
+                          VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        //Copies regions whose buffer offsets are relative to data, covering mipLevels levels of layerCount layers
+        Token uploadImage(VkImage destination, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions,
+                          uint32_t mipLevels, uint32_t layerCount, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        //Submits the batch being recorded, returns its token or the last submitted token when nothing was recorded
+        Token flush();
+
+        bool isComplete(Token token);
+
+        //Flushes first when token belongs to the batch being recorded
+        void wait(Token token);
+
+        void waitIdle();
+
+        //The frame submission signals this, later transfer batches wait for it before overwriting buffers the frame reads
+        FrameSignal frameSubmitSignal();
+
+        uint64_t getSubmitCount() const { return m_submitCount; }
+
+        uint64_t getUploadCount() const { return m_uploadCount; }
+
+        VkDeviceSize getUploadedBytes() const { return m_uploadedBytes; }
+
+    private:
+        struct Batch {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            //Graphics queue side of the queue family ownership transfer, unused without a dedicated transfer family
+            VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+            Token token = 0;
+            //Ring bytes from ringBegin up to the ring head at submission stay reserved until the batch completes
+            VkDeviceSize ringBegin = 0;
+            bool hasRingAllocation = false;
+            //Uploads larger than the ring get their own staging buffer
+            std::vector<std::unique_ptr<Buffer>> dedicatedStagingBuffers;
+            //Release barriers on the transfer queue, replayed as acquire barriers on the graphics queue
+            std::vector<VkBufferMemoryBarrier> bufferOwnershipBarriers;
+            std::vector<VkImageMemoryBarrier> imageOwnershipBarriers;
+        };
+
+        //Returns the batch being recorded, starting one when needed
+        Batch &recordingBatch();
+
+        //Offset of size free bytes in the ring, flushing and waiting on old batches until they fit
+        VkDeviceSize allocateStaging(VkDeviceSize size, VkBuffer &stagingBuffer, void *&mapped);
+
+        bool tryAllocateRing(VkDeviceSize size, VkDeviceSize &offset);
+
+        Token flushLocked();
+
+        //Releases finished batches in submission order, blocking on the oldest one when wait is set
+        void retireBatches(bool wait);
+
+        VkCommandPool createCommandPool(uint32_t queueFamilyIndex);
+
+        Device &device;
+        std::mutex m_mutex;
+        bool m_dedicatedTransfer = false;
+        uint32_t m_transferFamily = 0;
+        uint32_t m_graphicsFamily = 0;
+        VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+        VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+        //Both count tokens. The transfer timeline is signalled by the copies on the transfer queue, the upload timeline by
+        //the submission that makes a batch usable on the graphics queue
+        VkSemaphore m_transferTimeline = VK_NULL_HANDLE;
+        VkSemaphore m_uploadTimeline = VK_NULL_HANDLE;
+        VkSemaphore m_frameTimeline = VK_NULL_HANDLE;
+        uint64_t m_frameValue = 0;
+        std::unique_ptr<Buffer> m_stagingRing;
+        VkDeviceSize m_ringHead = 0;
+
+        std::vector<Batch> m_batches;
+        std::vector<Batch *> m_freeBatches;
+        std::deque<Batch *> m_inFlightBatches;
+        Batch *m_recordingBatch = nullptr;
+
+        Token m_nextToken = 1;
+        Token m_completedToken = 0;
+        Token m_submittedToken = 0;
+        uint64_t m_submitCount = 0;
+        uint64_t m_uploadCount = 0;
+        VkDeviceSize m_uploadedBytes = 0;
+    };
+}
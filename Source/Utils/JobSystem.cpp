@@ -0,0 +1,178 @@
+﻿#include "JobSystem.h"
+
+namespace Kaamoo {
+    namespace {
+        thread_local const JobSystem *currentSystem = nullptr;
+        thread_local size_t currentWorker = 0;
+    }
+
+    JobSystem::JobSystem(size_t workerCount) {
+        for (size_t i = 0; i <= workerCount; i++) {
+            m_queues.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < workerCount; i++) {
+            m_workers.push_back(m_queues[i].get());
+        }
+        for (size_t i = 0; i < workerCount; i++) {
+            m_workers[i]->thread = std::thread([this, i]() { WorkerLoop(i); });
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_sleepCondition.notify_all();
+        for (auto *worker: m_workers) {
+            worker->thread.join();
+        }
+    }
+
+    void JobSystem::Run(std::function<void()> function, Counter *counter, Counter *dependency) {
+        if (counter != nullptr) counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+        if (dependency != nullptr) {
+            std::lock_guard<std::mutex> lock(dependency->m_mutex);
+            //Checked under the lock Finish takes before releasing continuations, so a job is never parked after the release
+            if (!dependency->IsDone()) {
+                dependency->m_continuations.push_back({std::move(function), counter});
+                return;
+            }
+        }
+        Push({std::move(function), counter});
+    }
+
+    void JobSystem::Wait(Counter &counter) {
+        size_t queueIndex = CurrentQueue();
+        Job job;
+        while (!counter.IsDone()) {
+            if (TryPop(queueIndex, job)) {
+                Execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleepCondition.wait(lock, [this, &counter]() { return counter.IsDone() || m_queuedJobs.load() > 0; });
+        }
+
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        if (counter.m_exception) {
+            auto exception = counter.m_exception;
+            counter.m_exception = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void JobSystem::Push(Job job) {
+        if (m_workers.empty()) {
+            Execute(job);
+            return;
+        }
+        auto &queue = *m_queues[CurrentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+        m_queuedJobs.fetch_add(1);
+        WakeSleepers(false);
+    }
+
+    bool JobSystem::TryPop(size_t queueIndex, Job &job) {
+        if (m_queuedJobs.load() == 0) return false;
+        auto tryTake = [this, &job](size_t index, bool newest) {
+            auto &queue = *m_queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) return false;
+            if (newest) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            } else {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        };
+
+        size_t outsideQueue = m_workers.size();
+        if (queueIndex != outsideQueue && tryTake(queueIndex, true)) return true;
+        if (tryTake(outsideQueue, false)) return true;
+        //Start stealing next to ourselves so thieves spread over the workers
+        for (size_t i = 1; i <= m_workers.size(); i++) {
+            size_t victim = (queueIndex + i) % m_workers.size();
+            if (victim != queueIndex && tryTake(victim, false)) return true;
+        }
+        return false;
+    }
+
+    void JobSystem::Execute(Job &job) {
+        try {
+            job.function();
+        } catch (...) {
+            if (job.counter == nullptr) {
+                ReportUncaught(std::current_exception());
+            } else {
+                std::lock_guard<std::mutex> lock(job.counter->m_mutex);
+                if (!job.counter->m_exception) job.counter->m_exception = std::current_exception();
+            }
+        }
+        job.function = nullptr;
+        Finish(job.counter);
+    }
+
+    void JobSystem::SetExceptionHandler(std::function<void(std::exception_ptr)> handler) {
+        std::lock_guard<std::mutex> lock(m_handlerMutex);
+        m_exceptionHandler = std::move(handler);
+    }
+
+    void JobSystem::ReportUncaught(std::exception_ptr exception) {
+        std::function<void(std::exception_ptr)> handler;
+        {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_exceptionHandler;
+        }
+        if (!handler) std::terminate();
+        handler(exception);
+    }
+
+    void JobSystem::Finish(Counter *counter) {
+        if (counter == nullptr) return;
+        std::vector<Counter::Continuation> continuations;
+        {
+            //The lock also keeps Wait from returning, and the counter from going away, before the continuations are taken
+            std::lock_guard<std::mutex> lock(counter->m_mutex);
+            if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            continuations.swap(counter->m_continuations);
+        }
+        for (auto &continuation: continuations) {
+            Push({std::move(continuation.function), continuation.counter});
+        }
+        //Threads waiting on the counter sleep on the same condition
+        WakeSleepers(true);
+    }
+
+    void JobSystem::WorkerLoop(size_t workerIndex) {
+        currentSystem = this;
+        currentWorker = workerIndex;
+        Job job;
+        while (true) {
+            if (TryPop(workerIndex, job)) {
+                Execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleepCondition.wait(lock, [this]() { return m_stopping || m_queuedJobs.load() > 0; });
+            if (m_stopping && m_queuedJobs.load() == 0) return;
+        }
+    }
+
+    size_t JobSystem::CurrentQueue() const {
+        return currentSystem == this ? currentWorker : m_workers.size();
+    }
+
+    void JobSystem::WakeSleepers(bool all) {
+        //Taking the mutex orders this after a sleeper's predicate check, so the wake up cannot slip in between
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        if (all) m_sleepCondition.notify_all();
+        else m_sleepCondition.notify_one();
+    }
+}
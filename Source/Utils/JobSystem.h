@@ -0,0 +1,176 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Kaamoo {
+    //Worker pool shared by the whole engine. Every worker owns a deque, it takes its own newest job first and steals the oldest
+    //job of another worker or of the queue fed by outside threads when it runs dry. Waiting on a Counter runs other jobs instead
+    //of blocking, on workers and on the main thread alike, so jobs can wait for jobs without tying up the pool
+    class JobSystem {
+    public:
+        //Number of jobs in flight. Jobs signal it when they finish, jobs depending on it start once it reaches zero
+        class Counter {
+        public:
+            Counter() = default;
+
+            Counter(const Counter &) = delete;
+
+            Counter &operator=(const Counter &) = delete;
+
+            bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+        private:
+            friend class JobSystem;
+
+            struct Continuation {
+                std::function<void()> function;
+                Counter *counter;
+            };
+
+            std::atomic<size_t> m_pending{0};
+            std::mutex m_mutex;
+            std::vector<Continuation> m_continuations;
+            //First exception a job signalling this counter threw, rethrown by Wait
+            std::exception_ptr m_exception;
+        };
+
+        //ParallelFor grain size that starts with large chunks and shrinks them as the range runs out
+        inline static const size_t AdaptiveGrain = 0;
+
+        static JobSystem &GetInstance() {
+            static JobSystem jobSystem;
+            return jobSystem;
+        }
+
+        explicit JobSystem(size_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1);
+
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        //Worker threads plus the calling thread
+        size_t GetConcurrency() const { return m_workers.size() + 1; }
+
+        //Queues function, counter is signalled once it finished. With a dependency the job waits until that counter is done
+        void Run(std::function<void()> function, Counter *counter = nullptr, Counter *dependency = nullptr);
+
+        //Runs queued jobs until counter is done, then rethrows the first exception of its jobs
+        void Wait(Counter &counter);
+
+        //Receives the exception of a job run without a counter, on the thread that ran the job. Without a handler such an
+        //exception terminates the program, as one escaping a std::thread would
+        void SetExceptionHandler(std::function<void(std::exception_ptr)> handler);
+
+        template<typename F>
+        std::future<void> Submit(F &&function) {
+            auto task = std::make_shared<std::packaged_task<void()>>(std::forward<F>(function));
+            std::future<void> future = task->get_future();
+            Run([task]() { (*task)(); });
+            return future;
+        }
+
+        //Calls function(begin, end) over [0, count). A fixed grainSize makes chunks of exactly that many, AdaptiveGrain hands
+        //out chunks of a share of what is left so the tail still spreads over every thread.
+        //The calling thread takes chunks as well and helps while it waits, so it is safe to call from inside a job
+        template<typename F>
+        void ParallelFor(size_t count, size_t grainSize, F &&function) {
+            if (count == 0) return;
+            size_t concurrency = GetConcurrency();
+            size_t firstChunk = grainSize == AdaptiveGrain ? std::max<size_t>(1, count / (concurrency * 2)) : grainSize;
+            if (firstChunk >= count || m_workers.empty()) {
+                function(size_t(0), count);
+                return;
+            }
+
+            std::atomic<size_t> next{0};
+            auto claim = [&next, count, grainSize, concurrency](size_t &begin, size_t &end) {
+                size_t current = next.load(std::memory_order_relaxed);
+                while (current < count) {
+                    size_t size = grainSize == AdaptiveGrain ? std::max<size_t>(1, (count - current) / (concurrency * 2)) : grainSize;
+                    size_t claimedEnd = std::min(count, current + size);
+                    if (next.compare_exchange_weak(current, claimedEnd, std::memory_order_relaxed)) {
+                        begin = current;
+                        end = claimedEnd;
+                        return true;
+                    }
+                }
+                return false;
+            };
+            auto runChunks = [&claim, &function]() {
+                size_t begin, end;
+                while (claim(begin, end)) function(begin, end);
+            };
+
+            size_t chunkEstimate = grainSize == AdaptiveGrain ? concurrency * 2 : (count + grainSize - 1) / grainSize;
+            size_t helperCount = std::min(m_workers.size(), chunkEstimate - 1);
+            Counter counter;
+            for (size_t i = 0; i < helperCount; i++) {
+                //Helpers that start after every chunk is taken return without touching function
+                Run(runChunks, &counter);
+            }
+
+            std::exception_ptr exception;
+            try {
+                runChunks();
+            } catch (...) {
+                exception = std::current_exception();
+                //Let the helpers drain the range quickly, they stop as soon as nothing is left to claim
+                next.store(count);
+            }
+            Wait(counter);
+            if (exception) std::rethrow_exception(exception);
+        }
+
+    private:
+        struct Job {
+            std::function<void()> function;
+            Counter *counter;
+        };
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::thread thread;
+        };
+
+        void Push(Job job);
+
+        //Own queue first, then the outside queue, then the other workers
+        bool TryPop(size_t queueIndex, Job &job);
+
+        void Execute(Job &job);
+
+        void Finish(Counter *counter);
+
+        void ReportUncaught(std::exception_ptr exception);
+
+        void WorkerLoop(size_t workerIndex);
+
+        //Queue index of the calling thread, the outside queue for threads that are not workers of this system
+        size_t CurrentQueue() const;
+
+        void WakeSleepers(bool all);
+
+        //Workers first, the last queue is fed by threads outside the pool
+        std::vector<std::unique_ptr<Worker>> m_queues;
+        std::vector<Worker *> m_workers;
+        std::atomic<size_t> m_queuedJobs{0};
+        std::mutex m_sleepMutex;
+        std::condition_variable m_sleepCondition;
+        bool m_stopping = false;
+        std::mutex m_handlerMutex;
+        std::function<void(std::exception_ptr)> m_exceptionHandler;
+    };
+}
@@ -0,0 +1,73 @@
+﻿#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+namespace Kaamoo {
+#ifdef _WIN32
+
+    MappedFile::MappedFile(const std::string &path) {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        m_fileHandle = file;
+        m_opened = true;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            m_size = 0;
+            return;
+        }
+        m_mappingHandle = mapping;
+        m_data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == nullptr) m_size = 0;
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data != nullptr) UnmapViewOfFile(m_data);
+        if (m_mappingHandle != nullptr) CloseHandle(m_mappingHandle);
+        if (m_fileHandle != nullptr) CloseHandle(m_fileHandle);
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::string &path) {
+        m_fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (m_fileDescriptor < 0) return;
+        m_opened = true;
+
+        struct stat fileStat{};
+        if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) return;
+        m_size = static_cast<size_t>(fileStat.st_size);
+
+        void *mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+        if (mapped == MAP_FAILED) {
+            m_size = 0;
+            return;
+        }
+        m_data = static_cast<const uint8_t *>(mapped);
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data != nullptr) munmap(const_cast<uint8_t *>(m_data), m_size);
+        if (m_fileDescriptor >= 0) close(m_fileDescriptor);
+    }
+
+#endif
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace Kaamoo {
+    //Read-only memory mapping of a whole file, falls back to an invalid mapping if the file can't be opened
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool isValid() const { return m_data != nullptr || (m_opened && m_size == 0); }
+
+        const uint8_t *data() const { return m_data; }
+
+        size_t size() const { return m_size; }
+
+    private:
+        const uint8_t *m_data = nullptr;
+        size_t m_size = 0;
+        bool m_opened = false;
+
+#ifdef _WIN32
+        void *m_fileHandle = nullptr;
+        void *m_mappingHandle = nullptr;
+#else
+        int m_fileDescriptor = -1;
+#endif
+    };
+}
@@ -0,0 +1,190 @@
+﻿#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace Kaamoo {
+    namespace {
+        thread_local uint32_t scopeDepth = 0;
+
+        std::string escapeJson(const std::string &text) {
+            std::string escaped;
+            escaped.reserve(text.size());
+            for (char character: text) {
+                switch (character) {
+                    case '"':
+                        escaped += "\\\"";
+                        break;
+                    case '\\':
+                        escaped += "\\\\";
+                        break;
+                    case '\n':
+                        escaped += "\\n";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(character) < 0x20) {
+                            char code[8];
+                            std::snprintf(code, sizeof(code), "\\u%04x", character);
+                            escaped += code;
+                        } else {
+                            escaped += character;
+                        }
+                }
+            }
+            return escaped;
+        }
+    }
+
+    Profiler::Scope::Scope(const char *name, Category category) : m_name{name}, m_category{category} {
+        m_recording = Profiler::GetInstance().IsRecording();
+        if (!m_recording) return;
+        scopeDepth++;
+        m_startTime = std::chrono::steady_clock::now();
+    }
+
+    Profiler::Scope::~Scope() {
+        if (!m_recording) return;
+        auto endTime = std::chrono::steady_clock::now();
+        scopeDepth--;
+        auto &profiler = Profiler::GetInstance();
+        int64_t start = profiler.toMicroseconds(m_startTime);
+        profiler.record({m_name, m_category, threadIndex(), scopeDepth, start, profiler.toMicroseconds(endTime) - start});
+    }
+
+    void Profiler::BeginSession(const std::string &name) {
+        threadIndex();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sessionName = name;
+        m_events.clear();
+        m_coldReasons.clear();
+        m_sessionStart = std::chrono::steady_clock::now();
+        m_recording.store(true);
+    }
+
+    void Profiler::MarkCold(const std::string &reason) {
+        if (!IsRecording()) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_coldReasons.push_back(reason);
+    }
+
+    void Profiler::EndSession() {
+        if (!m_recording.exchange(false)) return;
+        int64_t sessionMicroseconds = toMicroseconds(std::chrono::steady_clock::now());
+
+        //Scopes still open on other threads finish into an idle profiler and are dropped
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool cold = !m_coldReasons.empty();
+        writeTrace(m_sessionName + (cold ? "_cold.json" : "_warm.json"), cold, sessionMicroseconds);
+        printSummary(cold, sessionMicroseconds);
+    }
+
+    void Profiler::record(const Event &event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!IsRecording()) return;
+        m_events.push_back(event);
+    }
+
+    int64_t Profiler::toMicroseconds(std::chrono::steady_clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - m_sessionStart).count();
+    }
+
+    uint32_t Profiler::threadIndex() {
+        static std::atomic<uint32_t> nextIndex{0};
+        thread_local uint32_t index = nextIndex.fetch_add(1);
+        return index;
+    }
+
+    void Profiler::writeTrace(const std::string &path, bool cold, int64_t sessionMicroseconds) const {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return;
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"session\":\"" << escapeJson(m_sessionName) << "\",\"startup\":\""
+             << (cold ? "cold" : "warm") << "\",\"coldReasons\":[";
+        for (size_t i = 0; i < m_coldReasons.size(); i++) {
+            file << (i == 0 ? "" : ",") << "\"" << escapeJson(m_coldReasons[i]) << "\"";
+        }
+        file << "]},\"traceEvents\":[\n";
+        file << "{\"name\":\"" << escapeJson(m_sessionName) << "\",\"cat\":\"session\",\"ph\":\"X\",\"ts\":0,\"dur\":" << sessionMicroseconds
+             << ",\"pid\":1,\"tid\":0}";
+        for (const auto &event: m_events) {
+            file << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"" << (event.category == Category::GpuWait ? "gpu_wait" : "cpu")
+                 << "\",\"ph\":\"X\",\"ts\":" << event.startMicroseconds << ",\"dur\":" << event.durationMicroseconds
+                 << ",\"pid\":1,\"tid\":" << event.threadIndex << "}";
+        }
+        file << "\n]}\n";
+        std::cout << "Wrote " << m_events.size() << " trace events to " << path << std::endl;
+    }
+
+    void Profiler::printSummary(bool cold, int64_t sessionMicroseconds) const {
+        struct Row {
+            std::string name;
+            bool gpuWait = false;
+            uint32_t calls = 0;
+            uint32_t minDepth = UINT32_MAX;
+            int64_t firstStart = INT64_MAX;
+            int64_t totalMicroseconds = 0;
+            int64_t selfMicroseconds = 0;
+        };
+
+        //Self time is what is left after the direct children on the same thread, found by replaying each thread's scopes as a stack
+        std::vector<int64_t> childMicroseconds(m_events.size(), 0);
+        std::vector<size_t> order(m_events.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            const auto &first = m_events[a], &second = m_events[b];
+            if (first.threadIndex != second.threadIndex) return first.threadIndex < second.threadIndex;
+            if (first.startMicroseconds != second.startMicroseconds) return first.startMicroseconds < second.startMicroseconds;
+            return first.depth < second.depth;
+        });
+        std::vector<size_t> stack;
+        for (size_t i: order) {
+            const auto &event = m_events[i];
+            while (!stack.empty() && (m_events[stack.back()].threadIndex != event.threadIndex || m_events[stack.back()].depth >= event.depth)) {
+                stack.pop_back();
+            }
+            if (!stack.empty()) childMicroseconds[stack.back()] += event.durationMicroseconds;
+            stack.push_back(i);
+        }
+
+        std::map<std::string, Row> rows;
+        int64_t gpuWaitMicroseconds = 0;
+        for (size_t i = 0; i < m_events.size(); i++) {
+            const auto &event = m_events[i];
+            auto &row = rows[event.name];
+            row.name = event.name;
+            row.gpuWait = event.category == Category::GpuWait;
+            row.calls++;
+            row.minDepth = std::min(row.minDepth, event.depth);
+            row.firstStart = std::min(row.firstStart, event.startMicroseconds);
+            row.totalMicroseconds += event.durationMicroseconds;
+            row.selfMicroseconds += std::max<int64_t>(0, event.durationMicroseconds - childMicroseconds[i]);
+            if (row.gpuWait && event.threadIndex == 0) gpuWaitMicroseconds += event.durationMicroseconds;
+        }
+        std::vector<Row> sortedRows;
+        for (auto &pair: rows) sortedRows.push_back(pair.second);
+        std::sort(sortedRows.begin(), sortedRows.end(), [](const Row &a, const Row &b) { return a.totalMicroseconds > b.totalMicroseconds; });
+
+        auto toMilliseconds = [](int64_t microseconds) { return static_cast<double>(microseconds) / 1000.0; };
+        std::cout << "---- " << m_sessionName << " (" << (cold ? "cold" : "warm") << "): " << std::fixed << std::setprecision(1)
+                  << toMilliseconds(sessionMicroseconds) << " ms, " << toMilliseconds(gpuWaitMicroseconds) << " ms waiting on the GPU ----" << std::endl;
+        for (const auto &reason: m_coldReasons) {
+            std::cout << "  cold: " << reason << std::endl;
+        }
+        std::cout << std::left << std::setw(44) << "  Phase" << std::right << std::setw(8) << "Calls" << std::setw(12) << "Total ms"
+                  << std::setw(12) << "Self ms" << std::setw(9) << "%" << std::endl;
+        for (const auto &row: sortedRows) {
+            std::string label = std::string(2 + 2 * std::min(row.minDepth, 6u), ' ') + row.name + (row.gpuWait ? " [gpu wait]" : "");
+            std::cout << std::left << std::setw(44) << label << std::right << std::setw(8) << row.calls
+                      << std::setw(12) << toMilliseconds(row.totalMicroseconds) << std::setw(12) << toMilliseconds(row.selfMicroseconds)
+                      << std::setw(8) << 100.0 * static_cast<double>(row.totalMicroseconds) / static_cast<double>(std::max<int64_t>(1, sessionMicroseconds))
+                      << "%" << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+}
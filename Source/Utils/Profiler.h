@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Define to print per asset import statistics while loading: parse speed, cache hits, vertex cache, LOD and meshlet
+//figures and texture PSNR. The startup trace already has the timings, so loads are quiet by default
+//#define ASSET_STATISTICS
+
+namespace Kaamoo {
+    //Records nested phase timings during a session, startup in practice, and writes them as a Chrome trace
+    //(chrome://tracing or ui.perfetto.dev) next to a summary table on stdout.
+    //A session that had to cook assets or build pipelines from scratch is reported as cold, separately from warm ones
+    class Profiler {
+    public:
+        enum class Category {
+            Cpu,
+            //The CPU blocked on a fence, semaphore or queue idle
+            GpuWait
+        };
+
+        //Times its own lifetime, costs one atomic load while no session is recording
+        class Scope {
+        public:
+            explicit Scope(const char *name, Category category = Category::Cpu);
+
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            const char *m_name;
+            Category m_category;
+            bool m_recording;
+            std::chrono::steady_clock::time_point m_startTime;
+        };
+
+        static Profiler &GetInstance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        //Drops what an earlier session recorded and starts recording
+        void BeginSession(const std::string &name);
+
+        //Something this session paid for that a later run gets from a cache
+        void MarkCold(const std::string &reason);
+
+        //Stops recording, writes <name>_cold.json or <name>_warm.json and prints the summary
+        void EndSession();
+
+        bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+
+    private:
+        struct Event {
+            const char *name;
+            Category category;
+            uint32_t threadIndex;
+            uint32_t depth;
+            int64_t startMicroseconds;
+            int64_t durationMicroseconds;
+        };
+
+        Profiler() = default;
+
+        void record(const Event &event);
+
+        int64_t toMicroseconds(std::chrono::steady_clock::time_point time) const;
+
+        //Small per thread number, the thread that began the session is 0
+        static uint32_t threadIndex();
+
+        void writeTrace(const std::string &path, bool cold, int64_t sessionMicroseconds) const;
+
+        void printSummary(bool cold, int64_t sessionMicroseconds) const;
+
+        std::atomic<bool> m_recording{false};
+        std::string m_sessionName;
+        std::chrono::steady_clock::time_point m_sessionStart;
+        mutable std::mutex m_mutex;
+        std::vector<Event> m_events;
+        std::vector<std::string> m_coldReasons;
+    };
+}
+
+#define KAAMOO_PROFILE_CONCAT_INNER(a, b) a##b
+#define KAAMOO_PROFILE_CONCAT(a, b) KAAMOO_PROFILE_CONCAT_INNER(a, b)
+//name must outlive the session, pass string literals
+#define PROFILE_SCOPE(name) Kaamoo::Profiler::Scope KAAMOO_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_WAIT(name) Kaamoo::Profiler::Scope KAAMOO_PROFILE_CONCAT(profileScope, __LINE__)(name, Kaamoo::Profiler::Category::GpuWait)
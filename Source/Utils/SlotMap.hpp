@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Kaamoo {
+    //Names a SlotMap element. The generation changes when the slot is reused, so a handle to an erased element never
+    //resolves to whatever took its place
+    struct SlotMapHandle {
+        inline static const uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+        uint32_t index = InvalidIndex;
+        uint32_t generation = 0;
+
+        bool IsValid() const { return index != InvalidIndex; }
+
+        bool operator==(const SlotMapHandle &other) const { return index == other.index && generation == other.generation; }
+
+        bool operator!=(const SlotMapHandle &other) const { return !(*this == other); }
+
+        struct Hash {
+            size_t operator()(const SlotMapHandle &handle) const {
+                return std::hash<uint64_t>()(static_cast<uint64_t>(handle.generation) << 32 | handle.index);
+            }
+        };
+    };
+
+    //Values live packed in one vector and are iterated in that order. Handles go through a slot table, so they stay valid
+    //while other values are inserted or erased. Erasing moves the last value into the hole, pointers to values do not survive it
+    template<typename T>
+    class SlotMap {
+    public:
+        using Handle = SlotMapHandle;
+        using iterator = typename std::vector<T>::iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+        Handle insert(T &&value) {
+            uint32_t slotIndex;
+            if (!m_freeSlots.empty()) {
+                slotIndex = m_freeSlots.back();
+                m_freeSlots.pop_back();
+            } else {
+                slotIndex = static_cast<uint32_t>(m_slots.size());
+                m_slots.push_back({});
+            }
+            m_slots[slotIndex].denseIndex = static_cast<uint32_t>(m_values.size());
+            m_values.push_back(std::move(value));
+            m_denseToSlot.push_back(slotIndex);
+            return {slotIndex, m_slots[slotIndex].generation};
+        }
+
+        bool erase(Handle handle) {
+            if (!contains(handle)) return false;
+            uint32_t denseIndex = m_slots[handle.index].denseIndex;
+            uint32_t lastIndex = static_cast<uint32_t>(m_values.size() - 1);
+            if (denseIndex != lastIndex) {
+                std::swap(m_values[denseIndex], m_values[lastIndex]);
+                m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+                m_slots[m_denseToSlot[denseIndex]].denseIndex = denseIndex;
+            }
+            m_values.pop_back();
+            m_denseToSlot.pop_back();
+            m_slots[handle.index].generation++;
+            m_slots[handle.index].denseIndex = Handle::InvalidIndex;
+            m_freeSlots.push_back(handle.index);
+            return true;
+        }
+
+        bool contains(Handle handle) const {
+            return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation &&
+                   m_slots[handle.index].denseIndex != Handle::InvalidIndex;
+        }
+
+        //Null once the value was erased
+        T *get(Handle handle) { return contains(handle) ? &m_values[m_slots[handle.index].denseIndex] : nullptr; }
+
+        const T *get(Handle handle) const { return contains(handle) ? &m_values[m_slots[handle.index].denseIndex] : nullptr; }
+
+        //Handle of the value at position denseIndex of the iteration order
+        Handle handleAt(size_t denseIndex) const {
+            uint32_t slotIndex = m_denseToSlot[denseIndex];
+            return {slotIndex, m_slots[slotIndex].generation};
+        }
+
+        size_t size() const { return m_values.size(); }
+
+        bool empty() const { return m_values.empty(); }
+
+        void reserve(size_t capacity) {
+            m_values.reserve(capacity);
+            m_denseToSlot.reserve(capacity);
+            m_slots.reserve(capacity);
+        }
+
+        //Destroys the values, handles given out so far stay invalid
+        void clear() {
+            while (!m_values.empty()) erase(handleAt(m_values.size() - 1));
+        }
+
+        iterator begin() { return m_values.begin(); }
+
+        iterator end() { return m_values.end(); }
+
+        const_iterator begin() const { return m_values.begin(); }
+
+        const_iterator end() const { return m_values.end(); }
+
+    private:
+        struct Slot {
+            uint32_t denseIndex = Handle::InvalidIndex;
+            uint32_t generation = 0;
+        };
+
+        std::vector<T> m_values;
+        std::vector<uint32_t> m_denseToSlot;
+        std::vector<Slot> m_slots;
+        std::vector<uint32_t> m_freeSlots;
+    };
+}
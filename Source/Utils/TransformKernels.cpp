@@ -0,0 +1,162 @@
+﻿#include "TransformKernels.h"
+#include "TransformKernelsBasis.h"
+#include <cmath>
+
+#ifdef TRANSFORM_SIMD
+
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#endif
+
+namespace Kaamoo {
+    namespace {
+#ifdef TRANSFORM_SIMD
+
+        //Cephes style sine and cosine of four angles. Accurate to a few ulp for |x| up to 8192, larger angles are handled by the
+        //scalar path
+        inline void SinCos(__m128 x, __m128 &sine, __m128 &cosine) {
+            const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000)));
+            __m128 signSin = _mm_and_ps(x, signMask);
+            x = _mm_andnot_ps(signMask, x);
+
+            __m128 y = _mm_mul_ps(x, _mm_set1_ps(1.27323954473516f));
+            __m128i octant = _mm_cvttps_epi32(y);
+            octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+            y = _mm_cvtepi32_ps(octant);
+
+            __m128 swapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29));
+            __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+            __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+            signSin = _mm_xor_ps(signSin, swapSignSin);
+
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+
+            __m128 z = _mm_mul_ps(x, x);
+            __m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+            cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+            cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+            cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+            cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+            __m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+            sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+            sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+            sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+            //Octants 1, 2, 5 and 6 swap the polynomials
+            __m128 sinResult = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+            __m128 cosResult = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+            sine = _mm_xor_ps(sinResult, signSin);
+            cosine = _mm_xor_ps(cosResult, signCos);
+        }
+
+#endif
+    }
+
+    void TransformKernels::Compose(const TRSArrays &trs, size_t count, float *matrices) {
+#ifdef TRANSFORM_SIMD
+        static const bool hasAVX2 = HasAVX2();
+        size_t avxCount = hasAVX2 ? count & ~static_cast<size_t>(7) : 0;
+        size_t sseCount = count & ~static_cast<size_t>(3);
+        if (avxCount > 0) ComposeAVX2(trs, 0, avxCount, matrices);
+        ComposeSSE(trs, avxCount, sseCount, matrices);
+        ComposeScalar(trs, sseCount, count, matrices);
+#else
+        ComposeScalar(trs, 0, count, matrices);
+#endif
+    }
+
+    void TransformKernels::ComposeScalar(const TRSArrays &trs, size_t begin, size_t end, float *matrices) {
+        auto mul = [](float a, float b) { return a * b; };
+        auto add = [](float a, float b) { return a + b; };
+        auto sub = [](float a, float b) { return a - b; };
+        auto neg = [](float a) { return -a; };
+        for (size_t i = begin; i < end; i++) {
+            float basis[9];
+            ComposeBasis(std::cos(trs.rotation[0][i]), std::sin(trs.rotation[0][i]),
+                         std::cos(trs.rotation[1][i]), std::sin(trs.rotation[1][i]),
+                         std::cos(trs.rotation[2][i]), std::sin(trs.rotation[2][i]),
+                         trs.scale[0][i], trs.scale[1][i], trs.scale[2][i], basis, mul, add, sub, neg);
+            float *matrix = matrices + i * 16;
+            for (int column = 0; column < 3; column++) {
+                matrix[column * 4 + 0] = basis[column * 3 + 0];
+                matrix[column * 4 + 1] = basis[column * 3 + 1];
+                matrix[column * 4 + 2] = basis[column * 3 + 2];
+                matrix[column * 4 + 3] = 0;
+            }
+            matrix[12] = trs.translation[0][i];
+            matrix[13] = trs.translation[1][i];
+            matrix[14] = trs.translation[2][i];
+            matrix[15] = 1;
+        }
+    }
+
+#ifdef TRANSFORM_SIMD
+
+    bool TransformKernels::HasAVX2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        //The CPU has AVX and OSXSAVE, and the OS saves the upper halves of the registers on a context switch
+        bool osSupport = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSupport && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    void TransformKernels::ComposeSSE(const TRSArrays &trs, size_t begin, size_t end, float *matrices) {
+        auto mul = [](__m128 a, __m128 b) { return _mm_mul_ps(a, b); };
+        auto add = [](__m128 a, __m128 b) { return _mm_add_ps(a, b); };
+        auto sub = [](__m128 a, __m128 b) { return _mm_sub_ps(a, b); };
+        auto neg = [](__m128 a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000)))); };
+        const __m128 reductionLimit = _mm_set1_ps(8192.0f);
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+        for (size_t i = begin; i < end; i += 4) {
+            __m128 rx = _mm_loadu_ps(trs.rotation[0] + i);
+            __m128 ry = _mm_loadu_ps(trs.rotation[1] + i);
+            __m128 rz = _mm_loadu_ps(trs.rotation[2] + i);
+            __m128 largest = _mm_max_ps(_mm_and_ps(rx, absMask), _mm_max_ps(_mm_and_ps(ry, absMask), _mm_and_ps(rz, absMask)));
+            if (_mm_movemask_ps(_mm_cmpgt_ps(largest, reductionLimit)) != 0) {
+                ComposeScalar(trs, i, i + 4, matrices);
+                continue;
+            }
+
+            __m128 sx, cx, sy, cy, sz, cz;
+            SinCos(rx, sx, cx);
+            SinCos(ry, sy, cy);
+            SinCos(rz, sz, cz);
+
+            __m128 basis[9];
+            ComposeBasis(cx, sx, cy, sy, cz, sz, _mm_loadu_ps(trs.scale[0] + i), _mm_loadu_ps(trs.scale[1] + i),
+                         _mm_loadu_ps(trs.scale[2] + i), basis, mul, add, sub, neg);
+
+            //Lane j of every register belongs to transform i + j, transposing a column's rows gives that column per transform
+            __m128 columns[4][4] = {
+                    {basis[0], basis[1], basis[2], _mm_setzero_ps()},
+                    {basis[3], basis[4], basis[5], _mm_setzero_ps()},
+                    {basis[6], basis[7], basis[8], _mm_setzero_ps()},
+                    {_mm_loadu_ps(trs.translation[0] + i), _mm_loadu_ps(trs.translation[1] + i), _mm_loadu_ps(trs.translation[2] + i), _mm_set1_ps(1.0f)},
+            };
+            for (int column = 0; column < 4; column++) {
+                __m128 *rows = columns[column];
+                _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+                for (int lane = 0; lane < 4; lane++) {
+                    _mm_storeu_ps(matrices + (i + lane) * 16 + column * 4, rows[lane]);
+                }
+            }
+        }
+    }
+
+#endif
+}
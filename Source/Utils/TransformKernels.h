@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SIMD
+#endif
+
+namespace Kaamoo {
+    //World translation, Euler rotation and scale of a batch of transforms, one array per component
+    struct TRSArrays {
+        const float *translation[3];
+        const float *rotation[3];
+        const float *scale[3];
+    };
+
+    //Builds translate * rotateY * rotateX * rotateZ * scale for every transform of a batch, the matrices TransformComponent
+    //used to compose with three glm::rotate calls each. Output is 16 floats per transform in glm::mat4's column-major layout
+    class TransformKernels {
+    public:
+        TransformKernels() = delete;
+
+        //AVX2 when the CPU has it, then SSE2 when the target has it, the scalar path for the rest
+        static void Compose(const TRSArrays &trs, size_t count, float *matrices);
+
+        static void ComposeScalar(const TRSArrays &trs, size_t begin, size_t end, float *matrices);
+
+#ifdef TRANSFORM_SIMD
+
+        //Four transforms per iteration with SSE2, end - begin has to be a multiple of 4
+        static void ComposeSSE(const TRSArrays &trs, size_t begin, size_t end, float *matrices);
+
+        //Eight transforms per iteration, end - begin has to be a multiple of 8. Only TransformKernelsAVX2.cpp is built with
+        //AVX2, so this may only run when HasAVX2 says so
+        static void ComposeAVX2(const TRSArrays &trs, size_t begin, size_t end, float *matrices);
+
+        //Whether the CPU and the OS support AVX2
+        static bool HasAVX2();
+
+#endif
+    };
+}
@@ -0,0 +1,109 @@
+﻿#include "TransformKernels.h"
+#include "TransformKernelsBasis.h"
+
+#ifdef TRANSFORM_SIMD
+
+#include <immintrin.h>
+
+//The only file built with AVX2. Nothing from the standard library is used here, an inline function compiled with AVX2 could
+//otherwise be the copy the linker keeps for every caller
+namespace Kaamoo {
+    namespace {
+        //SinCos of TransformKernels.cpp on eight angles
+        inline void SinCos(__m256 x, __m256 &sine, __m256 &cosine) {
+            const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000)));
+            __m256 signSin = _mm256_and_ps(x, signMask);
+            x = _mm256_andnot_ps(signMask, x);
+
+            __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f));
+            __m256i octant = _mm256_cvttps_epi32(y);
+            octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+            y = _mm256_cvtepi32_ps(octant);
+
+            __m256 swapSignSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29));
+            __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+            __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+            signSin = _mm256_xor_ps(signSin, swapSignSin);
+
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-0.78515625f)));
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-2.4187564849853515625e-4f)));
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-3.77489497744594108e-8f)));
+
+            __m256 z = _mm256_mul_ps(x, x);
+            __m256 cosPoly = _mm256_set1_ps(2.443315711809948e-5f);
+            cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(-1.388731625493765e-3f));
+            cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(4.166664568298827e-2f));
+            cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+            cosPoly = _mm256_add_ps(_mm256_sub_ps(cosPoly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+            __m256 sinPoly = _mm256_set1_ps(-1.9515295891e-4f);
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(8.3321608736e-3f));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(-1.6666654611e-1f));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, z), x), x);
+
+            //Octants 1, 2, 5 and 6 swap the polynomials
+            __m256 sinResult = _mm256_blendv_ps(cosPoly, sinPoly, polyMask);
+            __m256 cosResult = _mm256_blendv_ps(sinPoly, cosPoly, polyMask);
+            sine = _mm256_xor_ps(sinResult, signSin);
+            cosine = _mm256_xor_ps(cosResult, signCos);
+        }
+    }
+
+    void TransformKernels::ComposeAVX2(const TRSArrays &trs, size_t begin, size_t end, float *matrices) {
+        auto mul = [](__m256 a, __m256 b) { return _mm256_mul_ps(a, b); };
+        auto add = [](__m256 a, __m256 b) { return _mm256_add_ps(a, b); };
+        auto sub = [](__m256 a, __m256 b) { return _mm256_sub_ps(a, b); };
+        auto neg = [](__m256 a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000)))); };
+        const __m256 reductionLimit = _mm256_set1_ps(8192.0f);
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+        for (size_t i = begin; i < end; i += 8) {
+            __m256 rx = _mm256_loadu_ps(trs.rotation[0] + i);
+            __m256 ry = _mm256_loadu_ps(trs.rotation[1] + i);
+            __m256 rz = _mm256_loadu_ps(trs.rotation[2] + i);
+            __m256 largest = _mm256_max_ps(_mm256_and_ps(rx, absMask), _mm256_max_ps(_mm256_and_ps(ry, absMask), _mm256_and_ps(rz, absMask)));
+            if (_mm256_movemask_ps(_mm256_cmp_ps(largest, reductionLimit, _CMP_GT_OQ)) != 0) {
+                ComposeScalar(trs, i, i + 8, matrices);
+                continue;
+            }
+
+            __m256 sx, cx, sy, cy, sz, cz;
+            SinCos(rx, sx, cx);
+            SinCos(ry, sy, cy);
+            SinCos(rz, sz, cz);
+
+            __m256 basis[9];
+            ComposeBasis(cx, sx, cy, sy, cz, sz, _mm256_loadu_ps(trs.scale[0] + i), _mm256_loadu_ps(trs.scale[1] + i),
+                         _mm256_loadu_ps(trs.scale[2] + i), basis, mul, add, sub, neg);
+
+            //Transposing four rows inside each 128-bit half leaves one column of transform i + j in the low half of register j
+            //and of transform i + j + 4 in the high half
+            __m256 columns[4][4] = {
+                    {basis[0], basis[1], basis[2], _mm256_setzero_ps()},
+                    {basis[3], basis[4], basis[5], _mm256_setzero_ps()},
+                    {basis[6], basis[7], basis[8], _mm256_setzero_ps()},
+                    {_mm256_loadu_ps(trs.translation[0] + i), _mm256_loadu_ps(trs.translation[1] + i), _mm256_loadu_ps(trs.translation[2] + i), _mm256_set1_ps(1.0f)},
+            };
+            for (auto &rows: columns) {
+                __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+                __m256 t1 = _mm256_unpacklo_ps(rows[2], rows[3]);
+                __m256 t2 = _mm256_unpackhi_ps(rows[0], rows[1]);
+                __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+                rows[0] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+                rows[1] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+                rows[2] = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                rows[3] = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            }
+            for (int lane = 0; lane < 4; lane++) {
+                float *low = matrices + (i + lane) * 16;
+                float *high = matrices + (i + lane + 4) * 16;
+                _mm256_storeu_ps(low, _mm256_permute2f128_ps(columns[0][lane], columns[1][lane], 0x20));
+                _mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(columns[2][lane], columns[3][lane], 0x20));
+                _mm256_storeu_ps(high, _mm256_permute2f128_ps(columns[0][lane], columns[1][lane], 0x31));
+                _mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(columns[2][lane], columns[3][lane], 0x31));
+            }
+        }
+    }
+}
+
+#endif
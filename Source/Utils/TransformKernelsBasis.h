@@ -0,0 +1,21 @@
+﻿#pragma once
+
+namespace Kaamoo {
+    //Shared by the scalar, SSE2 and AVX2 kernels, which build in different files with different instruction sets.
+    //Rotation part of rotateY(ry) * rotateX(rx) * rotateZ(rz), columns scaled by the transform's scale
+    template<typename F, typename Mul, typename Add, typename Sub, typename Neg>
+    inline void ComposeBasis(F cx, F sx, F cy, F sy, F cz, F sz, F scaleX, F scaleY, F scaleZ, F *basis,
+                             Mul mul, Add add, Sub sub, Neg neg) {
+        F sysx = mul(sy, sx);
+        F cysx = mul(cy, sx);
+        basis[0] = mul(add(mul(cy, cz), mul(sysx, sz)), scaleX);
+        basis[1] = mul(mul(cx, sz), scaleX);
+        basis[2] = mul(sub(mul(cysx, sz), mul(sy, cz)), scaleX);
+        basis[3] = mul(sub(mul(sysx, cz), mul(cy, sz)), scaleY);
+        basis[4] = mul(mul(cx, cz), scaleY);
+        basis[5] = mul(add(mul(sy, sz), mul(cysx, cz)), scaleY);
+        basis[6] = mul(mul(sy, cx), scaleZ);
+        basis[7] = mul(neg(sx), scaleZ);
+        basis[8] = mul(mul(cy, cx), scaleZ);
+    }
+}